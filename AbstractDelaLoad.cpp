@@ -156,7 +156,33 @@ int is_abstract_or_persistent_dictionary_filename(const char* filename)
     return 0;
 }
 
-static struct INF_codes* try_read_inp(const char*fn)
+/**
+ * A packed .inp file is memory-mapped, and the strings of the INF_codes
+ * structure built from it point directly into the mapping. So, the mapping
+ * must live as long as the structure, and multiple processes that use the
+ * same dictionary share its pages.
+ */
+struct mapped_inp {
+    ABSTRACTMAPFILE* amf;
+    const void* buf;
+};
+
+static void ABSTRACT_CALLBACK_UNITEX free_mapped_pack_INF(struct INF_codes* INF, struct INF_free_info* p_inf_free_info, void* privateSpacePtr)
+{
+  DISCARD_UNUSED_PARAMETER(privateSpacePtr)
+  free_pack_inf(INF, NULL);
+  struct mapped_inp* m = (struct mapped_inp*)p_inf_free_info->private_ptr;
+  af_release_mapfile_pointer(m->amf, m->buf);
+  af_close_mapfile(m->amf);
+  free(m);
+}
+
+/**
+ * Looks for the packed version of the given .inf file, i.e. the file with
+ * the same name ending with 'p' instead of 'f', and loads it by mapping it.
+ * Returns NULL if there is no such file.
+ */
+static struct INF_codes* try_read_inp(const char*fn,struct INF_free_info* p_inf_free_info)
 {
   char modified_name[256];
   size_t len_file_name = strlen(fn);
@@ -175,19 +201,36 @@ static struct INF_codes* try_read_inp(const char*fn)
   strcpy(use_buffer, fn);
   *(use_buffer + len_file_name - 1) = 'p';
 
-  struct INF_codes* res = read_pack_inf_from_file(fn, NULL);
+  ABSTRACTMAPFILE* amf = af_open_mapfile(use_buffer, MAPFILE_OPTION_READ, 0);
   if (must_free_buffer)
     free(use_buffer);
+  if (amf == NULL) {
+    return NULL;
+  }
+  const void* buf = af_get_mapfile_pointer(amf);
+  struct INF_codes* res = NULL;
+  if (buf != NULL) {
+    res = read_pack_inf_from_permanent_memory(buf, af_get_mapfile_size(amf), NULL, true);
+  }
+  if (res == NULL) {
+    if (buf != NULL)
+      af_release_mapfile_pointer(amf, buf);
+    af_close_mapfile(amf);
+    return NULL;
+  }
+  struct mapped_inp* m = (struct mapped_inp*)malloc(sizeof(struct mapped_inp));
+  if (m == NULL) {
+    fatal_alloc_error("try_read_inp");
+  }
+  m->amf = amf;
+  m->buf = buf;
+  p_inf_free_info->must_be_free = 1;
+  p_inf_free_info->func_free_inf = (void*)&free_mapped_pack_INF;
+  p_inf_free_info->private_ptr = m;
+  p_inf_free_info->privateSpacePtr = NULL;
   return res;
 }
 
-static void ABSTRACT_CALLBACK_UNITEX free_pack_INF(struct INF_codes* INF, struct INF_free_info* p_inf_free_info, void* privateSpacePtr)
-{
-  DISCARD_UNUSED_PARAMETER(p_inf_free_info)
-  DISCARD_UNUSED_PARAMETER(privateSpacePtr)
-  free_pack_inf(INF, NULL);
-}
-
 const struct INF_codes* load_abstract_INF_file(const VersatileEncodingConfig* vec,const char* name,struct INF_free_info* p_inf_free_info)
 {
     struct INF_codes* res = NULL;
@@ -195,14 +238,9 @@ const struct INF_codes* load_abstract_INF_file(const VersatileEncodingConfig* ve
     if (pads == NULL)
     {
 
-        res = try_read_inp(name);
+        res = try_read_inp(name,p_inf_free_info);
         if (res != NULL)
         {
-            if (p_inf_free_info != NULL) {
-                p_inf_free_info->must_be_free = 1;
-                p_inf_free_info->func_free_inf = (void*)&free_pack_INF;
-                p_inf_free_info->private_ptr = NULL;
-            }
           return res;
         }
 
@@ -25,6 +25,8 @@
 #include "Error.h"
 #include "File.h"
 #include "BuildTextAutomaton.h"
+#include "SyncTool.h"
+#include "Persistence.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -38,6 +40,9 @@ namespace unitex {
  */
 #define TOKENS_IN_A_COMPOUND 256
 
+/* The first bytes of a Dico memo file */
+#define DICO_MEMO_FILE_MAGIC "UDICMEM1"
+
 /* This margin is used for compound words: when we are at less
  * than 'MARGIN_BEFORE_BUFFER_END' from the end of the buffer, we will
  * refill it, unless we are at the end of the input file. */
@@ -248,6 +253,362 @@ while (l!=NULL) {
 }
 
 
+/**
+ * This structure is used to memorize the result of the lookup of a simple word
+ * token in a .bin dictionary: 'known' indicates if the token is an entry of
+ * the dictionary, 'lines' contains the corresponding DELAF lines, and 'offsets'
+ * contains the offsets associated to the token in the word_array, so that
+ * compound words can still be looked for from this token. 'is_new' is used
+ * to know which entries must be appended to the memo file.
+ */
+struct dico_memo_entry {
+   int known;
+   vector_ptr* lines;
+   struct offset_list* offsets;
+   int is_new;
+};
+
+
+/**
+ * The memo of a .bin dictionary. 'forms' contains the token forms, and
+ * entries->tab[i] is the memo entry of the form #i. 'current' is the entry
+ * being filled by explore_bin_simple_words, if any.
+ */
+struct dico_memo {
+   uint64_t key;
+   struct string_hash* forms;
+   vector_ptr* entries;
+   struct dico_memo_entry* current;
+   /* 0 if the memo file exists but could not be read correctly */
+   int can_save;
+};
+
+
+static struct dico_memo_entry* new_dico_memo_entry() {
+struct dico_memo_entry* e=(struct dico_memo_entry*)malloc(sizeof(struct dico_memo_entry));
+if (e==NULL) {
+   fatal_alloc_error("new_dico_memo_entry");
+}
+e->known=0;
+e->lines=new_vector_ptr(1);
+e->offsets=NULL;
+e->is_new=0;
+return e;
+}
+
+
+static void free_dico_memo_entry(void* ptr) {
+struct dico_memo_entry* e=(struct dico_memo_entry*)ptr;
+if (e==NULL) return;
+free_vector_ptr(e->lines,free);
+free_offset_list(e->offsets);
+free(e);
+}
+
+
+static void add_dico_memo_entry(struct dico_memo* memo,const unichar* form,struct dico_memo_entry* e) {
+int n=get_value_index(form,memo->forms);
+if (n<memo->entries->nbelems) {
+   /* The form can only be there twice if several processes
+    * appended it to the memo file */
+   free_dico_memo_entry(e);
+   return;
+}
+vector_ptr_add(memo->entries,e);
+}
+
+
+/**
+ * Does for the given token what explore_bin_simple_words would do, using the
+ * given memo entry instead of looking the token up in the dictionary.
+ */
+static void use_dico_memo_entry(struct dico_application_info* info,struct dico_memo_entry* e,
+                                int token_number,int priority) {
+if (info->word_array!=NULL && e->offsets!=NULL) {
+   if (info->word_array->element[token_number]==NULL) {
+      info->word_array->element[token_number]=new_word_struct();
+   }
+   struct word_struct* w=info->word_array->element[token_number];
+   for (struct offset_list* l=e->offsets;l!=NULL;l=l->next) {
+      w->list=get_offset(l->offset,w->list,l->content,l->base,l->output);
+   }
+}
+if (!e->known) return;
+int p=0;
+if (info->simple_word!=NULL) p=get_value(info->simple_word,token_number);
+if (p!=0 && p!=priority) return;
+if (info->part_of_a_word!=NULL) set_value(info->part_of_a_word,token_number,1);
+if (info->simple_word!=NULL) set_value(info->simple_word,token_number,priority);
+for (int i=0;i<e->lines->nbelems;i++) {
+   if (info->dic_name[0]!='\0') {
+      u_fprintf(info->dlf,"%s\n",info->dic_name);
+      info->dic_name[0]='\0';
+   }
+   u_fprintf(info->dlf,"%S\n",(unichar*)e->lines->tab[i]);
+}
+}
+
+
+/**
+ * FNV-1a hash of the given data, starting from 'h' (0 for a new hash).
+ */
+static uint64_t hash_dico_memo_data(uint64_t h,const void* data,size_t size) {
+if (h==0) h=14695981039346656037ULL;
+const unsigned char* c=(const unsigned char*)data;
+for (size_t i=0;i<size;i++) {
+    h^=c[i];
+    h*=1099511628211ULL;
+}
+return h;
+}
+
+
+/**
+ * Adds the content of the given file to the hash 'h'. If the file cannot
+ * be read, only its absence is taken into account.
+ */
+uint64_t hash_dico_memo_file(uint64_t h,const char* name) {
+ABSTRACTMAPFILE* amf=af_open_mapfile(name,MAPFILE_OPTION_READ,0);
+if (amf==NULL) {
+   return hash_dico_memo_data(h,"",1);
+}
+size_t size=af_get_mapfile_size(amf);
+const void* data=af_get_mapfile_pointer(amf);
+h=hash_dico_memo_data(h,&size,sizeof(size_t));
+if (data!=NULL) {
+   h=hash_dico_memo_data(h,data,size);
+   af_release_mapfile_pointer(amf,data);
+}
+af_close_mapfile(amf);
+return h;
+}
+
+
+static void write_memo_int(int n,U_FILE* f) {
+fwrite(&n,sizeof(int),1,f);
+}
+
+
+static void write_memo_string(const unichar* s,U_FILE* f) {
+if (s==NULL) {
+   write_memo_int(-1,f);
+   return;
+}
+int length=u_strlen(s);
+write_memo_int(length,f);
+fwrite(s,sizeof(unichar),length,f);
+}
+
+
+/**
+ * Reads an int at the given position of the memo file, checking that it
+ * does not go beyond the end of the file.
+ */
+static int read_memo_int(const unsigned char* data,size_t size,size_t* pos,int* n) {
+if ((*pos)+sizeof(int)>size) return 0;
+memcpy(n,data+(*pos),sizeof(int));
+(*pos)+=sizeof(int);
+return 1;
+}
+
+
+/**
+ * Reads a string written by write_memo_string. Returns 0 on error. If the
+ * string was NULL, *s is set to NULL. If 's' is NULL, the string is skipped.
+ */
+static int read_memo_string(const unsigned char* data,size_t size,size_t* pos,unichar** s) {
+int length;
+if (!read_memo_int(data,size,pos,&length)) return 0;
+if (length==-1) {
+   if (s!=NULL) *s=NULL;
+   return 1;
+}
+if (length<0 || (*pos)+length*sizeof(unichar)>size) return 0;
+if (s==NULL) {
+   (*pos)+=length*sizeof(unichar);
+   return 1;
+}
+*s=(unichar*)malloc((length+1)*sizeof(unichar));
+if (*s==NULL) {
+   fatal_alloc_error("read_memo_string");
+}
+memcpy(*s,data+(*pos),length*sizeof(unichar));
+(*s)[length]='\0';
+(*pos)+=length*sizeof(unichar);
+return 1;
+}
+
+
+/**
+ * Reads one entry of the memo file. Returns 0 on error. If 'e' is NULL,
+ * the entry is skipped.
+ */
+static int read_dico_memo_entry(const unsigned char* data,size_t size,size_t* pos,struct dico_memo_entry* e) {
+int n,known;
+if (!read_memo_int(data,size,pos,&known) || !read_memo_int(data,size,pos,&n) || n<0) return 0;
+if (e!=NULL) e->known=known;
+for (int i=0;i<n;i++) {
+   unichar* line=NULL;
+   if (e==NULL) {
+      if (!read_memo_string(data,size,pos,NULL)) return 0;
+      continue;
+   }
+   if (!read_memo_string(data,size,pos,&line) || line==NULL) return 0;
+   vector_ptr_add(e->lines,line);
+}
+if (!read_memo_int(data,size,pos,&n) || n<0) return 0;
+struct offset_list** last=(e!=NULL)?&(e->offsets):NULL;
+for (int i=0;i<n;i++) {
+   int offset,base;
+   if (!read_memo_int(data,size,pos,&offset) || !read_memo_int(data,size,pos,&base)) return 0;
+   if (e==NULL) {
+      if (!read_memo_string(data,size,pos,NULL) || !read_memo_string(data,size,pos,NULL)) return 0;
+      continue;
+   }
+   struct offset_list* l=(struct offset_list*)malloc(sizeof(struct offset_list));
+   if (l==NULL) {
+      fatal_alloc_error("read_dico_memo_entry");
+   }
+   l->offset=offset;
+   l->base=base;
+   l->content=NULL;
+   l->output=NULL;
+   l->next=NULL;
+   *last=l;
+   last=&(l->next);
+   if (!read_memo_string(data,size,pos,&(l->content)) || l->content==NULL
+       || !read_memo_string(data,size,pos,&(l->output))) return 0;
+}
+return 1;
+}
+
+
+/**
+ * Loads the memo file entries that correspond to the given key.
+ */
+static void load_dico_memo(struct dico_memo* memo,const char* name) {
+if (!fexists(name)) return;
+ABSTRACTMAPFILE* amf=af_open_mapfile(name,MAPFILE_OPTION_READ,0);
+if (amf==NULL) {
+   error("Cannot read memo file %s\n",name);
+   memo->can_save=0;
+   return;
+}
+size_t size=af_get_mapfile_size(amf);
+if (size==0) {
+   af_close_mapfile(amf);
+   return;
+}
+const unsigned char* data=(const unsigned char*)af_get_mapfile_pointer(amf);
+size_t magic_size=strlen(DICO_MEMO_FILE_MAGIC);
+if (size<magic_size || memcmp(data,DICO_MEMO_FILE_MAGIC,magic_size)) {
+   error("%s is not a Dico memo file, it will be ignored\n",name);
+   af_release_mapfile_pointer(amf,data);
+   af_close_mapfile(amf);
+   memo->can_save=0;
+   return;
+}
+size_t pos=magic_size;
+while (pos<size) {
+   uint64_t key;
+   if (pos+sizeof(uint64_t)>size) break;
+   memcpy(&key,data+pos,sizeof(uint64_t));
+   pos+=sizeof(uint64_t);
+   if (key!=memo->key) {
+      /* The entries of other dictionaries are just skipped */
+      if (!read_memo_string(data,size,&pos,NULL) || !read_dico_memo_entry(data,size,&pos,NULL)) break;
+      continue;
+   }
+   unichar* form=NULL;
+   if (!read_memo_string(data,size,&pos,&form) || form==NULL) break;
+   struct dico_memo_entry* e=new_dico_memo_entry();
+   if (!read_dico_memo_entry(data,size,&pos,e)) {
+      free(form);
+      free_dico_memo_entry(e);
+      break;
+   }
+   add_dico_memo_entry(memo,form,e);
+   free(form);
+}
+if (pos<size) {
+   error("Memo file %s is corrupted, it will not be updated\n",name);
+   memo->can_save=0;
+}
+af_release_mapfile_pointer(amf,data);
+af_close_mapfile(amf);
+}
+
+
+/**
+ * Creates the memo of the given dictionary, loading the entries that
+ * were already saved in the memo file with this dictionary.
+ */
+static struct dico_memo* new_dico_memo(struct dico_application_info* info,const char* name_bin,const char* name_inf) {
+struct dico_memo* memo=(struct dico_memo*)malloc(sizeof(struct dico_memo));
+if (memo==NULL) {
+   fatal_alloc_error("new_dico_memo");
+}
+memo->key=hash_dico_memo_file(hash_dico_memo_file(info->memo_key,name_bin),name_inf);
+memo->forms=new_string_hash();
+memo->entries=new_vector_ptr(1024);
+memo->current=NULL;
+memo->can_save=1;
+if (info->memo_mutex!=NULL) SyncGetMutex(info->memo_mutex);
+load_dico_memo(memo,info->memo_file);
+if (info->memo_mutex!=NULL) SyncReleaseMutex(info->memo_mutex);
+return memo;
+}
+
+
+/**
+ * Appends the new entries of the given memo to the memo file.
+ */
+static void save_dico_memo(struct dico_application_info* info,struct dico_memo* memo) {
+if (!memo->can_save) return;
+if (info->memo_mutex!=NULL) SyncGetMutex(info->memo_mutex);
+int new_file=!fexists(info->memo_file);
+U_FILE* f=u_fopen(BINARY,info->memo_file,U_APPEND);
+if (f==NULL) {
+   error("Cannot write memo file %s\n",info->memo_file);
+} else {
+   if (new_file) {
+      fwrite(DICO_MEMO_FILE_MAGIC,1,strlen(DICO_MEMO_FILE_MAGIC),f);
+   }
+   for (int i=0;i<memo->entries->nbelems;i++) {
+      struct dico_memo_entry* e=(struct dico_memo_entry*)memo->entries->tab[i];
+      if (!e->is_new) continue;
+      fwrite(&(memo->key),sizeof(uint64_t),1,f);
+      write_memo_string(memo->forms->value[i],f);
+      write_memo_int(e->known,f);
+      write_memo_int(e->lines->nbelems,f);
+      for (int j=0;j<e->lines->nbelems;j++) {
+         write_memo_string((unichar*)e->lines->tab[j],f);
+      }
+      int n=0;
+      for (struct offset_list* l=e->offsets;l!=NULL;l=l->next) n++;
+      write_memo_int(n,f);
+      for (struct offset_list* l=e->offsets;l!=NULL;l=l->next) {
+         write_memo_int(l->offset,f);
+         write_memo_int(l->base,f);
+         write_memo_string(l->content,f);
+         write_memo_string(l->output,f);
+      }
+   }
+   u_fclose(f);
+}
+if (info->memo_mutex!=NULL) SyncReleaseMutex(info->memo_mutex);
+}
+
+
+static void free_dico_memo(struct dico_memo* memo) {
+if (memo==NULL) return;
+free_string_hash(memo->forms);
+free_vector_ptr(memo->entries,free_dico_memo_entry);
+free_dico_memo_entry(memo->current);
+free(memo);
+}
+
+
 /* display uncompress entry
  * function extracted from explore_bin_simple_words, because each recursive call
  * allocated 4096 unichar (and produce stack overflow)
@@ -260,6 +621,69 @@ free_Ustring(s);
 }
 
 
+/**
+ * This function is called when the whole token #token_number has been read in
+ * the dictionary, 'offset' being the offset of the node reached and 'inflected'
+ * the exact entry in the dictionary. If the node is final and if the token has
+ * not already been matched by dictionary with a greater priority, we save the
+ * corresponding DELAF line in the DLF.
+ */
+static void save_simple_word(struct dico_application_info* info,int offset,unichar* inflected,
+                             int final,int inf_number,int token_number,int priority,
+                             Ustring* ustr,int base) {
+struct dico_memo_entry* memo_entry=(info->memo!=NULL)?info->memo->current:NULL;
+if (final) {
+   /* If the node is final */
+    if (info->word_array!=NULL) add_offset_for_token(info->word_array,token_number,offset,inflected,0,NULL);
+    if (memo_entry!=NULL) {
+       memo_entry->offsets=get_offset(offset,memo_entry->offsets,inflected,0,NULL);
+       memo_entry->known=1;
+    }
+   int p=0;
+   if (info->simple_word!=NULL) p=get_value(info->simple_word,token_number);
+   int save=(p==0 || p==priority);
+   if (save) {
+      /* We save the token only if it has not already been matched by
+       * dictionary with a greater priority. Moreover, we indicate that
+       * this token is part of a word and that it has been processed. */
+       if (info->part_of_a_word!=NULL) set_value(info->part_of_a_word,token_number,1);
+      if (info->simple_word!=NULL) set_value(info->simple_word,token_number,priority);
+   }
+   if (save || memo_entry!=NULL) {
+      /* We get the INF codes. When a memo is being filled, we need the
+       * DELAF lines even if they are not to be saved in the DLF now */
+      struct list_ustring* head;
+      int to_be_freed=get_inf_codes(info->d,inf_number,ustr,&head,base);
+      struct list_ustring* tmp=head;
+      /* Then, we produce the DELAF line corresponding to each compressed line */
+      while (tmp!=NULL) {
+          if (memo_entry!=NULL) {
+             Ustring* line=new_Ustring(DIC_LINE_SIZE);
+             uncompress_entry(inflected,tmp->string,line);
+             vector_ptr_add(memo_entry->lines,u_strdup(line->str));
+             free_Ustring(line);
+          }
+          if (save) {
+             if (info->dic_name[0]!='\0') {
+                u_fprintf(info->dlf,"%s\n",info->dic_name);
+                info->dic_name[0]='\0';
+             }
+             display_uncompressed_entry(info->dlf,inflected,tmp->string);
+          }
+          tmp=tmp->next;
+      }
+      if (to_be_freed) free_list_ustring(head);
+   }
+} else {
+    /* The node is not final */
+    if (info->word_array!=NULL) add_offset_for_token(info->word_array,token_number,offset,inflected,base,ustr);
+    if (memo_entry!=NULL) {
+       memo_entry->offsets=get_offset(offset,memo_entry->offsets,inflected,base,(ustr->len!=0)?ustr->str:NULL);
+    }
+}
+}
+
+
 /**
  * This function explores a .bin dictionary in order to test if 'token' is a
  * simple word. 'offset' is the offset of the current dictionary node. 'inflected'
@@ -277,41 +701,12 @@ void explore_bin_simple_words(struct dico_application_info* info,
 int final,n_transitions,inf_number;
 /* We compute the number of transitions that outgo from the current node */
 int z=save_output(ustr);
-int new_offset=read_dictionary_state(info->d,offset,&final,&n_transitions,&inf_number);
+const struct cached_dictionary_state* s=get_cached_dictionary_state(info->d,offset);
+int new_offset=read_cached_dictionary_state(info->d,s,offset,&final,&n_transitions,&inf_number);
 if (token[pos]=='\0') {
    /* If we are at the end of the token */
    inflected[pos]='\0';
-   if (final) {
-      /* If the node is final */
-       if (info->word_array!=NULL) add_offset_for_token(info->word_array,token_number,offset,inflected,0,NULL);
-      int p=0;
-      if (info->simple_word!=NULL) p=get_value(info->simple_word,token_number);
-      if (p==0 || p==priority) {
-         /* We save the token only if it has not already been matched by
-          * dictionary with a greater priority. Moreover, we indicate that
-          * this token is part of a word and that it has been processed. */
-          if (info->part_of_a_word!=NULL) set_value(info->part_of_a_word,token_number,1);
-         if (info->simple_word!=NULL) set_value(info->simple_word,token_number,priority);
-         /* We get the INF codes */
-         struct list_ustring* head;
-         int to_be_freed=get_inf_codes(info->d,inf_number,ustr,&head,base);
-         struct list_ustring* tmp=head;
-         /* Then, we produce the DELAF line corresponding to each compressed line */
-         while (tmp!=NULL) {
-             if (info->dic_name[0]!='\0') {
-                u_fprintf(info->dlf,"%s\n",info->dic_name);
-                info->dic_name[0]='\0';
-             }
-             display_uncompressed_entry(info->dlf,inflected,tmp->string);
-             tmp=tmp->next;
-         }
-         if (to_be_freed) free_list_ustring(head);
-         base=ustr->len;
-      }
-   } else {
-       /* The node is not final */
-       if (info->word_array!=NULL) add_offset_for_token(info->word_array,token_number,offset,inflected,base,ustr);
-   }
+   save_simple_word(info,offset,inflected,final,inf_number,token_number,priority,ustr,base);
    /* If we are at the end of the token, there is no need to look at the
     * outgoing transitions */
    restore_output(z,ustr);
@@ -327,7 +722,7 @@ int offset_dest;
 for (int i=0;i<n_transitions;i++) {
    /* For each outgoing transition, we look if the transition character is
     * compatible with the token's one */
-    offset=read_dictionary_transition(info->d,offset,&c,&offset_dest,ustr);
+    offset=read_cached_dictionary_transition(info->d,s,i,offset,&c,&offset_dest,ustr);
     if (is_equal_or_uppercase(c,token[pos],info->alphabet)) {
       /* We copy the transition character so that 'inflected' will contain
        * the exact inflected form */
@@ -339,24 +734,152 @@ for (int i=0;i<n_transitions;i++) {
 }
 
 
+/**
+ * A node reached at the end of a token when looking up all the tokens at once.
+ */
+struct simple_word_match {
+   int offset;
+   int base;
+   unichar* inflected;
+   unichar* output;
+   struct simple_word_match* next;
+};
+
+
+/**
+ * This structure is used to collect the results of the lookup of the tokens.
+ * 'token_number' gives the token number of each sorted word, and 'matches'
+ * and 'last' are the lists of nodes reached by each token.
+ */
+struct simple_word_lookup {
+   const Alphabet* alphabet;
+   const int* token_number;
+   struct simple_word_match** matches;
+   struct simple_word_match** last;
+};
+
+
+static int simple_word_char_match(unichar c,unichar w,void* private_ptr) {
+return is_equal_or_uppercase(c,w,((struct simple_word_lookup*)private_ptr)->alphabet);
+}
+
+
+static void simple_word_found(int word_index,int offset,const unichar* inflected,
+                              Ustring* output,int base,void* private_ptr) {
+struct simple_word_lookup* lookup=(struct simple_word_lookup*)private_ptr;
+struct simple_word_match* m=(struct simple_word_match*)malloc(sizeof(struct simple_word_match));
+if (m==NULL) {
+   fatal_alloc_error("simple_word_found");
+}
+m->offset=offset;
+m->base=base;
+m->inflected=u_strdup(inflected);
+m->output=(output->len==0)?NULL:u_strdup(output->str);
+m->next=NULL;
+int token=lookup->token_number[word_index];
+if (lookup->matches[token]==NULL) lookup->matches[token]=m;
+else lookup->last[token]->next=m;
+lookup->last[token]=m;
+}
+
+
+/**
+ * Used to sort the tokens to look up.
+ */
+struct token_to_look_up {
+   const unichar* token;
+   int number;
+};
+
+
+static int compare_tokens_to_look_up(const void* a,const void* b) {
+return u_strcmp(((const struct token_to_look_up*)a)->token,((const struct token_to_look_up*)b)->token);
+}
+
+
 /**
  * This function looks for every token of the text if it can
  * be a simple word. If it is the case, the corresponding DELAF lines
  * are saved in 'info->dlf' if the word has not already been matched
  * by a dictionary with a greater priority.
+ *
+ * All the tokens that are not in the memo are looked up at once in
+ * alphabetical order, so that the dictionary nodes reached by a prefix
+ * shared by several tokens are only computed once. Then, the results are
+ * processed in the order of the tokens, as if each token was explored
+ * with explore_bin_simple_words.
  */
 void look_for_simple_words(struct dico_application_info* info,int priority) {
-/* this function is called only once by dico application, so we will use heap instead stack */
-unichar* entry=(unichar*)malloc(sizeof(unichar)*DIC_WORD_SIZE);
-if (entry==NULL) {
+int N=info->tokens->N;
+Ustring* ustr=new_Ustring();
+struct dico_memo* memo=info->memo;
+int* memo_index=(int*)malloc(sizeof(int)*N);
+struct token_to_look_up* tokens=(struct token_to_look_up*)malloc(sizeof(struct token_to_look_up)*N);
+const unichar** words=(const unichar**)malloc(sizeof(unichar*)*N);
+int* token_number=(int*)malloc(sizeof(int)*N);
+struct simple_word_lookup lookup;
+lookup.matches=(struct simple_word_match**)calloc(N,sizeof(struct simple_word_match*));
+lookup.last=(struct simple_word_match**)malloc(sizeof(struct simple_word_match*)*N);
+if (memo_index==NULL || tokens==NULL || words==NULL || token_number==NULL
+    || (N!=0 && (lookup.matches==NULL || lookup.last==NULL))) {
    fatal_alloc_error("look_for_simple_words");
 }
-Ustring* ustr=new_Ustring();
-for (int i=0;i<info->tokens->N;i++) {
-   explore_bin_simple_words(info,info->d->initial_state_offset,info->tokens->token[i],entry,0,i,priority,ustr,0);
+int n_words=0;
+for (int i=0;i<N;i++) {
+   memo_index[i]=-1;
+   if (memo!=NULL) {
+      memo_index[i]=get_value_index(info->tokens->token[i],memo->forms,DONT_INSERT);
+      if (memo_index[i]!=-1) {
+         /* The token was already looked up in this dictionary */
+         continue;
+      }
+   }
+   tokens[n_words].token=info->tokens->token[i];
+   tokens[n_words].number=i;
+   n_words++;
+}
+qsort(tokens,n_words,sizeof(struct token_to_look_up),compare_tokens_to_look_up);
+for (int i=0;i<n_words;i++) {
+   words[i]=tokens[i].token;
+   token_number[i]=tokens[i].number;
+}
+lookup.alphabet=info->alphabet;
+lookup.token_number=token_number;
+lookup_sorted_words(info->d,words,n_words,simple_word_char_match,simple_word_found,&lookup);
+int final,n_transitions,inf_number;
+for (int i=0;i<N;i++) {
+   if (memo_index[i]!=-1) {
+      use_dico_memo_entry(info,(struct dico_memo_entry*)memo->entries->tab[memo_index[i]],i,priority);
+      continue;
+   }
+   if (memo!=NULL) {
+      memo->current=new_dico_memo_entry();
+   }
+   struct simple_word_match* m=lookup.matches[i];
+   while (m!=NULL) {
+      struct simple_word_match* next=m->next;
+      read_dictionary_state(info->d,m->offset,&final,&n_transitions,&inf_number);
+      if (m->output==NULL) empty(ustr);
+      else u_strcpy(ustr,m->output);
+      save_simple_word(info,m->offset,m->inflected,final,inf_number,i,priority,ustr,m->base);
+      free(m->inflected);
+      free(m->output);
+      free(m);
+      m=next;
+   }
+   if (memo!=NULL) {
+      memo->current->is_new=1;
+      add_dico_memo_entry(memo,info->tokens->token[i],memo->current);
+      memo->current=NULL;
+   }
 }
+free(lookup.matches);
+free(lookup.last);
+free(token_number);
+free(words);
+free(tokens);
+free(memo_index);
 free_Ustring(ustr);
-free(entry);
 }
 
 
@@ -393,7 +916,8 @@ void explore_bin_compound_words(struct dico_application_info* info,
                                 int current_start_pos,Ustring* line_buf,Ustring* ustr,int base) {
 int final,n_transitions,inf_number;
 int z=save_output(ustr);
-int new_offset=read_dictionary_state(info->d,offset,&final,&n_transitions,&inf_number);
+const struct cached_dictionary_state* s=get_cached_dictionary_state(info->d,offset);
+int new_offset=read_cached_dictionary_state(info->d,s,offset,&final,&n_transitions,&inf_number);
 if (current_token[pos_in_current_token]=='\0') {
    /* If we are at the end of the current token, we look for the
     * corresponding node in the token tree */
@@ -412,7 +936,13 @@ if (current_token[pos_in_current_token]=='\0') {
        trans->node->list=get_offset(offset,trans->node->list,inflected,0,NULL);
       token_sequence[pos_token_sequence]=-1;
       /* We look if the compound word has already been matched */
-      int w=was_already_in_tct_hash(token_sequence,info->tct_h,priority);
+      int w=0;
+      if (info->shared_tct_h!=NULL) {
+         w=get_tct_priority(token_sequence,info->shared_tct_h);
+      }
+      if (w==0) {
+         w=was_already_in_tct_hash(token_sequence,info->tct_h,priority);
+      }
       if (w==0 || w==priority) {
          /* If the compound has not already been matched by a dictionary
           * with a greater priority */
@@ -472,7 +1002,7 @@ unichar c;
 int adr;
 offset=new_offset;
 for (int i=0;i<n_transitions;i++) {
-   offset=read_dictionary_transition(info->d,offset,&c,&adr,ustr);
+   offset=read_cached_dictionary_transition(info->d,s,i,offset,&c,&adr,ustr);
    if (is_equal_or_uppercase(c,current_token[pos_in_current_token],info->alphabet)) {
       /* We explore the rest of the dictionary only if the
        * dictionary char is compatible with the token char. In that case,
@@ -492,7 +1022,7 @@ for (int i=0;i<n_transitions;i++) {
  * 'info->dlc' if the word has not already been matched by a dictionary with
  * a greater priority.
  */
-void look_for_compound_words(struct dico_application_info* info,int priority) {
+void look_for_compound_words(struct dico_application_info* info,int priority,int verbose) {
 /* this function is called only once by dico application, so we will use heap instead stack */
 unichar* inflected=(unichar*)malloc(sizeof(unichar)*DIC_WORD_SIZE);
 if (inflected==NULL) {
@@ -511,7 +1041,7 @@ fill_buffer(info->buffer,info->text_cod);
 Ustring* line_buf=new_Ustring(4096);
 Ustring* ustr=new_Ustring();
 int current_start_pos=0;
-u_printf("First block...              \r");
+if (verbose) u_printf("First block...              \r");
 while (current_start_pos<info->text_cod_size_nb_int) {/*
    if (!info->buffer->end_of_file
        && current_start_pos>(info->buffer->size-MARGIN_BEFORE_BUFFER_END)) {
@@ -570,7 +1100,7 @@ while (current_start_pos<info->text_cod_size_nb_int) {/*
    }
    current_start_pos++;
 }
-u_printf("\n");
+if (verbose) u_printf("\n");
 free_Ustring(line_buf);
 free_Ustring(ustr);
 free(inflected);
@@ -648,7 +1178,12 @@ for (int j=0;j<tokens->N;j++) {
    info->n_occurrences[j]=0;
 }
 info->tct_h=new_tct_hash();
+info->shared_tct_h=NULL;
 info->tct_h_tags_ind=new_tct_hash();
+info->memo_file[0]='\0';
+info->memo_key=0;
+info->memo_mutex=NULL;
+info->memo=NULL;
 info->SIMPLE_WORDS=0;
 info->COMPOUND_WORDS=0;
 info->UNKNOWN_WORDS=0;
@@ -701,20 +1236,32 @@ if (info->d==NULL) {
     error("Cannot open dictionary %s\n",name_bin);
     return 1;
 }
+if (!is_persistent_structure(info->d)) {
+   /* Persistent dictionaries are given their cache when they are loaded */
+   cache_dictionary_states(info->d,DEFAULT_CACHED_DICTIONARY_STATES);
+}
 info->word_array=new_word_struct_array(info->tokens->N);
 /* And then we look simple and then compound words.
  * IMPORTANT: it is crucial to look for simple words first, since
  *            some initializations are made there that are used
  *            when looking for compound words.
  */
+if (info->memo_file[0]!='\0') {
+   info->memo=new_dico_memo(info,name_bin,name_inf);
+}
 u_printf("Looking for simple words...\n");
 look_for_simple_words(info,priority);
+if (info->memo!=NULL) {
+   save_dico_memo(info,info->memo);
+   free_dico_memo(info->memo);
+   info->memo=NULL;
+}
 u_printf("Looking for compound words...\n");
 /* We measure the elapsed time */
 #ifdef DEBUG
 clock_t startTime=clock();
 #endif
-look_for_compound_words(info,priority);
+look_for_compound_words(info,priority,1);
 #ifdef DEBUG
 clock_t endTime = clock();
 double  elapsedTime = (double) (endTime - startTime);
@@ -727,6 +1274,177 @@ return 0;
 }
 
 
+/**
+ * This structure is used by dico_application_in_threads. Each thread applies
+ * one .bin dictionary with its own copy of the dico_application_info, in which
+ * the DELAF lines are written to temporary files, and the tokens and
+ * compound words matched are recorded apart from the shared ones.
+ */
+struct dico_application_worker {
+   struct dico_application_info info;
+   const VersatileEncodingConfig* vec;
+   const char* name_bin;
+   char dlf[FILENAME_MAX];
+   char dlc[FILENAME_MAX];
+   int priority;
+   int result;
+};
+
+
+static void ABSTRACT_CALLBACK_UNITEX dico_application_worker_thread(void* private_ptr,unsigned int /* num_worker */) {
+struct dico_application_worker* w=(struct dico_application_worker*)private_ptr;
+struct dico_application_info* info=&(w->info);
+char name_inf[FILENAME_MAX];
+remove_extension(w->name_bin,name_inf);
+strcat(name_inf,".inf");
+info->d=new_Dictionary(w->vec,w->name_bin,name_inf);
+if (info->d==NULL) {
+   error("Cannot open dictionary %s\n",w->name_bin);
+   w->result=1;
+   return;
+}
+if (!is_persistent_structure(info->d)) {
+   /* Persistent dictionaries are given their cache when they are loaded */
+   cache_dictionary_states(info->d,DEFAULT_CACHED_DICTIONARY_STATES);
+}
+info->dlf=u_fopen(w->vec,w->dlf,U_WRITE);
+info->dlc=u_fopen(w->vec,w->dlc,U_WRITE);
+if (info->dlf==NULL || info->dlc==NULL) {
+   error("Cannot create temporary files for dictionary %s\n",w->name_bin);
+   u_fclose(info->dlf);
+   u_fclose(info->dlc);
+   free_Dictionary(info->d);
+   info->d=NULL;
+   w->result=1;
+   return;
+}
+info->word_array=new_word_struct_array(info->tokens->N);
+if (info->memo_file[0]!='\0') {
+   info->memo=new_dico_memo(info,w->name_bin,name_inf);
+}
+look_for_simple_words(info,w->priority);
+if (info->memo!=NULL) {
+   save_dico_memo(info,info->memo);
+   free_dico_memo(info->memo);
+   info->memo=NULL;
+}
+look_for_compound_words(info,w->priority,0);
+free_word_struct_array(info->word_array);
+info->word_array=NULL;
+free_Dictionary(info->d);
+info->d=NULL;
+u_fclose(info->dlf);
+u_fclose(info->dlc);
+w->result=0;
+}
+
+
+/**
+ * Appends the lines of the given file to 'dest', and removes the file.
+ */
+static void append_and_remove_file(const VersatileEncodingConfig* vec,const char* name,U_FILE* dest) {
+U_FILE* f=u_fopen(vec,name,U_READ);
+if (f==NULL) {
+   return;
+}
+Ustring* line=new_Ustring(DIC_LINE_SIZE);
+while (EOF!=readline(line,f)) {
+   u_fprintf(dest,"%S\n",line->str);
+}
+free_Ustring(line);
+u_fclose(f);
+af_remove(name);
+}
+
+
+/**
+ * Applies the given .bin dictionaries, that must all have the given priority,
+ * with at most 'n_threads' threads. Dictionaries of the same priority do not
+ * depend on each other, so each one is looked up in its own thread against
+ * the shared text tokens. Then, the results are merged in the order of the
+ * dictionaries, so that the dlf and dlc files, and all the information in
+ * 'info', are exactly the same as with successive calls to dico_application.
+ * 'dlf' and 'dlc' are the names of the files opened in 'info', used to
+ * name the temporary files of the threads.
+ *
+ * Returns 0 in case of success; 1 if a dictionary could not be applied.
+ */
+int dico_application_in_threads(const VersatileEncodingConfig* vec,char* const names[],int n_names,
+                                struct dico_application_info* info,int priority,
+                                const char* dlf,const char* dlc,int n_threads) {
+if (n_threads>n_names) {
+   n_threads=n_names;
+}
+struct dico_application_worker* workers=(struct dico_application_worker*)malloc(n_names*sizeof(struct dico_application_worker));
+void** worker_ptrs=(void**)malloc(n_names*sizeof(void*));
+if (workers==NULL || worker_ptrs==NULL) {
+   fatal_alloc_error("dico_application_in_threads");
+}
+int N=info->tokens->N;
+if (info->memo_file[0]!='\0') {
+   info->memo_mutex=SyncBuildMutex();
+}
+for (int i=0;i<n_names;i++) {
+   struct dico_application_worker* w=workers+i;
+   w->info=*info;
+   w->info.dlf=w->info.dlc=w->info.err=w->info.tags_err=w->info.morpho=NULL;
+   w->info.d=NULL;
+   w->info.word_array=NULL;
+   /* Marks made by higher priority dictionaries must be seen by the thread,
+    * so it starts with a copy of simple_word */
+   w->info.part_of_a_word=new_bit_array(N,ONE_BIT);
+   w->info.simple_word=new_bit_array(N,TWO_BITS);
+   if (w->info.part_of_a_word==NULL || w->info.simple_word==NULL) {
+      fatal_alloc_error("dico_application_in_threads");
+   }
+   memcpy(w->info.simple_word->array,info->simple_word->array,info->simple_word->size_in_bytes);
+   w->info.tct_h=new_tct_hash();
+   w->info.shared_tct_h=info->tct_h;
+   w->info.COMPOUND_WORDS=0;
+   w->vec=vec;
+   w->name_bin=names[i];
+   sprintf(w->dlf,"%s.%d",dlf,i);
+   sprintf(w->dlc,"%s.%d",dlc,i);
+   w->priority=priority;
+   w->result=0;
+   worker_ptrs[i]=w;
+}
+for (int start=0;start<n_names;start=start+n_threads) {
+   int n=(n_names-start<n_threads)?(n_names-start):n_threads;
+   SyncRunWorkerThreads((unsigned int)n,dico_application_worker_thread,worker_ptrs+start);
+}
+int ret=0;
+for (int i=0;i<n_names;i++) {
+   struct dico_application_worker* w=workers+i;
+   if (w->result!=0) {
+      ret=1;
+   }
+   append_and_remove_file(vec,w->dlf,info->dlf);
+   append_and_remove_file(vec,w->dlc,info->dlc);
+   for (int j=0;j<N;j++) {
+      if (get_value(w->info.part_of_a_word,j)) {
+         set_value(info->part_of_a_word,j,1);
+      }
+      if (get_value(w->info.simple_word,j)==priority) {
+         set_value(info->simple_word,j,priority);
+      }
+   }
+   merge_tct_hash(info->tct_h,w->info.tct_h);
+   info->COMPOUND_WORDS+=w->info.COMPOUND_WORDS;
+   free_bit_array(w->info.part_of_a_word);
+   free_bit_array(w->info.simple_word);
+   free_tct_hash(w->info.tct_h);
+}
+if (info->memo_mutex!=NULL) {
+   SyncDeleteMutex(info->memo_mutex);
+   info->memo_mutex=NULL;
+}
+free(worker_ptrs);
+free(workers);
+return ret;
+}
+
+
 /**
  * This function launches the application of the given .bin dictionary.
  *
@@ -31,6 +31,7 @@
 #include "BitArray.h"
 #include "LocateMatches.h"
 #include "CompressedDic.h"
+#include "SyncTool.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -93,6 +94,10 @@ struct word_struct_array {
 };
 
 
+/* The token memo of a .bin dictionary, defined in ApplyDic.cpp */
+struct dico_memo;
+
+
 /**
  * This structure is used to store various information needed for the
  * application of dictionaries to a text.
@@ -147,12 +152,27 @@ struct dico_application_info {
     * sequence matched when applying a .bin dictionary. Keys are sequences
     * of token numbers. */
    struct tct_hash* tct_h;
+   /* When dictionaries are applied in threads, tct_h only contains the sequences
+    * matched by the current thread, and the sequences matched before are looked
+    * up in this read-only table. Otherwise, it is NULL. */
+   struct tct_hash* shared_tct_h;
    /* tct_h_tags_ind is a hash table used to associate a priority to each token
     * sequence matched when applying a .fst2 dictionary.
     * IMPORTANT: unlike tct_h, keys are couple of offsets [start;end], because
     *            .fst2 matching are contextual */
    struct tct_hash* tct_h_tags_ind;
 
+   /* If memo_file is not empty, the results of the .bin dictionaries for each
+    * simple word token are cached in this file, so that the tokens already
+    * looked up with the same dictionary in a previous run don't need to be
+    * looked up again. memo_key identifies everything but the dictionary
+    * that can change these results (i.e. the alphabet), and memo_mutex, if
+    * not NULL, protects the memo file when dictionaries are applied in threads. */
+   char memo_file[FILENAME_MAX];
+   uint64_t memo_key;
+   SYNC_Mutex_OBJECT memo_mutex;
+   struct dico_memo* memo;
+
    /* Total number of simple, compound and unknown word occurrences in the text
     * WARNING: these are NOT the number of lines of the dlf, dlc and err files */
    int SIMPLE_WORDS;
@@ -172,6 +192,8 @@ struct dico_application_info* init_dico_application(struct text_tokens*,U_FILE*,
                                                     U_FILE*,const char*,const char*,Alphabet*,
                                                     const VersatileEncodingConfig*);
 int dico_application(const VersatileEncodingConfig*,const char*,struct dico_application_info*,int);
+int dico_application_in_threads(const VersatileEncodingConfig*,char* const[],int,struct dico_application_info*,int,
+                                const char*,const char*,int);
 int dico_application_simplified(const VersatileEncodingConfig*,const unichar*,const char*,struct dico_application_info*);
 void free_dico_application(struct dico_application_info*);
 void count_token_occurrences(struct dico_application_info*);
@@ -182,6 +204,8 @@ int merge_dic_locate_results(struct dico_application_info*,const char*,int,int);
 
 void save_and_sort_tag_sequences(struct dico_application_info*);
 
+uint64_t hash_dico_memo_file(uint64_t,const char*);
+
 } // namespace unitex
 
 #endif
@@ -861,12 +861,13 @@ void explore_normalization_tree(int first_pos_in_buffer,
 
 /**
  * This function builds the sentence automaton that correspond to the
- * given token buffer. It saves it into the given file.
+ * given token buffer. It saves it into the given file, or with the
+ * given binary writer if not NULL.
  */
 void build_sentence_automaton(const int* buffer, int length,
         const struct text_tokens* tokens, const struct DELA_tree* DELA_tree,
         const Alphabet* alph, U_FILE* out_tfst, U_FILE* out_tind,
-        int sentence_number, int we_must_clean,
+        struct binary_tfst_writer* binary_writer, int sentence_number, int we_must_clean,
         struct normalization_tree* norm_tree, struct match_list* *tag_list,
         int current_global_position_in_tokens,
         int current_global_position_in_chars, language_t* language,
@@ -1016,7 +1017,11 @@ void build_sentence_automaton(const int* buffer, int length,
         free_vector_ptr(tfst->tags, (void(*)(void*)) free_TfstTag);
         tfst->tags = new_vector_ptr(1);
         vector_ptr_add(tfst->tags, new_TfstTag(T_EPSILON));
-        save_current_sentence(tfst, out_tfst, out_tind, NULL, 0, NULL);
+        if (binary_writer != NULL) {
+            save_current_sentence(tfst, binary_writer, NULL, 0, NULL);
+        } else {
+            save_current_sentence(tfst, out_tfst, out_tind, NULL, 0, NULL);
+        }
     } else {
         /* Case 2: the automaton is not empty */
 
@@ -1035,8 +1040,13 @@ void build_sentence_automaton(const int* buffer, int length,
                 trans = trans->next;
             }
         }
-        save_current_sentence(tfst, out_tfst, out_tind, tags->value,
-                tags->size, form_frequencies);
+        if (binary_writer != NULL) {
+            save_current_sentence(tfst, binary_writer, tags->value,
+                    tags->size, form_frequencies);
+        } else {
+            save_current_sentence(tfst, out_tfst, out_tind, tags->value,
+                    tags->size, form_frequencies);
+        }
     }
     close_text_automaton(tfst);
     free_string_hash(tmp_tags);
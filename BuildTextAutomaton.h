@@ -79,7 +79,8 @@ struct info {
 
 void build_sentence_automaton(const int*,int,const struct text_tokens*,
                               const struct DELA_tree*,
-                              const Alphabet*,U_FILE*,U_FILE*,int,int,
+                              const Alphabet*,U_FILE*,U_FILE*,
+                              struct binary_tfst_writer*,int,int,
                               struct normalization_tree*,
                               struct match_list**,int,int,
                               language_t*,Korean* korean,
@@ -47,7 +47,7 @@
 
 namespace unitex {
 
-const char *optstring_Cassys = ":bp:t:a:w:l:Vhk:q:g:dvuNncm:s:ir:f:T:L:C:O$:x:";
+const char *optstring_Cassys = ":bp:t:a:w:l:Vhk:q:g:dvuNncm:s:iMr:f:T:L:C:O$:x:P:";
 const struct option_TS lopts_Cassys[] = {
   {"text", required_argument_TS, NULL, 't'},
   {"alphabet", required_argument_TS, NULL, 'a'},
@@ -61,10 +61,12 @@ const struct option_TS lopts_Cassys[] = {
   {"transducer_file",required_argument_TS,NULL,'s'},
   {"transducer_dir",required_argument_TS,NULL,'r'},
   {"in_place", no_argument_TS,NULL,'i'},
+  {"in_memory", no_argument_TS,NULL,'M'},
   {"dump_token_graph", no_argument_TS, NULL, 'u' },
   {"no_dump_token_graph", no_argument_TS, NULL, 'N' },
   {"realign_token_graph_pointer", no_argument_TS, NULL, 'n' },
   {"display_time", no_argument_TS, NULL, 'c' },
+  {"profile", required_argument_TS, NULL, 'P' },
   {"translate_path_separator_to_native", no_argument_TS, NULL, 'v' },
   {"working_dir", required_argument_TS, NULL, 'p' },
   {"cleanup_working_files", no_argument_TS, NULL, 'b' },
@@ -98,6 +100,17 @@ const char* usage_Cassys =
         "-O/--produce_offsets_file produce offsets file (automatic if --input_offsets=XXX is used)\n"
         "-t TXT/--text=TXT the text file to be modified, with extension .snt\n"
         "-i/--in_place mean uses the same csc/snt directories for each transducer\n"
+        "-M/--in_memory keeps the tokenized text in memory between transducers: the text.cod\n"
+        "      and tokens.txt of each transducer are built from the matches of the previous ones\n"
+        "      instead of tokenizing and merging the whole text again. Locate still reads them\n"
+        "      from the snt directory of each transducer. The differences with the default mode are:\n"
+        "      - the intermediate .snt texts are not labeled, they keep the input text, and the\n"
+        "        enter.pos, stats.n, tok_by_alph.txt, tok_by_freq.txt and snt_offsets.pos files of\n"
+        "        their snt directories are not written;\n"
+        "      - outputs are tokenized on their own: if a replaced text is glued to its neighbours,\n"
+        "        like 'a,b' where ',' is replaced by 'x', Tokenize would see 'axb' as one token,\n"
+        "        while this mode keeps 'a', 'x' and 'b', so tokens.txt, text.cod and the matches\n"
+        "        of the following transducers may differ.\n"
         "-p X/--working_dir=X uses directory X for intermediate working file\n"
         "-b/--cleanup_working_files remove intermediate working file after usage\n"
         "-u/--dump_token_graph create a .dot file with graph dump infos\n"
@@ -105,6 +118,10 @@ const char* usage_Cassys =
         "-n/--realign_token_graph_pointer create a.dot file will not depends to pointer allocation to be deterministic\n"
         "-v/--translate_path_separator_to_native replace path separator in csc by native separator for portable csc file\n"
         "-c/--display_time display time used in each unitex tool\n"
+        "-P X/--profile=X save in X the profile of each transducer application: tokenize, grf2fst2,\n"
+        "      locate and concord times, Locate statistics (matches, exploration steps, cache hits,\n"
+        "      memory held by its allocators when known) and bytes written. X is a CSV file if its\n"
+        "      extension is .csv, a JSON file otherwise\n"
         "-d/--no_create_directory mean the all snt/csc directories already exist and don't need to be created\n"
         "  -g minus/--negation_operator=minus: uses minus as negation operator for Unitex 2.0 graphs\n"
         "  -g tilde/--negation_operator=tilde: uses tilde as negation operator (default)\n"
@@ -1726,6 +1743,7 @@ typedef struct {
     char extension_text_name[FILENAME_MAX];
     char language[FILENAME_MAX];
     char stdoff_file[FILENAME_MAX];
+    char profile_file[FILENAME_MAX];
 } Cassys_text_buffer;
 
 typedef struct {
@@ -1769,6 +1787,7 @@ int main_Cassys(int argc,char* const argv[]) {
     VersatileEncodingConfig vec=VEC_DEFAULT;
     int must_create_directory = 1;
     int in_place = 0;
+    int in_memory = 0;
     int realign_token_graph_pointer = 0;
     int translate_path_separator_to_native = 0;
     int dump_graph = 0; // By default, don't build a .dot file.
@@ -1829,6 +1848,7 @@ int main_Cassys(int argc,char* const argv[]) {
     textbuf->name_input_offsets_file[0] = '\0';
     textbuf->language[0] = '\0';
     textbuf->stdoff_file[0] = '\0';
+    textbuf->profile_file[0] = '\0';
     bool only_verify_arguments = false;
     UnitexGetOpt options;
     while (EOF != (val=options.parse_long(argc, argv, optstring_Cassys,
@@ -2054,6 +2074,10 @@ int main_Cassys(int argc,char* const argv[]) {
             in_place = 1;
             break;
         }
+        case 'M': {
+            in_memory = 1;
+            break;
+        }
         case 'u': {
             dump_graph = 1;
             break;
@@ -2212,6 +2236,21 @@ int main_Cassys(int argc,char* const argv[]) {
             }
             break;
         }
+        case 'P': {
+            if (options.vars()->optarg[0] == '\0') {
+                error("Command line error : Empty profile file name\n");
+                free_transducer_name_and_mode_linked_list(transducer_name_and_mode_linked_list_arg);
+                free_vector_ptr(concord_additional_args, free);
+                free_vector_ptr(locate_additional_args, free);
+                free_vector_ptr(tokenize_additional_args, free);
+                free(temp_work_dir);
+                free(morpho_dic);
+                free(textbuf);
+                return USAGE_ERROR_CODE;
+            }
+            strcpy(textbuf->profile_file, options.vars()->optarg);
+            break;
+        }
         default :{
             error("Invalid option : %c\n",val);
             free_transducer_name_and_mode_linked_list(transducer_name_and_mode_linked_list_arg);
@@ -2265,11 +2304,12 @@ int main_Cassys(int argc,char* const argv[]) {
     }
     struct fifo *transducer_list=load_transducer_from_linked_list(transducer_name_and_mode_linked_list_arg, textbuf->transducer_filename_prefix);
 
-    int return_value = cascade(textbuf->text_file_name, in_place, must_create_directory, must_do_temp_cleanup, temp_work_dir,
+    int return_value = cascade(textbuf->text_file_name, in_place, in_memory, must_create_directory, must_do_temp_cleanup, temp_work_dir,
         transducer_list, textbuf->alphabet_file_name, textbuf->name_input_offsets_file, produce_offsets_file, textbuf->name_uima_offsets_file, negation_operator,
         &vec, morpho_dic,
         tokenize_additional_args, locate_additional_args, concord_additional_args,
-        dump_graph, realign_token_graph_pointer, display_perf, istex_param, textbuf->language,textbuf->stdoff_file);
+        dump_graph, realign_token_graph_pointer, display_perf, istex_param, textbuf->language,textbuf->stdoff_file,
+        textbuf->profile_file);
 
     free_fifo(transducer_list);
     free_transducer_name_and_mode_linked_list(transducer_name_and_mode_linked_list_arg);
@@ -2363,18 +2403,253 @@ static void quicksort(int nb_items, locate_perf_info* transitions) {
 }
 
 
+/**
+ * Profile of the application of one transducer in the cascade, saved with
+ * --profile. Times are in milliseconds. The Locate statistics are
+ * the ones saved by Locate --profile, -1 meaning unknown.
+ */
+typedef struct {
+    char* name;
+    int transducer_number;
+    int iteration;
+    unsigned int time_tokenize;
+    unsigned int time_grf2fst2;
+    unsigned int time_locate;
+    unsigned int time_concord;
+    long text_tokens;
+    long matches;
+    long outputs;
+    long exploration_steps;
+    long cache_hits;
+    long cache_misses;
+    long allocator_bytes;
+    long bytes_written;
+} cassys_stage_profile;
+
+
+typedef struct {
+    cassys_stage_profile* stages;
+    unsigned int nb_stages;
+    unsigned int capacity;
+} cassys_profile;
+
+
+static cassys_profile* new_cassys_profile() {
+    cassys_profile* profile = (cassys_profile*)malloc(sizeof(cassys_profile));
+    if (profile == NULL) {
+        fatal_alloc_error("new_cassys_profile");
+    }
+    profile->stages = NULL;
+    profile->nb_stages = 0;
+    profile->capacity = 0;
+    return profile;
+}
+
+
+static void free_cassys_profile(cassys_profile* profile) {
+    if (profile == NULL) return;
+    for (unsigned int i = 0; i < profile->nb_stages; i++) {
+        free(profile->stages[i].name);
+    }
+    free(profile->stages);
+    free(profile);
+}
+
+
+/**
+ * Adds a new stage to the profile and returns it, with all its Locate
+ * statistics set to unknown.
+ */
+static cassys_stage_profile* add_cassys_stage_profile(cassys_profile* profile, const char* name,
+        int transducer_number, int iteration) {
+    if (profile->nb_stages == profile->capacity) {
+        profile->capacity = (profile->capacity == 0) ? 16 : profile->capacity * 2;
+        profile->stages = (cassys_stage_profile*)realloc(profile->stages, profile->capacity * sizeof(cassys_stage_profile));
+        if (profile->stages == NULL) {
+            fatal_alloc_error("add_cassys_stage_profile");
+        }
+    }
+    cassys_stage_profile* stage = profile->stages + (profile->nb_stages++);
+    stage->name = strdup(name);
+    if (stage->name == NULL) {
+        fatal_alloc_error("add_cassys_stage_profile");
+    }
+    stage->transducer_number = transducer_number;
+    stage->iteration = iteration;
+    stage->time_tokenize = 0;
+    stage->time_grf2fst2 = 0;
+    stage->time_locate = 0;
+    stage->time_concord = 0;
+    stage->text_tokens = -1;
+    stage->matches = -1;
+    stage->outputs = -1;
+    stage->exploration_steps = -1;
+    stage->cache_hits = -1;
+    stage->cache_misses = -1;
+    stage->allocator_bytes = -1;
+    stage->bytes_written = 0;
+    return stage;
+}
+
+
+/**
+ * Reads the "name=value" lines saved by Locate --profile into the given stage.
+ * Unknown names are ignored.
+ */
+static void load_locate_profile(const char* name, const VersatileEncodingConfig* vec, cassys_stage_profile* stage) {
+    U_FILE* f = u_fopen(vec, name, U_READ);
+    if (f == NULL) {
+        return;
+    }
+    Ustring* line = new_Ustring();
+    while (EOF != readline(line, f)) {
+        int pos = 0;
+        while (line->str[pos] != '\0' && line->str[pos] != '=') pos++;
+        if (line->str[pos] != '=') continue;
+        line->str[pos] = '\0';
+        long value = 0;
+        for (const unichar* c = line->str + pos + 1; *c >= '0' && *c <= '9'; c++) {
+            value = value * 10 + (*c - '0');
+        }
+        const unichar* key = line->str;
+        if (!u_strcmp(key, "text_tokens")) stage->text_tokens = value;
+        else if (!u_strcmp(key, "matches")) stage->matches = value;
+        else if (!u_strcmp(key, "outputs")) stage->outputs = value;
+        else if (!u_strcmp(key, "exploration_steps")) stage->exploration_steps = value;
+        else if (!u_strcmp(key, "cache_hits")) stage->cache_hits = value;
+        else if (!u_strcmp(key, "cache_misses")) stage->cache_misses = value;
+        else if (!u_strcmp(key, "allocator_bytes")) stage->allocator_bytes = value;
+    }
+    free_Ustring(line);
+    u_fclose(f);
+}
+
+
+/**
+ * Adds the size of the given file, if it exists, to the bytes written by the stage.
+ */
+static void add_written_bytes(cassys_stage_profile* stage, const char* name) {
+    long size = get_file_size(name);
+    if (size > 0) {
+        stage->bytes_written += size;
+    }
+}
+
+
+/**
+ * Prints a quoted file name, escaping it the JSON way or the CSV way. The
+ * name is decoded from UTF-8 (or taken as Latin-1 if it is not valid UTF-8),
+ * so that it is written with the encoding of the profile file.
+ */
+static void print_profile_string(U_FILE* f, const char* s, int csv) {
+    size_t n = strlen(s) + 1;
+    size_t len = 0;
+    unichar* name;
+    if (convert_utf8_to_unichar(NULL, 0, &len, (const unsigned char*)s, n) == n) {
+        name = (unichar*)malloc(len * sizeof(unichar));
+        if (name == NULL) {
+            fatal_alloc_error("print_profile_string");
+        }
+        convert_utf8_to_unichar(name, len, NULL, (const unsigned char*)s, n);
+    } else {
+        name = u_strdup(s);
+    }
+    u_fprintf(f, "\"");
+    for (unichar* c = name; *c != '\0'; c++) {
+        if (*c == '"') u_fprintf(f, csv ? "\"\"" : "\\\"");
+        else if (csv) u_fprintf(f, "%C", *c);
+        else if (*c == '\\') u_fprintf(f, "\\\\");
+        else if (*c == '\n') u_fprintf(f, "\\n");
+        else if (*c == '\t') u_fprintf(f, "\\t");
+        else if (*c < 0x20) u_fprintf(f, "\\u%04X", *c);
+        else u_fprintf(f, "%C", *c);
+    }
+    u_fprintf(f, "\"");
+    free(name);
+}
+
+
+/**
+ * Prints a statistic, as null in JSON or as an empty field in CSV when it is unknown.
+ */
+static void print_profile_value(U_FILE* f, long value, int csv) {
+    if (value >= 0) u_fprintf(f, "%ld", value);
+    else if (!csv) u_fprintf(f, "null");
+}
+
+
+/**
+ * Saves the profile of the cascade. If the file name ends with .csv, we
+ * save one line per stage, otherwise we save a JSON document that also
+ * contains the total times of the cascade.
+ */
+static int save_cassys_profile(const char* name, const cassys_profile* profile,
+        unsigned int time_cascade, unsigned int time_tokenize, unsigned int time_grf2fst2,
+        unsigned int time_locate, unsigned int time_concord) {
+    U_FILE* f = u_fopen(UTF8, name, U_WRITE);
+    if (f == NULL) {
+        error("Cannot write %s\n", name);
+        return 0;
+    }
+    char extension[FILENAME_MAX];
+    get_extension(name, extension);
+    int csv = !strcmp(extension, ".csv") || !strcmp(extension, ".CSV");
+    if (csv) {
+        u_fprintf(f, "transducer,number,iteration,tokenize_ms,grf2fst2_ms,locate_ms,concord_ms,"
+            "text_tokens,matches,outputs,exploration_steps,cache_hits,cache_misses,allocator_bytes,bytes_written\n");
+    } else {
+        u_fprintf(f, "{\n  \"cascade_ms\": %u,\n  \"tokenize_ms\": %u,\n  \"grf2fst2_ms\": %u,\n"
+            "  \"locate_ms\": %u,\n  \"concord_ms\": %u,\n  \"transducers\": [",
+            time_cascade, time_tokenize, time_grf2fst2, time_locate, time_concord);
+    }
+    for (unsigned int i = 0; i < profile->nb_stages; i++) {
+        const cassys_stage_profile* stage = profile->stages + i;
+        if (csv) {
+            print_profile_string(f, stage->name, csv);
+            u_fprintf(f, ",%d,%d,%u,%u,%u,%u,", stage->transducer_number, stage->iteration,
+                stage->time_tokenize, stage->time_grf2fst2, stage->time_locate, stage->time_concord);
+        } else {
+            u_fprintf(f, "%s\n    {\"transducer\": ", (i == 0) ? "" : ",");
+            print_profile_string(f, stage->name, csv);
+            u_fprintf(f, ", \"number\": %d, \"iteration\": %d, \"tokenize_ms\": %u, \"grf2fst2_ms\": %u,"
+                " \"locate_ms\": %u, \"concord_ms\": %u", stage->transducer_number, stage->iteration,
+                stage->time_tokenize, stage->time_grf2fst2, stage->time_locate, stage->time_concord);
+        }
+        const char* names[] = { "text_tokens", "matches", "outputs", "exploration_steps",
+            "cache_hits", "cache_misses", "allocator_bytes", "bytes_written" };
+        long values[] = { stage->text_tokens, stage->matches, stage->outputs, stage->exploration_steps,
+            stage->cache_hits, stage->cache_misses, stage->allocator_bytes, stage->bytes_written };
+        for (int j = 0; j < 8; j++) {
+            if (csv) {
+                if (j != 0) u_fprintf(f, ",");
+            } else {
+                u_fprintf(f, ", \"%s\": ", names[j]);
+            }
+            print_profile_value(f, values[j], csv);
+        }
+        u_fprintf(f, csv ? "\n" : "}");
+    }
+    if (!csv) {
+        u_fprintf(f, "\n  ]\n}\n");
+    }
+    u_fclose(f);
+    return 1;
+}
+
+
 /**
  * The main function of the cascade
  *
  *
  */
-int cascade(const char* original_text, int in_place, int must_create_directory,  int must_do_temp_cleanup, const char* temp_work_dir,
+int cascade(const char* original_text, int in_place, int in_memory, int must_create_directory,  int must_do_temp_cleanup, const char* temp_work_dir,
     fifo* transducer_list, const char *alphabet,
     const char*name_input_offsets_file, int produce_offsets_file, const char* name_uima_offsets_file,
     const char*negation_operator,
     VersatileEncodingConfig* vec,
     const char *morpho_dic, vector_ptr* tokenize_args, vector_ptr* locate_args, vector_ptr* concord_args,
-    int dump_graph, int realign_token_graph_pointer, int display_perf, int istex_param, const char* lang, const char* stdoff_file) {
+    int dump_graph, int realign_token_graph_pointer, int display_perf, int istex_param, const char* lang, const char* stdoff_file,
+    const char* profile_file) {
 
     unsigned int time_tokenize = 0;
     unsigned int time_grf2fst2 = 0;
@@ -2386,9 +2661,18 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
     unsigned int nb_perf_info_allocated  = 0;
     locate_perf_info* p_locate_perf_info = NULL;
 
+    cassys_profile* profile = NULL;
+    if (profile_file != NULL && profile_file[0] != '\0') {
+        profile = new_cassys_profile();
+    }
+    // times are also measured when they are only needed for the profile
+    int measure_time = display_perf || (profile != NULL);
+
     hTimeElapsed htm_cascade = NULL;
-    if (display_perf) {
+    if (measure_time) {
         htm_cascade = SyncBuidTimeMarkerObject();
+    }
+    if (display_perf) {
         nb_perf_info_allocated = 1;
         p_locate_perf_info = (locate_perf_info*)malloc(nb_perf_info_allocated*sizeof(locate_perf_info));
         if (p_locate_perf_info == NULL) {
@@ -2401,6 +2685,7 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
     if (textbuf == NULL) {
         alloc_error("cascade");
         free(p_locate_perf_info);
+        free_cassys_profile(profile);
         return ALLOC_ERROR_CODE;
     }
 
@@ -2435,6 +2720,7 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
                 free_vector_int(uima_offsets);
                 free(textbuf);
                 free(p_locate_perf_info);
+                free_cassys_profile(profile);
                 return ALLOC_ERROR_CODE;
             }
 
@@ -2445,6 +2731,7 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
                 free_vector_int(uima_offsets);
                 free(textbuf);
                 free(p_locate_perf_info);
+                free_cassys_profile(profile);
                 return ALLOC_ERROR_CODE;
             }
 
@@ -2456,6 +2743,7 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
                 free_vector_int(uima_offsets);
                 free(textbuf);
                 free(p_locate_perf_info);
+                free_cassys_profile(profile);
                 return ALLOC_ERROR_CODE;
             }
 
@@ -2469,6 +2757,7 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
                     free_vector_int(uima_offsets);
                     free(textbuf);
                     free(p_locate_perf_info);
+                    free_cassys_profile(profile);
                     return ALLOC_ERROR_CODE;
                 }
 
@@ -2490,6 +2779,7 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
                     free_vector_int(uima_offsets);
                     free(textbuf);
                     free(p_locate_perf_info);
+                    free_cassys_profile(profile);
                     return ALLOC_ERROR_CODE;
                 }
 
@@ -2528,6 +2818,15 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
     struct text_tokens* tokens = NULL;
     cassys_tokens_list* tokens_list = cassys_load_text(vec,snt_text_files->tokens_txt, snt_text_files->text_cod,&tokens, uima_offsets,tokens_allocation_tool);
 
+    struct string_hash* text_tokens = NULL;
+    if (in_memory) {
+        // the token numbers of the original text are kept, new tokens are appended
+        text_tokens = new_string_hash(tokens->N);
+        for (int i = 0; i < tokens->N; i++) {
+            get_value_index(tokens->token[i], text_tokens);
+        }
+    }
+
     u_printf("CasSys Cascade begins\n");
 
     int transducer_number = 1;
@@ -2561,6 +2860,7 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
             error("graph %s has been compiled in debug mode. Please recompile it in normal mode\n", current_transducer->transducer_file_name);
             free(labeled_text_name);
             free_text_tokens(tokens);
+            free_string_hash(text_tokens);
             free_snt_files(snt_text_files);
             free(build_text);
             free(build_work_text_csc_work_path);
@@ -2573,6 +2873,7 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
                 free((p_locate_perf_info + loop_display_perf)->name);
             }
             free(p_locate_perf_info);
+            free_cassys_profile(profile);
             return DEFAULT_ERROR_CODE;
         }
 
@@ -2586,8 +2887,24 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
                     transducer_number, previous_iteration, iteration, must_create_directory, 1);
             }
 
-            launch_tokenize_in_Cassys(labeled_text_name, alphabet,
-                snt_text_files->tokens_txt, vec, tokenize_args, display_perf, display_perf ? &time_tokenize : NULL);
+            unsigned int time_this_tokenize = 0;
+            unsigned int time_this_grf2fst2 = 0;
+            unsigned int time_this_concord = 0;
+
+            if (in_memory) {
+                hTimeElapsed htm_tokens = measure_time ? SyncBuidTimeMarkerObject() : NULL;
+                struct snt_files* labeled_snt_files = new_snt_files(labeled_text_name);
+                write_cassys_text_tokens(vec, tokens_list, previous_transducer_number, previous_iteration,
+                    text_tokens, labeled_snt_files->tokens_txt, labeled_snt_files->text_cod);
+                free_snt_files(labeled_snt_files);
+                if (measure_time) {
+                    time_this_tokenize = SyncGetMSecElapsed(htm_tokens);
+                }
+            } else {
+                launch_tokenize_in_Cassys(labeled_text_name, alphabet,
+                    snt_text_files->tokens_txt, vec, tokenize_args, display_perf, measure_time ? &time_this_tokenize : NULL);
+            }
+            time_tokenize += time_this_tokenize;
 
             //int entity = 0;
             char* updated_grf_file_name = NULL;
@@ -2652,7 +2969,8 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
 
                         if (at_least_one_match_list_not_empty) {
 
-                            launch_grf2fst2_in_Cassys(updated_grf_file_name, alphabet, vec, display_perf, display_perf ? &time_grf2fst2 : NULL);
+                            launch_grf2fst2_in_Cassys(updated_grf_file_name, alphabet, vec, display_perf, measure_time ? &time_this_grf2fst2 : NULL);
+                            time_grf2fst2 += time_this_grf2fst2;
 
                             updated_fst2_file_name = create_updated_graph_filename(text,
                                 in_place ? 0 : transducer_number,
@@ -2685,15 +3003,22 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
                     current_transducer->transducer_file_name = updated_fst2_file_name;
                 }
 
+                char locate_profile_file[FILENAME_MAX];
+                if (profile != NULL) {
+                    get_snt_path(labeled_text_name, locate_profile_file);
+                    strcat(locate_profile_file, "locate_profile.txt");
+                }
+
                 unsigned int time_this_locate = 0;
                 launch_locate_in_Cassys(labeled_text_name, current_transducer,
-                    alphabet, negation_operator, vec, morpho_dic, locate_args, display_perf, display_perf ? &time_this_locate : NULL);
+                    alphabet, negation_operator, vec, morpho_dic, locate_args, display_perf, measure_time ? &time_this_locate : NULL,
+                    (profile != NULL) ? locate_profile_file : NULL);
 
                 if (backup_transducer_filename != NULL)
                     current_transducer->transducer_file_name = backup_transducer_filename;
 
+                time_locate += time_this_locate;
                 if (display_perf) {
-                    time_locate += time_this_locate;
                     if (nb_perf_info_allocated <= nb_perf_info) {
                         nb_perf_info_allocated *= 2;
                         locate_perf_info* p_locate_perf_info_more = (locate_perf_info*)realloc(p_locate_perf_info,nb_perf_info_allocated*sizeof(locate_perf_info));
@@ -2703,6 +3028,7 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
                             alloc_error("cascade");
                             free(labeled_text_name);
                             free_text_tokens(tokens);
+                            free_string_hash(text_tokens);
                             free_snt_files(snt_text_files);
                             free(build_text);
                             free(build_work_text_csc_work_path);
@@ -2715,6 +3041,7 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
                                 free((p_locate_perf_info + loop_display_perf)->name);
                             }
                             free(p_locate_perf_info);
+                            free_cassys_profile(profile);
                             return ALLOC_ERROR_CODE;
                         }
                     }
@@ -2730,8 +3057,28 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
                 snt_text_files = new_snt_files(labeled_text_name);
                 protect_lexical_tag_in_concord(snt_text_files->concord_ind, current_transducer->output_policy, vec);
                 // generate concordance for this transducer
-                launch_concord_in_Cassys(labeled_text_name,
-                    snt_text_files->concord_ind, alphabet, NULL, NULL, NULL, vec, concord_args, display_perf, display_perf ? &time_concord : NULL);
+                if (!in_memory) {
+                    launch_concord_in_Cassys(labeled_text_name,
+                        snt_text_files->concord_ind, alphabet, NULL, NULL, NULL, vec, concord_args, display_perf, measure_time ? &time_this_concord : NULL);
+                    time_concord += time_this_concord;
+                }
+
+                if (profile != NULL) {
+                    cassys_stage_profile* stage = add_cassys_stage_profile(profile, current_transducer->transducer_file_name,
+                        transducer_number, iteration);
+                    stage->time_tokenize = time_this_tokenize;
+                    stage->time_grf2fst2 = time_this_grf2fst2;
+                    stage->time_locate = time_this_locate;
+                    stage->time_concord = time_this_concord;
+                    load_locate_profile(locate_profile_file, vec, stage);
+                    af_remove(locate_profile_file);
+                    add_written_bytes(stage, snt_text_files->text_cod);
+                    add_written_bytes(stage, snt_text_files->tokens_txt);
+                    add_written_bytes(stage, snt_text_files->concord_ind);
+                    if (!in_memory) {
+                        add_written_bytes(stage, labeled_text_name);
+                    }
+                }
 
                 //
                 add_replaced_text(labeled_text_name, tokens_list, previous_transducer_number, previous_iteration,
@@ -2817,7 +3164,7 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
 
     // create the text file including XMLized concordance
     launch_concord_in_Cassys(textbuf->result_file_name_path_XML, snt_files->concord_ind, alphabet,
-        name_input_offsets_file, name_uima_offsets_file, textbuf->result_file_name_path_offset, vec,concord_args, display_perf, display_perf ? &time_concord : NULL);
+        name_input_offsets_file, name_uima_offsets_file, textbuf->result_file_name_path_offset, vec,concord_args, display_perf, measure_time ? &time_concord : NULL);
 
     // make a copy of the last resulting text of the cascade in the file named _csc.raw
     sprintf(textbuf->result_file_name_raw,"%s_csc.raw", textbuf->text_name_without_extension);
@@ -2833,7 +3180,7 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
     construct_cascade_concord(tokens_list,text,transducer_number, iteration, vec);
     // relaunch the construction of the text file without XML
     launch_concord_in_Cassys(textbuf->result_file_name_path_raw, snt_files->concord_ind, alphabet,
-        name_input_offsets_file, name_uima_offsets_file, textbuf->result_file_name_path_offset, vec,concord_args, display_perf, display_perf ? &time_concord : NULL);
+        name_input_offsets_file, name_uima_offsets_file, textbuf->result_file_name_path_offset, vec,concord_args, display_perf, measure_time ? &time_concord : NULL);
 
     if (dump_graph) {
         sprintf(textbuf->graph_file_name, "%s.dot", textbuf->text_name_without_extension);
@@ -2843,6 +3190,7 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
     //free_cassys_tokens_list(tokens_list);
     free_snt_files(snt_files);
     free_text_tokens(tokens);
+    free_string_hash(text_tokens);
     free_cassys_tokens_allocation_tool(tokens_allocation_tool);
 
 
@@ -2883,8 +3231,15 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
     }
     free(textbuf);
 
-    if (display_perf) {
+    if (measure_time) {
         time_cascade = SyncGetMSecElapsed(htm_cascade);
+    }
+
+    if (profile != NULL) {
+        save_cassys_profile(profile_file, profile, time_cascade, time_tokenize, time_grf2fst2, time_locate, time_concord);
+    }
+
+    if (display_perf) {
         float ratio = (float)(time_cascade / 100.);
         float ratio_locate = (float)(time_locate / 100.);
         if (ratio == 0) ratio = 1;
@@ -2919,6 +3274,7 @@ int cascade(const char* original_text, int in_place, int must_create_directory,
         }
         free(p_locate_perf_info);
     }
+    free_cassys_profile(profile);
 
     return SUCCESS_RETURN_CODE;
 }
@@ -34,6 +34,8 @@
 #include "UnitexRevisionInfo.h"
 #include "List_int.h"
 #include "UnusedParameter.h"
+#include "LocateMatches.h"
+#include "Af_stdio.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -60,12 +62,54 @@ void display_lu(struct list_ustring *l){
  * \return a fifo list of all the matches found with their replacement sentences. Each element is
  * stored in a locate_pos structure
  */
+/**
+ * \brief Reads a binary 'concord.ind' file, directly from the mapped file
+ *
+ * \param[in] concord_file_name the name of the concord.ind file
+ * \param[out] f the fifo list where the matches are put
+ */
+static void read_binary_concord_file(const char *concord_file_name, struct fifo *f) {
+    ABSTRACTMAPFILE *amf = af_open_mapfile(concord_file_name, MAPFILE_OPTION_READ, 0);
+    if (amf == NULL) {
+        fatal_error("Cannot open file %s\n", concord_file_name);
+    }
+    size_t size = af_get_mapfile_size(amf);
+    const void *buffer = af_get_mapfile_pointer(amf);
+    struct binary_concord concord;
+    if (!get_binary_concord(buffer, size, &concord)) {
+        fatal_error("Malformed concordance file %s\n", concord_file_name);
+    }
+    for (int i = 0; i < concord.n_matches; i++) {
+        const unichar *output = get_binary_concord_output(&concord, i);
+        locate_pos *l = (locate_pos*) malloc(sizeof(locate_pos));
+        if (l == NULL) {
+            fatal_alloc_error("read_binary_concord_file");
+        }
+        l->token_start_offset = concord.start_pos_in_token[i];
+        l->character_start_offset = concord.start_pos_in_char[i];
+        l->logical_start_offset = concord.start_pos_in_letter[i];
+        l->token_end_offset = concord.end_pos_in_token[i];
+        l->character_end_offset = concord.end_pos_in_char[i];
+        l->logical_end_offset = concord.end_pos_in_letter[i];
+        l->label = u_strdup(output != NULL ? output : U_EMPTY);
+        put_ptr(f, l);
+    }
+    af_release_mapfile_pointer(amf, buffer);
+    af_close_mapfile(amf);
+}
+
+
 struct fifo *read_concord_file(const char *concord_file_name, const VersatileEncodingConfig* vec){
     unichar* line = NULL;
     size_t size_buffer_line = 0;
 
     struct fifo *f = new_fifo();
 
+    if (is_binary_concord_file(concord_file_name)) {
+        read_binary_concord_file(concord_file_name, f);
+        return f;
+    }
+
     U_FILE *concord_desc_file;
     concord_desc_file = u_fopen(vec,concord_file_name,U_READ);
     if( concord_desc_file == NULL){
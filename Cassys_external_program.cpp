@@ -158,7 +158,8 @@ int launch_locate_in_Cassys(const char *text_name, const transducer *transducer,
     const char*negation_operator,
     const VersatileEncodingConfig* vec,
     const char *morpho_dic,
-    vector_ptr* additional_args, int display_perf, unsigned int* time_elapsed) {
+    vector_ptr* additional_args, int display_perf, unsigned int* time_elapsed,
+    const char* profile_file) {
 
     ProgramInvoker *invoker = new_ProgramInvoker(main_Locate, "main_Locate");
 
@@ -217,6 +218,10 @@ int launch_locate_in_Cassys(const char *text_name, const transducer *transducer,
         add_argument(invoker,tmp);
     }
 
+    if (profile_file != NULL) {
+        sprintf(tmp,"--profile=%s",profile_file);
+        add_argument(invoker,tmp);
+    }
 
     for (int i = 0; i<((additional_args == NULL) ? 0 : (additional_args->nbelems)); i++) {
         add_argument(invoker, (const char*)additional_args->tab[i]);
@@ -45,6 +45,7 @@ namespace unitex {
  * \param text_name target text
  * \param transducer transducer to apply
  * \param file name of the alphabet of the target text
+ * \param profile_file if not NULL, file where Locate saves its statistics (see Locate --profile)
  */
 int launch_locate_in_Cassys(const char *text_name,
                             const struct transducer *transducer,
@@ -52,7 +53,8 @@ int launch_locate_in_Cassys(const char *text_name,
                             const char*negation_operator,
                             const VersatileEncodingConfig*,
                             const char *morpho_dic,
-                            vector_ptr* additional_args, int display_perf, unsigned int* time_elapsed);
+                            vector_ptr* additional_args, int display_perf, unsigned int* time_elapsed,
+                            const char* profile_file=NULL);
 
 
 
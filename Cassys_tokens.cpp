@@ -401,6 +401,45 @@ cassys_tokens_list *add_replaced_text(
 }
 
 
+#define CASSYS_TEXT_COD_BUFFER_SIZE 0x400
+
+int write_cassys_text_tokens(const VersatileEncodingConfig* vec, cassys_tokens_list *list,
+            int transducer_id, int iteration, struct string_hash* text_tokens,
+            const char *token_text_name, const char *text_cod_name) {
+    U_FILE *f_cod = u_fopen(BINARY, text_cod_name, U_WRITE);
+    if (f_cod == NULL) {
+        error("Cannot create %s\n", text_cod_name);
+        return 0;
+    }
+    int buffer[CASSYS_TEXT_COD_BUFFER_SIZE];
+    int pos_buffer = 0;
+    for (cassys_tokens_list *l = get_output(list, transducer_id, iteration); l != NULL;
+            l = next_element(l, transducer_id, iteration)) {
+        if (pos_buffer == CASSYS_TEXT_COD_BUFFER_SIZE) {
+            fwrite(buffer, sizeof(int), pos_buffer, f_cod);
+            pos_buffer = 0;
+        }
+        buffer[pos_buffer++] = get_value_index(l->token, text_tokens);
+    }
+    if (pos_buffer > 0) {
+        fwrite(buffer, sizeof(int), pos_buffer, f_cod);
+    }
+    u_fclose(f_cod);
+
+    U_FILE *f_tokens = u_fopen(vec, token_text_name, U_WRITE);
+    if (f_tokens == NULL) {
+        error("Cannot create %s\n", token_text_name);
+        return 0;
+    }
+    u_fprintf(f_tokens, "%010d\n", text_tokens->size);
+    for (int i = 0; i < text_tokens->size; i++) {
+        u_fprintf(f_tokens, "%S\n", text_tokens->value[i]);
+    }
+    u_fclose(f_tokens);
+    return 1;
+}
+
+
 
 
 
@@ -117,6 +117,31 @@ cassys_tokens_list *cassys_load_text(const VersatileEncodingConfig*,const char *
 cassys_tokens_list *add_replaced_text(const char *text, cassys_tokens_list *list, int previous_transducer, int previous_iteration,
          int transducer_id, int iteration, const char *alphabet, const VersatileEncodingConfig*, cassys_tokens_allocation_tool * allocation_tool);
 
+/**
+ * \brief Writes the text.cod and tokens.txt files of the text as seen by the given
+ * transducer and iteration, without re-tokenizing it.
+ *
+ * \param[in] list the cassys_tokens_list of the cascade
+ * \param[in,out] text_tokens the tokens of the cascade, new tokens are appended to it
+ *
+ * The cassys_tokens_list already holds the outputs of the previous transducers split
+ * into tokens, so the spans changed by a transducer are the only ones that have
+ * been tokenized again. Token numbers are stable from one transducer to the next:
+ * as with Tokenize --tokens, tokens.txt starts with the tokens of the previous
+ * transducers, including those that no longer occur, and new ones are appended.
+ *
+ * The files are the same as Tokenize's, except when an output is glued to the
+ * text around it: each output is tokenized on its own, while Tokenize would
+ * tokenize the merged text and could join the output with its neighbours.
+ * The other files of the snt directory (enter.pos, stats.n, tok_by_*.txt,
+ * snt_offsets.pos) are not written.
+ *
+ * Returns 1 on success, 0 if a file could not be created.
+ */
+int write_cassys_text_tokens(const VersatileEncodingConfig*, cassys_tokens_list *list,
+         int transducer_id, int iteration, struct string_hash* text_tokens,
+         const char *token_text_name, const char *text_cod_name);
+
 //void free_cassys_tokens_list(cassys_tokens_list *l);
 
 
@@ -259,6 +259,40 @@ return 0;
 }
 
 
+/**
+ * Looks for the given token sequence in the hash table, without adding it.
+ * Returns 0 if the compound word is not found; its priority otherwise.
+ */
+int get_tct_priority(int* token_sequence,struct tct_hash* hash_table) {
+int hash_code=compute_tct_hash(token_sequence,hash_table->size);
+struct tct_hash_block* block=hash_table->hash_blocks+hash_code;
+int offset=tct_match(block,token_sequence);
+if (offset==-1) {
+   return 0;
+}
+return block->token_array[offset+tct_length(token_sequence)];
+}
+
+
+/**
+ * Adds to 'dest' all the token sequences of 'src' that are not already
+ * in 'dest', with their priorities.
+ */
+void merge_tct_hash(struct tct_hash* dest,const struct tct_hash* src) {
+for (int i=0;i<src->size;i++) {
+   const struct tct_hash_block* block=src->hash_blocks+i;
+   int j=0;
+   while (j<block->length) {
+      int* token_sequence=block->token_array+j;
+      int length=tct_length(token_sequence);
+      was_already_in_tct_hash(token_sequence,dest,token_sequence[length]);
+      /* We skip the sequence, its -1 and its priority */
+      j=j+length+1;
+   }
+}
+}
+
+
 /**
  * This function takes a compound word and tokenizes it according to
  * the given text tokens. The result is an integer sequence that is
@@ -38,6 +38,8 @@
 #include "CompressedDic.h"
 #include "Ustring.h"
 #include "UnitexRevisionInfo.h"
+#include "StringParsing.h"
+#include "SyncTool.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -62,6 +64,13 @@ const char* usage_Compress =
 "  -s, --semitic                   uses the semitic compression algorithm. This\n"
 "                                  option is useful to reduce the size of the\n"
 "                                  output when dealing with semitic languages\n"
+"  --incremental                   builds the minimal automaton while reading\n"
+"                                  the entries, instead of building the whole\n"
+"                                  tree before minimizing it. With sorted entries,\n"
+"                                  the memory used stays close to the size of the\n"
+"                                  final automaton. Only available for bin1\n"
+"  --threads=N                     uses N threads to parse the entries\n"
+"                                  [default: 1]\n"
 " \n"
 "Output options:\n"
 "  -t TYPE, --output_type=TYPE     specifies the type of the output file.\n"
@@ -72,7 +81,9 @@ const char* usage_Compress =
 "                                  in it, i.e. no .inf file is created\n"
 "                                  [default: bin1]\n"
 "  -o BINFILE, --output=BINFILE    filename used to write the produced automaton\n"
-"  -p, --pack-inf                  create a packed inf file (.inp)\n"
+"  -p, --pack-inf                  create a packed inf file (.inp) instead of the\n"
+"                                  .inf file. It is memory-mapped when the\n"
+"                                  dictionary is loaded, instead of being parsed\n"
 " \n"
 "Deprecated options:\n"
 "  --v1                            produces an old style .bin file with a size\n"
@@ -106,6 +117,8 @@ const struct option_TS lopts_Compress[] = {
   { (char *) "v1"                   , no_argument_TS       , NULL,   3  },
   { (char *) "v2"                   , no_argument_TS       , NULL,   4  },
   { (char *) "version"              , no_argument_TS       , NULL,   1  },
+  { (char *) "incremental"          , no_argument_TS       , NULL,   5  },
+  { (char *) "threads"              , required_argument_TS , NULL,   6  },
   { (char *) "input_encoding"       , required_argument_TS , NULL,  'k' },
   { (char *) "output"               , required_argument_TS , NULL,  'o' },
   { (char *) "output_type"          , required_argument_TS , NULL,  't' },
@@ -126,6 +139,32 @@ typedef void(*minimize_func)(struct dictionary_node* root,
                              struct bit_array* used_inf_values,
                              Abstract_allocator prv_alloc);
 
+// number of dictionary lines given to each thread at a time with --threads
+#define COMPRESS_LINES_PER_THREAD 4096
+
+/**
+ * A dictionary line parsed by a worker thread. 'n' is the number of
+ * (inflected form, compressed line) pairs to insert, or -1 if the line
+ * is not a valid DELAF entry
+ */
+struct parsed_dictionary_line {
+  unichar* line;
+  int line_number;
+  int n;
+  unichar* inflected[2];
+  unichar* compressed[2];
+};
+
+/**
+ * The lines of a batch that a worker thread must parse
+ */
+struct parse_dictionary_job {
+  struct parsed_dictionary_line* lines;
+  int n_lines;
+  int FLIP;
+  int semitic;
+};
+
 /**
  * This function writes the number of INF codes 'n' at the beginning
  * of the file named 'name'. This file is supposed to be a UTF-16
@@ -150,6 +189,200 @@ static void write_INF_file_header(const VersatileEncodingConfig* vec,
   u_fclose(f);
 }
 
+/**
+ * @brief Inserts an entry in the dictionary being built
+ *
+ * The entry is inserted in the automaton built by \a incremental, or in
+ * the tree whose initial state is \a root if \a incremental is NULL
+ */
+static void add_entry_to_dictionary(unichar* inflected,
+                                    unichar* compress_line,
+                                    struct dictionary_node* root,
+                                    struct string_hash* inf_codes,
+                                    struct incremental_dictionary* incremental,
+                                    int current_line,
+                                    Abstract_allocator prv_alloc) {
+  if (incremental != NULL) {
+    add_entry_to_incremental_dictionary(inflected,
+                                        compress_line,
+                                        incremental,
+                                        inf_codes);
+  } else {
+    add_entry_to_dictionary_tree(inflected,
+                                 compress_line,
+                                 root,
+                                 inf_codes,
+                                 current_line,
+                                 prv_alloc);
+  }
+}
+
+/**
+ * Returns 1 if replace_special_equal_signs() would fail on \a s, i.e. if
+ * \a s ends with an unprotected backslash
+ */
+static int ends_with_protection_char(const unichar* s) {
+  int i = 0;
+  while (s[i] != '\0') {
+    if (s[i] == PROTECTION_CHAR) {
+      if (s[i+1] == '\0') {
+        return 1;
+      }
+      i = i + 2;
+    } else {
+      i++;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Computes the compressed line of \a entry and stores it with the
+ * inflected form as a new pair of \a l
+ */
+static void add_parsed_entry(struct parsed_dictionary_line* l,
+                             struct dela_entry* entry,
+                             int semitic,
+                             unichar* compress_line) {
+  get_compressed_line(entry, compress_line, semitic);
+  l->inflected[l->n]  = u_strdup(entry->inflected);
+  l->compressed[l->n] = u_strdup(compress_line);
+  l->n++;
+}
+
+/**
+ * @brief Parses a dictionary line without printing anything
+ *
+ * This does the same work as build_tree_from_dictionary() for a
+ * line, except the insertion in the dictionary, so that it can be
+ * done by a worker thread. Errors are only reported by setting
+ * \a l->n to -1
+ */
+static void parse_dictionary_line(struct parsed_dictionary_line* l,
+                                  int FLIP,
+                                  int semitic) {
+  l->n = -1;
+  if (ends_with_protection_char(l->line)) {
+    return;
+  }
+  unichar* tmp = u_strdup(l->line);
+  replace_special_equal_signs(tmp);
+  int error_code = 0;
+  struct dela_entry* entry = tokenize_DELAF_line(tmp, 1, &error_code);
+  free(tmp);
+  if (entry == NULL) {
+    return;
+  }
+  for (int i = 0; i < entry->n_semantic_codes; ++i) {
+    replace_unprotected_equal_sign(entry->semantic_codes[i], (unichar)'=');
+  }
+  for (int i = 0; i < entry->n_inflectional_codes; ++i) {
+    replace_unprotected_equal_sign(entry->inflectional_codes[i], (unichar)'=');
+  }
+  if (FLIP) {
+    unichar* o       = entry->inflected;
+    entry->inflected = entry->lemma;
+    entry->lemma     = o;
+  }
+  unichar compress_line[DIC_LINE_SIZE];
+  l->n = 0;
+  if (contains_unprotected_equal_sign(entry->inflected)
+      || contains_unprotected_equal_sign(entry->lemma)) {
+    // pomme=de=terre, .N  ->  pomme de terre, pomme de terre.N
+    //                         pomme-de-terre, pomme-de-terre.N
+    unichar* inflected = u_strdup(entry->inflected);
+    unichar* lemma     = u_strdup(entry->lemma);
+    replace_unprotected_equal_sign(entry->inflected, (unichar)' ');
+    replace_unprotected_equal_sign(entry->lemma, (unichar)' ');
+    add_parsed_entry(l, entry, semitic, compress_line);
+    free(entry->inflected);
+    entry->inflected = inflected;
+    free(entry->lemma);
+    entry->lemma     = lemma;
+    replace_unprotected_equal_sign(entry->inflected, (unichar)'-');
+    replace_unprotected_equal_sign(entry->lemma, (unichar)'-');
+  }
+  add_parsed_entry(l, entry, semitic, compress_line);
+  free_dela_entry(entry);
+}
+
+static void ABSTRACT_CALLBACK_UNITEX parse_dictionary_thread(void* private_ptr,
+    unsigned int /* num_worker */) {
+  struct parse_dictionary_job* job = (struct parse_dictionary_job*) private_ptr;
+  for (int i = 0; i < job->n_lines; i++) {
+    parse_dictionary_line(&(job->lines[i]), job->FLIP, job->semitic);
+  }
+}
+
+/**
+ * @brief Parses a batch of dictionary lines with several threads, and
+ *        inserts the resulting entries in the order of the file
+ *
+ * Since the INF codes are numbered during the insertion, the .inf file
+ * does not depend on the number of threads. Invalid lines are parsed
+ * again in order to print the same error messages as without threads
+ */
+static void insert_dictionary_lines(struct parsed_dictionary_line* lines,
+                                    int n_lines,
+                                    int n_threads,
+                                    int FLIP,
+                                    int semitic,
+                                    const char* filename_as_char,
+                                    struct dictionary_node* root,
+                                    struct string_hash* inf_codes,
+                                    struct incremental_dictionary* incremental,
+                                    int* current_entry,
+                                    int* n_line_errors,
+                                    Abstract_allocator compress_abstract_allocator) {
+  struct parse_dictionary_job* jobs = (struct parse_dictionary_job*)
+      malloc(n_threads * sizeof(struct parse_dictionary_job));
+  void** ptrs = (void**) malloc(n_threads * sizeof(void*));
+  if (jobs == NULL || ptrs == NULL) {
+    fatal_alloc_error("insert_dictionary_lines");
+  }
+  int n_jobs = 0;
+  int lines_per_job = (n_lines + n_threads - 1) / n_threads;
+  for (int start = 0; start < n_lines; start = start + lines_per_job) {
+    jobs[n_jobs].lines   = lines + start;
+    jobs[n_jobs].n_lines = (n_lines - start < lines_per_job) ?
+                           (n_lines - start) : lines_per_job;
+    jobs[n_jobs].FLIP    = FLIP;
+    jobs[n_jobs].semitic = semitic;
+    ptrs[n_jobs] = &(jobs[n_jobs]);
+    n_jobs++;
+  }
+  SyncRunWorkerThreads((unsigned int) n_jobs, parse_dictionary_thread, ptrs);
+  free(ptrs);
+  free(jobs);
+  for (int i = 0; i < n_lines; i++) {
+    struct parsed_dictionary_line* l = &(lines[i]);
+    if (l->n == -1) {
+      // we parse the line again to print the error messages
+      if (replace_special_equal_signs(l->line) == SUCCESS_RETURN_CODE) {
+        free_dela_entry(tokenize_DELAF_line(l->line, 1, NULL, STANDARD_ALLOCATOR));
+      }
+      error("%s:%d\n",
+            filename_without_path(filename_as_char),
+            l->line_number+1);
+      (*n_line_errors)++;
+    } else {
+      for (int j = 0; j < l->n; j++) {
+        add_entry_to_dictionary(l->inflected[j],
+                                l->compressed[j],
+                                root,
+                                inf_codes,
+                                incremental,
+                                l->line_number,
+                                compress_abstract_allocator);
+        free(l->inflected[j]);
+        free(l->compressed[j]);
+      }
+      (*current_entry)++;
+    }
+    free(l->line);
+  }
+}
+
 /**
  * @brief Builds a tree representation of a DELAF dictionary
  *
@@ -165,6 +398,8 @@ static void write_INF_file_header(const VersatileEncodingConfig* vec,
  * @param[out] dictionary_list insert other dictionaries referred by \a filename
  * @param[out] root initial state of the dictionary tree
  * @param[out] inf_codes all the INF codes used by the dictionary tree
+ * @param[in,out] incremental if not NULL, builds a minimal automaton instead
+ * @param[in] n_threads number of threads used to parse the entries
  * @param[out] n_entries total entries processed without comments
  * @param[out] n_lines total lines scanned including comments
  * @param[out] n_line_errors total lines errors including comments
@@ -180,6 +415,8 @@ static int build_tree_from_dictionary(
                      list_ustring_ptr dictionary_list,
                      struct dictionary_node* root,
                      struct string_hash* inf_codes,
+                     struct incremental_dictionary* incremental,
+                     int n_threads,
                      int* n_entries,
                      int* n_lines,
                      int* n_line_errors,
@@ -239,6 +476,22 @@ static int build_tree_from_dictionary(
   // represents an entry of the current dictionary
   struct dela_entry* entry = NULL;
 
+  // lines waiting to be parsed by the worker threads
+  struct parsed_dictionary_line* batch = NULL;
+  int batch_size = 0;
+  if (n_threads > 1) {
+    batch = (struct parsed_dictionary_line*)
+        malloc(n_threads * COMPRESS_LINES_PER_THREAD *
+               sizeof(struct parsed_dictionary_line));
+    if (batch == NULL) {
+      alloc_error("compress_dictionary");
+      free_Ustring(line);
+      u_fclose(file_handler);
+      free(heap_buffer);
+      return ALLOC_ERROR_CODE;
+    }
+  }
+
   // set to 1 when the abstract allocator
   int tokenize_allocator_has_clean = ((get_allocator_flag(
                                        compress_tokenize_abstract_allocator) &
@@ -246,6 +499,18 @@ static int build_tree_from_dictionary(
 
   // read dictionary line-by-line
   while (EOF != readline(line, file_handler)) {
+    // we parse pending lines before any line that could print a message,
+    // so that messages keep the order of the file
+    if (batch_size != 0 && (batch_size == n_threads * COMPRESS_LINES_PER_THREAD
+                            || line->str[0] == '\0'
+                            || (line->str[0] == '/' && line->str[1] == '/'
+                                && line->str[2] == '!'))) {
+      insert_dictionary_lines(batch, batch_size, n_threads, FLIP, semitic,
+                              filename_as_char, root, inf_codes, incremental,
+                              &current_entry, n_line_errors,
+                              compress_abstract_allocator);
+      batch_size = 0;
+    }
     switch (line->str[0]) {
       // disallow empty lines
       case '\0':
@@ -344,6 +609,14 @@ static int build_tree_from_dictionary(
         break;
 
       default:
+        // with several threads, the line is parsed later with other ones
+        if (batch != NULL) {
+          batch[batch_size].line        = u_strdup(line->str);
+          batch[batch_size].line_number = current_line;
+          batch_size++;
+          break;
+        }
+
         // if we have a line, we tokenize it
 
         // reinitialize entry to NULL, in this way if replace_special_equal_signs()
@@ -429,12 +702,13 @@ static int build_tree_from_dictionary(
 
           // we insert "pomme de terre, pomme de terre.N"
           get_compressed_line(entry, compress_line, semitic);
-          add_entry_to_dictionary_tree(entry->inflected,
-                                       compress_line,
-                                       root,
-                                       inf_codes,
-                                       current_line,
-                                       compress_abstract_allocator);
+          add_entry_to_dictionary(entry->inflected,
+                                  compress_line,
+                                  root,
+                                  inf_codes,
+                                  incremental,
+                                  current_line,
+                                  compress_abstract_allocator);
 
           // and then we insert "pomme-de-terre, pomme-de-terre.N"
           u_strcpy(entry->inflected, inf_tmp);
@@ -448,20 +722,22 @@ static int build_tree_from_dictionary(
           replace_unprotected_equal_sign(entry->inflected, (unichar)'-');
           replace_unprotected_equal_sign(entry->lemma, (unichar)'-');
           get_compressed_line(entry, compress_line, semitic);
-          add_entry_to_dictionary_tree(entry->inflected,
-                                       compress_line,
-                                       root,
-                                       inf_codes,
-                                       current_line,
-                                       compress_abstract_allocator);
+          add_entry_to_dictionary(entry->inflected,
+                                  compress_line,
+                                  root,
+                                  inf_codes,
+                                  incremental,
+                                  current_line,
+                                  compress_abstract_allocator);
         } else {
           get_compressed_line(entry, compress_line, semitic);
-          add_entry_to_dictionary_tree(entry->inflected,
-                                       compress_line,
-                                       root,
-                                       inf_codes,
-                                       current_line,
-                                       compress_abstract_allocator);
+          add_entry_to_dictionary(entry->inflected,
+                                  compress_line,
+                                  root,
+                                  inf_codes,
+                                  incremental,
+                                  current_line,
+                                  compress_abstract_allocator);
         }
 
         // and last, but not least: don't forget to free your memory
@@ -494,6 +770,14 @@ static int build_tree_from_dictionary(
     }
   }  // while (EOF!=readline(line, file_handler)) {
 
+  if (batch_size != 0) {
+    insert_dictionary_lines(batch, batch_size, n_threads, FLIP, semitic,
+                            filename_as_char, root, inf_codes, incremental,
+                            &current_entry, n_line_errors,
+                            compress_abstract_allocator);
+  }
+  free(batch);
+
   *n_lines   = current_line;
   *n_entries = current_entry;
 
@@ -520,6 +804,8 @@ static int build_tree_from_dictionary(
  * @param[in] dictionary_list of dictionaries to process
  * @param[out] root initial state of the dictionary tree
  * @param[out] inf_codes all the INF codes used by the dictionary tree
+ * @param[in,out] incremental if not NULL, builds a minimal automaton instead
+ * @param[in] n_threads number of threads used to parse the entries
  * @param[out] n_files total file read
  * @param[out] n_lines total lines scanned including commentaries
  * @param[out] n_entries total entries processed without file commentaries
@@ -533,6 +819,8 @@ static int build_tree_from_dictionary_list(
                      list_ustring_ptr dictionary_list,
                      struct dictionary_node* root,
                      struct string_hash* inf_codes,
+                     struct incremental_dictionary* incremental,
+                     int n_threads,
                      int* n_entries,
                      int* n_lines,
                      int* n_line_errors,
@@ -575,6 +863,8 @@ static int build_tree_from_dictionary_list(
        dictionary_list,                        // dictionaries filenames
        root,                                   // automaton initial state
        inf_codes,                              // all the INF codes
+       incremental,                            // incremental construction
+       n_threads,                              // parsing threads
        &current_file_total_entries,            // entries processed
        &current_file_total_lines,              // lines scanned
        &current_file_total_line_errors,        // lines with errors
@@ -890,6 +1180,13 @@ int new_style_bin       = 1;
 // specifies if the semitic compression algorithm will be used
 int semitic             = 0;
 
+// specifies if the minimal automaton is built while reading the entries
+int incremental_mode    = 0;
+
+// number of threads used to parse the entries
+int n_threads           = 1;
+char foo;
+
 // describes the encoding configuration for I/O
 VersatileEncodingConfig vec = VEC_DEFAULT;
 
@@ -909,6 +1206,15 @@ while (EOF != (val = options.parse_long(argc, argv, optstring_Compress, lopts_Co
     case  2 : new_style_bin = 1; bin_type = BIN_BIN2;    break;
     case  3 : new_style_bin = 0; bin_type = BIN_CLASSIC; break;
     case  4 : new_style_bin = 1; bin_type = BIN_CLASSIC; break;
+    case  5 : incremental_mode = 1; break;
+    case  6 : if (1 != sscanf(options.vars()->optarg, "%d%c", &n_threads, &foo)
+                  || n_threads <= 0) {
+                // foo is used to check that the number of threads is not like "45gjh"
+                error("Invalid number of threads: %s\n", options.vars()->optarg);
+                free(buffer_filename);
+                return USAGE_ERROR_CODE;
+              }
+              break;
     case 'V': only_verify_arguments = true;
               break;
     case 'h': usage();
@@ -990,6 +1296,13 @@ if (output_type[0] != '\0') {
   }
 }
 
+// the incremental construction only produces nodes with INF codes, while
+// .bin2 dictionaries need a tree to move the outputs on the transitions
+if (incremental_mode && bin_type == BIN_BIN2) {
+  error("--incremental is not available for bin2 dictionaries, ignoring it\n");
+  incremental_mode = 0;
+}
+
 // returns here if we're only verifying the arguments syntax
 if (only_verify_arguments) {
   // freeing all allocated memory
@@ -1062,6 +1375,12 @@ struct dictionary_node* root  = new_dictionary_node(compress_abstract_allocator)
 // structure that will contain all the INF codes
 struct string_hash* INF_codes = new_string_hash();
 
+// with --incremental, the tree is minimized while it is built
+struct incremental_dictionary* incremental = NULL;
+if (incremental_mode) {
+  incremental = new_incremental_dictionary(root, compress_abstract_allocator);
+}
+
 int return_value  = SUCCESS_RETURN_CODE; // default return code
 int n_entries     = 0;                   // number of entries processed
 int n_lines       = 0;                   // number of lines scanned
@@ -1081,6 +1400,8 @@ return_value = build_tree_from_dictionary_list(
                        dictionary_list,  // dictionaries filenames
                        root,             // automaton initial state
                        INF_codes,        // all the INF codes
+                       incremental,      // incremental construction, if any
+                       n_threads,        // number of parsing threads
                        &n_entries,       // number of entries processed
                        &n_lines,         // number of lines scanned
                        &n_line_errors,   // number of line errors
@@ -1088,6 +1409,9 @@ return_value = build_tree_from_dictionary_list(
                        compress_abstract_allocator,
                        compress_tokenize_abstract_allocator);
 
+// minimizes the last entry, so that the automaton is minimal
+free_incremental_dictionary(incremental);
+
 // minimize and save the tree in a binary file always that there are
 // at least one entry to process
 if (return_value == SUCCESS_RETURN_CODE) {
@@ -1100,7 +1424,7 @@ if (return_value == SUCCESS_RETURN_CODE) {
                        inf_filename,     // output .inf filename
                        new_style_bin,    // 0: old style, 1: new style (>16Mb)
                        INF_codes,        // all the INF codes
-                       minimize_tree,    // function to construct a minimal ADFA
+                       incremental_mode ? mark_used_INF_codes : minimize_tree,
                        root,             // automaton initial state
                        &n_inf_codes,     // inflectional codes used
                        &n_states,        // states of the automaton
@@ -1158,6 +1482,11 @@ if (pack_inp && (bin_type!=BIN_BIN2) && (return_value==SUCCESS_RETURN_CODE)) {
     return_value = DEFAULT_ERROR_CODE;
   }
   af_remove(inf_filename);
+} else if (bin_type == BIN_CLASSIC && return_value == SUCCESS_RETURN_CODE
+           && fexists(inp_filename)) {
+  // a packed .inf file is preferred to the .inf file when loading the
+  // dictionary, so we must not leave an obsolete one
+  af_remove(inp_filename);
 }
 free(buffer_filename);
 return return_value;
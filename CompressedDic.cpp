@@ -37,6 +37,7 @@
 namespace unitex {
 
 static int read_bin_header(Dictionary*);
+static void free_dictionary_state_cache(struct dictionary_state_cache*);
 
 /**
  * return 1 if Bin data is a classic bin which need inf file
@@ -79,6 +80,7 @@ if (!read_bin_header(d)) {
     return NULL;
 }
 d->inf=NULL;
+d->state_cache=NULL;
 if (d->type==BIN_CLASSIC) {
     if (inf==NULL) {
         error("NULL .inf file in new_Dictionary\n");
@@ -118,6 +120,7 @@ if (d->bin!=NULL) free_abstract_BIN(d->bin,&d->bin_free);
 if (d->inf!=NULL) {
     free_abstract_INF(d->inf,&d->inf_free);
 }
+free_dictionary_state_cache(d->state_cache);
 free_cb(d,prv_alloc);
 }
 
@@ -558,6 +561,287 @@ if (s!=NULL && n!=-1) {
 }
 
 
+/**
+ * Returns the slot of the given offset in the hash table of the cache.
+ */
+static inline unsigned int get_cache_slot(int offset,int hash_bits) {
+return (((unsigned int)offset)*2654435769u)>>(32-hash_bits);
+}
+
+
+/**
+ * Decodes the state at the given offset and adds it to the cache.
+ */
+static struct cached_dictionary_state* add_cached_dictionary_state(const Dictionary* d,
+                                       struct dictionary_state_cache* cache,int offset,Ustring* ustr) {
+struct cached_dictionary_state* s=&(cache->states[cache->n++]);
+int pos=read_dictionary_state(d,offset,&(s->final),&(s->n_transitions),&(s->inf_number));
+s->offset=offset;
+s->letters=(unichar*)malloc(s->n_transitions*sizeof(unichar)+1);
+s->destinations=(int*)malloc(s->n_transitions*sizeof(int)+1);
+s->outputs=NULL;
+if (s->letters==NULL || s->destinations==NULL) {
+    fatal_alloc_error("add_cached_dictionary_state");
+}
+if (d->type==BIN_BIN2) {
+    s->outputs=(unichar**)calloc(s->n_transitions+1,sizeof(unichar*));
+    if (s->outputs==NULL) {
+        fatal_alloc_error("add_cached_dictionary_state");
+    }
+}
+for (int i=0;i<s->n_transitions;i++) {
+    empty(ustr);
+    pos=read_dictionary_transition(d,pos,&(s->letters[i]),&(s->destinations[i]),ustr);
+    if (ustr->len!=0) {
+        s->outputs[i]=u_strdup(ustr->str);
+    }
+}
+unsigned int slot=get_cache_slot(offset,cache->hash_bits);
+while (cache->table[slot]!=-1) {
+    slot=(slot+1)&((1u<<cache->hash_bits)-1);
+}
+cache->table[slot]=cache->n-1;
+return s;
+}
+
+
+/**
+ * Returns the decoded state at the given offset if it is in the cache of
+ * the dictionary, or NULL otherwise.
+ */
+const struct cached_dictionary_state* get_cached_dictionary_state(const Dictionary* d,int offset) {
+const struct dictionary_state_cache* cache=d->state_cache;
+if (cache==NULL) return NULL;
+unsigned int slot=get_cache_slot(offset,cache->hash_bits);
+int n;
+while ((n=cache->table[slot])!=-1) {
+    if (cache->states[n].offset==offset) return &(cache->states[n]);
+    slot=(slot+1)&((1u<<cache->hash_bits)-1);
+}
+return NULL;
+}
+
+
+/**
+ * Decodes the states of the dictionary that are the closest to the initial
+ * state, in breadth-first order, and keeps them in a cache so that the
+ * lookups that go through them do not need to decode bytes. These states are
+ * the ones that are used by almost every lookup. 'max_states' bounds the size
+ * of the cache. Nothing is done if the dictionary already has a cache.
+ */
+void cache_dictionary_states(Dictionary* d,int max_states) {
+if (d->state_cache!=NULL || max_states<=0) return;
+struct dictionary_state_cache* cache=(struct dictionary_state_cache*)malloc(sizeof(struct dictionary_state_cache));
+if (cache==NULL) {
+    fatal_alloc_error("cache_dictionary_states");
+}
+cache->hash_bits=1;
+while ((1<<cache->hash_bits)<2*max_states) {
+    cache->hash_bits++;
+}
+cache->table=(int*)malloc((1<<cache->hash_bits)*sizeof(int));
+cache->states=(struct cached_dictionary_state*)malloc(max_states*sizeof(struct cached_dictionary_state));
+if (cache->table==NULL || cache->states==NULL) {
+    fatal_alloc_error("cache_dictionary_states");
+}
+for (int i=0;i<(1<<cache->hash_bits);i++) {
+    cache->table[i]=-1;
+}
+cache->n=0;
+Ustring* ustr=new_Ustring();
+add_cached_dictionary_state(d,cache,d->initial_state_offset,ustr);
+/* The array of states is used as the queue of the breadth-first exploration */
+d->state_cache=cache;
+for (int i=0;i<cache->n && cache->n<max_states;i++) {
+    for (int j=0;j<cache->states[i].n_transitions && cache->n<max_states;j++) {
+        int dest=cache->states[i].destinations[j];
+        if (get_cached_dictionary_state(d,dest)==NULL) {
+            add_cached_dictionary_state(d,cache,dest,ustr);
+        }
+    }
+}
+free_Ustring(ustr);
+}
+
+
+/**
+ * Frees the cache of decoded states of the given dictionary, if any.
+ */
+static void free_dictionary_state_cache(struct dictionary_state_cache* cache) {
+if (cache==NULL) return;
+for (int i=0;i<cache->n;i++) {
+    free(cache->states[i].letters);
+    free(cache->states[i].destinations);
+    if (cache->states[i].outputs!=NULL) {
+        for (int j=0;j<cache->states[i].n_transitions;j++) {
+            free(cache->states[i].outputs[j]);
+        }
+        free(cache->states[i].outputs);
+    }
+}
+free(cache->states);
+free(cache->table);
+free(cache);
+}
+
+/**
+ * A state reached during a batch lookup. 'parent' is the index of the item
+ * of the previous level it comes from, and 'letter' is the dictionary letter
+ * of the transition that led to it, so that the inflected form can be
+ * rebuilt. 'output' is the output accumulated for .bin2 dictionaries, and
+ * 'base' the length of this output when the last final state was crossed.
+ */
+struct lookup_item {
+    int offset;
+    int base;
+    int parent;
+    unichar letter;
+    unichar* output;
+};
+
+
+/**
+ * The items reached after reading a given number of letters.
+ */
+struct lookup_level {
+    struct lookup_item* items;
+    int n;
+    int capacity;
+};
+
+
+static void add_lookup_item(struct lookup_level* level,int offset,int base,int parent,
+                            unichar letter,const Ustring* output) {
+if (level->n==level->capacity) {
+    level->capacity=(level->capacity==0)?4:2*level->capacity;
+    level->items=(struct lookup_item*)realloc(level->items,level->capacity*sizeof(struct lookup_item));
+    if (level->items==NULL) {
+        fatal_alloc_error("add_lookup_item");
+    }
+}
+struct lookup_item* item=&(level->items[level->n++]);
+item->offset=offset;
+item->base=base;
+item->parent=parent;
+item->letter=letter;
+item->output=(output->len==0)?NULL:u_strdup(output->str);
+}
+
+
+static void empty_lookup_level(struct lookup_level* level) {
+for (int i=0;i<level->n;i++) {
+    free(level->items[i].output);
+}
+level->n=0;
+}
+
+
+/**
+ * Computes the items reached from the items of 'src' with a letter
+ * matching 'w'.
+ */
+static void expand_lookup_level(const Dictionary* d,const struct lookup_level* src,struct lookup_level* dst,
+                                unichar w,t_fnc_dictionary_char_match match,void* private_ptr,Ustring* ustr) {
+int final,n_transitions,inf_number;
+unichar c;
+int dest;
+for (int i=0;i<src->n;i++) {
+    const struct lookup_item* item=&(src->items[i]);
+    const struct cached_dictionary_state* s=get_cached_dictionary_state(d,item->offset);
+    int pos=read_cached_dictionary_state(d,s,item->offset,&final,&n_transitions,&inf_number);
+    int output_length=(item->output==NULL)?0:u_strlen(item->output);
+    /* As in explore_bin_simple_words, crossing a final state moves the base */
+    int base=final?output_length:item->base;
+    for (int j=0;j<n_transitions;j++) {
+        if (item->output==NULL) empty(ustr);
+        else u_strcpy(ustr,item->output);
+        pos=read_cached_dictionary_transition(d,s,j,pos,&c,&dest,ustr);
+        if ((match==NULL)?(c==w):(*match)(c,w,private_ptr)) {
+            add_lookup_item(dst,dest,base,i,c,ustr);
+        }
+    }
+}
+}
+
+
+/**
+ * Looks up the given words in the dictionary. The words must be sorted, so
+ * that the states reached by a prefix shared with the previous word are not
+ * computed again. 'match' tells if a dictionary letter matches a word letter
+ * (for instance to allow case variations); if NULL, letters must be equal.
+ * For each word, 'found' is called on each state reached at the end of the
+ * word, final or not, in the order of a depth-first exploration, with the
+ * exact inflected form read in the dictionary.
+ */
+void lookup_sorted_words(const Dictionary* d,const unichar* const* words,int n_words,
+                         t_fnc_dictionary_char_match match,t_fnc_dictionary_word_found found,
+                         void* private_ptr) {
+int n_levels=1;
+struct lookup_level* levels=(struct lookup_level*)calloc(n_levels,sizeof(struct lookup_level));
+if (levels==NULL) {
+    fatal_alloc_error("lookup_sorted_words");
+}
+Ustring* ustr=new_Ustring();
+Ustring* inflected=new_Ustring();
+empty(ustr);
+add_lookup_item(&(levels[0]),d->initial_state_offset,0,-1,'\0',ustr);
+/* Number of letters of the previous word for which the levels are computed */
+int depth=0;
+const unichar* previous=NULL;
+for (int k=0;k<n_words;k++) {
+    const unichar* word=words[k];
+    int prefix=0;
+    if (previous!=NULL) {
+        while (prefix<depth && word[prefix]!='\0' && word[prefix]==previous[prefix]) {
+            prefix++;
+        }
+    }
+    for (int i=prefix+1;i<=depth;i++) {
+        empty_lookup_level(&(levels[i]));
+    }
+    depth=prefix;
+    while (word[depth]!='\0' && levels[depth].n!=0) {
+        if (depth+1==n_levels) {
+            levels=(struct lookup_level*)realloc(levels,2*n_levels*sizeof(struct lookup_level));
+            if (levels==NULL) {
+                fatal_alloc_error("lookup_sorted_words");
+            }
+            memset(levels+n_levels,0,n_levels*sizeof(struct lookup_level));
+            n_levels=2*n_levels;
+        }
+        expand_lookup_level(d,&(levels[depth]),&(levels[depth+1]),word[depth],match,private_ptr,ustr);
+        depth++;
+    }
+    previous=word;
+    if (word[depth]!='\0') {
+        /* The word is not a prefix of any entry */
+        continue;
+    }
+    for (int i=0;i<levels[depth].n;i++) {
+        const struct lookup_item* item=&(levels[depth].items[i]);
+        /* We rebuild the inflected form from the letters of the transitions */
+        resize(inflected,depth+1);
+        inflected->len=depth;
+        inflected->str[depth]='\0';
+        int index=i;
+        for (int j=depth;j>0;j--) {
+            inflected->str[j-1]=levels[j].items[index].letter;
+            index=levels[j].items[index].parent;
+        }
+        if (item->output==NULL) empty(ustr);
+        else u_strcpy(ustr,item->output);
+        (*found)(k,item->offset,inflected->str,ustr,item->base,private_ptr);
+    }
+}
+for (int i=0;i<n_levels;i++) {
+    empty_lookup_level(&(levels[i]));
+    free(levels[i].items);
+}
+free(levels);
+free_Ustring(ustr);
+free_Ustring(inflected);
+}
+
 /**
  * This function stores in *inf_codes the inf code list associated either to the inf number
  * or to the given output, if the dictionary is a .bin2 one. The function returns 1
@@ -587,6 +871,7 @@ int load_persistent_dictionary(const char* name) {
 VersatileEncodingConfig vec=VEC_DEFAULT;
 Dictionary* d=new_Dictionary(&vec,name);
 if (d==NULL) return 0;
+cache_dictionary_states(d,DEFAULT_CACHED_DICTIONARY_STATES);
 set_persistent_structure(name,d);
 return 1;
 }
@@ -70,6 +70,34 @@ typedef int (*t_fnc_bin_read_bytes)(const unsigned char* bin,int*offset) ;
 typedef void (*t_fnc_bin_write_bytes)(unsigned char* bin,int value,int *offset) ;
 
 
+/**
+ * A dictionary state decoded once for all: its transitions are stored in
+ * plain arrays. 'outputs' is only used for .bin2 dictionaries,
+ * and outputs[i] is NULL if the transition #i has no output.
+ */
+struct cached_dictionary_state {
+    int offset;
+    int final;
+    int inf_number;
+    int n_transitions;
+    unichar* letters;
+    int* destinations;
+    unichar** outputs;
+};
+
+
+/**
+ * A cache of decoded states, indexed by their offsets in an open
+ * addressing hash table of 2^hash_bits slots.
+ */
+struct dictionary_state_cache {
+    struct cached_dictionary_state* states;
+    int n;
+    int* table;
+    int hash_bits;
+};
+
+
 /**
  * This structure represents a compressed dictionary.
  */
@@ -95,6 +123,8 @@ typedef struct {
     /* The codes contained in the .inf file */
     const struct INF_codes* inf;
     struct INF_free_info inf_free;
+    /* The decoded states, if any */
+    struct dictionary_state_cache* state_cache;
 } Dictionary;
 
 
@@ -125,6 +155,50 @@ void restore_output(int,Ustring*);
 
 int get_inf_codes(Dictionary* d,int inf_number,Ustring* output,struct list_ustring* *inf_codes,int base);
 
+/* Number of states decoded in advance by the programs that apply dictionaries */
+#define DEFAULT_CACHED_DICTIONARY_STATES 4096
+
+void cache_dictionary_states(Dictionary*,int max_states);
+const struct cached_dictionary_state* get_cached_dictionary_state(const Dictionary*,int offset);
+
+/**
+ * Same as read_dictionary_state and read_dictionary_transition, except that
+ * the decoded state 's' is used instead of the bytes when it is not NULL.
+ * In that case, the transition to read is given by 'n' and 'pos' is
+ * returned unchanged.
+ */
+static inline int read_cached_dictionary_state(const Dictionary* d,const struct cached_dictionary_state* s,
+                                               int pos,int *final,int *n_transitions,int *code) {
+if (s==NULL) return read_dictionary_state(d,pos,final,n_transitions,code);
+*final=s->final;
+*n_transitions=s->n_transitions;
+*code=s->inf_number;
+return pos;
+}
+
+static inline int read_cached_dictionary_transition(const Dictionary* d,const struct cached_dictionary_state* s,
+                                                    int n,int pos,unichar *c,int *dest,Ustring* output) {
+if (s==NULL) return read_dictionary_transition(d,pos,c,dest,output);
+*c=s->letters[n];
+*dest=s->destinations[n];
+if (s->outputs!=NULL && s->outputs[n]!=NULL) {
+    u_strcat(output,s->outputs[n]);
+}
+return pos;
+}
+
+/**
+ * Callbacks used by lookup_sorted_words. The first one tells if the dictionary
+ * letter 'c' matches the word letter 'w'. The second one is called for each
+ * state at 'offset' reached by the word #word_index, with the corresponding
+ * 'inflected' form, .bin2 'output' and 'base' as used by get_inf_codes.
+ */
+typedef int (*t_fnc_dictionary_char_match)(unichar c,unichar w,void* private_ptr);
+typedef void (*t_fnc_dictionary_word_found)(int word_index,int offset,const unichar* inflected,
+                                            Ustring* output,int base,void* private_ptr);
+void lookup_sorted_words(const Dictionary*,const unichar* const* words,int n_words,
+                         t_fnc_dictionary_char_match,t_fnc_dictionary_word_found,void* private_ptr);
+
 int load_persistent_dictionary(const char* name);
 void free_persistent_dictionary(const char* name);
 
@@ -120,6 +120,7 @@ const char* usage_Concord =
     "  -d DIR/--directory=DIR: does not work in the same directory than <concord> but in DIR\n"
     "  -a ALPH/--alphabet=ALPH : the char order file used for sorting\n"
     "  -T/--thai: option to use for Thai concordances\n"
+    "  --threads=N: sorts the concordance with N threads (default=1)\n"
     "  -V/--only-verify-arguments: only verify arguments syntax and exit\n"
     "  -h/--help: this help\n"
     "\n"
@@ -215,6 +216,7 @@ const struct option_TS lopts_Concord[]= {
   {"only_matches",no_argument_TS,NULL,10},
   {"lemmatize",no_argument_TS,NULL,11},
   {"export_csv",no_argument_TS,NULL,12},
+  {"threads",required_argument_TS,NULL,13},
   {"TO",no_argument_TS,NULL,0},
   {"LC",no_argument_TS,NULL,1},
   {"LR",no_argument_TS,NULL,2},
@@ -334,6 +336,14 @@ while (EOF!=(val=options.parse_long(argc,argv,optstring_Concord,lopts_Concord,&i
    case 10: concord_options->only_matches=1; break;
    case 11: concord_options->result_mode=LEMMATIZE_; break;
    case 12: concord_options->result_mode=CSV_; break;
+   case 13: if (1!=sscanf(options.vars()->optarg,"%d%c",&(concord_options->n_threads),&foo)
+                || concord_options->n_threads<=0) {
+              /* foo is used to check that the number of threads is not like "45gjh" */
+              error("Invalid number of threads: %s\n",options.vars()->optarg);
+              free_conc_opt(concord_options);
+              return USAGE_ERROR_CODE;
+            }
+            break;
    case 'H': concord_options->result_mode=HTML_; break;
    case 't': {
      concord_options->result_mode=TEXT_;
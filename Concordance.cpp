@@ -37,7 +37,7 @@ namespace unitex {
 #define PRLG_DELIMITOR 0x02
 #define LEMMATIZE_DELIMITOR 0x03
 
-int create_raw_text_concordance(U_FILE*,U_FILE*,ABSTRACTMAPFILE*,struct text_tokens*,int,int,
+int create_raw_text_concordance(U_FILE*,vector_ptr*,U_FILE*,ABSTRACTMAPFILE*,struct text_tokens*,int,int,
                                 int*,int*,int,int,struct conc_opt*);
 void compute_token_length(int*,struct text_tokens*);
 
@@ -106,6 +106,30 @@ return c;
 }
 
 
+/**
+ * Reads a line of the raw text concordance file, without its final new line.
+ * Returns 0 at the end of the file.
+ */
+static int read_raw_concordance_line(U_FILE* f,Ustring* line) {
+empty(line);
+int c;
+while ((c=u_fgetc(f))!=EOF && c!='\n') {
+    u_strcat(line,(unichar)c);
+}
+return (c!=EOF || line->len!=0);
+}
+
+
+/**
+ * Returns the next char of the given raw text concordance line, or '\n' at
+ * the end of the line.
+ */
+static inline int next_raw_char(const unichar* *s) {
+if (**s=='\0') return '\n';
+return *((*s)++);
+}
+
+
 static void print_PRGL_tag_for_csv(U_FILE* out,unichar* s) {
 if (s==NULL || s[0]=='\0') return;
 if (s[0]!='[') {
@@ -292,12 +316,18 @@ if (options->output[0]=='\0') {
     else strcat(options->output,"concord.html");
 }
 int N_MATCHES;
+/* The lines of the raw text concordance, if it is kept in memory */
+vector_ptr* lines=NULL;
 
 /* If we are in the 'xalign' mode, we don't need to sort the results.
- * So, we don't need to store the results in a temporary file */
+ * So, we don't need to store the results in a temporary file. In Thai mode,
+ * we use a temporary file that is sorted with the SortTxt program. Otherwise,
+ * the results are kept and sorted in memory. */
+f=NULL;
 if (options->result_mode==XALIGN_) f=u_fopen(UTF8,options->output,U_WRITE);
-else f=u_fopen(vec,temp_file_name,U_WRITE);
-if (f==NULL) {
+else if (options->thai_mode) f=u_fopen(vec,temp_file_name,U_WRITE);
+else lines=new_vector_ptr(1024);
+if (f==NULL && lines==NULL) {
     error("Cannot write %s\n",temp_file_name);
     free(token_length);
     return 1;
@@ -305,28 +335,36 @@ if (f==NULL) {
 /* First, we create a raw text concordance.
  * NOTE: columns may have been reordered according to the sort mode. See the
  * comments of the 'create_raw_text_concordance' function for more details. */
-N_MATCHES=create_raw_text_concordance(f,concordance,text,tokens,
+N_MATCHES=create_raw_text_concordance(f,lines,concordance,text,tokens,
                                       options->result_mode,n_enter_char,enter_pos,
                                       token_length,open_bracket,close_bracket,
                                       options);
-u_fclose(f);
+if (f!=NULL) u_fclose(f);
 free(token_length);
 
 if(options->result_mode==XALIGN_) return 0;
 
-/* If necessary, we sort it by invoking the main function of the SortTxt program */
+/* If necessary, we sort it, with the same order as the SortTxt program */
 if (options->sort_mode!=TEXT_ORDER) {
-   pseudo_main_SortTxt(vec,0,0,options->sort_alphabet,NULL,options->thai_mode,temp_file_name,0);
+   if (lines!=NULL) {
+      lines->nbelems=sort_lines_in_memory(vec,options->sort_alphabet,(unichar**)lines->tab,
+                                          lines->nbelems,1,options->n_threads);
+   } else {
+      pseudo_main_SortTxt(vec,0,0,options->sort_alphabet,NULL,options->thai_mode,temp_file_name,0);
+   }
 }
 /* Now, we will take the sorted raw text concordance and we will:
  * 1) reorder the columns
  * 2) insert HTML info if needed
  */
 
-f=u_fopen(vec,temp_file_name,U_READ);
-if (f==NULL) {
-    error("Cannot read %s\n",temp_file_name);
-    return 1;
+f=NULL;
+if (lines==NULL) {
+   f=u_fopen(vec,temp_file_name,U_READ);
+   if (f==NULL) {
+       error("Cannot read %s\n",temp_file_name);
+       return 1;
+   }
 }
 if (options->result_mode==TEXT_ || options->result_mode==INDEX_
       || options->result_mode==XML_ || options->result_mode==XML_WITH_HEADER_
@@ -341,7 +379,8 @@ else {
 }
 if (out==NULL) {
     error("Cannot write %s\n",options->output);
-    u_fclose(f);
+    if (f!=NULL) u_fclose(f);
+    free_vector_ptr(lines,free);
     return 1;
 }
 /* If we have an HTML or a GlossaNet/script concordance, we must write an HTML
@@ -377,43 +416,54 @@ unichar* left=NULL;
 unichar* middle=NULL;
 unichar* right=NULL;
 Ustring* PRLG_tag=new_Ustring(32);
+Ustring* raw_line=new_Ustring(1024);
+const unichar* s;
+int n_line=0;
 int j;
 int c;
 int csv_line=1;
 /* Now we process each line of the sorted raw text concordance */
-while ((c=u_fgetc(f))!=EOF) {
+for (;;) {
+    if (lines!=NULL) {
+        if (n_line==lines->nbelems) break;
+        s=(const unichar*)lines->tab[n_line++];
+    } else {
+        if (!read_raw_concordance_line(f,raw_line)) break;
+        s=raw_line->str;
+    }
+    c=next_raw_char(&s);
     empty(PRLG_tag);
     j=0;
     /* We save the first column in A... */
     while (c!=0x09) {
         A[j++]=(unichar)c;
-        c=u_fgetc(f);
+        c=next_raw_char(&s);
     }
     A[j]='\0';
-    c=u_fgetc(f);
+    c=next_raw_char(&s);
     j=0;
     /* ...the second in B... */
     while (c!=0x09) {
         B[j++]=(unichar)c;
-        c=u_fgetc(f);
+        c=next_raw_char(&s);
     }
     B[j]='\0';
-    c=u_fgetc(f);
+    c=next_raw_char(&s);
     j=0;
     /* ...and the third in C */
     while (c!='\n' && c!='\t') {
         C[j++]=(unichar)c;
-        c=u_fgetc(f);
+        c=next_raw_char(&s);
     }
     C[j]='\0';
     indices[0]='\0';
     /* If there are indices to be read like "15 17 1", we read them */
     if (c=='\t') {
-        c=u_fgetc(f);
+        c=next_raw_char(&s);
         j=0;
         while (c!='\t' && c!='\n' && c!=PRLG_DELIMITOR) {
             indices[j++]=(unichar)c;
-            c=u_fgetc(f);
+            c=next_raw_char(&s);
         }
         indices[j]='\0';
         /*------------begin GlossaNet-------------------*/
@@ -424,7 +474,7 @@ while ((c=u_fgetc(f))!=EOF) {
                 href[0]='\0';
             } else {
                 j=0;
-                while ((c=u_fgetc(f))!='\n' && c!=PRLG_DELIMITOR) {
+                while ((c=next_raw_char(&s))!='\n' && c!=PRLG_DELIMITOR) {
                     href[j++]=(unichar)c;
                 }
                 href[j]='\0';
@@ -434,13 +484,13 @@ while ((c=u_fgetc(f))!=EOF) {
     }
     if (c==PRLG_DELIMITOR) {
         /* If there is a PRLG tag */
-        c=u_fgetc(f);
+        c=next_raw_char(&s);
         if (c!='[') {
             fatal_error("Invalid PRLG tag in create_concordance");
         }
         while (c!='\n') {
             u_strcat(PRLG_tag,(unichar)c);
-            c=u_fgetc(f);
+            c=next_raw_char(&s);
         }
         u_strcat(PRLG_tag,"  ");
     }
@@ -595,11 +645,15 @@ if ((options->result_mode==HTML_) || (options->result_mode==GLOSSANET_) ||
 if ((options->result_mode==XML_) || (options->result_mode==XML_WITH_HEADER_)){
   u_fprintf(out,"</concord>\n");
 }
-u_fclose(f);
-af_remove(temp_file_name);
+if (f!=NULL) {
+    u_fclose(f);
+    af_remove(temp_file_name);
+}
+free_vector_ptr(lines,free);
 u_fclose(out);
 free(unichar_buffer);
 free_Ustring(PRLG_tag);
+free_Ustring(raw_line);
 if (options->result_mode==GLOSSANET_) {
     free_string_hash(glossa_hash);
 }
@@ -1057,6 +1111,8 @@ while (list!=NULL) {
  * and 'enter_pos' is an array that contains the positions of these new lines.
  * If 'option.thai_mode' is set to a non zero value, it indicates that the concordance
  * is a Thai one. This information is used to compute correctly the context sizes.
+ * If 'output' is NULL, the lines are not written to a file, but added to 'lines'
+ * without their final new line.
  *
  * The function returns the number of matches actually written to the output file.
  *
@@ -1066,7 +1122,7 @@ while (list!=NULL) {
  *    - Column 2: shift in chars from the beginning of the sentence to the left side of the match
  *    - Column 3: shift in chars from the beginning of the sentence to the right side of the match
  */
-int create_raw_text_concordance(U_FILE* output,U_FILE* concordance,ABSTRACTMAPFILE* text,struct text_tokens* tokens,
+int create_raw_text_concordance(U_FILE* output,vector_ptr* lines,U_FILE* concordance,ABSTRACTMAPFILE* text,struct text_tokens* tokens,
                                 int expected_result,
                                 int n_enter_char,int* enter_pos,
                                 int* token_length,int open_bracket,int close_bracket,
@@ -1082,6 +1138,8 @@ unichar* middle = unichar_buffer + ((MAX_CONTEXT_IN_UNITS+1) * 1);
 unichar* right = unichar_buffer + ((MAX_CONTEXT_IN_UNITS+1) * 2);
 unichar* href = unichar_buffer + ((MAX_CONTEXT_IN_UNITS+1) * 3);
 size_t size_middle=MAX_CONTEXT_IN_UNITS;
+/* The concordance line to be saved */
+Ustring* line=new_Ustring(1024);
 int number_of_matches=0;
 int is_a_good_match=1;
 int start_pos,end_pos;
@@ -1306,29 +1364,33 @@ while (matches!=NULL) {
         /* We save the 3 parts of the concordance line according to the sort mode */
         switch(options->sort_mode) {
             case TEXT_ORDER:
-            if(expected_result==XALIGN_) u_fprintf(output,"%S\t%S",positions_from_eos,middle);
-                else u_fprintf(output,"%S\t%S\t%S",left,middle,right);
+            if(expected_result==XALIGN_) u_sprintf(line,"%S\t%S",positions_from_eos,middle);
+                else u_sprintf(line,"%S\t%S\t%S",left,middle,right);
                 break;
-            case LEFT_CENTER:  u_fprintf(output,"%R\t%S\t%S",left,middle,right); break;
-            case LEFT_RIGHT:   u_fprintf(output,"%R\t%S\t%S",left,right,middle); break;
-            case CENTER_LEFT:  u_fprintf(output,"%S\t%R\t%S",middle,left,right); break;
-            case CENTER_RIGHT: u_fprintf(output,"%S\t%S\t%R",middle,right,left);    break;
-            case RIGHT_LEFT:   u_fprintf(output,"%S\t%R\t%S",right,left,middle); break;
-            case RIGHT_CENTER: u_fprintf(output,"%S\t%S\t%R",right,middle,left);    break;
+            case LEFT_CENTER:  u_sprintf(line,"%R\t%S\t%S",left,middle,right); break;
+            case LEFT_RIGHT:   u_sprintf(line,"%R\t%S\t%S",left,right,middle); break;
+            case CENTER_LEFT:  u_sprintf(line,"%S\t%R\t%S",middle,left,right); break;
+            case CENTER_RIGHT: u_sprintf(line,"%S\t%S\t%R",middle,right,left);    break;
+            case RIGHT_LEFT:   u_sprintf(line,"%S\t%R\t%S",right,left,middle); break;
+            case RIGHT_CENTER: u_sprintf(line,"%S\t%S\t%R",right,middle,left);    break;
         }
         /* And we add the position information */
-        if(expected_result!=XALIGN_) u_fputs(positions,output);
+        if(expected_result!=XALIGN_) u_strcat(line,positions);
         /* And the GlossaNet URL if needed */
         if (expected_result==GLOSSANET_) {
-            u_fprintf(output,"\t%S",href);
+            u_strcatf(line,"\t%S",href);
         }
         if (closest_tag!=NULL) {
-            u_fprintf(output,"%C[%S",PRLG_DELIMITOR,closest_tag);
+            u_strcatf(line,"%C[%S",PRLG_DELIMITOR,closest_tag);
             int padding=options->PRLG_data->max_width-u_strlen(closest_tag);
-            for (int k=0;k<padding;k++) u_fprintf(output," ");
-            u_fprintf(output,"]");
+            for (int k=0;k<padding;k++) u_strcat(line," ");
+            u_strcat(line,"]");
+        }
+        if (output!=NULL) {
+            u_fprintf(output,"%S\n",line->str);
+        } else {
+            vector_ptr_add(lines,u_strdup(line->str));
         }
-        u_fprintf(output,"\n");
         /* We increase the number of matches actually written to the output */
         number_of_matches++;
     }
@@ -1340,6 +1402,7 @@ while (matches!=NULL) {
 af_release_mapfile_pointer(buffer->amf,buffer->int_buffer_);
 free_vector_int(renumber);
 free(unichar_buffer);
+free_Ustring(line);
 free(buffer);
 return number_of_matches;
 }
@@ -1644,6 +1707,7 @@ opt->uima_offsets=NULL;
 opt->PRLG_data=NULL;
 opt->only_matches=0;
 opt->original_file_offsets=0;
+opt->n_threads=1;
 opt->output_offsets[0]='\0';
 opt->input_offsets[0] = '\0';
 opt->convLFtoCRLF=1;
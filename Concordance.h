@@ -92,6 +92,8 @@ struct conc_opt {
   char original_file_offsets;
   char input_offsets[FILENAME_MAX];
   char output_offsets[FILENAME_MAX];
+  /* Number of threads used to sort the concordance */
+  int n_threads;
 };
 
 struct conc_opt* new_conc_opt();
@@ -81,6 +81,13 @@ const char* usage_Dico =
          "  -K/--korean: tells Dico that it works on Korean\n"
          "  -s/--semitic: tells Dico that it works on a semitic language\n"
          "  -u X/--arabic_rules=X: Arabic typographic rule configuration file\n"
+         "  --threads=N: applies with N threads the .bin dictionaries of a same priority\n"
+         "               that are not separated by a .fst2 grammar of this priority (default: 1).\n"
+         "               The results are the same as with a single thread\n"
+         "  --memo=FILE: caches in FILE the results of the .bin dictionaries for each simple\n"
+         "               word token, so that the tokens already looked up in a previous run\n"
+         "               with the same dictionary and alphabet are not looked up again. The\n"
+         "               results of the new tokens are appended to FILE\n"
          "  -r X/--raw=X: indicates that Dico should just produce one output file X containing\n"
          "                both simple and compound words, without requiring a text directory.\n"
          "                If X is omitted, results are displayed on the standard output.\n"
@@ -204,8 +211,21 @@ if (len==0 || s[len]!='-') {
 }
 
 
+/**
+ * Returns 1 if the dictionary or grammar 'name' must be applied with the
+ * given priority, according to the priority mark at the end of its name;
+ * 0 otherwise.
+ */
+static int has_priority(const char* name,int priority) {
+char tmp[FILENAME_MAX];
+remove_extension(name,tmp);
+char priority_mark=tmp[strlen(tmp)-1];
+return (priority==1 && priority_mark=='-') || (priority==2 && priority_mark!='-' && priority_mark!='+') || (priority==3 && priority_mark=='+');
+}
+
 
-const char* optstring_Dico=":t:a:m:KVhk:q:u:g:sr::";
+
+const char* optstring_Dico=":t:a:m:KVhk:q:u:g:sr::#:$:";
 const struct option_TS lopts_Dico[]= {
   {"text",required_argument_TS,NULL,'t'},
   {"alphabet",required_argument_TS,NULL,'a'},
@@ -219,6 +239,8 @@ const struct option_TS lopts_Dico[]= {
   {"arabic_rules",required_argument_TS,NULL,'u'},
   {"raw",optional_argument_TS,NULL,'r'},
   {"semitic",no_argument_TS,NULL,'s'},
+  {"threads",required_argument_TS,NULL,'#'},
+  {"memo",required_argument_TS,NULL,'$'},
   {NULL,no_argument_TS,NULL,0}
 };
 
@@ -233,7 +255,7 @@ int ret=0;
 int val,index=-1;
 
 size_t step_filename_buffer = (((FILENAME_MAX / 0x10) + 1) * 0x10);
-char* buffer_filename = (char*)malloc(step_filename_buffer * 6);
+char* buffer_filename = (char*)malloc(step_filename_buffer * 7);
 if (buffer_filename == NULL) {
   alloc_error("main_Dico");
   return ALLOC_ERROR_CODE;
@@ -243,15 +265,19 @@ char* alph = (buffer_filename + (step_filename_buffer * 0));
 char* text = (buffer_filename + (step_filename_buffer * 1));
 char* arabic_rules = (buffer_filename + (step_filename_buffer * 2));
 char* raw_output = (buffer_filename + (step_filename_buffer * 3));
+char* memo = (buffer_filename + (step_filename_buffer * 6));
 *alph = '\0';
 *text = '\0';
 *arabic_rules = '\0';
 *raw_output = '\0';
+*memo = '\0';
 
 char negation_operator[0x20]="";
 char* morpho_dic=NULL;
 int is_korean=0;
 int semitic=0;
+int n_threads=1;
+char foo;
 U_FILE* f_raw_output=NULL;
 VersatileEncodingConfig vec=VEC_DEFAULT;
 bool only_verify_arguments = false;
@@ -331,6 +357,22 @@ while (EOF!=(val=options.parse_long(argc,argv,optstring_Dico,lopts_Dico,&index))
              break;
    case 's': semitic=1;
              break;
+   case '#': if (1!=sscanf(options.vars()->optarg,"%d%c",&n_threads,&foo) || n_threads<=0) {
+                /* foo is used to check that the param is not like "45gjh" */
+                error("Invalid number of threads: %s\n",options.vars()->optarg);
+                free(morpho_dic);
+                free(buffer_filename);
+                return USAGE_ERROR_CODE;
+             }
+             break;
+   case '$': if (options.vars()->optarg[0]=='\0') {
+                error("You must specify a non empty memo file name\n");
+                free(morpho_dic);
+                free(buffer_filename);
+                return USAGE_ERROR_CODE;
+             }
+             strcpy(memo,options.vars()->optarg);
+             break;
    case 'r': if (options.vars()->optarg==NULL) {
               /* No argument ? We display on stdout */
               f_raw_output=U_STDOUT;
@@ -507,6 +549,11 @@ u_fclose(text_cod);
 
 u_printf("Initializing...\n");
 struct dico_application_info* info=init_dico_application(tokens,NULL,NULL,NULL,NULL,NULL,snt_files->tags_ind,snt_files->text_cod,alphabet,&vec);
+if (memo[0]!='\0') {
+   strcpy(info->memo_file,memo);
+   /* The results of a dictionary also depend on the alphabet */
+   info->memo_key=hash_dico_memo_file(0,alph);
+}
 
 /* First of all, we compute the number of occurrences of each token */
 u_printf("Counting tokens...\n");
@@ -527,7 +574,36 @@ for (int priority=1;priority<4;priority++) {
             /*
              * If it is a .bin dictionary
              */
-           u_printf("Applying dico  %s...\n",argv[i]);
+            /*
+             * With several threads, this dictionary is applied together with the
+             * next .bin dictionaries of the same priority, up to the next .fst2
+             * grammar of this priority
+             */
+            int n_dics=0;
+            char** dics=NULL;
+            if (n_threads>1) {
+               dics=(char**)malloc(sizeof(char*)*argc);
+               if (dics==NULL) {
+                  fatal_alloc_error("main_Dico");
+               }
+               for (int j=i;j<argc;j++) {
+                  if (!has_priority(argv[j],priority)) continue;
+                  get_extension(argv[j],tmp2);
+                  if (!strcmp(tmp2,".bin") || !strcmp(tmp2,".bin2")) {
+                     dics[n_dics++]=argv[j];
+                     i=j;
+                  } else if (!strcmp(tmp2,".fst2")) {
+                     break;
+                  }
+               }
+            }
+            if (n_dics>1) {
+               for (int j=0;j<n_dics;j++) {
+                  u_printf("Applying dico  %s...\n",dics[j]);
+               }
+            } else {
+               u_printf("Applying dico  %s...\n",argv[i]);
+            }
             /* We open output files: dictionaries in APPEND mode since we
              * can only add entries to them, and 'err' in WRITE mode because
              * each dictionary application may reduce this file */
@@ -539,9 +615,14 @@ for (int priority=1;priority<4;priority++) {
             info->dlc=u_fopen(&vec,snt_files->dlc,U_APPEND);
             info->err=u_fopen(&vec,snt_files->err,U_WRITE);
             /* Working... */
-            if (dico_application(&vec,argv[i],info,priority) != 0) {
+            if (n_dics>1) {
+               if (dico_application_in_threads(&vec,dics,n_dics,info,priority,snt_files->dlf,snt_files->dlc,n_threads) != 0) {
+                  ret = 1;
+               }
+            } else if (dico_application(&vec,argv[i],info,priority) != 0) {
                 ret = 1;
             }
+            free(dics);
             /* Dumping and closing output files */
             save_unknown_words(info);
             u_fclose(info->dlf);
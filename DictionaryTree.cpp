@@ -177,6 +177,33 @@ static int get_value_index_for_string_colon_string(const unichar* str1,const uni
    return value;
 }
 
+/**
+ * Adds the given INF code to the INF codes associated to the given node, and
+ * updates the global INF line of the node.
+ */
+static void add_INF_code_to_node(struct dictionary_node* node,const unichar* INF_code,
+                                 struct string_hash* INF_code_list,Abstract_allocator prv_alloc) {
+int N=get_value_index(INF_code,INF_code_list);
+if (node->single_INF_code_list==NULL) {
+   /* If there is no INF code in the node, then
+    * we add one and we return */
+   node->single_INF_code_list=new_list_int(N,prv_alloc);
+   node->INF_code=N;
+   return;
+}
+/* If there is an INF code list in the node ...*/
+if (is_in_list(N,node->single_INF_code_list)) {
+   /* If the INF code has already been taken into account for this node
+    * (case of duplicates), we do nothing */
+   return;
+}
+/* Otherwise, we add it to the INF code list */
+node->single_INF_code_list=head_insert(N,node->single_INF_code_list,prv_alloc);
+/* And we update the global INF line for this node */
+node->INF_code=get_value_index_for_string_colon_string(INF_code_list->value[node->INF_code],INF_code,INF_code_list);
+}
+
+
 /**
  * This function explores a dictionary tree in order to insert an entry.
  * 'inflected' is the inflected form to insert, and 'pos' is the current position
@@ -189,24 +216,7 @@ for (;;) {
 if (inflected[pos]=='\0') {
    /* If we have reached the end of 'inflected', then we are in the
     * node where the INF code must be inserted */
-   int N=get_value_index(infos->INF_code,infos->INF_code_list);
-   if (node->single_INF_code_list==NULL) {
-      /* If there is no INF code in the node, then
-       * we add one and we return */
-      node->single_INF_code_list=new_list_int(N,prv_alloc);
-      node->INF_code=N;
-      return;
-   }
-   /* If there is an INF code list in the node ...*/
-   if (is_in_list(N,node->single_INF_code_list)) {
-      /* If the INF code has already been taken into account for this node
-       * (case of duplicates), we do nothing */
-      return;
-   }
-   /* Otherwise, we add it to the INF code list */
-   node->single_INF_code_list=head_insert(N,node->single_INF_code_list,prv_alloc);
-    /* And we update the global INF line for this node */
-   node->INF_code=get_value_index_for_string_colon_string(infos->INF_code_list->value[node->INF_code],infos->INF_code,infos->INF_code_list);
+   add_INF_code_to_node(node,infos->INF_code,infos->INF_code_list,prv_alloc);
    return;
 }
 /* If we are not at the end of 'inflected', then we look for
@@ -272,6 +282,7 @@ struct transition_list {
 };
 
 static inline int compare_nodes(const struct dictionary_node_transition*,const struct dictionary_node_transition*);
+static inline int compare_dictionary_nodes(const struct dictionary_node*,const struct dictionary_node*);
 //void init_minimize_arrays(struct transition_list***,struct dictionary_node_transition***);
 static void init_minimize_arrays_transition_list(struct transition_list***);
 static void init_minimize_arrays_dictionary_node_transition(struct dictionary_node_transition***,unsigned int nb);
@@ -341,11 +352,16 @@ if (a==NULL || a->node==NULL) {
  * 3) by the transition that get out of them
  */
 static inline int compare_nodes(const struct dictionary_node_transition* a,const struct dictionary_node_transition* b) {
-/* If the nodes have not the same INF codes, they are different */
+return compare_dictionary_nodes(a->node,b->node);
+}
 
-    struct dictionary_node* a_node = a->node;
-    struct dictionary_node* b_node = b->node;
 
+/**
+ * This function compares two nodes by their INF codes and then by their
+ * outgoing transitions. It returns 0 if the nodes are equivalent.
+ */
+static inline int compare_dictionary_nodes(const struct dictionary_node* a_node,const struct dictionary_node* b_node) {
+/* If the nodes have not the same INF codes, they are different */
     if (a_node->single_INF_code_list!=b_node->single_INF_code_list) {
         if (a_node->single_INF_code_list!=NULL && b_node->single_INF_code_list==NULL) return -1;
         if (a_node->single_INF_code_list==NULL && b_node->single_INF_code_list!=NULL) return 1;
@@ -355,8 +371,8 @@ static inline int compare_nodes(const struct dictionary_node_transition* a,const
             return (a_node->INF_code - b_node->INF_code);
 
 /* Then, we compare all the outgoing transitions, two by two */
-a=a_node->trans;
-b=b_node->trans;
+const struct dictionary_node_transition* a=a_node->trans;
+const struct dictionary_node_transition* b=b_node->trans;
 while(a!=NULL && b!=NULL) {
    /* If the 2 current transitions are not tagged by the same
     * character, then the nodes are different */
@@ -587,6 +603,324 @@ while (i<size) {
 }
 
 
+/******************************************************************
+ *
+ *
+ * The following code builds the minimal automaton incrementally,
+ * using the algorithm of Daciuk, Mihov, Watson and Watson (2000).
+ *
+ *
+ ******************************************************************/
+
+/**
+ * A cell of the register of the incremental construction. The register
+ * contains exactly one representative of each equivalence class of the
+ * nodes that cannot be modified anymore.
+ */
+struct register_cell {
+   struct dictionary_node* node;
+   unsigned int hash;
+   struct register_cell* next;
+};
+
+
+/**
+ * This structure holds the state of an incremental construction. 'path'
+ * contains the nodes reached by the last inserted inflected form 'last':
+ * path[i] is the node reached after reading i letters. These nodes are the
+ * only ones that may be modified, all the other nodes being in the register.
+ */
+struct incremental_dictionary {
+   struct dictionary_node* root;
+   struct dictionary_node** path;
+   unichar* last;
+   int length;
+   int capacity;
+   struct register_cell** cells;
+   unsigned int register_size;
+   unsigned int n_registered;
+   Abstract_allocator prv_alloc;
+};
+
+
+#define INITIAL_REGISTER_SIZE 4096
+#define INITIAL_PATH_CAPACITY 256
+
+
+/**
+ * Returns a hash value for the given node that is consistent with
+ * 'compare_dictionary_nodes'.
+ */
+static unsigned int hash_dictionary_node(const struct dictionary_node* n) {
+unsigned int h=(n->single_INF_code_list==NULL)?0:(unsigned int)n->INF_code+1;
+for (const struct dictionary_node_transition* t=n->trans;t!=NULL;t=t->next) {
+   h=h*31+t->letter;
+   h=h*31+(unsigned int)(((size_t)t->node)>>4);
+}
+return h;
+}
+
+
+/**
+ * Allocates, initializes and returns a structure to build the minimal
+ * automaton of the entries that will be added to the given root.
+ */
+struct incremental_dictionary* new_incremental_dictionary(struct dictionary_node* root,Abstract_allocator prv_alloc) {
+struct incremental_dictionary* d=(struct incremental_dictionary*)malloc(sizeof(struct incremental_dictionary));
+if (d==NULL) {
+   fatal_alloc_error("new_incremental_dictionary");
+}
+d->root=root;
+d->capacity=INITIAL_PATH_CAPACITY;
+d->path=(struct dictionary_node**)malloc(d->capacity*sizeof(struct dictionary_node*));
+d->last=(unichar*)malloc(d->capacity*sizeof(unichar));
+d->register_size=INITIAL_REGISTER_SIZE;
+d->cells=(struct register_cell**)calloc(d->register_size,sizeof(struct register_cell*));
+if (d->path==NULL || d->last==NULL || d->cells==NULL) {
+   fatal_alloc_error("new_incremental_dictionary");
+}
+d->path[0]=root;
+d->last[0]='\0';
+d->length=0;
+d->n_registered=0;
+d->prv_alloc=prv_alloc;
+return d;
+}
+
+
+/**
+ * Doubles the size of the register.
+ */
+static void resize_register(struct incremental_dictionary* d) {
+unsigned int size=2*d->register_size;
+struct register_cell** cells=(struct register_cell**)calloc(size,sizeof(struct register_cell*));
+if (cells==NULL) {
+   fatal_alloc_error("resize_register");
+}
+for (unsigned int i=0;i<d->register_size;i++) {
+   struct register_cell* c=d->cells[i];
+   while (c!=NULL) {
+      struct register_cell* next=c->next;
+      c->next=cells[c->hash&(size-1)];
+      cells[c->hash&(size-1)]=c;
+      c=next;
+   }
+}
+free(d->cells);
+d->cells=cells;
+d->register_size=size;
+}
+
+
+/**
+ * Removes the given node from the register, if it is there.
+ */
+static void unregister_node(struct incremental_dictionary* d,struct dictionary_node* n) {
+struct register_cell** c=&(d->cells[hash_dictionary_node(n)&(d->register_size-1)]);
+while (*c!=NULL) {
+   if ((*c)->node==n) {
+      struct register_cell* tmp=*c;
+      *c=tmp->next;
+      free(tmp);
+      d->n_registered--;
+      return;
+   }
+   c=&((*c)->next);
+}
+}
+
+
+/**
+ * Returns the transition of 'n' tagged with 'c', or NULL if there is none.
+ */
+static struct dictionary_node_transition* find_transition(const struct dictionary_node* n,unichar c) {
+struct dictionary_node_transition* t=n->trans;
+while (t!=NULL && t->letter<c) {
+   t=t->next;
+}
+return (t!=NULL && t->letter==c)?t:NULL;
+}
+
+
+/**
+ * The node pointed by the transition of 'parent' tagged with 'c' cannot be
+ * modified anymore. If an equivalent node is already in the register, we
+ * redirect the transition to it and we free the node; otherwise, the node is
+ * added to the register.
+ */
+static void replace_or_register(struct incremental_dictionary* d,struct dictionary_node* parent,unichar c) {
+struct dictionary_node_transition* t=find_transition(parent,c);
+struct dictionary_node* n=t->node;
+unsigned int h=hash_dictionary_node(n);
+for (struct register_cell* cell=d->cells[h&(d->register_size-1)];cell!=NULL;cell=cell->next) {
+   if (cell->hash==h && compare_dictionary_nodes(cell->node,n)==0) {
+      t->node=cell->node;
+      (cell->node->incoming)++;
+      free_dictionary_node(n,d->prv_alloc);
+      return;
+   }
+}
+struct register_cell* cell=(struct register_cell*)malloc(sizeof(struct register_cell));
+if (cell==NULL) {
+   fatal_alloc_error("replace_or_register");
+}
+cell->node=n;
+cell->hash=h;
+cell->next=d->cells[h&(d->register_size-1)];
+d->cells[h&(d->register_size-1)]=cell;
+d->n_registered++;
+if (d->n_registered>d->register_size) {
+   resize_register(d);
+}
+}
+
+
+/**
+ * The node pointed by 't' is in the register, and we want to modify it
+ * because an entry goes through it. If this node is shared, we replace
+ * it by a copy; otherwise, we just remove it from the register. This can
+ * only happen when the entries are not sorted.
+ */
+static void make_mutable(struct incremental_dictionary* d,struct dictionary_node_transition* t) {
+struct dictionary_node* n=t->node;
+if (n->incoming<=1) {
+   unregister_node(d,n);
+   return;
+}
+struct dictionary_node* copy=new_dictionary_node(d->prv_alloc);
+copy->single_INF_code_list=clone(n->single_INF_code_list,d->prv_alloc);
+copy->INF_code=n->INF_code;
+struct dictionary_node_transition** last=&(copy->trans);
+for (struct dictionary_node_transition* tmp=n->trans;tmp!=NULL;tmp=tmp->next) {
+   *last=new_dictionary_node_transition(d->prv_alloc);
+   (*last)->letter=tmp->letter;
+   (*last)->node=tmp->node;
+   (tmp->node->incoming)++;
+   last=&((*last)->next);
+}
+(n->incoming)--;
+copy->incoming=1;
+t->node=copy;
+}
+
+
+/**
+ * Minimizes the nodes of the current path that are deeper than 'length'.
+ */
+static void minimize_path(struct incremental_dictionary* d,int length) {
+for (int i=d->length;i>length;i--) {
+   replace_or_register(d,d->path[i-1],d->last[i-1]);
+}
+}
+
+
+/**
+ * This function inserts an entry in a dictionary automaton that is being
+ * built incrementally. The nodes that cannot be modified by the following
+ * entries are minimized on the fly, so that the memory used is bounded by
+ * the size of the minimal automaton when the entries are sorted. Unsorted
+ * entries are also supported, at the price of some node copies.
+ */
+void add_entry_to_incremental_dictionary(const unichar* inflected,const unichar* INF_code,
+                                         struct incremental_dictionary* d,struct string_hash* INF_code_list) {
+int prefix=0;
+while (prefix<d->length && inflected[prefix]==d->last[prefix]) {
+   prefix++;
+}
+minimize_path(d,prefix);
+int n=prefix+u_strlen(inflected+prefix);
+if (n>=d->capacity) {
+   while (n>=d->capacity) {
+      d->capacity=2*d->capacity;
+   }
+   d->path=(struct dictionary_node**)realloc(d->path,d->capacity*sizeof(struct dictionary_node*));
+   d->last=(unichar*)realloc(d->last,d->capacity*sizeof(unichar));
+   if (d->path==NULL || d->last==NULL) {
+      fatal_alloc_error("add_entry_to_incremental_dictionary");
+   }
+}
+struct dictionary_node* node=d->path[prefix];
+for (int i=prefix;i<n;i++) {
+   struct dictionary_node_transition* t=get_transition(inflected[i],&node,d->prv_alloc);
+   if (t->node==NULL) {
+      t->node=new_dictionary_node(d->prv_alloc);
+      (t->node->incoming)++;
+   } else {
+      make_mutable(d,t);
+   }
+   node=t->node;
+   d->path[i+1]=node;
+   d->last[i]=inflected[i];
+}
+d->last[n]='\0';
+d->length=n;
+add_INF_code_to_node(node,INF_code,INF_code_list,d->prv_alloc);
+}
+
+
+/**
+ * Minimizes the last inserted entry and frees the given structure. After
+ * this call, the automaton whose root was given to 'new_incremental_dictionary'
+ * is minimal.
+ */
+void free_incremental_dictionary(struct incremental_dictionary* d) {
+if (d==NULL) return;
+minimize_path(d,0);
+for (unsigned int i=0;i<d->register_size;i++) {
+   struct register_cell* c=d->cells[i];
+   while (c!=NULL) {
+      struct register_cell* next=c->next;
+      free(c);
+      c=next;
+   }
+}
+free(d->cells);
+free(d->path);
+free(d->last);
+free(d);
+}
+
+
+/**
+ * Marks the INF codes used by the nodes reachable from 'n'. Visited
+ * nodes are marked with a 0 offset.
+ */
+static void mark_used_INF_codes_(struct dictionary_node* n,struct bit_array* used_inf_values) {
+if (n->offset==0) return;
+n->offset=0;
+if (n->single_INF_code_list!=NULL) {
+   set_value(used_inf_values,n->INF_code,1);
+}
+for (struct dictionary_node_transition* t=n->trans;t!=NULL;t=t->next) {
+   mark_used_INF_codes_(t->node,used_inf_values);
+}
+}
+
+
+/**
+ * Restores the -1 offsets of the nodes marked by 'mark_used_INF_codes_'.
+ */
+static void reset_offsets(struct dictionary_node* n) {
+if (n->offset==-1) return;
+n->offset=-1;
+for (struct dictionary_node_transition* t=n->trans;t!=NULL;t=t->next) {
+   reset_offsets(t->node);
+}
+}
+
+
+/**
+ * This function marks the INF codes that are used by a dictionary
+ * automaton that is already minimal, like the ones built with
+ * 'add_entry_to_incremental_dictionary'. It has the same signature as
+ * 'minimize_tree' so that it can be used instead.
+ */
+void mark_used_INF_codes(struct dictionary_node* root,struct bit_array* used_inf_values,Abstract_allocator /*prv_alloc*/) {
+mark_used_INF_codes_(root,used_inf_values);
+reset_offsets(root);
+}
+
+
 /**
  * This function takes a prefix and a string s. It replaces
  * pfx by the longest prefix that is common to pfx and s.
@@ -102,6 +102,13 @@ struct dictionary_node* new_dictionary_node(Abstract_allocator);
 void minimize_tree(struct dictionary_node*,struct bit_array*,Abstract_allocator);
 void move_outputs_on_transitions(struct dictionary_node* root,struct string_hash* inf_codes);
 
+struct incremental_dictionary;
+struct incremental_dictionary* new_incremental_dictionary(struct dictionary_node*,Abstract_allocator);
+void add_entry_to_incremental_dictionary(const unichar*,const unichar*,struct incremental_dictionary*,
+        struct string_hash*);
+void free_incremental_dictionary(struct incremental_dictionary*);
+void mark_used_INF_codes(struct dictionary_node*,struct bit_array*,Abstract_allocator);
+
 } // namespace unitex
 
 #endif
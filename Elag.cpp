@@ -58,6 +58,8 @@ const char* usage_Elag =
          "  -r RULES/--rules=RULES: compiled elag rules file\n"
          "  -o OUT/--output=OUT: resulting output .tfst file\n"
          "  -S/--no_statistics: do not produce statistics file\n"
+         "  --threads=N: disambiguates the sentences with N threads\n"
+         "  --progress: reports the number of processed sentences\n"
          "  -V/--only-verify-arguments: only verify arguments syntax and exit\n"
          "  -h/--help: this help\n"
          "\n"
@@ -79,6 +81,8 @@ const struct option_TS lopts_Elag[]= {
   {"output_encoding",required_argument_TS,NULL,'q'},
   {"only_verify_arguments",no_argument_TS,NULL,'V'},
   {"no_statistics",no_argument_TS,NULL,'S'},
+  {"threads",required_argument_TS,NULL,'#'},
+  {"progress",no_argument_TS,NULL,1},
   {"help",no_argument_TS,NULL,'h'},
   {NULL,no_argument_TS,NULL,0}
 };
@@ -93,6 +97,9 @@ if (argc==1) {
 VersatileEncodingConfig vec=VEC_DEFAULT;
 int val,index=-1;
 int save_statistics=1;
+int n_threads=1;
+int progress=0;
+char foo;
 char language[FILENAME_MAX]="";
 char rule_file[FILENAME_MAX]="";
 char output_tfst[FILENAME_MAX]="";
@@ -134,6 +141,14 @@ while (EOF!=(val=options.parse_long(argc,argv,optstring_Elag,lopts_Elag,&index))
              break;
    case 'S': save_statistics = 0;
              break;
+   case '#': if (1!=sscanf(options.vars()->optarg,"%d%c",&n_threads,&foo) || n_threads<=0) {
+                /* foo is used to check that the param is not like "45gjh" */
+                error("Invalid number of threads: %s\n",options.vars()->optarg);
+                return USAGE_ERROR_CODE;
+             }
+             break;
+   case 1: progress=1;
+           break;
    case 'V': only_verify_arguments = true;
              break;
    case 'h': usage();
@@ -187,7 +202,7 @@ if ((grammars=load_elag_grammars(&vec,rule_file,lang,directory)) == NULL) {
 }
 u_printf("Grammars are loaded.\n");
 
-remove_ambiguities(input_tfst,grammars,output_tfst,&vec,lang,save_statistics);
+remove_ambiguities(input_tfst,grammars,output_tfst,&vec,lang,save_statistics,n_threads,progress);
 free_vector_ptr(grammars,(release_f)free_Fst2Automaton_including_symbols);
 free_language_t(lang);
 return SUCCESS_RETURN_CODE;
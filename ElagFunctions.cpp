@@ -43,6 +43,7 @@
 #include "Symbol.h"
 #include "Ustring.h"
 #include "TfstStats.h"
+#include "SyncTool.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -54,12 +55,125 @@ static void add_sentence_delimiters(Tfst* tfst,language_t*);
 static void remove_sentence_delimiters(Tfst* tfst,language_t*);
 vector_ptr* convert_elag_symbols_to_tfst_tags(Elag_Tfst_file_in*);
 
+/* Number of consecutive sentences given to a worker at a time */
+#define ELAG_SENTENCES_PER_WORKER 16
+
+/* What happened to a sentence during the disambiguation */
+#define ELAG_SENTENCE_OK 0
+#define ELAG_SENTENCE_EMPTY 1
+#define ELAG_SENTENCE_EMPTY_WITH_DELIMITERS 2
+#define ELAG_SENTENCE_REJECTED 3
+
+static const unichar SENTENCE_DELIMITER[] = { '{', 'S', '}', 0 };
+
+/**
+ * This structure holds a sentence to be disambiguated. 'input' shares the
+ * language of the main input, but has its own Tfst, into which the sentence
+ * is moved once loaded. The disambiguation fills 'tags' with the tags to be
+ * saved, and it stores the ambiguity measures of the sentence, so that they
+ * can be summed in sentence order.
+ */
+struct elag_sentence {
+   Elag_Tfst_file_in input;
+   int status;
+   double before;
+   double after;
+   double length_before;
+   double length_after;
+   vector_ptr* tags;
+};
+
+
+/**
+ * This structure describes a worker of the multi-threaded mode. The grammars
+ * and the language are shared by all the workers. They are only read, since
+ * all the forms and codes of the sentences have already been added to the
+ * language when the sentences were loaded.
+ */
+struct elag_worker {
+   struct elag_sentence* sentences;
+   int n_sentences;
+   vector_ptr* gramms;
+   language_t* language;
+};
+
+
+/**
+ * Disambiguates the given sentence with the given grammars.
+ */
+static void disambiguate_sentence(struct elag_sentence* s,vector_ptr* gramms,language_t* language) {
+Tfst* tfst=s->input.tfst;
+s->status=ELAG_SENTENCE_OK;
+s->before=s->after=0.;
+s->length_before=s->length_after=0.;
+elag_determinize(language,tfst->automaton,free_symbol);
+elag_minimize(tfst->automaton);
+if (tfst->automaton->number_of_states<2) {
+   /* If the sentence is empty, we replace the sentence automaton
+    * by a 1-state automaton with no transition. */
+   free_SingleGraph(tfst->automaton,free_symbol);
+   tfst->automaton=new_SingleGraph(1,PTR_TAGS);
+   SingleGraphState initial_state=add_state(tfst->automaton);
+   set_initial_state(initial_state);
+   s->status=ELAG_SENTENCE_EMPTY;
+} else {
+   int min,max;
+   s->before=evaluate_ambiguity(tfst->automaton,&min,&max);
+   s->length_before=((double) (min + max) / (double) 2);
+   add_sentence_delimiters(tfst,language);
+   if (tfst->automaton->number_of_states<2) {
+      s->status=ELAG_SENTENCE_EMPTY_WITH_DELIMITERS;
+   } else {
+      for (int j=0;j<gramms->nbelems;j++) {
+         Fst2Automaton* grammar=(Fst2Automaton*)(gramms->tab[j]);
+         SingleGraph temp=elag_intersection(language,tfst->automaton,grammar->automaton,TEXT_GRAMMAR);
+         trim(temp,free_symbol);
+         free_SingleGraph(tfst->automaton,free_symbol);
+         tfst->automaton=temp;
+         if (tfst->automaton->number_of_states<2) {
+            /* If the sentence has been rejected by the grammar, we don't go on
+             * intersecting with other grammars */
+            free_SingleGraph(tfst->automaton,free_symbol);
+            tfst->automaton=new_SingleGraph(1,PTR_TAGS);
+            SingleGraphState initial_state=add_state(tfst->automaton);
+            set_initial_state(initial_state);
+            s->status=ELAG_SENTENCE_REJECTED;
+            break;
+         }
+      }
+   }
+   if (s->status!=ELAG_SENTENCE_REJECTED) {
+      elag_determinize(language,tfst->automaton,free_symbol);
+      trim(tfst->automaton,free_symbol);
+      elag_minimize(tfst->automaton);
+      remove_sentence_delimiters(tfst,language);
+      s->after=evaluate_ambiguity(tfst->automaton,&min,&max);
+      s->length_after=((double) (min + max) / (double) 2);
+   }
+}
+s->tags=convert_elag_symbols_to_tfst_tags(&(s->input));
+}
+
+
+/**
+ * Worker thread function: disambiguates the sentences of the worker.
+ */
+static void ABSTRACT_CALLBACK_UNITEX elag_worker_thread(void* private_ptr,unsigned int /* num_worker */) {
+struct elag_worker* w=(struct elag_worker*)private_ptr;
+for (int i=0;i<w->n_sentences;i++) {
+   disambiguate_sentence(w->sentences+i,w->gramms,w->language);
+}
+}
+
 
 /**
  * This function loads a .tfst text automaton, disambiguates it according to the given rules,
- * and saves the result in another text automaton.
+ * and saves the result in another text automaton. Sentences are disambiguated with
+ * 'n_threads' threads. If 'progress' is not null, the number of processed sentences
+ * is reported at most once per second.
  */
-void remove_ambiguities(const char* input_tfst,vector_ptr* gramms,const char* output, const VersatileEncodingConfig* vec,language_t* language,int save_statistics) {
+void remove_ambiguities(const char* input_tfst,vector_ptr* gramms,const char* output, const VersatileEncodingConfig* vec,language_t* language,int save_statistics,
+                        int n_threads,int progress) {
    Elag_Tfst_file_in* input=load_tfst_file(vec,input_tfst,language);
    if (input==NULL) {
       fatal_error("Unable to load text automaton'%s'\n",input_tfst);
@@ -84,80 +198,106 @@ void remove_ambiguities(const char* input_tfst,vector_ptr* gramms,const char* ou
    u_printf("\nProcessing ...\n");
    int n_rejected_sentences = 0;
    int nb_unloadable = 0;
-   double before, after;
    double total_before = 0.0, total_after = 0.0;
    double length_before = 0., length_after = 0.; // average text length in words
-   Tfst* tfst=input->tfst;
+   int N=input->tfst->N;
 
    /* We use this hash table to rebuild files tfst_tags_by_freq/alph.txt */
    hash_table* form_frequencies=new_hash_table((HASH_FUNCTION)hash_unichar,(EQUAL_FUNCTION)u_equal,
            (FREE_FUNCTION)free,NULL,(KEYCOPY_FUNCTION)keycopy);
 
-   for (int current_sentence=1;current_sentence<=input->tfst->N;current_sentence++) {
-      load_tfst_sentence_automaton(input,current_sentence);
-      elag_determinize(language,tfst->automaton,free_symbol);
-      elag_minimize(tfst->automaton);
-      int is_rejected=0;
-      if (current_sentence % 100 == 0) {
-         u_printf("Sentence %d/%d...\r",current_sentence,input->tfst->N);
+   /* Sentences are processed by batches: they are loaded by the main thread, since
+    * loading adds their forms to the language, then they are disambiguated
+    * in parallel, and finally they are saved in sentence order */
+   if (n_threads>1 && !SyncIsWorkerThreadAvailable()) {
+      n_threads=1;
+   }
+   if (n_threads>(N+ELAG_SENTENCES_PER_WORKER-1)/ELAG_SENTENCES_PER_WORKER) {
+      n_threads=(N+ELAG_SENTENCES_PER_WORKER-1)/ELAG_SENTENCES_PER_WORKER;
+   }
+   if (n_threads<1) {
+      n_threads=1;
+   }
+   int batch_size=(n_threads==1)?1:n_threads*ELAG_SENTENCES_PER_WORKER;
+   struct elag_sentence* sentences=(struct elag_sentence*)malloc(batch_size*sizeof(struct elag_sentence));
+   struct elag_worker* workers=(struct elag_worker*)malloc(n_threads*sizeof(struct elag_worker));
+   struct elag_worker** worker_ptrs=(struct elag_worker**)malloc(n_threads*sizeof(struct elag_worker*));
+   if (sentences==NULL || workers==NULL || worker_ptrs==NULL) {
+      fatal_alloc_error("remove_ambiguities");
+   }
+   for (int i=0;i<batch_size;i++) {
+      sentences[i].input.tfst=new_Tfst(NULL,NULL,N);
+      sentences[i].input.language=language;
+      sentences[i].tags=NULL;
+   }
+   for (int i=0;i<n_threads;i++) {
+      workers[i].gramms=gramms;
+      workers[i].language=language;
+      worker_ptrs[i]=workers+i;
+   }
+   time_t last_report=0;
+   for (int first=1;first<=N;first+=batch_size) {
+      int last=first+batch_size-1;
+      if (last>N) {
+         last=N;
       }
-      u_printf("Sentence %d\n",current_sentence);
-      if (tfst->automaton->number_of_states<2) {
-         /* If the sentence is empty, we replace the sentence automaton
-          * by a 1-state automaton with no transition. */
-         error("Sentence %d is empty\n",current_sentence);
-         free_SingleGraph(tfst->automaton,free_symbol);
-         tfst->automaton=new_SingleGraph(1,PTR_TAGS);
-         SingleGraphState initial_state=add_state(tfst->automaton);
-         set_initial_state(initial_state);
-         nb_unloadable++;
+      for (int i=first;i<=last;i++) {
+         load_tfst_sentence_automaton(input,i);
+         move_current_sentence(input->tfst,sentences[i-first].input.tfst);
+         if (i==1) {
+            /* {S} is added to the forms after the first sentence, as it used to
+             * be when sentences were processed one by one, so that the
+             * numbering of the forms does not depend on the number of threads */
+            language_add_form(language,SENTENCE_DELIMITER);
+         }
+      }
+      if (n_threads==1) {
+         disambiguate_sentence(sentences,gramms,language);
       } else {
-         int min,max;
-         before=evaluate_ambiguity(tfst->automaton,&min,&max);
-         total_before += before;
-         length_before = length_before + ((double) (min + max) / (double) 2);
-         add_sentence_delimiters(tfst,language);
-         if (tfst->automaton->number_of_states<2) {
-            error("Sentence %d is empty\n",current_sentence) ;
-         } else {
-            for (int j=0;j<gramms->nbelems;j++) {
-               Fst2Automaton* grammar=(Fst2Automaton*)(gramms->tab[j]);
-               SingleGraph temp=elag_intersection(language,tfst->automaton,grammar->automaton,TEXT_GRAMMAR);
-               trim(temp,free_symbol);
-               free_SingleGraph(tfst->automaton,free_symbol);
-               tfst->automaton=temp;
-               if (tfst->automaton->number_of_states<2) {
-                  /* If the sentence has been rejected by the grammar */
-                  error("Sentence %d rejected\n\n",current_sentence);
-                  j=gramms->nbelems; /* We don't go on intersecting with other grammars */
-                  n_rejected_sentences++;
-                  free_SingleGraph(tfst->automaton,free_symbol);
-                  tfst->automaton=new_SingleGraph(1,PTR_TAGS);
-                  SingleGraphState initial_state=add_state(tfst->automaton);
-                  set_initial_state(initial_state);
-                  is_rejected=1;
-                  break;
-               }
+         int n=0;
+         for (int start=first;start<=last;start+=ELAG_SENTENCES_PER_WORKER) {
+            workers[n].sentences=sentences+(start-first);
+            workers[n].n_sentences=ELAG_SENTENCES_PER_WORKER;
+            if (start+ELAG_SENTENCES_PER_WORKER-1>last) {
+               workers[n].n_sentences=last-start+1;
             }
+            n++;
          }
-         if (!is_rejected) {
-            elag_determinize(language,tfst->automaton,free_symbol);
-            trim(tfst->automaton,free_symbol);
-            elag_minimize(tfst->automaton);
-            remove_sentence_delimiters(tfst,language);
-            after = evaluate_ambiguity(tfst->automaton,&min,&max);
-            total_after += after;
-            length_after = length_after + ((double) (min + max) / (double) 2);
+         SyncRunWorkerThreads((unsigned int)n,elag_worker_thread,(void**)worker_ptrs);
+      }
+      for (int i=first;i<=last;i++) {
+         struct elag_sentence* s=sentences+(i-first);
+         switch (s->status) {
+         case ELAG_SENTENCE_EMPTY: nb_unloadable++;
+                                   /* No break here */
+         case ELAG_SENTENCE_EMPTY_WITH_DELIMITERS: error("Sentence %d is empty\n",i); break;
+         case ELAG_SENTENCE_REJECTED: error("Sentence %d rejected\n\n",i);
+                                      n_rejected_sentences++;
+                                      break;
+         }
+         total_before += s->before;
+         length_before = length_before + s->length_before;
+         total_after += s->after;
+         length_after = length_after + s->length_after;
+         save_current_sentence(s->input.tfst,output_tfst,output_tind,(unichar**)s->tags->tab,s->tags->nbelems,form_frequencies);
+         free_vector_ptr(s->tags,free);
+         s->tags=NULL;
+         if (progress && time(0)!=last_report) {
+            /* We report the progress at most once per second */
+            last_report=time(0);
+            u_printf("Sentence %d/%d...\r",i,N);
          }
       }
-      vector_ptr* new_tags=convert_elag_symbols_to_tfst_tags(input);
-      save_current_sentence(input->tfst,output_tfst,output_tind,(unichar**)new_tags->tab,new_tags->nbelems,form_frequencies);
-      free_vector_ptr(new_tags,free);
-      free_SingleGraph(tfst->automaton,NULL);
-      tfst->automaton=NULL;
    }
-   u_printf("\n");
-   int N=input->tfst->N;
+   for (int i=0;i<batch_size;i++) {
+      close_text_automaton(sentences[i].input.tfst);
+   }
+   free(worker_ptrs);
+   free(workers);
+   free(sentences);
+   if (progress) {
+      u_printf("\n");
+   }
    tfst_file_close_in(input);
    u_fclose(output_tfst);
    u_fclose(output_tind);
@@ -336,8 +476,9 @@ return grammars;
  * Adds {S} at the beginning and end of the sentence automaton.
  */
 static void add_sentence_delimiters(Tfst* tfst,language_t* language) {
-static const unichar S[] = { '{', 'S', '}', 0 };
-int idx=language_add_form(language,S);
+/* {S} is supposed to be already in the forms, so that this
+ * function does not modify the language */
+int idx=language_add_form(language,SENTENCE_DELIMITER);
 symbol_t* delimiter=new_symbol_PUNC(language,idx,-1);
 int pseudo_initial_state_index=tfst->automaton->number_of_states;
 SingleGraphState pseudo_initial_state=add_state(tfst->automaton);
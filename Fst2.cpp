@@ -1022,6 +1022,43 @@ Fst2* fst2ret;
 }
 
 
+/**
+ * Returns a copy of the given fst2 that only owns a copy of the tags. States,
+ * initial states, graph names and variable lists are shared with 'fst2org',
+ * so this clone is cheap to build. It is designed for programs like Locate
+ * that modify tags but never modify states. It must be freed with
+ * free_Fst2_shallow_clone and must not outlive 'fst2org'.
+ */
+Fst2* new_Fst2_shallow_clone(const Fst2* fst2org,Abstract_allocator prv_alloc) {
+Fst2* fst2ret=(Fst2*)malloc_cb(sizeof(Fst2),prv_alloc);
+if (fst2ret==NULL) {
+   fatal_alloc_error("new_Fst2_shallow_clone");
+}
+*fst2ret=*fst2org;
+fst2ret->tags=(Fst2Tag*)malloc_cb(sizeof(Fst2Tag)*fst2org->number_of_tags,prv_alloc);
+if (fst2ret->tags==NULL) {
+   fatal_alloc_error("new_Fst2_shallow_clone");
+}
+for (int i=0;i<fst2org->number_of_tags;i++) {
+   fst2ret->tags[i]=new_Fst2Tag_clone(fst2org->tags[i],prv_alloc);
+}
+return fst2ret;
+}
+
+
+/**
+ * Frees a fst2 created with new_Fst2_shallow_clone.
+ */
+void free_Fst2_shallow_clone(Fst2* fst2,Abstract_allocator prv_alloc) {
+if (fst2==NULL) return;
+for (int i=0;i<fst2->number_of_tags;i++) {
+   free_Fst2Tag(fst2->tags[i],prv_alloc);
+}
+free_cb(fst2->tags,prv_alloc);
+free_cb(fst2,prv_alloc);
+}
+
+
 /**
  * Returns the number of the graph (starting at 1) containing the given state.
  *
@@ -235,6 +235,8 @@ void free_Fst2(Fst2*,Abstract_allocator prv_alloc=STANDARD_ALLOCATOR);
 int get_graph_compatibility_mode_by_file(const VersatileEncodingConfig*,int *p_tilde_negation_operator);
 
 Fst2* new_Fst2_clone(Fst2* fst2org,Abstract_allocator prv_alloc=STANDARD_ALLOCATOR);
+Fst2* new_Fst2_shallow_clone(const Fst2* fst2org,Abstract_allocator prv_alloc=STANDARD_ALLOCATOR);
+void free_Fst2_shallow_clone(Fst2*,Abstract_allocator prv_alloc=STANDARD_ALLOCATOR);
 
 /* Functions for writing grammars */
 void write_graph(U_FILE*,Fst2*,int);
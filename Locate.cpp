@@ -127,6 +127,30 @@ const char* usage_Locate =
          "  --least_tolerant: set max matches per subgraph, max matches per token and\n"
          "                         max exploration step at a tenth of default value.\n"
          "\n"
+         "  --cache_size=N: limits the memory used by the Locate cache to N megabytes;\n"
+         "                 when the limit is reached, the least recently used parts of\n"
+         "                 the cache are evicted (default: no limit)\n"
+         "  --persistent_cache=X: loads the Locate cache from file X before exploring\n"
+         "                        the text, and saves it into X at the end. The file is\n"
+         "                        ignored if it was produced with another grammar,\n"
+         "                        other options or other resource files. It is not\n"
+         "                        used with grammars that look up the text dictionaries\n"
+         "                        (lexical masks like <N>, <DIC>, <CDIC>, <SDIC>)\n"
+         "  --stream: reads the text through a sliding window of tokens instead of\n"
+         "            mapping it entirely in memory, so that the memory used does not\n"
+         "            depend on the text size. The results are the same. This option\n"
+         "            is ignored in Korean mode and it disables --threads\n"
+         "  --profile=X: saves the statistics of the operation (matches, exploration\n"
+         "               steps, cache hits, memory held by the allocators) in file X,\n"
+         "               one \"name=value\" line per statistic\n"
+         "  --threads=N: explores the text with N threads (default: 1). The text is cut\n"
+         "               at {S} sentence delimiters and the results are merged, so that\n"
+         "               concord.ind is the same as with a single thread\n"
+         "  --binary_ind: saves concord.ind in a binary format made of fixed-width\n"
+         "                arrays, which is faster to write and to load. Concord, Dico,\n"
+         "                Extract, ConcorDiff and Cassys read both formats. This option\n"
+         "                is ignored for debug grammars\n"
+         "\n"
          "  -V/--only-verify-arguments: only verify arguments syntax and exit\n"
          "  -h/--help: this help\n"
          "\n"
@@ -144,7 +168,7 @@ static void usage() {
 #endif
 }
 
-const char* optstring_Locate=":t:a:m:SLAIMRXYZln:d:cewsxbzpKVhk:q:o:u:g:Tv:$:@:C:P:HQN+:";
+const char* optstring_Locate=":t:a:m:SLAIMRXYZln:d:cewsxbzpKVhk:q:o:u:g:Tv:$:@:C:P:HQN+:#:&:!:%^:|";
 const struct option_TS lopts_Locate[]= {
   {"text",required_argument_TS,NULL,'t'},
   {"alphabet",required_argument_TS,NULL,'a'},
@@ -185,6 +209,12 @@ const struct option_TS lopts_Locate[]= {
   {"lesser_tolerant",no_argument_TS,NULL,'Q'},
   {"least_tolerant",no_argument_TS,NULL,'N'},
   {"trace_option",required_argument_TS,NULL,'+'},
+  {"threads",required_argument_TS,NULL,'#'},
+  {"cache_size",required_argument_TS,NULL,'&'},
+  {"persistent_cache",required_argument_TS,NULL,'!'},
+  {"stream",no_argument_TS,NULL,'%'},
+  {"profile",required_argument_TS,NULL,'^'},
+  {"binary_ind",no_argument_TS,NULL,'|'},
   {"only_verify_arguments",no_argument_TS,NULL,'V'},
   {"help",no_argument_TS,NULL,'h'},
   {NULL,no_argument_TS,NULL,0}
@@ -251,6 +281,8 @@ char alph[FILENAME_MAX]="";
 char text[FILENAME_MAX]="";
 char dynamicSntDir[FILENAME_MAX]="";
 char arabic_rules[FILENAME_MAX]="";
+char persistent_cache[FILENAME_MAX]="";
+char profile[FILENAME_MAX]="";
 char* morpho_dic=NULL;
 MatchPolicy match_policy=LONGEST_MATCHES;
 OutputPolicy output_policy=IGNORE_OUTPUTS;
@@ -268,6 +300,10 @@ int max_matches_at_token_pos=MAX_MATCHES_AT_TOKEN_POS;
 int max_matches_per_subgraph=MAX_MATCHES_PER_SUBGRAPH;
 int tolerance_divide_factor=1;
 int max_errors=0;
+int n_threads=1;
+int cache_size_in_mb=0;
+int stream=0;
+int binary_concord=0;
 int tilde_negation_operator=1;
 int useLocateCache=1;
 int selected_negation_operator=0;
@@ -352,6 +388,8 @@ while (EOF!=(val=options.parse_long(argc,argv,optstring_Locate,lopts_Locate,&ind
    case 'l': search_limit=NO_MATCH_LIMIT; break;
    case 'e': useLocateCache=0; break;
    case 'T': allow_trace=0; break;
+   case '%': stream=1; break;
+   case '|': binary_concord=1; break;
    case 'n': if (1!=sscanf(options.vars()->optarg,"%d%c",&search_limit,&foo) || search_limit<=0) {
                 /* foo is used to check that the search limit is not like "45gjh" */
                 error("Invalid search limit argument: %s\n",options.vars()->optarg);
@@ -424,6 +462,24 @@ while (EOF!=(val=options.parse_long(argc,argv,optstring_Locate,lopts_Locate,&ind
                 return USAGE_ERROR_CODE;
              }
              break;
+   case '#': if (1!=sscanf(options.vars()->optarg,"%d%c",&n_threads,&foo) || n_threads<=0) {
+                /* foo is used to check that the param is not like "45gjh" */
+                error("Invalid number of threads: %s\n",options.vars()->optarg);
+                free_vector_ptr(injected_vars,free);
+                free_locate_trace_param(list_param_trace);
+                free(morpho_dic);
+                return USAGE_ERROR_CODE;
+             }
+             break;
+   case '&': if (1!=sscanf(options.vars()->optarg,"%d%c",&cache_size_in_mb,&foo) || cache_size_in_mb<=0) {
+                /* foo is used to check that the param is not like "45gjh" */
+                error("Invalid cache size: %s\n",options.vars()->optarg);
+                free_vector_ptr(injected_vars,free);
+                free_locate_trace_param(list_param_trace);
+                free(morpho_dic);
+                return USAGE_ERROR_CODE;
+             }
+             break;
    case 'H': {
                 tolerance_divide_factor=2;
              }
@@ -488,6 +544,24 @@ while (EOF!=(val=options.parse_long(argc,argv,optstring_Locate,lopts_Locate,&ind
              }
              strcpy(arabic_rules,options.vars()->optarg);
              break;
+   case '!': if (options.vars()->optarg[0]=='\0') {
+                error("You must specify a non empty cache file name\n");
+                free_vector_ptr(injected_vars,free);
+                free_locate_trace_param(list_param_trace);
+                free(morpho_dic);
+                return USAGE_ERROR_CODE;
+             }
+             strcpy(persistent_cache,options.vars()->optarg);
+             break;
+   case '^': if (options.vars()->optarg[0]=='\0') {
+                error("You must specify a non empty profile file name\n");
+                free_vector_ptr(injected_vars,free);
+                free_locate_trace_param(list_param_trace);
+                free(morpho_dic);
+                return USAGE_ERROR_CODE;
+             }
+             strcpy(profile,options.vars()->optarg);
+             break;
    case '+': if (options.vars()->optarg[0]=='\0') {
                 error("You must specify a non empty trace option\n");
                 free_vector_ptr(injected_vars,free);
@@ -630,7 +704,9 @@ int OK=locate_pattern(text_cod,
                useLocateCache,
                allow_trace,
                list_param_trace,
-               injected_vars);
+               injected_vars,
+               n_threads,(size_t)cache_size_in_mb*1024*1024,
+               persistent_cache,stream,profile,binary_concord);
 
 free(buffer_filename);
 free_vector_ptr(injected_vars,free);
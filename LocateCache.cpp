@@ -21,9 +21,12 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "LocateCache.h"
 #include "Error.h"
 #include "Match.h"
+#include "Af_stdio.h"
+#include "File.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -62,11 +65,25 @@ free_cb(c,prv_alloc);
 }
 
 
+/**
+ * Returns the number of bytes used by the given match.
+ */
+static size_t match_size(const struct match_list* match) {
+size_t size=sizeof(struct match_list);
+if (match->output!=NULL) {
+    size+=(u_strlen(match->output)+1)*sizeof(unichar);
+}
+return size;
+}
+
+
 /**
  * Caches the given token sequence in the given cache. Note that
  * match is supposed to contain a single match, not a match list.
+ * '*size' is increased by the number of bytes used to do so.
  */
-static void cache_match_internal(struct match_list* match,const int* tab,int start,int end,LocateCache *c,Abstract_allocator prv_alloc) {
+static void cache_match_internal(struct match_list* match,const int* tab,int start,int end,LocateCache *c,
+                                 size_t* size,Abstract_allocator prv_alloc) {
 int token=-1;
 struct match_list* m=match;
 if (start<=end) {
@@ -76,19 +93,22 @@ if (start<=end) {
 /* No node */
 if (*c==NULL) {
     *c=new_LocateCache(token,m,prv_alloc);
+    (*size)+=sizeof(struct locate_cache);
     if (token!=-1) {
-        cache_match_internal(match,tab,start+1,end,&((*c)->middle),prv_alloc);
+        cache_match_internal(match,tab,start+1,end,&((*c)->middle),size,prv_alloc);
+    } else {
+        (*size)+=match_size(match);
     }
     return;
 }
 /* There is a node */
 if (token<(*c)->token) {
     /* If we have to move on the left */
-    return cache_match_internal(match,tab,start,end,&((*c)->left),prv_alloc);
+    return cache_match_internal(match,tab,start,end,&((*c)->left),size,prv_alloc);
 }
 if (token>(*c)->token) {
     /* If we have to move on the right */
-    return cache_match_internal(match,tab,start,end,&((*c)->right),prv_alloc);
+    return cache_match_internal(match,tab,start,end,&((*c)->right),size,prv_alloc);
 }
 /* We have the correct token */
 if (token==-1) {
@@ -109,9 +129,81 @@ if (token==-1) {
         ptr=&((*ptr)->next);
     }
     (*ptr)=match;
+    (*size)+=match_size(match);
     return;
 }
-cache_match_internal(match,tab,start+1,end,&((*c)->middle),prv_alloc);
+cache_match_internal(match,tab,start+1,end,&((*c)->middle),size,prv_alloc);
+}
+
+
+/**
+ * Allocates, initializes and returns a new cache set for 'n_tokens' tokens.
+ * 'max_size' is the memory budget in bytes, 0 meaning no limit.
+ */
+LocateCacheSet new_LocateCacheSet(int n_tokens,size_t max_size,Abstract_allocator prv_alloc) {
+LocateCacheSet set=(LocateCacheSet)malloc_cb(sizeof(struct locate_cache_set),prv_alloc);
+if (set==NULL) {
+    fatal_alloc_error("new_LocateCacheSet");
+}
+set->caches=(LocateCache*)malloc_cb(n_tokens*sizeof(LocateCache),prv_alloc);
+set->sizes=(size_t*)malloc_cb(n_tokens*sizeof(size_t),prv_alloc);
+set->referenced=(unsigned char*)malloc_cb(n_tokens*sizeof(unsigned char),prv_alloc);
+if ((set->caches==NULL || set->sizes==NULL || set->referenced==NULL) && n_tokens!=0) {
+    fatal_alloc_error("new_LocateCacheSet");
+}
+memset(set->caches,0,n_tokens*sizeof(LocateCache));
+memset(set->sizes,0,n_tokens*sizeof(size_t));
+memset(set->referenced,0,n_tokens*sizeof(unsigned char));
+set->n_tokens=n_tokens;
+set->size=0;
+set->max_size=max_size;
+set->clock_hand=0;
+set->hits=0;
+set->misses=0;
+set->evictions=0;
+set->prv_alloc=prv_alloc;
+return set;
+}
+
+
+/**
+ * Frees all the memory associated to the given cache set.
+ */
+void free_LocateCacheSet(LocateCacheSet set) {
+if (set==NULL) return;
+Abstract_allocator prv_alloc=set->prv_alloc;
+for (int i=0;i<set->n_tokens;i++) {
+    free_LocateCache(set->caches[i],prv_alloc);
+}
+free_cb(set->caches,prv_alloc);
+free_cb(set->sizes,prv_alloc);
+free_cb(set->referenced,prv_alloc);
+free_cb(set,prv_alloc);
+}
+
+
+/**
+ * Evicts token caches until the memory budget is respected again. This must
+ * not be called while the matches of a token sequence are being cached, since
+ * the cache of a sequence must contain all its matches or none of them.
+ */
+void evict_caches_if_needed(LocateCacheSet set) {
+if (set->max_size==0) return;
+while (set->size>set->max_size) {
+    int i=set->clock_hand;
+    set->clock_hand=(i+1)%set->n_tokens;
+    if (set->caches[i]==NULL) continue;
+    if (set->referenced[i]) {
+        /* Second chance */
+        set->referenced[i]=0;
+        continue;
+    }
+    free_LocateCache(set->caches[i],set->prv_alloc);
+    set->caches[i]=NULL;
+    set->size-=set->sizes[i];
+    set->sizes[i]=0;
+    (set->evictions)++;
+}
 }
 
 
@@ -121,8 +213,13 @@ cache_match_internal(match,tab,start+1,end,&((*c)->middle),prv_alloc);
  * There is no need to save the first token, since caches are stored
  * in an array indexed on first tokens.
  */
-void cache_match(struct match_list* match,const int* tab,int start,int end,LocateCache *c, Abstract_allocator prv_alloc) {
-cache_match_internal(match,tab,start+1,end,c,prv_alloc);
+void cache_match(struct match_list* match,const int* tab,int start,int end,LocateCacheSet set) {
+int first_token=tab[start];
+size_t size=0;
+cache_match_internal(match,tab,start+1,end,&(set->caches[first_token]),&size,set->prv_alloc);
+set->sizes[first_token]+=size;
+set->size+=size;
+set->referenced[first_token]=1;
 }
 
 
@@ -157,14 +254,331 @@ explore_cache_node(tab,pos,tab_size,c->right,res);
  * associated to token sequences are stored in 'res'. Returns 1 if matches
  * were found; 0 otherwise.
  */
-int consult_cache(const int* tab,int start,int tab_size,LocateCache* caches,vector_ptr* res) {
+int consult_cache(const int* tab,int start,int tab_size,LocateCacheSet set,vector_ptr* res) {
 res->nbelems=0;
 int first_token=tab[start];
 if (first_token==-1) {
     return 0;
 }
-explore_cache_node(tab,start+1,tab_size,caches[first_token],res);
-return res->nbelems!=0;
+explore_cache_node(tab,start+1,tab_size,set->caches[first_token],res);
+if (res->nbelems==0) {
+    (set->misses)++;
+    return 0;
+}
+(set->hits)++;
+set->referenced[first_token]=1;
+return 1;
+}
+
+
+typedef void (*t_cached_sequence_func)(const int* tokens,int n,struct match_list* matches,void* private_ptr);
+
+
+/**
+ * Calls 'f' for each token sequence stored in the given cache node. 'path'
+ * contains the tokens that lead to this node.
+ */
+static void explore_cached_sequences(LocateCache c,vector_int* path,t_cached_sequence_func f,void* private_ptr) {
+if (c==NULL) return;
+explore_cached_sequences(c->left,path,f,private_ptr);
+if (c->token==-1) {
+    f(path->tab,path->nbelems,c->matches,private_ptr);
+} else {
+    vector_int_add(path,c->token);
+    explore_cached_sequences(c->middle,path,f,private_ptr);
+    (path->nbelems)--;
+}
+explore_cached_sequences(c->right,path,f,private_ptr);
+}
+
+
+/**
+ * Calls 'f' for each token sequence stored in the given cache set.
+ */
+static void explore_cache_set(LocateCacheSet set,t_cached_sequence_func f,void* private_ptr) {
+vector_int* path=new_vector_int(16);
+for (int i=0;i<set->n_tokens;i++) {
+    if (set->caches[i]==NULL) continue;
+    path->nbelems=0;
+    vector_int_add(path,i);
+    explore_cached_sequences(set->caches[i],path,f,private_ptr);
+}
+free_vector_int(path);
+}
+
+
+/**
+ * Returns 1 if the exact given token sequence is cached in the given set;
+ * 0 otherwise.
+ */
+static int is_sequence_cached(const int* tokens,int n,LocateCacheSet set) {
+LocateCache c=set->caches[tokens[0]];
+for (int i=1;i<=n;i++) {
+    int token=(i==n) ? -1 : tokens[i];
+    while (c!=NULL && c->token!=token) {
+        c=(token<c->token) ? c->left : c->right;
+    }
+    if (c==NULL) return 0;
+    if (i!=n) c=c->middle;
+}
+return 1;
+}
+
+
+/**
+ * Adds a copy of the given matches to the cache set 'private_ptr', unless
+ * the sequence is already cached there. We must not add matches to an
+ * existing sequence, since its match list is already complete, and since
+ * match positions depend on where the sequence was found, so that
+ * duplicates would not be detected.
+ */
+static void copy_cached_sequence(const int* tokens,int n,struct match_list* matches,void* private_ptr) {
+LocateCacheSet dest=(LocateCacheSet)private_ptr;
+if (is_sequence_cached(tokens,n,dest)) return;
+for (;matches!=NULL;matches=matches->next) {
+    struct match_list* m=new_match(matches->m.start_pos_in_token,matches->m.end_pos_in_token,
+            matches->m.start_pos_in_char,matches->m.end_pos_in_char,
+            matches->m.start_pos_in_letter,matches->m.end_pos_in_letter,
+            matches->output,matches->weight,NULL,dest->prv_alloc);
+    cache_match(m,tokens,0,n-1,dest);
+}
+evict_caches_if_needed(dest);
+}
+
+
+/**
+ * Adds to 'dest' a copy of all the token sequences cached in 'src' that are
+ * not already in 'dest'. Both sets must be related to the same text tokens.
+ */
+void merge_LocateCacheSet(LocateCacheSet dest,LocateCacheSet src) {
+explore_cache_set(src,copy_cached_sequence,dest);
+}
+
+
+/**
+ * Updates the given FNV-1a hash value with the given data. The initial
+ * value to use is 0.
+ */
+uint64_t hash_match_cache_key(uint64_t h,const void* data,size_t size) {
+if (h==0) h=14695981039346656037ULL;
+const unsigned char* c=(const unsigned char*)data;
+for (size_t i=0;i<size;i++) {
+    h^=c[i];
+    h*=1099511628211ULL;
+}
+return h;
+}
+
+
+static void write_int(int n,U_FILE* f) {
+fwrite(&n,sizeof(int),1,f);
+}
+
+
+struct save_cache_info {
+    U_FILE* f;
+    const struct string_hash* tokens;
+    int n_sequences;
+};
+
+
+/**
+ * Saves a token sequence and its matches. Match positions are saved relative
+ * to the start of the match, since they will be adjusted anyway when read
+ * from the cache.
+ */
+static void save_cached_sequence(const int* tokens,int n,struct match_list* matches,void* private_ptr) {
+struct save_cache_info* info=(struct save_cache_info*)private_ptr;
+U_FILE* f=info->f;
+write_int(n,f);
+for (int i=0;i<n;i++) {
+    const unichar* token=info->tokens->value[tokens[i]];
+    int length=u_strlen(token);
+    write_int(length,f);
+    fwrite(token,sizeof(unichar),length,f);
+}
+int n_matches=0;
+for (struct match_list* m=matches;m!=NULL;m=m->next) n_matches++;
+write_int(n_matches,f);
+for (struct match_list* m=matches;m!=NULL;m=m->next) {
+    write_int(0,f);
+    write_int(m->m.end_pos_in_token-m->m.start_pos_in_token,f);
+    write_int(m->m.start_pos_in_char,f);
+    write_int(m->m.end_pos_in_char,f);
+    write_int(m->m.start_pos_in_letter,f);
+    write_int(m->m.end_pos_in_letter,f);
+    write_int(m->weight,f);
+    if (m->output==NULL) {
+        write_int(-1,f);
+    } else {
+        int length=u_strlen(m->output);
+        write_int(length,f);
+        fwrite(m->output,sizeof(unichar),length,f);
+    }
+}
+(info->n_sequences)++;
+}
+
+
+/**
+ * Saves all the sequences of the given cache set into the given file.
+ * Returns 1 on success, 0 otherwise.
+ */
+int save_LocateCacheSet(const char* name,LocateCacheSet set,uint64_t key,const struct string_hash* tokens) {
+U_FILE* f=u_fopen(BINARY,name,U_WRITE);
+if (f==NULL) {
+    error("Cannot write cache file %s\n",name);
+    return 0;
+}
+fwrite(LOCATE_CACHE_FILE_MAGIC,1,strlen(LOCATE_CACHE_FILE_MAGIC),f);
+fwrite(&key,sizeof(uint64_t),1,f);
+struct save_cache_info info;
+info.f=f;
+info.tokens=tokens;
+info.n_sequences=0;
+explore_cache_set(set,save_cached_sequence,&info);
+u_fclose(f);
+return 1;
+}
+
+
+/**
+ * Reads an int at the given position of a cache file, checking that it
+ * does not go beyond the end of the file. The file being mapped, we don't
+ * make any assumption about the alignment.
+ */
+static int read_int(const unsigned char* data,size_t size,size_t* pos,int* n) {
+if ((*pos)+sizeof(int)>size) return 0;
+memcpy(n,data+(*pos),sizeof(int));
+(*pos)+=sizeof(int);
+return 1;
+}
+
+
+/* Growing buffer used to read the strings of a cache file */
+struct read_buffer {
+    unichar* str;
+    int size;
+};
+
+
+/**
+ * Reads a string of 'length' unichars. Returns NULL on error.
+ */
+static unichar* read_string(const unsigned char* data,size_t size,size_t* pos,int length,struct read_buffer* buffer) {
+if (length<0 || (*pos)+length*sizeof(unichar)>size) return NULL;
+if (buffer->size<length+1) {
+    buffer->str=(unichar*)realloc(buffer->str,(length+1)*sizeof(unichar));
+    if (buffer->str==NULL) {
+        fatal_alloc_error("read_string");
+    }
+    buffer->size=length+1;
+}
+memcpy(buffer->str,data+(*pos),length*sizeof(unichar));
+buffer->str[length]='\0';
+(*pos)+=length*sizeof(unichar);
+return buffer->str;
+}
+
+
+/**
+ * Loads the token sequences stored in the given cache file, if it exists and
+ * if it was produced with the same key. Sequences that contain tokens that
+ * are not in the text are ignored. Returns the number of loaded sequences, or
+ * -1 if the file could not be used.
+ */
+int load_LocateCacheSet(const char* name,LocateCacheSet set,uint64_t key,struct string_hash* tokens) {
+if (!fexists(name)) {
+    return -1;
+}
+ABSTRACTMAPFILE* amf=af_open_mapfile(name,MAPFILE_OPTION_READ,0);
+if (amf==NULL) {
+    return -1;
+}
+size_t size=af_get_mapfile_size(amf);
+size_t header_size=strlen(LOCATE_CACHE_FILE_MAGIC)+sizeof(uint64_t);
+if (size<header_size) {
+    af_close_mapfile(amf);
+    return -1;
+}
+const unsigned char* data=(const unsigned char*)af_get_mapfile_pointer(amf);
+uint64_t file_key;
+memcpy(&file_key,data+strlen(LOCATE_CACHE_FILE_MAGIC),sizeof(uint64_t));
+if (memcmp(data,LOCATE_CACHE_FILE_MAGIC,strlen(LOCATE_CACHE_FILE_MAGIC)) || file_key!=key) {
+    af_release_mapfile_pointer(amf,data);
+    af_close_mapfile(amf);
+    return -1;
+}
+struct read_buffer buffer;
+buffer.str=NULL;
+buffer.size=0;
+vector_int* sequence=new_vector_int(16);
+size_t pos=header_size;
+int n_loaded=0;
+int ok=1;
+while (ok && pos<size) {
+    int n=0,length=0;
+    ok=read_int(data,size,&pos,&n) && n>0;
+    sequence->nbelems=0;
+    int known_tokens=1;
+    for (int i=0;ok && i<n;i++) {
+        unichar* token=NULL;
+        ok=read_int(data,size,&pos,&length) && (token=read_string(data,size,&pos,length,&buffer))!=NULL;
+        if (ok) {
+            int t=get_value_index(token,tokens,DONT_INSERT);
+            if (t==-1) known_tokens=0;
+            vector_int_add(sequence,t);
+        }
+    }
+    int n_matches=0;
+    struct match_list* matches=NULL;
+    ok=ok && read_int(data,size,&pos,&n_matches);
+    for (int i=0;ok && i<n_matches;i++) {
+        int v[7];
+        for (int j=0;ok && j<7;j++) {
+            ok=read_int(data,size,&pos,&(v[j]));
+        }
+        unichar* output=NULL;
+        ok=ok && read_int(data,size,&pos,&length);
+        if (ok && length!=-1) {
+            ok=(output=read_string(data,size,&pos,length,&buffer))!=NULL;
+        }
+        if (ok && known_tokens) {
+            matches=new_match(v[0],v[1],v[2],v[3],v[4],v[5],output,v[6],matches,set->prv_alloc);
+        }
+    }
+    if (!ok) {
+        /* A sequence must be cached with all its matches or not at all */
+        free_match_list(matches,set->prv_alloc);
+        break;
+    }
+    if (known_tokens) {
+        /* Matches were read in reverse order */
+        struct match_list* reversed=NULL;
+        while (matches!=NULL) {
+            struct match_list* next=matches->next;
+            matches->next=reversed;
+            reversed=matches;
+            matches=next;
+        }
+        while (reversed!=NULL) {
+            struct match_list* next=reversed->next;
+            reversed->next=NULL;
+            cache_match(reversed,sequence->tab,0,n-1,set);
+            reversed=next;
+        }
+        n_loaded++;
+        evict_caches_if_needed(set);
+    }
+}
+if (!ok) {
+    error("Cache file %s is corrupted, it was only partially loaded\n",name);
+}
+free(buffer.str);
+free_vector_int(sequence);
+af_release_mapfile_pointer(amf,data);
+af_close_mapfile(amf);
+return n_loaded;
 }
 
 } // namespace unitex
@@ -24,6 +24,7 @@
 
 #include "LocateMatches.h"
 #include "Vector.h"
+#include "String_hash.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -34,8 +35,17 @@ namespace unitex {
 /**
  * This library provides a cache for storing match lists associated to token
  * sequences, using a ternary search tree.
+ *
+ * A cache can also be saved to a file and loaded by a later Locate run. As
+ * token numbers depend on the text, the file stores token sequences as
+ * strings. It starts with a key computed from the grammar and the Locate
+ * options, so that a cache file is ignored if it was not produced with the
+ * same grammar and options.
  */
 
+/* Magic string at the beginning of a cache file */
+#define LOCATE_CACHE_FILE_MAGIC "ULOCACH1"
+
 
 typedef struct locate_cache {
     struct locate_cache* left;
@@ -46,10 +56,47 @@ typedef struct locate_cache {
 }* LocateCache;
 
 
+/**
+ * This structure gathers the caches of all the tokens. The cache of a token
+ * contains the matches of all the token sequences that start with it.
+ *
+ * If 'max_size' is not 0, the memory used by the cached sequences and matches
+ * is limited to 'max_size' bytes. When this budget is exceeded, whole token
+ * caches are evicted, chosen with the CLOCK algorithm: each token cache has a
+ * reference bit that is set when the cache is used, and that gives it a second
+ * chance when the clock hand reaches it. Evicting a token cache is always safe,
+ * since the matches will just be computed again the next time.
+ */
+typedef struct locate_cache_set {
+    LocateCache* caches;
+    /* Number of bytes used by the cache of each token */
+    size_t* sizes;
+    unsigned char* referenced;
+    int n_tokens;
+    size_t size;
+    size_t max_size;
+    int clock_hand;
+
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+
+    Abstract_allocator prv_alloc;
+}* LocateCacheSet;
+
+
 LocateCache new_LocateCache(int token,struct match_list* matches,Abstract_allocator);
 void free_LocateCache(LocateCache c,Abstract_allocator);
-void cache_match(struct match_list* matches,const int* tab,int start,int end,LocateCache* c,Abstract_allocator);
-int consult_cache(const int* tab,int start,int tab_size,LocateCache* c,vector_ptr* res);
+LocateCacheSet new_LocateCacheSet(int n_tokens,size_t max_size,Abstract_allocator);
+void free_LocateCacheSet(LocateCacheSet);
+void cache_match(struct match_list* matches,const int* tab,int start,int end,LocateCacheSet);
+void evict_caches_if_needed(LocateCacheSet);
+void merge_LocateCacheSet(LocateCacheSet dest,LocateCacheSet src);
+
+uint64_t hash_match_cache_key(uint64_t h,const void* data,size_t size);
+int load_LocateCacheSet(const char* name,LocateCacheSet,uint64_t key,struct string_hash* tokens);
+int save_LocateCacheSet(const char* name,LocateCacheSet,uint64_t key,const struct string_hash* tokens);
+int consult_cache(const int* tab,int start,int tab_size,LocateCacheSet,vector_ptr* res);
 
 } // namespace unitex
 
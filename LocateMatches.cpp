@@ -22,6 +22,7 @@
 #include "LocateMatches.h"
 #include "Error.h"
 #include "Ustring.h"
+#include "Af_stdio.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -98,9 +99,214 @@ while (l!=NULL) {
 
 
 
+/**
+ * Returns the output policy that corresponds to the given concord.ind header.
+ */
+static OutputPolicy get_binary_concord_policy(unichar header) {
+switch (header) {
+   case 'M': return MERGE_OUTPUTS;
+   case 'R': return REPLACE_OUTPUTS;
+   default: return IGNORE_OUTPUTS;
+}
+}
+
+
+/**
+ * Fills 'concord' with pointers to the arrays of the binary concord.ind
+ * content 'buffer'. Returns 0 if the buffer is not a valid binary
+ * concordance; 1 otherwise.
+ */
+int get_binary_concord(const void* buffer,size_t size,struct binary_concord* concord) {
+const unsigned char* buf=(const unsigned char*)buffer;
+if (size<(size_t)BINARY_CONCORD_HEADER_SIZE
+    || memcmp(buf,BINARY_CONCORD_MAGIC,BINARY_CONCORD_MAGIC_SIZE)) {
+   return 0;
+}
+const int32_t* values=(const int32_t*)(buf+BINARY_CONCORD_MAGIC_SIZE);
+int n=values[1];
+int pool_size=values[2];
+if (n<0 || pool_size<0
+    || size!=(size_t)BINARY_CONCORD_HEADER_SIZE+7*(size_t)n*sizeof(int32_t)+pool_size*sizeof(unichar)) {
+   return 0;
+}
+concord->header=(unichar)values[0];
+concord->n_matches=n;
+const int32_t* column=values+3;
+concord->start_pos_in_token=column;
+concord->start_pos_in_char=column+n;
+concord->start_pos_in_letter=column+2*n;
+concord->end_pos_in_token=column+3*n;
+concord->end_pos_in_char=column+4*n;
+concord->end_pos_in_letter=column+5*n;
+concord->output=column+6*n;
+concord->pool=(const unichar*)(column+7*n);
+return 1;
+}
+
+
+/**
+ * Returns the output of the match #n of the given binary concordance,
+ * or NULL if it has none.
+ */
+const unichar* get_binary_concord_output(const struct binary_concord* concord,int n) {
+if (concord->output[n]==-1) return NULL;
+return concord->pool+concord->output[n];
+}
+
+
+/**
+ * Loads a match list from a binary concord.ind file, whose header has
+ * already been read from 'f'. The rest of the file is read at once, since
+ * its arrays can be used as is.
+ */
+static struct match_list* load_binary_match_list(U_FILE* f,OutputPolicy *output_policy,unichar* header,
+                                                 Abstract_allocator prv_alloc) {
+fseek(f,0,SEEK_END);
+long size=ftell(f);
+fseek(f,0,SEEK_SET);
+void* buffer=malloc(size>0?size:1);
+if (buffer==NULL) {
+   fatal_alloc_error("load_binary_match_list");
+}
+struct binary_concord concord;
+if (size<=0 || (long)fread(buffer,1,size,f)!=size || !get_binary_concord(buffer,size,&concord)) {
+   error("Invalid binary concordance\n");
+   free(buffer);
+   return NULL;
+}
+*header=concord.header;
+OutputPolicy policy=get_binary_concord_policy(concord.header);
+if (output_policy!=NULL) {
+   (*output_policy)=policy;
+}
+struct match_list* l=NULL;
+/* We build the list from its end, so that we don't need to keep
+ * a pointer on the last cell */
+for (int i=concord.n_matches-1;i>=0;i--) {
+   const unichar* output=(policy!=IGNORE_OUTPUTS)?get_binary_concord_output(&concord,i):NULL;
+   l=new_match(concord.start_pos_in_token[i],concord.end_pos_in_token[i],
+               concord.start_pos_in_char[i],concord.end_pos_in_char[i],
+               concord.start_pos_in_letter[i],concord.end_pos_in_letter[i],
+               (unichar*)output,-1,l,prv_alloc);
+}
+free(buffer);
+return l;
+}
+
+
+/**
+ * Returns 1 if the given file is a binary concord.ind file; 0 otherwise.
+ */
+int is_binary_concord_file(const char* name) {
+U_FILE* f=u_fopen(BINARY,name,U_READ);
+if (f==NULL) return 0;
+char magic[BINARY_CONCORD_MAGIC_SIZE];
+int ret=(fread(magic,1,BINARY_CONCORD_MAGIC_SIZE,f)==BINARY_CONCORD_MAGIC_SIZE
+         && !memcmp(magic,BINARY_CONCORD_MAGIC,BINARY_CONCORD_MAGIC_SIZE));
+u_fclose(f);
+return ret;
+}
+
+
+/**
+ * Allocates, initializes and returns a new binary concordance writer.
+ */
+struct binary_concord_writer* new_binary_concord_writer(OutputPolicy policy) {
+struct binary_concord_writer* w=(struct binary_concord_writer*)malloc(sizeof(struct binary_concord_writer));
+if (w==NULL) {
+   fatal_alloc_error("new_binary_concord_writer");
+}
+switch (policy) {
+   case MERGE_OUTPUTS: w->header='M'; break;
+   case REPLACE_OUTPUTS: w->header='R'; break;
+   default: w->header='I'; break;
+}
+for (int i=0;i<7;i++) {
+   w->columns[i]=new_vector_int(1024);
+}
+w->pool_size=0;
+w->pool_capacity=1024;
+w->pool=(unichar*)malloc(w->pool_capacity*sizeof(unichar));
+if (w->pool==NULL) {
+   fatal_alloc_error("new_binary_concord_writer");
+}
+return w;
+}
+
+
+/**
+ * Adds the given match and its output, if any, to the binary concordance.
+ */
+void add_binary_concord_match(struct binary_concord_writer* w,const Match* m,const unichar* output) {
+vector_int_add(w->columns[0],m->start_pos_in_token);
+vector_int_add(w->columns[1],m->start_pos_in_char);
+vector_int_add(w->columns[2],m->start_pos_in_letter);
+vector_int_add(w->columns[3],m->end_pos_in_token);
+vector_int_add(w->columns[4],m->end_pos_in_char);
+vector_int_add(w->columns[5],m->end_pos_in_letter);
+if (output==NULL) {
+   vector_int_add(w->columns[6],-1);
+   return;
+}
+vector_int_add(w->columns[6],w->pool_size);
+int length=u_strlen(output)+1;
+if (w->pool_size+length>w->pool_capacity) {
+   while (w->pool_size+length>w->pool_capacity) {
+      w->pool_capacity*=2;
+   }
+   w->pool=(unichar*)realloc(w->pool,w->pool_capacity*sizeof(unichar));
+   if (w->pool==NULL) {
+      fatal_alloc_error("add_binary_concord_match");
+   }
+}
+memcpy(w->pool+w->pool_size,output,length*sizeof(unichar));
+w->pool_size+=length;
+}
+
+
+/**
+ * Saves the given binary concordance into the file 'name'. Returns 0 in
+ * case of error; 1 otherwise.
+ */
+int save_binary_concord(struct binary_concord_writer* w,const char* name) {
+U_FILE* f=u_fopen(BINARY,name,U_WRITE);
+if (f==NULL) {
+   error("Cannot write %s\n",name);
+   return 0;
+}
+int32_t values[3];
+values[0]=w->header;
+values[1]=w->columns[0]->nbelems;
+values[2]=w->pool_size;
+fwrite(BINARY_CONCORD_MAGIC,1,BINARY_CONCORD_MAGIC_SIZE,f);
+fwrite(values,sizeof(int32_t),3,f);
+for (int i=0;i<7;i++) {
+   /* int and int32_t are the same on all the supported platforms */
+   fwrite(w->columns[i]->tab,sizeof(int32_t),w->columns[i]->nbelems,f);
+}
+fwrite(w->pool,sizeof(unichar),w->pool_size,f);
+u_fclose(f);
+return 1;
+}
+
+
+/**
+ * Frees all the memory associated to the given binary concordance writer.
+ */
+void free_binary_concord_writer(struct binary_concord_writer* w) {
+if (w==NULL) return;
+for (int i=0;i<7;i++) {
+   free_vector_int(w->columns[i]);
+}
+free(w->pool);
+free(w);
+}
+
+
 /**
  * Loads a match list. Match lists are supposed to have been
- * generated by the Locate program.
+ * generated by the Locate program. Both the text and the binary
+ * concord.ind formats are supported.
  */
 struct match_list* load_match_list(U_FILE* f,OutputPolicy *output_policy,unichar *header,Abstract_allocator prv_alloc) {
 struct match_list* l=NULL;
@@ -114,6 +320,10 @@ if (header==NULL) {
   header=&foo;
 }
 u_fscanf(f,"#%C\n",header);
+if (*header=='B') {
+   free_Ustring(line);
+   return load_binary_match_list(f,output_policy,header,prv_alloc);
+}
 OutputPolicy policy;
 switch(*header) {
    case 'D': {
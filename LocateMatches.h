@@ -52,6 +52,65 @@ struct match_list* new_match(int,int,int,int,int,int,unichar*,int,struct match_l
 void free_match_list_element(struct match_list*,Abstract_allocator prv_alloc=NULL);
 void free_match_list(struct match_list*,Abstract_allocator prv_alloc=NULL);
 struct match_list* load_match_list(U_FILE*,OutputPolicy*,unichar*,Abstract_allocator prv_alloc=NULL);
+
+
+/**
+ * A concord.ind file can also be saved in a binary format, which starts
+ * with BINARY_CONCORD_MAGIC, i.e. a UTF16-LE byte order mark followed by
+ * the line "#B", so that load_match_list can recognize it from the U_FILE
+ * opened by its callers. Then come, as native 32-bit integers:
+ *
+ *   - the output policy ('I', 'M' or 'R'), the number of matches N and the
+ *     number of unichars P of the output pool;
+ *   - 7 arrays of N integers: the start and end positions of the matches
+ *     in token, char and letter, in the same order as in the text format,
+ *     then the offset of the output of each match in the pool, or -1 if the
+ *     match has no output;
+ *   - the output pool, made of P unichars that contain the outputs
+ *     separated by '\0'.
+ *
+ * All the arrays are at fixed offsets, so that the file can be used
+ * directly from memory, once mapped.
+ */
+#define BINARY_CONCORD_MAGIC "\xFF\xFE#\0B\0\n\0"
+#define BINARY_CONCORD_MAGIC_SIZE 8
+#define BINARY_CONCORD_HEADER_SIZE (BINARY_CONCORD_MAGIC_SIZE+3*(int)sizeof(int32_t))
+
+/**
+ * A read-only view on the content of a binary concord.ind file.
+ */
+struct binary_concord {
+   unichar header;
+   int n_matches;
+   const int32_t* start_pos_in_token;
+   const int32_t* start_pos_in_char;
+   const int32_t* start_pos_in_letter;
+   const int32_t* end_pos_in_token;
+   const int32_t* end_pos_in_char;
+   const int32_t* end_pos_in_letter;
+   const int32_t* output;
+   const unichar* pool;
+};
+
+/**
+ * This structure is used to build a binary concord.ind file, since the
+ * arrays can only be written when all the matches are known.
+ */
+struct binary_concord_writer {
+   unichar header;
+   vector_int* columns[7];
+   unichar* pool;
+   int pool_size;
+   int pool_capacity;
+};
+
+int is_binary_concord_file(const char* name);
+int get_binary_concord(const void* buffer,size_t size,struct binary_concord* concord);
+const unichar* get_binary_concord_output(const struct binary_concord* concord,int n);
+struct binary_concord_writer* new_binary_concord_writer(OutputPolicy policy);
+void add_binary_concord_match(struct binary_concord_writer* writer,const Match* m,const unichar* output);
+int save_binary_concord(struct binary_concord_writer* writer,const char* name);
+void free_binary_concord_writer(struct binary_concord_writer* writer);
 void filter_unambiguous_outputs(struct match_list* *list,vector_int*);
 int are_ambiguous(struct match_list* a,struct match_list* b);
 
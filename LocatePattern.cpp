@@ -30,6 +30,7 @@
 #include "File.h"
 #include "UserCancelling.h"
 #include "LocateTrace.h"
+#include "DicVariables.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -75,6 +76,8 @@ p->current_origin=-1;
 p->max_count_call=0;
 p->max_count_call_warning=0;
 p->buffer=NULL;
+p->text_cod=NULL;
+p->window=NULL;
 p->tokenization_policy=WORD_BY_WORD_TOKENIZATION;
 p->space_policy=DONT_START_WITH_SPACE;
 p->matching_units=0;
@@ -86,6 +89,7 @@ p->variable_error_policy=IGNORE_VARIABLE_ERRORS;
 p->match_list=NULL;
 p->number_of_matches=0;
 p->number_of_outputs=0;
+p->exploration_steps=0;
 p->start_position_last_printed_match=-1;
 p->end_position_last_printed_match=-1;
 p->search_limit=0;
@@ -118,6 +122,7 @@ p->failfast=NULL;
 p->match_cache_first=NULL;
 p->match_cache_last=NULL;
 p->match_cache=NULL;
+p->match_cache_file=NULL;
 p->al.prv_alloc_generic=NULL;
 p->al.pa.prv_alloc_vector_int_inside_token=NULL;
 p->al.pa.prv_alloc_recycle=NULL;
@@ -141,6 +146,8 @@ p->counting_step_count_cancel_trying_real_in_debug_or_trace = 0;
 p->debug=0;
 p->weight=-1;
 p->graph_depth_backup_nested=0;
+p->chunk=NULL;
+p->binary_concord=NULL;
 
 p->stack_max=STACK_MAX;
 p->max_matches_at_token_pos=MAX_MATCHES_AT_TOKEN_POS;
@@ -163,10 +170,352 @@ if (p->recyclable_unichar_buffer!=NULL) {
     free(p->recyclable_unichar_buffer);
 }
 free_vector_ptr(p->cached_match_vector,NULL);
+free_locate_text_window(p->window);
+free_binary_concord_writer(p->binary_concord);
 free(p);
 }
 
 
+/**
+ * Opens the given text.cod file for a streaming Locate. Returns NULL if
+ * the file cannot be opened.
+ */
+struct locate_text_window* new_locate_text_window(const char* text_cod,int lookahead) {
+U_FILE* f=u_fopen(BINARY,text_cod,U_READ);
+if (f==NULL) {
+   return NULL;
+}
+struct locate_text_window* w=(struct locate_text_window*)malloc(sizeof(struct locate_text_window));
+if (w==NULL) {
+   fatal_alloc_error("new_locate_text_window");
+}
+w->f=f;
+w->lookahead=(lookahead>0) ? lookahead : 1;
+w->capacity=4*w->lookahead;
+if (w->capacity<LOCATE_TEXT_WINDOW_MIN_SIZE) {
+   w->capacity=LOCATE_TEXT_WINDOW_MIN_SIZE;
+}
+/* +1 because some functions look at the token just after the end of the window */
+w->tokens=(int*)malloc((w->capacity+1)*sizeof(int));
+if (w->tokens==NULL) {
+   fatal_alloc_error("new_locate_text_window");
+}
+w->start=0;
+w->size=0;
+w->eof=0;
+w->overflow=0;
+return w;
+}
+
+
+void free_locate_text_window(struct locate_text_window* w) {
+if (w==NULL) return;
+u_fclose(w->f);
+free(w->tokens);
+free(w);
+}
+
+
+/**
+ * Updates the window so that it starts at the absolute position 'keep_from'
+ * and goes at least 'lookahead' tokens after the current origin, unless the
+ * end of the text is reached. Then, the buffer of 'p' is updated.
+ */
+void fill_locate_text_window(struct locate_parameters* p,int keep_from) {
+struct locate_text_window* w=p->window;
+if (keep_from>w->start) {
+   /* We forget the tokens we don't need anymore */
+   int shift=keep_from-w->start;
+   if (shift>w->size) shift=w->size;
+   memmove(w->tokens,w->tokens+shift,(w->size-shift)*sizeof(int));
+   w->start+=shift;
+   w->size-=shift;
+}
+int needed_end=p->current_origin+w->lookahead;
+while (!w->eof && w->start+w->size<needed_end) {
+   if (w->size==w->capacity) {
+      w->capacity*=2;
+      w->tokens=(int*)realloc(w->tokens,(w->capacity+1)*sizeof(int));
+      if (w->tokens==NULL) {
+         fatal_alloc_error("fill_locate_text_window");
+      }
+   }
+   int n=(int)fread(w->tokens+w->size,sizeof(int),w->capacity-w->size,w->f);
+   if (n<w->capacity-w->size) {
+      w->eof=1;
+   }
+   w->size+=n;
+}
+w->tokens[w->size]=-1;
+w->overflow=0;
+/* We shift the pointer so that positions in the text can be used as usual */
+p->buffer=w->tokens-w->start;
+p->buffer_size=w->start+w->size;
+}
+
+
+/**
+ * Creates all the allocators used while exploring the text, except the
+ * generic one.
+ */
+void create_locate_work_allocators(struct locate_allocators* al,int nb_input_variable) {
+al->pa.prv_alloc_recycle=create_abstract_allocator("locate_pattern_recycle",
+                                 AllocatorFreeOnlyAtAllocatorDelete|AllocatorTipOftenRecycledObject,
+                                 get_prefered_allocator_item_size_for_nb_variable(nb_input_variable));
+
+al->pa.prv_alloc_vector_int_inside_token=create_abstract_allocator("locate_pattern_inside_token", AllocatorCreationFlagAutoFreePrefered);/*create_abstract_allocator("locate_pattern_recycle",
+                                 AllocatorFreeOnlyAtAllocatorDelete|AllocatorTipOftenRecycledObject,
+                                 get_prefered_allocator_item_size_for_nb_variable(nb_input_variable));*/
+
+al->prv_alloc_recycle_morphlogical_content_buffer=create_abstract_allocator("morphlogical_content_buffer_recycle",
+                                 AllocatorFreeOnlyAtAllocatorDelete|AllocatorTipGrowingOftenRecycledObject,
+                                 0);
+
+al->pa.prv_alloc_backup_growing_recycle=create_abstract_allocator("locate_pattern_growing_recycle",
+                                 AllocatorFreeOnlyAtAllocatorDelete|AllocatorTipGrowingOftenRecycledObject,
+                                 0);
+
+al->prv_alloc_context=create_abstract_allocator("locate_pattern_growing_recycle",
+                                 AllocatorFreeOnlyAtAllocatorDelete|AllocatorTipGrowingOftenRecycledObject,
+                                 0);
+
+al->prv_alloc_trace_info_allocator=create_abstract_allocator("locate_pattern_recycle_locate_trace_info",
+                                 AllocatorFreeOnlyAtAllocatorDelete|AllocatorTipOftenRecycledObject,
+                                 sizeof(locate_trace_info));
+}
+
+
+/**
+ * Closes the allocators created by create_locate_work_allocators.
+ */
+void close_locate_work_allocators(struct locate_allocators* al) {
+close_abstract_allocator(al->pa.prv_alloc_vector_int_inside_token);
+close_abstract_allocator(al->pa.prv_alloc_recycle);
+close_abstract_allocator(al->pa.prv_alloc_backup_growing_recycle);
+close_abstract_allocator(al->prv_alloc_trace_info_allocator);
+close_abstract_allocator(al->prv_alloc_context);
+close_abstract_allocator(al->prv_alloc_recycle_morphlogical_content_buffer);
+al->pa.prv_alloc_vector_int_inside_token=NULL;
+al->pa.prv_alloc_recycle=NULL;
+al->pa.prv_alloc_backup_growing_recycle=NULL;
+al->prv_alloc_trace_info_allocator=NULL;
+al->prv_alloc_context=NULL;
+al->prv_alloc_recycle_morphlogical_content_buffer=NULL;
+}
+
+
+/**
+ * Allocates and returns the parameters of a Locate worker thread. The
+ * worker shares with 'model' everything that is read-only during the
+ * exploration (grammar, tokens, token controls, dictionaries, ...) and
+ * gets its own stack, variables, allocators, cache and fail fast array.
+ */
+struct locate_parameters* new_locate_worker_parameters(const struct locate_parameters* model,vector_ptr* injected_vars) {
+struct locate_parameters* p=new_locate_parameters();
+/* Shared read-only data */
+p->token_control=model->token_control;
+p->matching_patterns=model->matching_patterns;
+p->pattern_tree_root=model->pattern_tree_root;
+p->current_compound_pattern=model->current_compound_pattern;
+p->SPACE=model->SPACE;
+p->SENTENCE=model->SENTENCE;
+p->STOP=model->STOP;
+p->tag_token_list=model->tag_token_list;
+#ifdef REGEX_FACADE_ENGINE
+p->filters=model->filters;
+p->filter_match_index=model->filter_match_index;
+#endif
+p->DLC_tree=model->DLC_tree;
+p->optimized_states=model->optimized_states;
+p->fst2=model->fst2;
+p->tags=model->tags;
+p->tokens=model->tokens;
+p->max_count_call=model->max_count_call;
+p->max_count_call_warning=model->max_count_call_warning;
+p->buffer_size=model->buffer_size;
+p->buffer=model->buffer;
+p->text_cod=model->text_cod;
+p->tokenization_policy=model->tokenization_policy;
+p->space_policy=model->space_policy;
+p->match_policy=model->match_policy;
+p->real_output_policy=model->real_output_policy;
+p->output_policy=model->output_policy;
+p->ambiguous_output_policy=model->ambiguous_output_policy;
+p->variable_error_policy=model->variable_error_policy;
+p->search_limit=model->search_limit;
+p->alphabet=model->alphabet;
+p->morpho_dic=model->morpho_dic;
+p->n_morpho_dics=model->n_morpho_dics;
+p->protect_dic_chars=model->protect_dic_chars;
+p->useLocateCache=model->useLocateCache;
+p->tilde_negation_operator=model->tilde_negation_operator;
+p->arabic=model->arabic;
+p->token_filename=model->token_filename;
+p->debug=model->debug;
+p->stack_max=model->stack_max;
+p->max_matches_at_token_pos=model->max_matches_at_token_pos;
+p->max_matches_per_subgraph=model->max_matches_per_subgraph;
+p->max_errors=model->max_errors;
+p->graph_filename=model->graph_filename;
+/* Private data */
+int nb_input_variable=0;
+p->input_variables=new_Variables(p->fst2->input_variables,&nb_input_variable);
+p->output_variables=new_OutputVariables(p->fst2->output_variables,&p->nb_output_variables,injected_vars);
+p->al.prv_alloc_generic=create_abstract_allocator("locate_pattern_worker",AllocatorCreationFlagAutoFreePrefered);
+create_locate_work_allocators(&(p->al),nb_input_variable);
+p->failfast=new_bit_array(p->tokens->size,ONE_BIT);
+p->match_cache=new_LocateCacheSet(p->tokens->size,model->match_cache->max_size,p->al.prv_alloc_generic);
+return p;
+}
+
+
+/**
+ * Frees the parameters of a Locate worker thread, without touching to the
+ * data shared with the main parameters.
+ */
+void free_locate_worker_parameters(struct locate_parameters* p) {
+if (p==NULL) return;
+free_LocateCacheSet(p->match_cache);
+free_bit_array(p->failfast);
+free_Variables(p->input_variables);
+free_OutputVariables(p->output_variables);
+if (p->dic_variables!=NULL) {
+    clear_dic_variable_list(&(p->dic_variables));
+}
+free_stack_unichar(p->stack);
+close_locate_work_allocators(&(p->al));
+close_abstract_allocator(p->al.prv_alloc_generic);
+free_locate_parameters(p);
+}
+
+
+/**
+ * Loads the text independent part of a Locate grammar. Returns NULL on error.
+ */
+struct locate_grammar* new_locate_grammar(const VersatileEncodingConfig* vec,const char* fst2_name,
+                                          const char* alphabet,int is_korean) {
+struct locate_grammar* g=(struct locate_grammar*)malloc(sizeof(struct locate_grammar));
+if (g==NULL) {
+   fatal_alloc_error("new_locate_grammar");
+}
+memset(g,0,sizeof(struct locate_grammar));
+g->fst2_name=strdup(fst2_name);
+g->alphabet_name=strdup((alphabet!=NULL) ? alphabet : "");
+if (g->fst2_name==NULL || g->alphabet_name==NULL) {
+   fatal_alloc_error("new_locate_grammar");
+}
+g->is_korean=is_korean;
+if (alphabet!=NULL && alphabet[0]!='\0') {
+   g->alphabet=load_alphabet(vec,alphabet,is_korean);
+   if (g->alphabet==NULL) {
+      error("Cannot load alphabet file %s\n",alphabet);
+      free_locate_grammar(g);
+      return NULL;
+   }
+}
+struct FST2_free_info fst2load_free;
+Fst2* fst2load=load_abstract_fst2(vec,fst2_name,1,&fst2load_free);
+if (fst2load==NULL) {
+   error("Cannot load grammar %s\n",fst2_name);
+   free_locate_grammar(g);
+   return NULL;
+}
+/* We work on a private copy, because the filter numbers are stored in the tags */
+g->fst2=new_Fst2_clone(fst2load);
+free_abstract_Fst2(fst2load,&fst2load_free);
+#ifdef REGEX_FACADE_ENGINE
+g->filters=new_FilterSet(g->fst2,g->alphabet);
+if (g->filters==NULL) {
+   error("Cannot compile filter(s)\n");
+   free_locate_grammar(g);
+   return NULL;
+}
+#endif
+return g;
+}
+
+
+/**
+ * Frees a grammar loaded with new_locate_grammar. It must have been
+ * unregistered before.
+ */
+void free_locate_grammar(struct locate_grammar* g) {
+if (g==NULL) return;
+free(g->fst2_name);
+free(g->alphabet_name);
+free_Fst2(g->fst2);
+free_alphabet(g->alphabet);
+#ifdef REGEX_FACADE_ENGINE
+free_FilterSet(g->filters);
+#endif
+free(g);
+}
+
+
+struct list_locate_grammar {
+   struct locate_grammar* grammar;
+   struct list_locate_grammar* next;
+};
+
+/* Like persistent resources, registered grammars are expected to be
+ * registered and unregistered while no Locate operation is running */
+static struct list_locate_grammar* registered_locate_grammars=NULL;
+
+
+/**
+ * Makes the given grammar available to all the next Locate operations that
+ * use the same fst2 and alphabet file names. Returns 1 on success, 0 if a
+ * grammar is already registered for these names.
+ */
+int register_locate_grammar(struct locate_grammar* g) {
+if (g==NULL || get_registered_locate_grammar(g->fst2_name,g->alphabet_name,g->is_korean)!=NULL) {
+   return 0;
+}
+struct list_locate_grammar* l=(struct list_locate_grammar*)malloc(sizeof(struct list_locate_grammar));
+if (l==NULL) {
+   fatal_alloc_error("register_locate_grammar");
+}
+l->grammar=g;
+l->next=registered_locate_grammars;
+registered_locate_grammars=l;
+return 1;
+}
+
+
+/**
+ * Removes the given grammar from the registered ones. It does not free it.
+ * Returns 1 on success, 0 if the grammar was not registered.
+ */
+int unregister_locate_grammar(struct locate_grammar* g) {
+struct list_locate_grammar** l=&registered_locate_grammars;
+while (*l!=NULL) {
+   if ((*l)->grammar==g) {
+      struct list_locate_grammar* tmp=*l;
+      *l=tmp->next;
+      free(tmp);
+      return 1;
+   }
+   l=&((*l)->next);
+}
+return 0;
+}
+
+
+/**
+ * Returns the grammar registered for the given fst2 and alphabet, or NULL.
+ */
+const struct locate_grammar* get_registered_locate_grammar(const char* fst2_name,const char* alphabet,int is_korean) {
+if (alphabet==NULL) alphabet="";
+for (struct list_locate_grammar* l=registered_locate_grammars;l!=NULL;l=l->next) {
+   if (l->grammar->is_korean==is_korean && !strcmp(l->grammar->fst2_name,fst2_name)
+       && !strcmp(l->grammar->alphabet_name,alphabet)) {
+      return l->grammar;
+   }
+}
+return NULL;
+}
+
+
 /**
  * Returns an array containing the jamo versions of all the given tokens.
  */
@@ -191,6 +540,202 @@ return res;
 
 
 
+/**
+ * Frees the fst2 used by locate_pattern, that is a shallow clone if the
+ * grammar was registered.
+ */
+static void free_locate_fst2(Fst2* fst2,const struct locate_grammar* grammar,Abstract_allocator prv_alloc) {
+if (grammar!=NULL) {
+   free_Fst2_shallow_clone(fst2,prv_alloc);
+} else {
+   free_Fst2(fst2,prv_alloc);
+}
+}
+
+
+/**
+ * Updates the given hash value with the content of the given file. If the
+ * file cannot be read, only its absence is taken into account.
+ */
+static uint64_t hash_file(uint64_t h,const char* name) {
+ABSTRACTMAPFILE* amf=(name==NULL) ? NULL : af_open_mapfile(name,MAPFILE_OPTION_READ,0);
+if (amf==NULL) {
+   return hash_match_cache_key(h,"",1);
+}
+size_t size=af_get_mapfile_size(amf);
+const void* data=af_get_mapfile_pointer(amf);
+h=hash_match_cache_key(h,&size,sizeof(size_t));
+if (data!=NULL) {
+   h=hash_match_cache_key(h,data,size);
+   af_release_mapfile_pointer(amf,data);
+}
+af_close_mapfile(amf);
+return h;
+}
+
+
+/**
+ * Updates the given hash value with the content of the .bin and .inf files
+ * of the given list of morphological dictionaries, separated with semi-colons.
+ */
+static uint64_t hash_morpho_dic_list(uint64_t h,const char* morpho_dic_list) {
+if (morpho_dic_list==NULL) {
+   return hash_match_cache_key(h,"",1);
+}
+char bin[FILENAME_MAX];
+char inf[FILENAME_MAX];
+while (*morpho_dic_list!='\0') {
+   int pos=0;
+   while (*morpho_dic_list!='\0' && *morpho_dic_list!=';') {
+      if (pos<FILENAME_MAX-1) {
+         bin[pos++]=*morpho_dic_list;
+      }
+      morpho_dic_list++;
+   }
+   bin[pos]='\0';
+   if (*morpho_dic_list==';') {
+      morpho_dic_list++;
+   }
+   remove_extension(bin,inf);
+   strcat(inf,".inf");
+   h=hash_file(hash_file(h,bin),inf);
+}
+return hash_match_cache_key(h,"",1);
+}
+
+
+/**
+ * Updates the given hash value with the given unicode string, if not NULL.
+ */
+static uint64_t hash_ustring(uint64_t h,const unichar* s) {
+if (s==NULL) return hash_match_cache_key(h,"",1);
+return hash_match_cache_key(h,s,(u_strlen(s)+1)*sizeof(unichar));
+}
+
+
+/**
+ * Adds to *total the number of bytes held by the given allocator, if it
+ * is able to tell it. Returns 1 in this case, 0 otherwise.
+ */
+static int add_allocated_bytes(Abstract_allocator a,size_t* total) {
+size_t n=0;
+if (a==NULL || !get_allocator_statistic_info(a,STATISTIC_NB_TOTAL_BYTE_ALLOCATED,&n)) {
+   return 0;
+}
+(*total)+=n;
+return 1;
+}
+
+
+/**
+ * Saves the statistics of a Locate operation into the given file, as
+ * "name=value" lines, so that they can be read by other programs like
+ * Cassys. The memory held by the allocators is only written if at least
+ * one of them can report it. Since pool allocators never give memory back
+ * before they are closed, this is their peak usage.
+ */
+static void save_locate_profile(const char* name,const VersatileEncodingConfig* vec,
+                                const struct locate_parameters* p,long text_size,
+                                Abstract_allocator locate_abstract_allocator) {
+U_FILE* f=u_fopen(vec,name,U_WRITE);
+if (f==NULL) {
+   error("Cannot write %s\n",name);
+   return;
+}
+u_fprintf(f,"text_tokens=%ld\n",text_size);
+u_fprintf(f,"matches=%d\n",p->number_of_matches);
+u_fprintf(f,"outputs=%d\n",p->number_of_outputs);
+u_fprintf(f,"recognized_units=%d\n",p->matching_units);
+u_fprintf(f,"exploration_steps=%lu\n",p->exploration_steps);
+if (p->match_cache!=NULL) {
+   u_fprintf(f,"cache_hits=%lu\n",p->match_cache->hits);
+   u_fprintf(f,"cache_misses=%lu\n",p->match_cache->misses);
+   u_fprintf(f,"cache_evictions=%lu\n",p->match_cache->evictions);
+}
+size_t allocated=0;
+int known=add_allocated_bytes(locate_abstract_allocator,&allocated);
+known|=add_allocated_bytes(p->al.pa.prv_alloc_recycle,&allocated);
+known|=add_allocated_bytes(p->al.pa.prv_alloc_vector_int_inside_token,&allocated);
+known|=add_allocated_bytes(p->al.pa.prv_alloc_backup_growing_recycle,&allocated);
+known|=add_allocated_bytes(p->al.prv_alloc_recycle_morphlogical_content_buffer,&allocated);
+known|=add_allocated_bytes(p->al.prv_alloc_context,&allocated);
+known|=add_allocated_bytes(p->al.prv_alloc_trace_info_allocator,&allocated);
+if (known) {
+   u_fprintf(f,"allocator_bytes=%lu\n",(unsigned long)allocated);
+}
+u_fclose(f);
+}
+
+
+/**
+ * Computes the key of the persistent match cache, from everything that
+ * may change the matches of a token sequence: the grammar, as it was
+ * loaded, the Locate options and the content of the alphabet, of the
+ * morphological dictionaries (including the local one) and of the arabic
+ * rules. The grammar must not have been modified by process_tags yet.
+ * The dlf and dlc of the text are not part of the key: the cache file is
+ * not used with grammars that look at them (see locate_pattern).
+ */
+static uint64_t compute_match_cache_key(const Fst2* fst2,const struct locate_parameters* p,
+                                        const char* alphabet,const char* morpho_dic_list,
+                                        const char* local_morpho_dic,
+                                        const char* arabic_rules,int is_korean,vector_ptr* injected_vars) {
+uint64_t h=0;
+h=hash_match_cache_key(h,&(fst2->number_of_graphs),sizeof(int));
+h=hash_match_cache_key(h,fst2->initial_states+1,fst2->number_of_graphs*sizeof(int));
+for (int i=0;i<fst2->number_of_states;i++) {
+    h=hash_match_cache_key(h,&(fst2->states[i]->control),sizeof(unsigned char));
+    for (Transition* t=fst2->states[i]->transitions;t!=NULL;t=t->next) {
+        h=hash_match_cache_key(h,&(t->tag_number),sizeof(int));
+        h=hash_match_cache_key(h,&(t->state_number),sizeof(int));
+    }
+    /* End of transition list mark */
+    h=hash_match_cache_key(h,"",1);
+}
+for (int i=0;i<fst2->number_of_tags;i++) {
+    Fst2Tag tag=fst2->tags[i];
+    h=hash_match_cache_key(h,&(tag->control),sizeof(unsigned char));
+    h=hash_ustring(h,tag->input);
+    h=hash_ustring(h,tag->output);
+    h=hash_ustring(h,tag->morphological_filter);
+}
+int options[]={p->match_policy,p->real_output_policy,p->output_policy,p->tokenization_policy,
+               p->space_policy,p->ambiguous_output_policy,p->variable_error_policy,
+               p->protect_dic_chars,p->tilde_negation_operator,p->max_count_call,
+               p->stack_max,p->max_matches_at_token_pos,p->max_matches_per_subgraph,is_korean};
+h=hash_match_cache_key(h,options,sizeof(options));
+h=hash_file(h,alphabet);
+h=hash_morpho_dic_list(h,morpho_dic_list);
+h=hash_morpho_dic_list(h,fexists(local_morpho_dic) ? local_morpho_dic : NULL);
+h=hash_file(h,arabic_rules);
+for (int i=0;i<injected_vars->nbelems;i++) {
+    h=hash_ustring(h,(const unichar*)(injected_vars->tab[i]));
+}
+return h;
+}
+
+
+/**
+ * Returns 1 if some tag of the grammar, as processed by process_tags, looks
+ * at the text dictionaries: lexical masks like <be>, <V> or <be.V> and the
+ * <DIC>, <!DIC>, <CDIC> and <SDIC> metas; 0 otherwise.
+ */
+static int uses_text_dictionaries(const Fst2* fst2) {
+for (int i=0;i<fst2->number_of_tags;i++) {
+    Fst2Tag tag=fst2->tags[i];
+    if (tag->type==META_TAG) {
+       if (tag->meta==META_DIC || tag->meta==META_CDIC || tag->meta==META_SDIC) {
+          return 1;
+       }
+    } else if ((tag->type==PATTERN_TAG || tag->type==PATTERN_NUMBER_TAG)
+               && tag->pattern!=NULL && tag->pattern->type!=TOKEN_PATTERN) {
+       return 1;
+    }
+}
+return 0;
+}
+
+
 int locate_pattern(const char* text_cod,const char* tokens,const char* fst2_name,const char* dlf,const char* dlc,const char* err,
                    const char* alphabet,MatchPolicy match_policy,OutputPolicy output_policy,
                    const VersatileEncodingConfig* vec,
@@ -201,11 +746,15 @@ int locate_pattern(const char* text_cod,const char* tokens,const char* fst2_name
                    int is_korean,int max_count_call,int max_count_call_warning,
                    int stack_max, int max_matches_at_token_pos,int max_matches_per_subgraph,int max_errors,
                    char* arabic_rules,int tilde_negation_operator,int useLocateCache,int allow_trace,char* const trace_params[],
-                   vector_ptr* injected_vars) {
+                   vector_ptr* injected_vars,int n_threads,size_t cache_size,
+                   const char* match_cache_file,int stream,const char* profile_file,
+                   int binary_concord) {
 
 U_FILE* out;
 U_FILE* info;
 struct locate_parameters* p=new_locate_parameters();
+/* If the grammar was registered, we don't have to load it */
+const struct locate_grammar* grammar=get_registered_locate_grammar(fst2_name,alphabet,is_korean);
 
 if (stack_max>0) {
     p->stack_max = stack_max;
@@ -230,10 +779,29 @@ if (buffer_filename == NULL)
     fatal_alloc_error("locate_pattern");
 }
 
-p->text_cod=af_open_mapfile(text_cod,MAPFILE_OPTION_READ,0);
-p->buffer=(int*)af_get_mapfile_pointer(p->text_cod);
-long text_size=(long)af_get_mapfile_size(p->text_cod)/sizeof(int);
-p->buffer_size=(int)text_size;
+long text_size;
+/* In Korean mode, tokens are read beyond the current position without
+ * checking the buffer end, so we don't use the streaming mode */
+if (stream && !is_korean) {
+   /* The lookahead starts with the maximal number of tokens that can be
+    * matched in one match, and it will be extended if needed */
+   p->window=new_locate_text_window(text_cod,p->stack_max+1);
+   if (p->window==NULL) {
+      error("Cannot open %s\n",text_cod);
+      free_stack_unichar(p->stack);
+      free_locate_parameters(p);
+      free(buffer_filename);
+      return 0;
+   }
+   text_size=get_file_size(text_cod)/sizeof(int);
+   p->current_origin=0;
+   fill_locate_text_window(p,0);
+} else {
+   p->text_cod=af_open_mapfile(text_cod,MAPFILE_OPTION_READ,0);
+   p->buffer=(int*)af_get_mapfile_pointer(p->text_cod);
+   text_size=(long)af_get_mapfile_size(p->text_cod)/sizeof(int);
+   p->buffer_size=(int)text_size;
+}
 p->tilde_negation_operator=tilde_negation_operator;
 p->useLocateCache=useLocateCache;
 if (max_count_call == -1) {
@@ -284,7 +852,9 @@ info=u_fopen(vec,concord_info,U_WRITE);
 if (info==NULL) {
    error("Cannot write %s\n",concord_info);
 }
-if (alphabet!=NULL && alphabet[0]!='\0') {
+if (grammar!=NULL) {
+   p->alphabet=grammar->alphabet;
+} else if (alphabet!=NULL && alphabet[0]!='\0') {
    u_printf("Loading alphabet...\n");
    p->alphabet=load_alphabet(vec,alphabet,is_korean);
    if (p->alphabet==NULL) {
@@ -305,7 +875,7 @@ extract_semantic_codes(vec,dlc,semantic_codes);
 
 if (is_cancelling_requested() != 0) {
        error("user cancel request.\n");
-       free_alphabet(p->alphabet);
+       if (grammar==NULL) free_alphabet(p->alphabet);
        free_string_hash(semantic_codes);
        af_release_mapfile_pointer(p->text_cod,p->buffer);
        af_close_mapfile(p->text_cod);
@@ -317,12 +887,19 @@ if (is_cancelling_requested() != 0) {
        return 0;
     }
 
-u_printf("Loading fst2...\n");
 struct FST2_free_info fst2load_free;
-Fst2* fst2load=load_abstract_fst2(vec,fst2_name,1,&fst2load_free);
-if (fst2load==NULL) {
+Fst2* fst2load=NULL;
+const Fst2* fst2_model;
+if (grammar!=NULL) {
+   fst2_model=grammar->fst2;
+} else {
+   u_printf("Loading fst2...\n");
+   fst2load=load_abstract_fst2(vec,fst2_name,1,&fst2load_free);
+   fst2_model=fst2load;
+}
+if (fst2_model==NULL) {
    error("Cannot load grammar %s\n",fst2_name);
-   free_alphabet(p->alphabet);
+   if (grammar==NULL) free_alphabet(p->alphabet);
    free_string_hash(semantic_codes);
    af_release_mapfile_pointer(p->text_cod,p->buffer);
    af_close_mapfile(p->text_cod);
@@ -333,7 +910,7 @@ if (fst2load==NULL) {
    free(buffer_filename);
    return 0;
 }
-if (fst2load->debug) {
+if (fst2_model->debug) {
     /* If Locate uses a debug fst2, we force the output mode to MERGE,
      * we allow ambiguous outputs and we write graph names into the
      * concordance file */
@@ -341,9 +918,16 @@ if (fst2load->debug) {
     p->ambiguous_output_policy=ALLOW_AMBIGUOUS_OUTPUTS;
     p->debug=1;
     u_fprintf(out,"#D\n");
-    u_fprintf(out,"%d\n",fst2load->number_of_graphs);
-    for (int i=0;i<fst2load->number_of_graphs;i++) {
-        u_fprintf(out,"%S\n",fst2load->graph_names[i+1]);
+    u_fprintf(out,"%d\n",fst2_model->number_of_graphs);
+    for (int i=0;i<fst2_model->number_of_graphs;i++) {
+        u_fprintf(out,"%S\n",fst2_model->graph_names[i+1]);
+    }
+}
+if (binary_concord) {
+    if (p->debug) {
+        u_printf("Debug mode: the binary concordance format cannot be used\n");
+    } else {
+        p->binary_concord=new_binary_concord_writer(p->real_output_policy);
     }
 }
 switch(p->real_output_policy) {
@@ -355,15 +939,26 @@ switch(p->real_output_policy) {
 
 Abstract_allocator locate_abstract_allocator=create_abstract_allocator("locate_pattern",AllocatorCreationFlagAutoFreePrefered);
 
+uint64_t match_cache_key=0;
+if (useLocateCache && match_cache_file!=NULL && match_cache_file[0]!='\0') {
+   p->match_cache_file=match_cache_file;
+   match_cache_key=compute_match_cache_key(fst2_model,p,alphabet,morpho_dic_list,morpho_bin,arabic_rules,is_korean,injected_vars);
+}
 
-p->fst2=new_Fst2_clone(fst2load,locate_abstract_allocator);
-free_abstract_Fst2(fst2load,&fst2load_free);
+
+if (grammar!=NULL) {
+   /* Tags are modified according to the text tokens, so we need our own copy */
+   p->fst2=new_Fst2_shallow_clone(grammar->fst2,locate_abstract_allocator);
+} else {
+   p->fst2=new_Fst2_clone(fst2load,locate_abstract_allocator);
+   free_abstract_Fst2(fst2load,&fst2load_free);
+}
 
 if (is_cancelling_requested() != 0) {
    error("User cancel request..\n");
-   free_alphabet(p->alphabet);
+   if (grammar==NULL) free_alphabet(p->alphabet);
    free_string_hash(semantic_codes);
-   free_Fst2(p->fst2,locate_abstract_allocator);
+   free_locate_fst2(p->fst2,grammar,locate_abstract_allocator);
    close_abstract_allocator(locate_abstract_allocator);
    af_release_mapfile_pointer(p->text_cod,p->buffer);
    af_close_mapfile(p->text_cod);
@@ -377,12 +972,12 @@ if (is_cancelling_requested() != 0) {
 
 p->tags=p->fst2->tags;
 #ifdef REGEX_FACADE_ENGINE
-p->filters=new_FilterSet(p->fst2,p->alphabet);
+p->filters=(grammar!=NULL) ? grammar->filters : new_FilterSet(p->fst2,p->alphabet);
 if (p->filters==NULL) {
    error("Cannot compile filter(s)\n");
-   free_alphabet(p->alphabet);
+   if (grammar==NULL) free_alphabet(p->alphabet);
    free_string_hash(semantic_codes);
-   free_Fst2(p->fst2,locate_abstract_allocator);
+   free_locate_fst2(p->fst2,grammar,locate_abstract_allocator);
    close_abstract_allocator(locate_abstract_allocator);
    free_stack_unichar(p->stack);
    free_locate_parameters(p);
@@ -400,9 +995,9 @@ int n_text_tokens=0;
 p->tokens=load_text_tokens_hash(tokens,vec,&(p->SENTENCE),&(p->STOP),&n_text_tokens);
 if (p->tokens==NULL) {
    error("Cannot load token list %s\n",tokens);
-   free_alphabet(p->alphabet);
+   if (grammar==NULL) free_alphabet(p->alphabet);
    free_string_hash(semantic_codes);
-   free_Fst2(p->fst2,locate_abstract_allocator);
+   free_locate_fst2(p->fst2,grammar,locate_abstract_allocator);
    close_abstract_allocator(locate_abstract_allocator);
    free_locate_parameters(p);
    af_release_mapfile_pointer(p->text_cod,p->buffer);
@@ -414,17 +1009,13 @@ if (p->tokens==NULL) {
 }
 Abstract_allocator locate_work_abstract_allocator = locate_abstract_allocator;
 
-p->match_cache=(LocateCache*)malloc_cb(p->tokens->size * sizeof(LocateCache),locate_work_abstract_allocator);
-memset(p->match_cache,0,p->tokens->size * sizeof(LocateCache));
-if (p->match_cache==NULL) {
-    fatal_alloc_error("locate_pattern");
-}
+p->match_cache=new_LocateCacheSet(p->tokens->size,cache_size,locate_work_abstract_allocator);
 
 #ifdef REGEX_FACADE_ENGINE
 p->filter_match_index=new_FilterMatchIndex(p->filters,p->tokens);
 if (p->filter_match_index==NULL) {
    error("Cannot optimize filter(s)\n");
-   free_alphabet(p->alphabet);
+   if (grammar==NULL) free_alphabet(p->alphabet);
    free_string_hash(semantic_codes);
    free_string_hash(p->tokens);
    close_abstract_allocator(locate_abstract_allocator);
@@ -462,6 +1053,19 @@ int number_of_patterns,is_DIC,is_CDIC,is_SDIC;
 p->pattern_tree_root=new_pattern_node(locate_abstract_allocator);
 u_printf("Computing fst2 tags...\n");
 process_tags(&number_of_patterns,semantic_codes,&is_DIC,&is_CDIC,&is_SDIC,p,locate_abstract_allocator);
+if (p->match_cache_file!=NULL) {
+   if (uses_text_dictionaries(p->fst2)) {
+      /* Lexical masks and <DIC>-like tags depend on the dlf, dlc and err files
+       * of the text, so their matches cannot be reused for another text */
+      u_printf("The grammar uses dictionary information: the cache file %s is not used\n",p->match_cache_file);
+      p->match_cache_file=NULL;
+   } else {
+      int n=load_LocateCacheSet(p->match_cache_file,p->match_cache,match_cache_key,p->tokens);
+      if (n!=-1) {
+         u_printf("%d token sequence%s loaded from cache file\n",n,(n==1)?"":"s");
+      }
+   }
+}
 p->current_compound_pattern=number_of_patterns;
 p->DLC_tree=new_DLC_tree(p->tokens->size);
 struct lemma_node* root=new_lemma_node();
@@ -480,37 +1084,6 @@ int nb_input_variable=0;
 p->input_variables=new_Variables(p->fst2->input_variables,&nb_input_variable);
 p->output_variables=new_OutputVariables(p->fst2->output_variables,&p->nb_output_variables,injected_vars);
 
-Abstract_allocator locate_recycle_abstract_allocator=NULL;
-locate_recycle_abstract_allocator=create_abstract_allocator("locate_pattern_recycle",
-                                 AllocatorFreeOnlyAtAllocatorDelete|AllocatorTipOftenRecycledObject,
-                                 get_prefered_allocator_item_size_for_nb_variable(nb_input_variable));
-
-Abstract_allocator locate_work_abstract_allocator_inside_token = NULL;
-locate_work_abstract_allocator_inside_token=create_abstract_allocator("locate_pattern_inside_token", AllocatorCreationFlagAutoFreePrefered);/*create_abstract_allocator("locate_pattern_recycle",
-                                 AllocatorFreeOnlyAtAllocatorDelete|AllocatorTipOftenRecycledObject,
-                                 get_prefered_allocator_item_size_for_nb_variable(nb_input_variable));*/
-
-Abstract_allocator morphlogical_content_buffer_recycle_abstract_allocator=NULL;
-morphlogical_content_buffer_recycle_abstract_allocator=create_abstract_allocator("morphlogical_content_buffer_recycle",
-                                 AllocatorFreeOnlyAtAllocatorDelete|AllocatorTipGrowingOftenRecycledObject,
-                                 0);
-
-
-Abstract_allocator locate_recycle_backup_abstract_allocator=NULL;
-locate_recycle_backup_abstract_allocator=create_abstract_allocator("locate_pattern_growing_recycle",
-                                 AllocatorFreeOnlyAtAllocatorDelete|AllocatorTipGrowingOftenRecycledObject,
-                                 0);
-
-Abstract_allocator locate_recycle_context_abstract_allocator=NULL;
-locate_recycle_context_abstract_allocator=create_abstract_allocator("locate_pattern_growing_recycle",
-                                 AllocatorFreeOnlyAtAllocatorDelete|AllocatorTipGrowingOftenRecycledObject,
-                                 0);
-
-Abstract_allocator locate_recycle_locate_trace_info_allocator=NULL;
-locate_recycle_locate_trace_info_allocator=create_abstract_allocator("locate_pattern_recycle_locate_trace_info",
-                                 AllocatorFreeOnlyAtAllocatorDelete|AllocatorTipOftenRecycledObject,
-                                 sizeof(locate_trace_info));
-
 u_printf("Optimizing fst2...\n");
 p->optimized_states=build_optimized_fst2_states(p->input_variables,p->output_variables,p->fst2,locate_abstract_allocator);
 if (is_korean) {
@@ -521,13 +1094,11 @@ p->failfast=new_bit_array(n_text_tokens,ONE_BIT);
 
 u_printf("Working...\n");
 p->al.prv_alloc_generic=locate_work_abstract_allocator;
-p->al.pa.prv_alloc_vector_int_inside_token=locate_work_abstract_allocator_inside_token;
-p->al.pa.prv_alloc_recycle=locate_recycle_abstract_allocator;
-p->al.prv_alloc_recycle_morphlogical_content_buffer=morphlogical_content_buffer_recycle_abstract_allocator;
-p->al.pa.prv_alloc_backup_growing_recycle=locate_recycle_backup_abstract_allocator;
-p->al.prv_alloc_trace_info_allocator=locate_recycle_locate_trace_info_allocator;
-p->al.prv_alloc_context=locate_recycle_context_abstract_allocator;
-launch_locate(out,text_size,info,p);
+create_locate_work_allocators(&(p->al),nb_input_variable);
+launch_locate_in_threads(out,text_size,info,p,n_threads,injected_vars);
+if (profile_file!=NULL && profile_file[0]!='\0') {
+   save_locate_profile(profile_file,vec,p,text_size,locate_abstract_allocator);
+}
 if (allow_trace!=0) {
    close_locate_trace(p,p->fnc_locate_trace_step,p->private_param_locate_trace);
 }
@@ -538,13 +1109,15 @@ af_release_mapfile_pointer(p->text_cod,p->buffer);
 af_close_mapfile(p->text_cod);
 if (info!=NULL) u_fclose(info);
 u_fclose(out);
+if (p->binary_concord!=NULL) {
+   /* The text concordance only contains its header, so we replace it */
+   save_binary_concord(p->binary_concord,concord);
+}
 
-if (p->match_cache!=NULL) {
-    for (int i=0;i<p->tokens->size;i++) {
-        free_LocateCache(p->match_cache[i],locate_work_abstract_allocator);
-    }
-    free_cb(p->match_cache,locate_work_abstract_allocator);
+if (p->match_cache_file!=NULL) {
+   save_LocateCacheSet(p->match_cache_file,p->match_cache,match_cache_key,p->tokens);
 }
+free_LocateCacheSet(p->match_cache);
 int free_abstract_allocator_item=(get_allocator_cb_flag(locate_abstract_allocator) & AllocatorGetFlagAutoFreePresent) ? 0 : 1;
 
 if (free_abstract_allocator_item) {
@@ -556,22 +1129,15 @@ free_stack_unichar(p->stack);
  */
 if (free_abstract_allocator_item) {
   free_pattern_node(p->pattern_tree_root,locate_abstract_allocator);
-  free_Fst2(p->fst2,locate_abstract_allocator);
+  free_locate_fst2(p->fst2,grammar,locate_abstract_allocator);
   free_list_int(p->tag_token_list,locate_abstract_allocator);
 }
 close_abstract_allocator(locate_abstract_allocator);
-close_abstract_allocator(locate_work_abstract_allocator_inside_token);
-close_abstract_allocator(locate_recycle_abstract_allocator);
-close_abstract_allocator(locate_recycle_backup_abstract_allocator);
-close_abstract_allocator(locate_recycle_locate_trace_info_allocator);
-close_abstract_allocator(locate_recycle_context_abstract_allocator);
-close_abstract_allocator(morphlogical_content_buffer_recycle_abstract_allocator);
-locate_recycle_abstract_allocator=locate_abstract_allocator=NULL;
-locate_recycle_backup_abstract_allocator=locate_recycle_context_abstract_allocator=NULL;
-morphlogical_content_buffer_recycle_abstract_allocator=NULL;
+close_locate_work_allocators(&(p->al));
+locate_abstract_allocator=NULL;
 
 /* We don't free 'parameters->tags' because it was just a link on 'parameters->fst2->tags' */
-free_alphabet(p->alphabet);
+if (grammar==NULL) free_alphabet(p->alphabet);
 if (p->korean!=NULL) {
     delete p->korean;
 }
@@ -591,7 +1157,7 @@ for (int i=0;i<n_text_tokens;i++) {
 }
 free(p->matching_patterns);
 #ifdef REGEX_FACADE_ENGINE
-free_FilterSet(p->filters);
+if (grammar==NULL) free_FilterSet(p->filters);
 free_FilterMatchIndex(p->filter_match_index);
 #endif
 for (int i=0;i<p->n_morpho_dics;i++) {
@@ -67,6 +67,7 @@ struct counting_step_st
 
 
 struct locate_parameters ;
+struct locate_chunk ;
 
 struct locate_trace_info
 {
@@ -101,6 +102,31 @@ int n_matches_at_token_pos__locate;
 int n_matches_at_token_pos__morphological_locate;
 };
 
+/**
+ * In streaming mode, the text.cod file is not mapped. Its tokens are read
+ * into a sliding window that starts a little before the current origin, and
+ * that goes at least 'lookahead' tokens after it. 'tokens[i]' is the token
+ * at the absolute position 'start+i' in the text.
+ *
+ * If an exploration needs a token beyond the window end while the end of
+ * the file has not been reached, 'overflow' is set. The exploration from
+ * the current origin is then discarded and made again with a larger window,
+ * so that the results are the same as without streaming.
+ */
+/* Minimal number of tokens of the streaming window */
+#define LOCATE_TEXT_WINDOW_MIN_SIZE (1<<16)
+
+struct locate_text_window {
+   U_FILE* f;
+   int* tokens;
+   int capacity;
+   int start;
+   int size;
+   int eof;
+   int lookahead;
+   int overflow;
+};
+
 #define SIZE_RECYCLABLE_UNICHAR_BUFFER 2048
 #define SIZE_RECYCLABLE_WCHAR_T_BUFFER 2048
 /**
@@ -223,6 +249,12 @@ struct locate_parameters {
    /* A system-dependent object that represents the mapped' text.cod' file */
    ABSTRACTMAPFILE* text_cod;
 
+   /* The sliding window used instead of 'text_cod' in streaming mode,
+    * NULL otherwise. In that case, 'buffer' is set so that 'buffer[i]'
+    * is the token at the absolute position i, as long as i is in the window,
+    * and 'buffer_size' is the absolute position of the window end */
+   struct locate_text_window* window;
+
 
    /* Indicates if we work char by char or not */
    TokenizationPolicy tokenization_policy;
@@ -257,6 +289,9 @@ struct locate_parameters {
     * of matches if ambiguous outputs are allowed. */
    int number_of_outputs;
 
+   /* The total number of exploration steps */
+   unsigned long exploration_steps;
+
    /* Position of the last printed match. It is used when ambiguous outputs
     * are used. */
    int start_position_last_printed_match;
@@ -335,7 +370,10 @@ struct locate_parameters {
    struct match_list* match_cache_first;
    struct match_list* match_cache_last;
    /* This is the cache array to store matches */
-   LocateCache* match_cache;
+   LocateCacheSet match_cache;
+   /* If not NULL, the name of the file the match cache is loaded from
+    * and saved to */
+   const char* match_cache_file;
    /* This vector is used to store results obtained from cache consultation */
    vector_ptr* cached_match_vector;
 
@@ -386,15 +424,77 @@ struct locate_parameters {
    int graph_depth_backup_nested;
 
    const char* graph_filename;
+
+   /* When Locate works with several threads, each worker explores a chunk of
+    * the text and records its matches in it instead of adding them to
+    * 'match_list'. NULL for the main Locate parameters */
+   struct locate_chunk* chunk;
+
+   /* If not NULL, the matches are saved in the binary concord.ind format
+    * instead of being printed to the output file */
+   struct binary_concord_writer* binary_concord;
+};
+
+
+/**
+ * This structure holds the part of a compiled Locate grammar that does not
+ * depend on the text: the fst2, the alphabet and the compiled morphological
+ * filters. Everything else (tag kinds, token lists, pattern tree, DLC tree,
+ * optimized states) is computed from the text tokens and must be rebuilt for
+ * each text.
+ *
+ * locate_pattern never modifies such a structure, so that once it has been
+ * registered with register_locate_grammar, it is shared by pointer between
+ * all the Locate calls and threads that use the same fst2 and alphabet.
+ */
+struct locate_grammar {
+   char* fst2_name;
+   char* alphabet_name;
+   int is_korean;
+   Fst2* fst2;
+   Alphabet* alphabet;
+#ifdef REGEX_FACADE_ENGINE
+   FilterSet* filters;
+#endif
 };
 
+struct locate_grammar* new_locate_grammar(const VersatileEncodingConfig*,const char* fst2_name,const char* alphabet,int is_korean);
+void free_locate_grammar(struct locate_grammar*);
+int register_locate_grammar(struct locate_grammar*);
+int unregister_locate_grammar(struct locate_grammar*);
+const struct locate_grammar* get_registered_locate_grammar(const char* fst2_name,const char* alphabet,int is_korean);
 
 int locate_pattern(const char*,const char*,const char*,const char*,const char*,const char*,const char*,
                    MatchPolicy,OutputPolicy, const VersatileEncodingConfig*,const char*,TokenizationPolicy,
                    SpacePolicy,int,const char*,AmbiguousOutputPolicy,
                    VariableErrorPolicy,int,int,int,int,
                    int stack_max, int max_matches_at_token_pos,int max_matches_per_subgraph,int max_errors,
-                   char*,int,int,int,char* const [],vector_ptr*);
+                   char*,int,int,int,char* const [],vector_ptr*,int n_threads=1,size_t cache_size=0,
+                   const char* match_cache_file=NULL,int stream=0,const char* profile_file=NULL,
+                   int binary_concord=0);
+
+struct locate_text_window* new_locate_text_window(const char* text_cod,int lookahead);
+void free_locate_text_window(struct locate_text_window*);
+void fill_locate_text_window(struct locate_parameters*,int keep_from);
+
+
+/**
+ * This function must be called when the exploration reaches the absolute
+ * position 'position' and finds no more token there. In streaming mode, if
+ * it is the end of the window but not the end of the text, we note it.
+ */
+static inline void check_text_window_end(struct locate_parameters* p,int position) {
+if (p->window!=NULL && position>=p->buffer_size && !p->window->eof) {
+   p->window->overflow=1;
+}
+}
+
+struct locate_parameters* new_locate_parameters();
+void free_locate_parameters(struct locate_parameters*);
+void create_locate_work_allocators(struct locate_allocators*,int nb_input_variable);
+void close_locate_work_allocators(struct locate_allocators*);
+struct locate_parameters* new_locate_worker_parameters(const struct locate_parameters*,vector_ptr* injected_vars);
+void free_locate_worker_parameters(struct locate_parameters*);
 
 void numerote_tags(Fst2*,struct string_hash*,int*,struct string_hash*,Alphabet*,int*,int*,int*,int,struct locate_parameters*);
 unsigned char get_control_byte(const unichar*,const Alphabet*,struct string_hash*,TokenizationPolicy);
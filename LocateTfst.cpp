@@ -86,6 +86,16 @@ const char* usage_LocateTfst =
   "  --tagging: indicates that the concordance must be a tagging one, containing\n"
   "             additional information on the start and end states of each match\n"
   "\n"
+  "  --shared_exploration: remembers the pairs of (text automaton state,grammar state)\n"
+  "                        from which no match can be found, so that they are not\n"
+  "                        explored again from other start states of the sentence.\n"
+  "                        This speeds up long ambiguous sentences. Results are\n"
+  "                        the same, unless the exploration of a sentence is cut\n"
+  "                        because of a combinatorial explosion\n"
+  "  --threads=N: explores the sentences of the text automaton with N threads\n"
+  "               (default: 1). Matches are saved in sentence order, so that\n"
+  "               concord.ind is the same as with a single thread\n"
+  "\n"
   "  -V/--only-verify-arguments: only verify arguments syntax and exit\n"
   "  -h/--help: this help\n"
   "\n"
@@ -99,7 +109,7 @@ static void usage() {
 }
 
 
-const char* optstring_LocateTfst=":t:a:Kln:SLAIMRXYZbzVhg:k:q:v:";
+const char* optstring_LocateTfst=":t:a:Kln:SLAIMRXYZbzVhg:k:q:v:#:";
 const struct option_TS lopts_LocateTfst[]= {
   {"text",required_argument_TS,NULL,'t'},
   {"alphabet",required_argument_TS,NULL,'a'},
@@ -126,6 +136,8 @@ const struct option_TS lopts_LocateTfst[]= {
   {"tagging",no_argument_TS,NULL,1},
   {"single_tags_only",no_argument_TS,NULL,2},
   {"dont_match_word_boundaries", no_argument_TS, NULL,3},
+  {"threads",required_argument_TS,NULL,'#'},
+  {"shared_exploration",no_argument_TS,NULL,4},
   {NULL,no_argument_TS,NULL,0}
 };
 
@@ -155,6 +167,8 @@ OutputPolicy output_policy=IGNORE_OUTPUTS;
 AmbiguousOutputPolicy ambiguous_output_policy=ALLOW_AMBIGUOUS_OUTPUTS;
 VariableErrorPolicy variable_error_policy=IGNORE_VARIABLE_ERRORS;
 int search_limit=NO_MATCH_LIMIT;
+int n_threads=1;
+int shared_exploration=0;
 char foo;
 vector_ptr* injected=new_vector_ptr();
 bool only_verify_arguments = false;
@@ -202,6 +216,13 @@ while (EOF!=(val=options.parse_long(argc,argv,optstring_LocateTfst,lopts_LocateT
                 return USAGE_ERROR_CODE;
              }
              break;
+   case '#': if (1!=sscanf(options.vars()->optarg,"%d%c",&n_threads,&foo) || n_threads<=0) {
+                /* foo is used to check that the param is not like "45gjh" */
+                error("Invalid number of threads: %s\n",options.vars()->optarg);
+                free_vector_ptr(injected);
+                return USAGE_ERROR_CODE;
+             }
+             break;
    case 'S': match_policy=SHORTEST_MATCHES; break;
    case 'L': match_policy=LONGEST_MATCHES; break;
    case 'A': match_policy=ALL_MATCHES; break;
@@ -220,6 +241,7 @@ while (EOF!=(val=options.parse_long(argc,argv,optstring_LocateTfst,lopts_LocateT
    case 1: tagging=1; break;
    case 2: single_tags_only=1; break;
    case 3: match_word_boundaries=0; break;
+   case 4: shared_exploration=1; break;
    case 'k': if (options.vars()->optarg[0]=='\0') {
                 error("Empty input_encoding argument\n");
                 free_vector_ptr(injected);
@@ -299,7 +321,9 @@ int OK=locate_tfst(text,
                    injected,
                    tagging,
                    single_tags_only,
-                   match_word_boundaries);
+                   match_word_boundaries,
+                   n_threads,
+                   shared_exploration);
 
 free_vector_ptr(injected);
 
@@ -29,6 +29,7 @@
 #include "Korean.h"
 #include "Contexts.h"
 #include "List_int.h"
+#include "SyncTool.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -48,8 +49,12 @@ namespace unitex {
  * a combinatorial explosion */
 #define MAX_VISITS_PER_TFST_STATE 128
 
+/* Maximum number of unsigned ints of the dead end matrix used in shared
+ * exploration mode. For larger sentence automata, the mode is disabled */
+#define MAX_SHARED_EXPLORATION_MATRIX_SIZE (16*1024*1024)
 
-void explore_tfst(int* visits,Tfst* tfst,int current_state_in_tfst,
+
+void explore_tfst(struct tfst_visits* visits,Tfst* tfst,int current_state_in_tfst,
                   int current_state_in_fst2,int graph_depth,
                   struct tfst_match* match_element_list,
                 struct tfst_match_list** LIST,
@@ -106,8 +111,245 @@ return s;
 
 
 /**
- * This function applies the given grammar to the given text automaton.
- * It returns 1 in case of success; 0 otherwise.
+ * Allocates, initializes and returns a tfst_visits structure. If 'shared_exploration'
+ * is not null, the structure will remember the dead ends of the main graph of 'fst2'.
+ */
+static struct tfst_visits* new_tfst_visits(const Fst2* fst2,int shared_exploration) {
+struct tfst_visits* visits=(struct tfst_visits*)malloc(sizeof(struct tfst_visits));
+if (visits==NULL) {
+   fatal_alloc_error("new_tfst_visits");
+}
+visits->capacity=0;
+visits->count=NULL;
+visits->stamp=NULL;
+visits->epoch=0;
+visits->shared_exploration=shared_exploration;
+visits->first_main_state=fst2->initial_states[1];
+visits->n_main_states=fst2->number_of_states_per_graphs[1];
+visits->row_size=(visits->n_main_states+31)/32;
+visits->dead=NULL;
+visits->dead_stamp=NULL;
+visits->sentence=0;
+visits->n_final_states=0;
+visits->n_cutoffs=0;
+return visits;
+}
+
+
+/**
+ * Frees all the memory associated to the given tfst_visits structure.
+ */
+static void free_tfst_visits(struct tfst_visits* visits) {
+if (visits==NULL) return;
+free(visits->count);
+free(visits->stamp);
+free(visits->dead);
+free(visits->dead_stamp);
+free(visits);
+}
+
+
+/**
+ * Prepares the visit counters for a sentence automaton with 'n_states' states.
+ * The arrays are only reallocated if they are too small, and they are never
+ * cleared, since counters and dead end rows are validated by their stamps.
+ */
+static void prepare_tfst_visits_for_new_sentence(struct tfst_visits* visits,int n_states) {
+if (n_states>visits->capacity) {
+   free(visits->count);
+   free(visits->stamp);
+   free(visits->dead);
+   free(visits->dead_stamp);
+   visits->capacity=n_states;
+   visits->count=(int*)malloc(n_states*sizeof(int));
+   visits->stamp=(unsigned int*)calloc(n_states,sizeof(unsigned int));
+   if (visits->count==NULL || visits->stamp==NULL) {
+      fatal_alloc_error("prepare_tfst_visits_for_new_sentence");
+   }
+   visits->dead=NULL;
+   visits->dead_stamp=NULL;
+   if (visits->shared_exploration
+       && (size_t)n_states*visits->row_size<=MAX_SHARED_EXPLORATION_MATRIX_SIZE) {
+      visits->dead=(unsigned int*)malloc((size_t)n_states*visits->row_size*sizeof(unsigned int));
+      visits->dead_stamp=(unsigned int*)calloc(n_states,sizeof(unsigned int));
+      if (visits->dead==NULL || visits->dead_stamp==NULL) {
+         fatal_alloc_error("prepare_tfst_visits_for_new_sentence");
+      }
+   }
+   visits->epoch=0;
+   visits->sentence=0;
+}
+if (++(visits->sentence)==0) {
+   /* If the stamp has wrapped around, we have to reset the rows */
+   if (visits->dead_stamp!=NULL) {
+      memset(visits->dead_stamp,0,visits->capacity*sizeof(unsigned int));
+   }
+   visits->sentence=1;
+}
+}
+
+
+/**
+ * Resets all the visit counters before exploring from a new start state.
+ */
+static void start_new_tfst_exploration(struct tfst_visits* visits) {
+if (++(visits->epoch)==0) {
+   memset(visits->stamp,0,visits->capacity*sizeof(unsigned int));
+   visits->epoch=1;
+}
+}
+
+
+/**
+ * Returns the row of dead ends of the given state of the sentence automaton,
+ * clearing it if it was not used yet for the current sentence.
+ */
+static unsigned int* get_dead_end_row(struct tfst_visits* visits,int state) {
+unsigned int* row=visits->dead+(size_t)state*visits->row_size;
+if (visits->dead_stamp[state]!=visits->sentence) {
+   memset(row,0,visits->row_size*sizeof(unsigned int));
+   visits->dead_stamp[state]=visits->sentence;
+}
+return row;
+}
+
+
+/**
+ * Applies the grammar to the sentence #n of infos->tfst. The matches are
+ * left in infos->matches.
+ */
+static void locate_tfst_in_sentence(struct locate_tfst_infos* infos,int n,int tilde_negation_operator) {
+Tfst* tfst=infos->tfst;
+load_sentence(tfst,n);
+compute_token_contents(tfst);
+if (infos->korean!=NULL) {
+   compute_jamo_tfst_tags(infos);
+}
+infos->matches=NULL;
+prepare_cache_for_new_sentence(infos->cache,tfst->tags->nbelems);
+prepare_tfst_visits_for_new_sentence(infos->visits,tfst->automaton->number_of_states);
+/* Within a sentence graph, we try to match from any state */
+for (int j=0;j<tfst->automaton->number_of_states;j++) {
+   start_new_tfst_exploration(infos->visits);
+   explore_tfst(infos->visits,tfst,j,infos->fst2->initial_states[1],0,NULL,NULL,infos,-1,-1,NULL,NULL,NULL,tilde_negation_operator);
+}
+clear_dic_variable_list(&(infos->dic_variables));
+}
+
+
+/* Number of consecutive sentences given to a worker at a time */
+#define LOCATE_TFST_SENTENCES_PER_WORKER 64
+
+/**
+ * This structure describes a worker of the multi-threaded mode. 'infos' is
+ * a copy of the main locate_tfst_infos that shares the grammar, the alphabet,
+ * the filters and the contexts, but has its own Tfst, variables and tag
+ * matching cache. The worker explores the sentences [first;last] and stores
+ * the match list of sentence #i in matches[i-first].
+ */
+struct locate_tfst_worker {
+   struct locate_tfst_infos infos;
+   int first;
+   int last;
+   struct tfst_simple_match_list** matches;
+   int tilde_negation_operator;
+};
+
+
+/**
+ * Worker thread function: explores the sentences of the worker's range.
+ */
+static void ABSTRACT_CALLBACK_UNITEX locate_tfst_worker_thread(void* private_ptr,unsigned int /* num_worker */) {
+struct locate_tfst_worker* w=(struct locate_tfst_worker*)private_ptr;
+for (int i=w->first;i<=w->last;i++) {
+   locate_tfst_in_sentence(&(w->infos),i,w->tilde_negation_operator);
+   w->matches[i-w->first]=w->infos.matches;
+   w->infos.matches=NULL;
+}
+}
+
+
+/**
+ * Applies the grammar to all the sentences of the text automaton with
+ * 'n_threads' workers. Sentences are explored by batches, and the match
+ * lists of a batch are saved in sentence order by the main thread, so that
+ * the concordance is the same as the one of a sequential exploration.
+ */
+static void locate_tfst_in_threads(struct locate_tfst_infos* infos,const char* text,
+                                   const VersatileEncodingConfig* vec,vector_ptr* injected_vars,
+                                   int n_threads,int tilde_negation_operator) {
+Tfst* tfst=infos->tfst;
+if (n_threads>(tfst->N+LOCATE_TFST_SENTENCES_PER_WORKER-1)/LOCATE_TFST_SENTENCES_PER_WORKER) {
+   n_threads=(tfst->N+LOCATE_TFST_SENTENCES_PER_WORKER-1)/LOCATE_TFST_SENTENCES_PER_WORKER;
+}
+int batch_size=n_threads*LOCATE_TFST_SENTENCES_PER_WORKER;
+struct locate_tfst_worker* workers=(struct locate_tfst_worker*)malloc(n_threads*sizeof(struct locate_tfst_worker));
+struct locate_tfst_worker** worker_ptrs=(struct locate_tfst_worker**)malloc(n_threads*sizeof(struct locate_tfst_worker*));
+struct tfst_simple_match_list** matches=(struct tfst_simple_match_list**)malloc(batch_size*sizeof(struct tfst_simple_match_list*));
+if (workers==NULL || worker_ptrs==NULL || matches==NULL) {
+   fatal_alloc_error("locate_tfst_in_threads");
+}
+for (int i=0;i<n_threads;i++) {
+   struct locate_tfst_worker* w=workers+i;
+   w->infos=*infos;
+   w->infos.tfst=open_text_automaton(vec,text);
+   if (w->infos.tfst==NULL) {
+      fatal_error("Cannot open %s\n",text);
+   }
+   w->infos.input_variables=new_Variables(infos->fst2->input_variables);
+   w->infos.output_variables=new_OutputVariables(infos->fst2->output_variables,NULL,injected_vars);
+   w->infos.dic_variables=NULL;
+   w->infos.matches=NULL;
+   w->infos.cache=new_LocateTfstTagMatchingCache(tfst->N,infos->fst2->number_of_tags);
+   w->infos.visits=new_tfst_visits(infos->fst2,infos->visits->shared_exploration);
+   w->tilde_negation_operator=tilde_negation_operator;
+   worker_ptrs[i]=w;
+}
+for (int first=1;first<=tfst->N && infos->number_of_matches!=infos->search_limit;first+=batch_size) {
+   int last=first+batch_size-1;
+   if (last>tfst->N) {
+      last=tfst->N;
+   }
+   int n=0;
+   for (int start=first;start<=last;start+=LOCATE_TFST_SENTENCES_PER_WORKER) {
+      workers[n].first=start;
+      workers[n].last=start+LOCATE_TFST_SENTENCES_PER_WORKER-1;
+      if (workers[n].last>last) {
+         workers[n].last=last;
+      }
+      workers[n].matches=matches+(start-first);
+      n++;
+   }
+   SyncRunWorkerThreads((unsigned int)n,locate_tfst_worker_thread,(void**)worker_ptrs);
+   for (int i=first;i<=last;i++) {
+      /* The sentence number is needed for tagging concordances */
+      tfst->current_sentence=i;
+      infos->matches=matches[i-first];
+      save_tfst_matches(infos);
+   }
+   tfst->current_sentence=NO_SENTENCE_LOADED;
+   u_printf("\rSentence %d/%d...",last,tfst->N);
+}
+for (int i=0;i<n_threads;i++) {
+   struct locate_tfst_worker* w=workers+i;
+   free_Variables(w->infos.input_variables);
+   free_OutputVariables(w->infos.output_variables);
+   free_LocateTfstTagMatchingCache(w->infos.cache);
+   free_tfst_visits(w->infos.visits);
+   close_text_automaton(w->infos.tfst);
+}
+free(matches);
+free(worker_ptrs);
+free(workers);
+}
+
+
+/**
+ * This function applies the given grammar to the given text automaton,
+ * using 'n_threads' threads. If 'shared_exploration' is not null, the pairs of
+ * states from which no match can be found are remembered, so that they are not
+ * explored again from other start states of the sentence. It returns 1 in case
+ * of success; 0 otherwise.
  */
 int locate_tfst(const char* text,const char* grammar,const char* alphabet,const char* output,
                 const VersatileEncodingConfig* vec,
@@ -115,7 +357,8 @@ int locate_tfst(const char* text,const char* grammar,const char* alphabet,const
                   OutputPolicy output_policy,AmbiguousOutputPolicy ambiguous_output_policy,
                   VariableErrorPolicy variable_error_policy,int search_limit,int is_korean,
                   int tilde_negation_operator,vector_ptr* injected_vars,int tagging,
-                  int single_tags_only,int match_word_boundaries) {
+                  int single_tags_only,int match_word_boundaries,int n_threads,
+                  int shared_exploration) {
 Tfst* tfst=open_text_automaton(vec,text);
 if (tfst==NULL) {
     return 0;
@@ -210,36 +453,19 @@ infos.end_position_last_printed_match_letter=-1;
 infos.search_limit=search_limit;
 init_Korean_stuffs(&infos,is_korean);
 infos.cache=new_LocateTfstTagMatchingCache(tfst->N,infos.fst2->number_of_tags);
+infos.visits=new_tfst_visits(infos.fst2,shared_exploration);
 infos.contexts=compute_contexts(infos.fst2);
-/* We launch the matching for each sentence */
-for (int i=1;i<=tfst->N && infos.number_of_matches!=infos.search_limit;i++) {
-   if (i%100==0) {
-        u_printf("\rSentence %d/%d...",i,tfst->N);
-    }
-   load_sentence(tfst,i);
-    compute_token_contents(tfst);
-    if (infos.korean!=NULL) {
-       compute_jamo_tfst_tags(&infos);
-    }
-    infos.matches=NULL;
-    prepare_cache_for_new_sentence(infos.cache,tfst->tags->nbelems);
-#ifdef NO_C99_VARIABLE_LENGTH_ARRAY
-    int* visits=(int*)malloc(sizeof(int)*(1+tfst->automaton->number_of_states));
-#else
-    int visits[tfst->automaton->number_of_states];
-#endif
-    /* Within a sentence graph, we try to match from any state */
-    for (int j=0;j<tfst->automaton->number_of_states;j++) {
-       for (int k=0;k<tfst->automaton->number_of_states;k++) {
-          visits[k]=0;
-       }
-       explore_tfst(visits,tfst,j,infos.fst2->initial_states[1],0,NULL,NULL,&infos,-1,-1,NULL,NULL,NULL,tilde_negation_operator);
-    }
-#ifdef NO_C99_VARIABLE_LENGTH_ARRAY
-    free(visits);
-#endif
-    save_tfst_matches(&infos);
-    clear_dic_variable_list(&(infos.dic_variables));
+if (n_threads>1 && tfst->N>1 && infos.korean==NULL && SyncIsWorkerThreadAvailable()) {
+   locate_tfst_in_threads(&infos,text,vec,injected_vars,n_threads,tilde_negation_operator);
+} else {
+   /* We launch the matching for each sentence */
+   for (int i=1;i<=tfst->N && infos.number_of_matches!=infos.search_limit;i++) {
+      if (i%100==0) {
+         u_printf("\rSentence %d/%d...",i,tfst->N);
+      }
+      locate_tfst_in_sentence(&infos,i,tilde_negation_operator);
+      save_tfst_matches(&infos);
+   }
 }
 u_printf("\rDone.                                    \n");
 /* We save some infos */
@@ -276,6 +502,7 @@ free_Variables(infos.input_variables);
 free_OutputVariables(infos.output_variables);
 free_Korean_stuffs(&infos);
 free_LocateTfstTagMatchingCache(infos.cache);
+free_tfst_visits(infos.visits);
 for (int i=0;i<infos.fst2->number_of_states;i++) {
    free_opt_contexts(infos.contexts[i]);
 }
@@ -417,9 +644,9 @@ for (int i=0;i<infos->n_jamo_tfst_tags;i++) {
 
 
 /**
- * Explores in parallel the tfst and the fst2.
+ * Explores in parallel the tfst and the fst2 from the given pair of states.
  */
-void explore_tfst(int* visits,Tfst* tfst,int current_state_in_tfst,
+static void explore_tfst_from_state(struct tfst_visits* visits,Tfst* tfst,int current_state_in_tfst,
                   int current_state_in_fst2,int graph_depth,
                   struct tfst_match* match_element_list,
                 struct tfst_match_list* *LIST,
@@ -435,12 +662,6 @@ void explore_tfst(int* visits,Tfst* tfst,int current_state_in_tfst,
                 Transition* current_pending_tfst_transition,
                 struct list_context* ctx /* information about the current context, if any */,
                 int tilde_negation_operator) {
-//error("visits for current state=%d  tfst state=%d  fst2 state=%d\n",visits[current_state_in_tfst],current_state_in_tfst,current_state_in_fst2);
-if (visits[current_state_in_tfst]>MAX_VISITS_PER_TFST_STATE) {
-   /* If there are too much recursive calls */
-   return;
-}
-visits[current_state_in_tfst]++;
 if (current_pending_fst2_transition!=NULL && current_pending_tfst_transition!=NULL) {
    fatal_error("Internal error in explore_tfst: cannot have two non NULL pending transitions\n");
 }
@@ -603,6 +824,7 @@ if (is_final_state(current_state_in_grammar)) {
    }
    if (graph_depth==0) {
       /* If we are in the main graph, we add a match to the main match list */
+      (visits->n_final_states)++;
       if (match_element_list!=NULL) {
           add_tfst_match(infos,match_element_list);
       }
@@ -834,6 +1056,61 @@ while (grammar_transition!=NULL) {
 }
 }
 
+/**
+ * Explores in parallel the tfst and the fst2, unless there are too many
+ * visits of the current tfst state, or unless we know that no match can be
+ * reached from the current pair of states (shared exploration mode).
+ */
+void explore_tfst(struct tfst_visits* visits,Tfst* tfst,int current_state_in_tfst,
+                  int current_state_in_fst2,int graph_depth,
+                  struct tfst_match* match_element_list,
+                struct tfst_match_list* *LIST,
+                struct locate_tfst_infos* infos,
+                int pos_pending_in_fst2_tag,
+                int pos_pending_in_tfst_tag,
+                Transition* current_pending_fst2_transition,
+                Transition* current_pending_tfst_transition,
+                struct list_context* ctx,
+                int tilde_negation_operator) {
+/* A pair of states in the main graph and out of any context or pending tag
+ * leads to the same final states, whatever the start state of the exploration */
+unsigned int* dead_end_row=NULL;
+int n=current_state_in_fst2-visits->first_main_state;
+if (visits->dead!=NULL && graph_depth==0 && ctx==NULL
+    && current_pending_fst2_transition==NULL && current_pending_tfst_transition==NULL
+    && pos_pending_in_fst2_tag==-1 && pos_pending_in_tfst_tag==-1
+    && n>=0 && n<visits->n_main_states) {
+   dead_end_row=get_dead_end_row(visits,current_state_in_tfst);
+   if (dead_end_row[n/32] & (1u<<(n%32))) {
+      return;
+   }
+}
+//error("visits for current state=%d  tfst state=%d  fst2 state=%d\n",visits->count[current_state_in_tfst],current_state_in_tfst,current_state_in_fst2);
+if (visits->stamp[current_state_in_tfst]!=visits->epoch) {
+   visits->stamp[current_state_in_tfst]=visits->epoch;
+   visits->count[current_state_in_tfst]=0;
+}
+if (visits->count[current_state_in_tfst]>MAX_VISITS_PER_TFST_STATE) {
+   /* If there are too much recursive calls */
+   (visits->n_cutoffs)++;
+   return;
+}
+visits->count[current_state_in_tfst]++;
+unsigned long n_final_states=visits->n_final_states;
+unsigned long n_cutoffs=visits->n_cutoffs;
+explore_tfst_from_state(visits,tfst,current_state_in_tfst,current_state_in_fst2,graph_depth,
+                        match_element_list,LIST,infos,pos_pending_in_fst2_tag,pos_pending_in_tfst_tag,
+                        current_pending_fst2_transition,current_pending_tfst_transition,ctx,
+                        tilde_negation_operator);
+if (dead_end_row!=NULL && n_final_states==visits->n_final_states && n_cutoffs==visits->n_cutoffs) {
+   /* If no final state of the main graph was reached, we will never have to explore
+    * this pair of states again. We don't do that if the exploration was cut, since
+    * it may have reached a final state otherwise */
+   dead_end_row[n/32]|=(1u<<(n%32));
+}
+}
+
+
 
 /**
  * This function tests if a text tag can be matched by a grammar tag, but only
@@ -1284,9 +1561,11 @@ if (tag[l-1]!='>') {
 }
 if (tag[1]=='!') {(*negation)=1;}
 else {(*negation)=0;}
-tag[l-1]='\0';
-struct pattern* pattern=build_pattern(&(tag[1+(*negation)]),NULL,tilde_negation_operator);
-tag[l-1]='>';
+/* We work on a copy, because the grammar tag may be shared by several
+ * threads */
+unichar* content=u_strdup(&(tag[1+(*negation)]),l-2-(*negation));
+struct pattern* pattern=build_pattern(content,NULL,tilde_negation_operator);
+free(content);
 return pattern;
 }
 
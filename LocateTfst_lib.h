@@ -50,6 +50,37 @@ namespace unitex {
 #define TEXT_INDEPENDENT_MATCH 3
 #define PARTIAL_MATCH_STATUS 4
 
+/**
+ * This structure holds the visit counters of the states of the current sentence
+ * automaton. A counter is only valid if its stamp is equal to 'epoch', so that
+ * all the counters are reset before exploring from a new start state by just
+ * incrementing 'epoch'.
+ *
+ * In shared exploration mode, 'dead' is a bit matrix that gives, for each state
+ * of the sentence automaton, the states of the main graph from which no final
+ * state can be reached. A row is only valid if its stamp is equal to 'sentence'.
+ */
+struct tfst_visits {
+    int capacity;
+    int* count;
+    unsigned int* stamp;
+    unsigned int epoch;
+
+    int shared_exploration;
+    int first_main_state;
+    int n_main_states;
+    int row_size;
+    unsigned int* dead;
+    unsigned int* dead_stamp;
+    unsigned int sentence;
+
+    /* These counters are used to know if an exploration has reached a final
+     * state of the main graph or has been cut */
+    unsigned long n_final_states;
+    unsigned long n_cutoffs;
+};
+
+
 /**
  * This structure is used to wrap many information needed to perform the locate
  * operation on a text automaton.
@@ -112,6 +143,7 @@ struct locate_tfst_infos {
     unichar** jamo_tfst_tags;
 
     LocateTfstTagMatchingCache* cache;
+    struct tfst_visits* visits;
     struct opt_contexts** contexts;
 
     int debug;
@@ -122,7 +154,7 @@ struct locate_tfst_infos {
 
 
 int locate_tfst(const char*,const char*,const char*,const char*, const VersatileEncodingConfig*,MatchPolicy,OutputPolicy,AmbiguousOutputPolicy,
-                VariableErrorPolicy,int,int,int,vector_ptr*,int,int,int);
+                VariableErrorPolicy,int,int,int,vector_ptr*,int,int,int,int,int);
 
 } // namespace unitex
 
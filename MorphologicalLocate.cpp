@@ -450,6 +450,7 @@ unichar* content_buffer /* reusable unichar 4096 buffer for content */
     /* If we have reached the end of the token buffer, we indicate it by setting
      * the current tokens to -1 */
     if (pos_in_tokens + p->current_origin >= p->buffer_size) {
+        check_text_window_end(p, pos_in_tokens + p->current_origin);
         token = -1;
     } else {
         token = p->buffer[pos_in_tokens + p->current_origin];
@@ -1620,6 +1621,9 @@ offset=read_dictionary_state(d,offset,&final,&n_transitions,&inf_number);
             pos_offset++;
             int token_number = (((int)(pos_offset + p->current_origin + 1)) <= (int)(p->buffer_size)) ?
                 p->buffer[pos_offset + p->current_origin] : -1;
+            if (token_number == -1) {
+                check_text_window_end(p, pos_offset + p->current_origin);
+            }
 
             if (token_number == -1 || token_number == p->STOP) {
                 /* Remember 1) that we must not be out of the array's bounds and
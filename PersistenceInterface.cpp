@@ -27,6 +27,7 @@
 #include "AbstractDelaLoad.h"
 #include "AbstractFst2Load.h"
 #include "Alphabet.h"
+#include "LocatePattern.h"
 
 #include "PersistenceInterface.h"
 #include "Error.h"
@@ -111,6 +112,28 @@ UNITEX_FUNC void UNITEX_CALL persistence_public_unload_alphabet(const char*filen
     return standard_unload_persistence_alphabet(filename);
 }
 
+UNITEX_FUNC int UNITEX_CALL persistence_public_load_locate_grammar(const char*fst2_filename,const char*alphabet_filename,int is_korean)
+{
+    VersatileEncodingConfig vec = VEC_DEFAULT;
+    struct locate_grammar* grammar = new_locate_grammar(&vec, fst2_filename, alphabet_filename, is_korean);
+    if (grammar == NULL)
+        return 0;
+    if (register_locate_grammar(grammar) == 0) {
+        free_locate_grammar(grammar);
+        return 0;
+    }
+    return 1;
+}
+
+UNITEX_FUNC void UNITEX_CALL persistence_public_unload_locate_grammar(const char*fst2_filename,const char*alphabet_filename,int is_korean)
+{
+    struct locate_grammar* grammar = (struct locate_grammar*)get_registered_locate_grammar(fst2_filename, alphabet_filename, is_korean);
+    if (grammar == NULL)
+        return;
+    unregister_locate_grammar(grammar);
+    free_locate_grammar(grammar);
+}
+
 UNITEX_FUNC int UNITEX_CALL persistence_public_is_persisted_fst2_filename(const char*filename)
 {
     return is_abstract_or_persistent_fst2_filename(filename);
@@ -80,6 +80,16 @@ UNITEX_FUNC void UNITEX_CALL persistence_public_unload_fst2(const char*filename)
 UNITEX_FUNC int UNITEX_CALL persistence_public_load_alphabet(const char*filename,char* persistent_filename_buffer,size_t buffer_size);
 UNITEX_FUNC void UNITEX_CALL persistence_public_unload_alphabet(const char*filename);
 
+/* persistence_public_load_locate_grammar : loads the text independent part of a
+   Locate grammar (fst2, alphabet and morphological filters) and shares it with all
+   the next Locate calls that use the same fst2 and alphabet names, with or without
+   the Korean option according to is_korean. Use it with a persisted fst2 and
+   alphabet, and call persistence_public_unload_locate_grammar before unloading them.
+
+   return 0 if fail, no zero if success */
+UNITEX_FUNC int UNITEX_CALL persistence_public_load_locate_grammar(const char*fst2_filename,const char*alphabet_filename,int is_korean);
+UNITEX_FUNC void UNITEX_CALL persistence_public_unload_locate_grammar(const char*fst2_filename,const char*alphabet_filename,int is_korean);
+
 
 UNITEX_FUNC int UNITEX_CALL persistence_public_is_persisted_fst2_filename(const char*filename);
 UNITEX_FUNC int UNITEX_CALL persistence_public_is_persisted_dictionary_filename(const char*filename);
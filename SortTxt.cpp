@@ -30,6 +30,8 @@
 #include "SortTxt.h"
 #include "ProgramInvoker.h"
 #include "DELA.h"
+#include "File.h"
+#include "SyncTool.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -133,6 +135,9 @@ int explore_node(struct sort_tree_node*, struct sort_infos* inf,
 static void quicksort(struct sort_tree_transition**, int, int, struct sort_infos* inf);
 int char_cmp(unichar, unichar, struct sort_infos* inf);
 int strcmp2(unichar*, unichar*, struct sort_infos* inf);
+static int get_line(struct sort_infos*, unichar*, int*);
+static void save_sorted_line(unichar*, int, struct sort_infos*, struct dela_entry**);
+static int external_sort(struct sort_infos*, const char*, int, int);
 struct couple* insert_string_thai(unichar*, struct couple*,
     struct sort_infos* inf);
 
@@ -224,6 +229,10 @@ const char* usage_SortTxt =
         "  -t/--thai: sorts thai text\n"
         "  -f/--factorize_inflectional_codes: makes two entries XXX,YYY.ZZZ:A and XXX,YYY.ZZZ:B\n"
         "                                   become a single entry XXX,YYY.ZZZ:A:B\n"
+        "  -m N/--max_memory=N: sorts the file with at most about N Mb of memory, using\n"
+        "                       temporary files (not available with --thai)\n"
+        "  --threads=N: with --max_memory, sorts the temporary files with N threads\n"
+        "               (default=1)\n"
         "  -V/--only-verify-arguments: only verify arguments syntax and exit\n"
         "  -h/--help: this help\n"
         "\n"
@@ -284,7 +293,7 @@ int pseudo_main_SortTxt(const VersatileEncodingConfig* vec, int duplicates,
   return ret;
 }
 
-const char* optstring_SortTxt = ":ndr:o:l:tfVhk:q:";
+const char* optstring_SortTxt = ":ndr:o:l:tfm:Vhk:q:#:";
 const struct option_TS lopts_SortTxt[] = {
   { "no_duplicates", no_argument_TS, NULL, 'n' },
   { "duplicates", no_argument_TS, NULL, 'd' },
@@ -293,6 +302,8 @@ const struct option_TS lopts_SortTxt[] = {
   { "line_info", required_argument_TS, NULL, 'l' },
   { "thai", no_argument_TS, NULL, 't' },
   { "factorize_inflectional_codes", no_argument_TS, NULL, 'f' },
+  { "max_memory", required_argument_TS, NULL, 'm' },
+  { "threads", required_argument_TS, NULL, '#' },
   { "input_encoding", required_argument_TS, NULL, 'k' },
   { "output_encoding", required_argument_TS, NULL, 'q' },
   { "only_verify_arguments",no_argument_TS,NULL,'V'},
@@ -311,6 +322,9 @@ int main_SortTxt(int argc, char* const argv[]) {
   }
 
   int mode = DEFAULT;
+  int max_memory = 0;
+  int n_threads = 1;
+  char foo;
   char line_info[FILENAME_MAX] = "";
   char sort_order[FILENAME_MAX] = "";
   VersatileEncodingConfig vec = { DEFAULT_MASK_ENCODING_COMPATIBILITY_INPUT,
@@ -352,6 +366,23 @@ int main_SortTxt(int argc, char* const argv[]) {
     case 'f':
       inf->factorize_inflectional_codes = 1;
       break;
+    case 'm':
+      if (1 != sscanf(options.vars()->optarg, "%d%c", &max_memory, &foo)
+          || max_memory <= 0) {
+        /* foo is used to check that the memory size is not like "45gjh" */
+        error("Invalid memory size argument: %s\n", options.vars()->optarg);
+        free_sort_infos(inf);
+        return USAGE_ERROR_CODE;
+      }
+      break;
+    case '#':
+      if (1 != sscanf(options.vars()->optarg, "%d%c", &n_threads, &foo)
+          || n_threads <= 0) {
+        error("Invalid number of threads: %s\n", options.vars()->optarg);
+        free_sort_infos(inf);
+        return USAGE_ERROR_CODE;
+      }
+      break;
     case 'V': only_verify_arguments = true;
       break;
     case 'h':
@@ -425,14 +456,29 @@ int main_SortTxt(int argc, char* const argv[]) {
     return DEFAULT_ERROR_CODE;
   }
 
+  int ret = SUCCESS_RETURN_CODE;
   switch (mode) {
   case DEFAULT:
-    sort(inf);
+    if (max_memory != 0) {
+      ret = external_sort(inf, new_name, max_memory, n_threads);
+      /* The sort tree is only used by the in-memory sort */
+      free_sort_tree_node(inf->root);
+      inf->root = NULL;
+    } else {
+      sort(inf);
+    }
     break;
   case THAI:
     sort_thai(inf);
     break;
   }
+  if (ret != SUCCESS_RETURN_CODE) {
+    u_fclose(inf->f_out);
+    u_fclose(inf->f);
+    af_remove(new_name);
+    free_sort_infos(inf);
+    return ret;
+  }
   if (line_info[0] != '\0') {
     U_FILE* F = u_fopen(&vec, line_info, U_WRITE);
     if (F == NULL) {
@@ -517,10 +563,26 @@ void sort_thai(struct sort_infos* inf) {
  * Returns 0 if the end of file has been reached; 1 otherwise.
  */
 int read_line(struct sort_infos* inf) {
-  unichar line[LINE_LENGTH];
+  unichar line[LINE_LENGTH + 1];
+  int length;
+  int ret = get_line(inf, line, &length);
+  if (length != 0) {
+    get_node(line, 0, inf->root, inf);
+  }
+  return ret;
+}
+
+/**
+ * Reads a line of the text file into 'line', that must be able to hold
+ * LINE_LENGTH+1 chars. '*length' is set to the length of the line, or to 0
+ * if the line must be ignored because it is empty or too long.
+ * Returns 0 if the end of file has been reached; 1 otherwise.
+ */
+static int get_line(struct sort_infos* inf, unichar* line, int* length) {
   int c;
   int ret = 1;
   int i = 0;
+  *length = 0;
   while ((c = u_fgetc(inf->f)) != '\n' && c != EOF && i < LINE_LENGTH) {
     line[i++] = (unichar) c;
   }
@@ -538,7 +600,7 @@ int read_line(struct sort_infos* inf) {
     error("Line %d: line too long\n", inf->number_of_lines);
     return ret;
   }
-  get_node(line, 0, inf->root, inf);
+  *length = i;
   return ret;
 }
 
@@ -727,13 +789,83 @@ return !u_strcmp(a->inflected,b->inflected)
 }
 
 
+/**
+ * Saves 'n' occurrences of the given line, or factorizes its inflectional
+ * codes with the previous line if needed. '*last' is the DELAF entry of the
+ * previous line, if any, or -1 if no line was printed yet.
+ */
+static void save_sorted_line(unichar* s, int n, struct sort_infos* inf,
+    struct dela_entry** last) {
+  int i;
+  if (inf->factorize_inflectional_codes) {
+    /* We look if the previously printed line, if any, did share
+     * the same information. If so, we just append the new inflectional codes.
+     * Otherwise, we print the new line.
+     *
+     * NOTE: in factorize mode, we always ignore duplicates */
+    int err;
+    struct dela_entry* entry = tokenize_DELAF_line(s,1,&err,0);
+    if (entry==NULL) {
+      /* We have a non DELAF entry line, like for instance a comment one */
+      if (*last!=NULL && *last!=(struct dela_entry*)-1) {
+        /* If there was at least one line already printed, then this line
+         * awaits for its \n */
+        u_fprintf(inf->f_out, "\n");
+      }
+      /* Then we print the line */
+      u_fprintf(inf->f_out, "%S\n",s);
+      /* And we reset *last */
+      if (*last==(struct dela_entry*)-1) {
+        *last=NULL;
+      } else if (*last!=NULL) {
+        free_dela_entry(*last);
+        *last=NULL;
+      }
+    } else {
+      /* So, we have a dic entry. Was there a previous one ? */
+      if (*last==NULL || *last==(struct dela_entry*)-1) {
+        /* No ? So we print the line, and the current entry becomes *last */
+        u_fputs(s, inf->f_out);
+        *last=entry;
+      } else {
+        /* Yes ? We must compare if the codes are compatible */
+        if (are_compatible(*last,entry)) {
+          /* We look for any code of entry if it was already in *last */
+          for (int j=0;j<entry->n_inflectional_codes;j++) {
+            if (!dic_entry_contain_inflectional_code(*last,entry->inflectional_codes[j])) {
+              u_fprintf(inf->f_out, ":%S",entry->inflectional_codes[j]);
+              /* We also have to add the newly printed code to *last */
+              (*last)->inflectional_codes[((*last)->n_inflectional_codes)++]=u_strdup(entry->inflectional_codes[j]);
+            }
+          }
+          /* And we must free entry */
+          free_dela_entry(entry);
+        } else {
+          /* If codes are not compatible, we print the \n for the previous
+           * line, then the current line that becomes *last */
+          u_fprintf(inf->f_out, "\n%S",s);
+          free_dela_entry(*last);
+          *last=entry;
+        }
+      }
+    }
+  } else {
+    /* Normal way: we print each line one after the other */
+    for (i = 0; i < n; i++) {
+      u_fprintf(inf->f_out, "%S\n", s);
+      (inf->resulting_line_number)++;
+    }
+  }
+}
+
+
 /**
  * Explores the node n, dumps the corresponding lines to the output file,
  * and then frees the node. 'pos' is the current position in the string 's'.
  */
 int explore_node(struct sort_tree_node* n, struct sort_infos* inf,
     struct dela_entry* *last) {
-  int i, N;
+  int N;
   struct sort_tree_transition* t = NULL;
   struct couple* couple = NULL;
   struct couple* tmp    = NULL;
@@ -745,65 +877,7 @@ int explore_node(struct sort_tree_node* n, struct sort_infos* inf,
     /* If the node is a final one, we print the corresponding lines */
     couple = n->couples;
     while (couple != NULL) {
-      if (inf->factorize_inflectional_codes) {
-        /* We look if the previously printed line, if any, did share
-         * the same information. If so, we just append the new inflectional codes.
-         * Otherwise, we print the new line.
-         *
-         * NOTE: in factorize mode, we always ignore duplicates */
-        int err;
-        struct dela_entry* entry = tokenize_DELAF_line(couple->s,1,&err,0);
-        if (entry==NULL) {
-          /* We have a non DELAF entry line, like for instance a comment one */
-          if (*last!=NULL && *last!=(struct dela_entry*)-1) {
-            /* If there was at least one line already printed, then this line
-             * awaits for its \n */
-            u_fprintf(inf->f_out, "\n");
-          }
-          /* Then we print the line */
-          u_fprintf(inf->f_out, "%S\n",couple->s);
-          /* And we reset *last */
-          if (*last==(struct dela_entry*)-1) {
-            *last=NULL;
-          } else if (*last!=NULL) {
-            free_dela_entry(*last);
-            *last=NULL;
-          }
-        } else {
-          /* So, we have a dic entry. Was there a previous one ? */
-          if (*last==NULL || *last==(struct dela_entry*)-1) {
-            /* No ? So we print the line, and the current entry becomes *last */
-            u_fputs(couple->s, inf->f_out);
-            *last=entry;
-          } else {
-            /* Yes ? We must compare if the codes are compatible */
-            if (are_compatible(*last,entry)) {
-              /* We look for any code of entry if it was already in *last */
-              for (int j=0;j<entry->n_inflectional_codes;j++) {
-                if (!dic_entry_contain_inflectional_code(*last,entry->inflectional_codes[j])) {
-                  u_fprintf(inf->f_out, ":%S",entry->inflectional_codes[j]);
-                  /* We also have to add the newly printed code to *last */
-                  (*last)->inflectional_codes[((*last)->n_inflectional_codes)++]=u_strdup(entry->inflectional_codes[j]);
-                }
-              }
-              /* And we must free entry */
-              free_dela_entry(entry);
-            } else {
-              /* If codes are not compatible, we print the \n for the previous
-               * line, then the current line that becomes *last */
-              u_fprintf(inf->f_out, "\n%S",couple->s);
-              free_dela_entry(*last);
-              *last=entry;
-            }
-          }
-        }
-      } else {
-        /* Normal way: we print each line one after the other */
-        for (i = 0; i < couple->n; i++) {
-          u_fprintf(inf->f_out, "%S\n", couple->s);
-          (inf->resulting_line_number)++;
-        }
-      }
+      save_sorted_line(couple->s, couple->n, inf, last);
       tmp = couple;
       couple = couple->next;
       free(tmp->s);
@@ -890,6 +964,699 @@ static void quicksort(struct sort_tree_transition** t, int m, int n,
 }
 
 
+/* Maximum number of run files that are merged at the same time */
+#define MAX_MERGED_RUNS 128
+
+/**
+ * This structure represents a batch of lines to be sorted in memory and
+ * saved into a sorted run file. Lines are stored one after the other in
+ * 'text', and 'starts' gives the position of each of them.
+ */
+struct sort_run {
+  struct sort_infos* inf;
+  unichar* text;
+  size_t text_size;
+  size_t text_capacity;
+  size_t* starts;
+  int n_lines;
+  int lines_capacity;
+  /* Maximum number of bytes that this batch may use */
+  size_t budget;
+  char name[FILENAME_MAX];
+  int ok;
+};
+
+/**
+ * This structure is used to read back a sorted run file.
+ */
+struct run_reader {
+  U_FILE* f;
+  unichar* line;
+  int capacity;
+  /* Number of occurrences of the current line */
+  int n;
+};
+
+/**
+ * Compares two lines according to the order produced by the sort tree:
+ * lines are first compared on their char classes, a line being smaller than
+ * all the lines it is a prefix of. Lines with the same char classes are then
+ * compared with strcmp2.
+ */
+static int sort_line_cmp(const unichar* a, const unichar* b,
+    struct sort_infos* inf) {
+  int i;
+  for (i = 0; a[i] != '\0' && b[i] != '\0'; i++) {
+    unichar ca = a[i];
+    unichar cb = b[i];
+    if (inf->class_numbers[ca] != 0) {
+      ca = inf->canonical[ca];
+    }
+    if (inf->class_numbers[cb] != 0) {
+      cb = inf->canonical[cb];
+    }
+    if (ca != cb) {
+      return char_cmp(ca, cb, inf);
+    }
+  }
+  if (a[i] != b[i]) {
+    return (a[i] == '\0') ? -1 : 1;
+  }
+  return inf->REVERSE * strcmp2((unichar*) a, (unichar*) b, inf);
+}
+
+/**
+ * Merge sorts the given array of lines, using 'tmp' as work array.
+ */
+static void sort_lines(unichar** lines, unichar** tmp, int n,
+    struct sort_infos* inf) {
+  if (n < 2) {
+    return;
+  }
+  int middle = n / 2;
+  sort_lines(lines, tmp, middle, inf);
+  sort_lines(lines + middle, tmp, n - middle, inf);
+  if (sort_line_cmp(lines[middle - 1], lines[middle], inf) <= 0) {
+    /* Already in order */
+    return;
+  }
+  int i = 0, j = middle, k = 0;
+  while (i < middle && j < n) {
+    if (sort_line_cmp(lines[j], lines[i], inf) < 0) {
+      tmp[k++] = lines[j++];
+    } else {
+      tmp[k++] = lines[i++];
+    }
+  }
+  while (i < middle) {
+    tmp[k++] = lines[i++];
+  }
+  while (j < n) {
+    tmp[k++] = lines[j++];
+  }
+  memcpy(lines, tmp, n * sizeof(unichar*));
+}
+
+/**
+ * Writes a line with its number of occurrences into a run file.
+ */
+static void write_run_line(U_FILE* f, const unichar* s, int length, int n) {
+  fwrite(&n, sizeof(int), 1, f);
+  fwrite(&length, sizeof(int), 1, f);
+  fwrite(s, sizeof(unichar), length, f);
+}
+
+/**
+ * Reads the next line of the given run file. Returns 0 at the end of the file.
+ */
+static int read_run_line(struct run_reader* r) {
+  int length;
+  if (fread(&(r->n), sizeof(int), 1, r->f) != 1
+      || fread(&length, sizeof(int), 1, r->f) != 1) {
+    return 0;
+  }
+  if (length >= r->capacity) {
+    r->capacity = length + 1;
+    r->line = (unichar*) realloc(r->line, r->capacity * sizeof(unichar));
+    if (r->line == NULL) {
+      fatal_alloc_error("read_run_line");
+    }
+  }
+  if ((int) fread(r->line, sizeof(unichar), length, r->f) != length) {
+    return 0;
+  }
+  r->line[length] = '\0';
+  return 1;
+}
+
+/**
+ * Returns the number of bytes used by the given batch if we add it a line
+ * of the given length.
+ */
+static size_t sort_run_size(struct sort_run* run, int length) {
+  /* For each line, we count its start, and the two pointers used to sort it */
+  return (run->text_size + length + 1) * sizeof(unichar)
+      + (run->n_lines + 1) * (sizeof(size_t) + 2 * sizeof(unichar*));
+}
+
+/**
+ * Adds the given line to the batch. Returns 0 if the batch is full.
+ */
+static int add_sort_run_line(struct sort_run* run, const unichar* line,
+    int length) {
+  if (run->n_lines != 0 && sort_run_size(run, length) > run->budget) {
+    return 0;
+  }
+  if (run->text_size + length + 1 > run->text_capacity) {
+    size_t capacity = 2 * run->text_capacity;
+    size_t max = run->budget / sizeof(unichar);
+    if (capacity > max) {
+      capacity = max;
+    }
+    if (capacity < run->text_size + length + 1) {
+      capacity = run->text_size + length + 1;
+    }
+    run->text = (unichar*) realloc(run->text, capacity * sizeof(unichar));
+    if (run->text == NULL) {
+      fatal_alloc_error("add_sort_run_line");
+    }
+    run->text_capacity = capacity;
+  }
+  if (run->n_lines == run->lines_capacity) {
+    run->lines_capacity = 2 * run->lines_capacity;
+    run->starts = (size_t*) realloc(run->starts,
+        run->lines_capacity * sizeof(size_t));
+    if (run->starts == NULL) {
+      fatal_alloc_error("add_sort_run_line");
+    }
+  }
+  run->starts[(run->n_lines)++] = run->text_size;
+  memcpy(run->text + run->text_size, line, (length + 1) * sizeof(unichar));
+  run->text_size = run->text_size + length + 1;
+  return 1;
+}
+
+/**
+ * Sorts the lines of the given batch and saves them into its run file.
+ * Duplicates are merged into a single line with its number of occurrences.
+ */
+static void ABSTRACT_CALLBACK_UNITEX sort_run_thread(void* private_ptr,
+    unsigned int /* num_worker */) {
+  struct sort_run* run = (struct sort_run*) private_ptr;
+  struct sort_infos* inf = run->inf;
+  int n = run->n_lines;
+  unichar** lines = (unichar**) malloc(2 * n * sizeof(unichar*));
+  if (lines == NULL) {
+    fatal_alloc_error("sort_run_thread");
+  }
+  for (int i = 0; i < n; i++) {
+    lines[i] = run->text + run->starts[i];
+  }
+  sort_lines(lines, lines + n, n, inf);
+  U_FILE* f = u_fopen(BINARY, run->name, U_WRITE);
+  if (f == NULL) {
+    run->ok = 0;
+    free(lines);
+    return;
+  }
+  int i = 0;
+  while (i < n) {
+    int occurrences = 1;
+    int j = i + 1;
+    while (j < n && !u_strcmp(lines[i], lines[j])) {
+      occurrences++;
+      j++;
+    }
+    if (inf->REMOVE_DUPLICATES) {
+      occurrences = 1;
+    }
+    write_run_line(f, lines[i], u_strlen(lines[i]), occurrences);
+    i = j;
+  }
+  u_fclose(f);
+  free(lines);
+  run->ok = 1;
+}
+
+/**
+ * Moves down the reader at position 'i' of the given heap.
+ */
+static void sift_run_reader(struct run_reader** heap, int size, int i,
+    struct sort_infos* inf) {
+  for (;;) {
+    int min = i;
+    int left = 2 * i + 1;
+    int right = left + 1;
+    if (left < size && sort_line_cmp(heap[left]->line, heap[min]->line, inf) < 0) {
+      min = left;
+    }
+    if (right < size && sort_line_cmp(heap[right]->line, heap[min]->line, inf) < 0) {
+      min = right;
+    }
+    if (min == i) {
+      return;
+    }
+    struct run_reader* tmp = heap[i];
+    heap[i] = heap[min];
+    heap[min] = tmp;
+    i = min;
+  }
+}
+
+/**
+ * Merges the given run files. If 'f_run' is not NULL, the result is saved
+ * into it as a new run; otherwise, the lines are saved into the output file.
+ * The merged run files are removed. Returns 0 if a run file cannot be read.
+ */
+static int merge_runs(char** names, int n_runs, U_FILE* f_run,
+    struct sort_infos* inf, struct dela_entry** last) {
+  if (n_runs == 0) {
+    /* Empty input: there is nothing to merge */
+    return 1;
+  }
+  struct run_reader* readers = (struct run_reader*) malloc(
+      n_runs * sizeof(struct run_reader));
+  struct run_reader** heap = (struct run_reader**) malloc(
+      n_runs * sizeof(struct run_reader*));
+  if (readers == NULL || heap == NULL) {
+    fatal_alloc_error("merge_runs");
+  }
+  int size = 0;
+  int ok = 1;
+  for (int i = 0; i < n_runs; i++) {
+    readers[i].line = NULL;
+    readers[i].capacity = 0;
+    readers[i].f = u_fopen(BINARY, names[i], U_READ);
+    if (readers[i].f == NULL) {
+      error("Cannot read temporary file %s\n", names[i]);
+      ok = 0;
+      continue;
+    }
+    if (read_run_line(&(readers[i]))) {
+      heap[size++] = &(readers[i]);
+    }
+  }
+  for (int i = size / 2 - 1; i >= 0; i--) {
+    sift_run_reader(heap, size, i, inf);
+  }
+  unichar* current = NULL;
+  int current_capacity = 0;
+  int current_n = 0;
+  while (size != 0) {
+    struct run_reader* r = heap[0];
+    if (current_n != 0 && !u_strcmp(current, r->line)) {
+      /* A duplicate coming from another run */
+      if (!inf->REMOVE_DUPLICATES) {
+        current_n = current_n + r->n;
+      }
+    } else {
+      if (current_n != 0) {
+        if (f_run != NULL) {
+          write_run_line(f_run, current, u_strlen(current), current_n);
+        } else {
+          save_sorted_line(current, current_n, inf, last);
+        }
+      }
+      int length = u_strlen(r->line);
+      if (length >= current_capacity) {
+        current_capacity = length + 1;
+        current = (unichar*) realloc(current, current_capacity * sizeof(unichar));
+        if (current == NULL) {
+          fatal_alloc_error("merge_runs");
+        }
+      }
+      u_strcpy(current, r->line);
+      current_n = r->n;
+    }
+    if (!read_run_line(r)) {
+      heap[0] = heap[--size];
+    }
+    sift_run_reader(heap, size, 0, inf);
+  }
+  if (current_n != 0) {
+    if (f_run != NULL) {
+      write_run_line(f_run, current, u_strlen(current), current_n);
+    } else {
+      save_sorted_line(current, current_n, inf, last);
+    }
+  }
+  free(current);
+  for (int i = 0; i < n_runs; i++) {
+    if (readers[i].f != NULL) {
+      u_fclose(readers[i].f);
+      af_remove(names[i]);
+    }
+    free(readers[i].line);
+  }
+  free(readers);
+  free(heap);
+  return ok;
+}
+
+/**
+ * Frees the names of the given run files, removing the files that still
+ * exist.
+ */
+static void free_run_names(char** names, int n_runs) {
+  for (int i = 0; i < n_runs; i++) {
+    if (fexists(names[i])) {
+      af_remove(names[i]);
+    }
+    free(names[i]);
+  }
+  free(names);
+}
+
+/**
+ * Sorts the text file without loading it fully in memory: the lines are read
+ * by batches of at most 'max_memory' bytes, each batch is sorted and saved
+ * into a temporary run file, and then all the run files are merged. Batches
+ * are sorted in parallel by 'n_threads' threads. Temporary files are named
+ * from 'name'. Returns 0 on success, or an error code.
+ */
+static int external_sort(struct sort_infos* inf, const char* name,
+    int max_memory, int n_threads) {
+  size_t budget = (size_t) max_memory * 1024 * 1024 / n_threads;
+  if (budget < LINE_LENGTH * sizeof(unichar)) {
+    budget = LINE_LENGTH * sizeof(unichar);
+  }
+  struct sort_run* runs = (struct sort_run*) malloc(
+      n_threads * sizeof(struct sort_run));
+  void** ptrs = (void**) malloc(n_threads * sizeof(void*));
+  if (runs == NULL || ptrs == NULL) {
+    fatal_alloc_error("external_sort");
+  }
+  for (int i = 0; i < n_threads; i++) {
+    runs[i].inf = inf;
+    runs[i].text_capacity = 4096;
+    runs[i].text = (unichar*) malloc(runs[i].text_capacity * sizeof(unichar));
+    runs[i].lines_capacity = 256;
+    runs[i].starts = (size_t*) malloc(runs[i].lines_capacity * sizeof(size_t));
+    if (runs[i].text == NULL || runs[i].starts == NULL) {
+      fatal_alloc_error("external_sort");
+    }
+    runs[i].budget = budget;
+    ptrs[i] = &(runs[i]);
+  }
+  int n_runs = 0;
+  int runs_capacity = 16;
+  char** names = (char**) malloc(runs_capacity * sizeof(char*));
+  if (names == NULL) {
+    fatal_alloc_error("external_sort");
+  }
+  int ret = SUCCESS_RETURN_CODE;
+  unichar line[LINE_LENGTH + 1];
+  /* 'length' is the length of the line that is waiting to be added to a
+   * batch, if any */
+  int length = 0;
+  int go_on = 1;
+  u_printf("Loading text...\n");
+  while (go_on || length != 0) {
+    /* We fill up to one batch per thread */
+    int n_batches = 0;
+    while ((go_on || length != 0) && n_batches < n_threads) {
+      struct sort_run* run = &(runs[n_batches]);
+      run->text_size = 0;
+      run->n_lines = 0;
+      for (;;) {
+        if (length == 0) {
+          if (!go_on) {
+            break;
+          }
+          go_on = get_line(inf, line, &length);
+          continue;
+        }
+        if (!add_sort_run_line(run, line, length)) {
+          /* The batch is full */
+          break;
+        }
+        length = 0;
+      }
+      if (run->n_lines != 0) {
+        if (n_runs == runs_capacity) {
+          runs_capacity = 2 * runs_capacity;
+          names = (char**) realloc(names, runs_capacity * sizeof(char*));
+          if (names == NULL) {
+            fatal_alloc_error("external_sort");
+          }
+        }
+        sprintf(run->name, "%s.%d.run", name, n_runs);
+        names[n_runs++] = strdup(run->name);
+        n_batches++;
+      }
+    }
+    if (n_batches == 1) {
+      sort_run_thread(ptrs[0], 0);
+    } else if (n_batches > 1) {
+      SyncRunWorkerThreads((unsigned int) n_batches, sort_run_thread, ptrs);
+    }
+    for (int i = 0; i < n_batches; i++) {
+      if (!runs[i].ok) {
+        error("Cannot create temporary file %s\n", runs[i].name);
+        ret = DEFAULT_ERROR_CODE;
+        go_on = 0;
+        length = 0;
+      }
+    }
+  }
+  for (int i = 0; i < n_threads; i++) {
+    free(runs[i].text);
+    free(runs[i].starts);
+  }
+  free(runs);
+  free(ptrs);
+  u_printf("%d lines read\n", inf->number_of_lines);
+  if (ret != SUCCESS_RETURN_CODE) {
+    free_run_names(names, n_runs);
+    return ret;
+  }
+  u_printf("Sorting and saving...\n");
+  /* If there are too many runs, we merge them by groups until we can
+   * merge all of them at once */
+  int first = 0;
+  while (n_runs - first > MAX_MERGED_RUNS) {
+    if (n_runs == runs_capacity) {
+      runs_capacity = 2 * runs_capacity;
+      names = (char**) realloc(names, runs_capacity * sizeof(char*));
+      if (names == NULL) {
+        fatal_alloc_error("external_sort");
+      }
+    }
+    char merged[FILENAME_MAX];
+    sprintf(merged, "%s.%d.run", name, n_runs);
+    U_FILE* f = u_fopen(BINARY, merged, U_WRITE);
+    if (f == NULL) {
+      error("Cannot create temporary file %s\n", merged);
+      free_run_names(names, n_runs);
+      return DEFAULT_ERROR_CODE;
+    }
+    names[n_runs++] = strdup(merged);
+    int ok = merge_runs(names + first, MAX_MERGED_RUNS, f, inf, NULL);
+    u_fclose(f);
+    first = first + MAX_MERGED_RUNS;
+    if (!ok) {
+      free_run_names(names, n_runs);
+      return DEFAULT_ERROR_CODE;
+    }
+  }
+  /* -1 means that no line at all was already printed */
+  struct dela_entry* last = (struct dela_entry*) -1;
+  if (!merge_runs(names + first, n_runs - first, NULL, inf, &last)) {
+    ret = DEFAULT_ERROR_CODE;
+  }
+  if (last != NULL && last != (struct dela_entry*) -1) {
+    u_fprintf(inf->f_out, "\n");
+    free_dela_entry(last);
+  }
+  free_run_names(names, n_runs);
+  return ret;
+}
+
+
+/* Number of chars whose weights are stored in the key of a sort record, and
+ * number of bits used for each of them */
+#define SORT_KEY_CHARS 3
+#define SORT_KEY_BITS 18
+
+/**
+ * This structure represents a line to be sorted in memory. 'key' contains
+ * the weights of the first chars of the line, so that most comparisons can
+ * be done without looking at the line itself.
+ */
+struct sort_record {
+  uint64_t key;
+  unichar* s;
+};
+
+/**
+ * This structure is used to sort or merge a part of an array of sort records
+ * in a worker thread. If 'middle' is -1, the 'n' records are sorted;
+ * otherwise, the already sorted parts [0,middle[ and [middle,n[ are merged.
+ */
+struct sort_record_job {
+  struct sort_infos* inf;
+  struct sort_record* records;
+  struct sort_record* tmp;
+  int n;
+  int middle;
+};
+
+/**
+ * Returns the key of the given line. The weight of a char is the same as
+ * the one used to compare sort tree transitions: unclassed chars are sorted
+ * by code, and come before classed chars, sorted by class number.
+ */
+static uint64_t get_sort_key(const unichar* s, struct sort_infos* inf) {
+  uint64_t key = 0;
+  for (int i = 0; i < SORT_KEY_CHARS; i++) {
+    uint64_t weight = 0;
+    if (*s != '\0') {
+      weight = inf->class_numbers[*s] ? (uint64_t) (0x10000 + inf->class_numbers[*s]) : *s;
+      s++;
+    }
+    key = (key << SORT_KEY_BITS) | weight;
+  }
+  return key;
+}
+
+static int sort_record_cmp(const struct sort_record* a,
+    const struct sort_record* b, struct sort_infos* inf) {
+  if (a->key != b->key) {
+    return (a->key < b->key) ? -1 : 1;
+  }
+  return sort_line_cmp(a->s, b->s, inf);
+}
+
+/**
+ * Merges the sorted parts [0,middle[ and [middle,n[ of the given records,
+ * using 'tmp' as work array.
+ */
+static void merge_sort_records(struct sort_record* records,
+    struct sort_record* tmp, int middle, int n, struct sort_infos* inf) {
+  if (middle == 0 || middle == n
+      || sort_record_cmp(&(records[middle - 1]), &(records[middle]), inf) <= 0) {
+    /* Already in order */
+    return;
+  }
+  int i = 0, j = middle, k = 0;
+  while (i < middle && j < n) {
+    if (sort_record_cmp(&(records[j]), &(records[i]), inf) < 0) {
+      tmp[k++] = records[j++];
+    } else {
+      tmp[k++] = records[i++];
+    }
+  }
+  while (i < middle) {
+    tmp[k++] = records[i++];
+  }
+  while (j < n) {
+    tmp[k++] = records[j++];
+  }
+  memcpy(records, tmp, n * sizeof(struct sort_record));
+}
+
+/**
+ * Merge sorts the given records, using 'tmp' as work array.
+ */
+static void sort_records(struct sort_record* records, struct sort_record* tmp,
+    int n, struct sort_infos* inf) {
+  if (n < 2) {
+    return;
+  }
+  int middle = n / 2;
+  sort_records(records, tmp, middle, inf);
+  sort_records(records + middle, tmp, n - middle, inf);
+  merge_sort_records(records, tmp, middle, n, inf);
+}
+
+static void ABSTRACT_CALLBACK_UNITEX sort_record_thread(void* private_ptr,
+    unsigned int /* num_worker */) {
+  struct sort_record_job* job = (struct sort_record_job*) private_ptr;
+  if (job->middle == -1) {
+    sort_records(job->records, job->tmp, job->n, job->inf);
+  } else {
+    merge_sort_records(job->records, job->tmp, job->middle, job->n, job->inf);
+  }
+}
+
+/**
+ * Sorts the given lines in memory, in the same order as SortTxt does with
+ * the given char order file, if any. The array is split into 'n_threads'
+ * parts that are sorted in parallel, and then merged two by two. If
+ * 'remove_duplicates' is not null, duplicate lines are freed. Returns the
+ * number of lines that remain in the array.
+ *
+ * NOTE: the Thai mode and the reverse order are not supported.
+ */
+int sort_lines_in_memory(const VersatileEncodingConfig* vec,
+    const char* sort_alphabet, unichar** lines, int n, int remove_duplicates,
+    int n_threads) {
+  if (n < 2) {
+    return n;
+  }
+  struct sort_infos* inf = new_sort_infos();
+  if (inf == NULL) {
+    fatal_alloc_error("sort_lines_in_memory");
+  }
+  if (sort_alphabet != NULL && sort_alphabet[0] != '\0') {
+    read_char_order(vec, sort_alphabet, inf);
+  }
+  struct sort_record* records = (struct sort_record*) malloc(
+      2 * n * sizeof(struct sort_record));
+  if (records == NULL) {
+    fatal_alloc_error("sort_lines_in_memory");
+  }
+  struct sort_record* tmp = records + n;
+  for (int i = 0; i < n; i++) {
+    records[i].key = get_sort_key(lines[i], inf);
+    records[i].s = lines[i];
+  }
+  if (n_threads > n) {
+    n_threads = n;
+  }
+  if (n_threads <= 1) {
+    sort_records(records, tmp, n, inf);
+  } else {
+    /* We sort n_threads parts, and then we merge them two by two */
+    struct sort_record_job* jobs = (struct sort_record_job*) malloc(
+        n_threads * sizeof(struct sort_record_job));
+    void** ptrs = (void**) malloc(n_threads * sizeof(void*));
+    int* starts = (int*) malloc((n_threads + 1) * sizeof(int));
+    if (jobs == NULL || ptrs == NULL || starts == NULL) {
+      fatal_alloc_error("sort_lines_in_memory");
+    }
+    int n_parts = n_threads;
+    for (int i = 0; i <= n_parts; i++) {
+      starts[i] = (int) (((long long) n * i) / n_parts);
+    }
+    for (int i = 0; i < n_parts; i++) {
+      jobs[i].inf = inf;
+      jobs[i].records = records + starts[i];
+      jobs[i].tmp = tmp + starts[i];
+      jobs[i].n = starts[i + 1] - starts[i];
+      jobs[i].middle = -1;
+      ptrs[i] = &(jobs[i]);
+    }
+    SyncRunWorkerThreads((unsigned int) n_parts, sort_record_thread, ptrs);
+    while (n_parts > 1) {
+      int n_jobs = n_parts / 2;
+      for (int i = 0; i < n_jobs; i++) {
+        int start = starts[2 * i];
+        jobs[i].records = records + start;
+        jobs[i].tmp = tmp + start;
+        jobs[i].middle = starts[2 * i + 1] - start;
+        jobs[i].n = starts[2 * i + 2] - start;
+      }
+      SyncRunWorkerThreads((unsigned int) n_jobs, sort_record_thread, ptrs);
+      /* We update the part boundaries */
+      int k = 0;
+      for (int i = 0; i <= n_parts; i = i + 2) {
+        starts[k++] = starts[i];
+      }
+      if (n_parts % 2 == 1) {
+        starts[k++] = starts[n_parts];
+      }
+      n_parts = k - 1;
+    }
+    free(jobs);
+    free(ptrs);
+    free(starts);
+  }
+  int k = 0;
+  for (int i = 0; i < n; i++) {
+    if (remove_duplicates && k != 0 && !u_strcmp(lines[k - 1], records[i].s)) {
+      free(records[i].s);
+      continue;
+    }
+    lines[k++] = records[i].s;
+  }
+  free(records);
+  free_sort_tree_node(inf->root);
+  free_sort_infos(inf);
+  return k;
+}
+
+
 /**
  * Converts the string 'src' into a string with no diacritic sign and
  * in which initial vowels and following consons have been swapped.
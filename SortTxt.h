@@ -22,6 +22,7 @@
 #ifndef SortTxtH
 #define SortTxtH
 
+#include "Unicode.h"
 #include "UnitexGetOpt.h"
 #include "FileEncoding.h"
 
@@ -38,6 +39,8 @@ extern const char* usage_SortTxt;
 int main_SortTxt(int argc,char* const argv[]);
 int pseudo_main_SortTxt(const VersatileEncodingConfig*,
                         int duplicates,int reverse,char* sort_alphabet,char* line_info,int thai,char*,int);
+int sort_lines_in_memory(const VersatileEncodingConfig*,const char* sort_alphabet,
+                         unichar** lines,int n,int remove_duplicates,int n_threads);
 
 } // namespace unitex
 
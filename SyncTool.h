@@ -66,6 +66,20 @@ UNITEX_FUNC void UNITEX_CALL SyncReleaseMutex(SYNC_Mutex_OBJECT pMut);
 UNITEX_FUNC void UNITEX_CALL SyncDeleteMutex(SYNC_Mutex_OBJECT pMut);
 
 
+/*
+ * Worker threads, used by the tools that can split their work (Locate --threads, ...)
+ * SyncRunWorkerThreads starts iNbThread threads, calls worker_func(privateDataPtrArray[i],i)
+ * in each of them and returns when all of them are finished.
+ * When threads are not available (SyncIsWorkerThreadAvailable() returns 0), the
+ * workers are just called one after the other in the current thread.
+ */
+#define SYNC_CALLBACK_WORKER ABSTRACT_CALLBACK_UNITEX
+typedef void (SYNC_CALLBACK_WORKER* t_sync_worker_func)(void* privateDataPtr,unsigned int iNumWorker);
+
+UNITEX_FUNC int UNITEX_CALL SyncIsWorkerThreadAvailable();
+UNITEX_FUNC void UNITEX_CALL SyncRunWorkerThreads(unsigned int iNbThread,t_sync_worker_func worker_func,void** privateDataPtrArray);
+
+
 
 
 #ifdef __cplusplus
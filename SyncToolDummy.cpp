@@ -123,6 +123,23 @@ UNITEX_FUNC void UNITEX_CALL SyncDeleteMutex(SYNC_Mutex_OBJECT pMut)
 }
 
 
+/*
+Without thread support, the workers are called one after the other
+*/
+
+UNITEX_FUNC int UNITEX_CALL SyncIsWorkerThreadAvailable()
+{
+    return 0;
+}
+
+UNITEX_FUNC void UNITEX_CALL SyncRunWorkerThreads(unsigned int iNbThread,t_sync_worker_func worker_func,void** privateDataPtrArray)
+{
+    unsigned int i;
+    for (i=0;i<iNbThread;i++)
+        (*worker_func)(*(privateDataPtrArray+i),i);
+}
+
+
 
 
 
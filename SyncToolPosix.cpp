@@ -140,5 +140,73 @@ UNITEX_FUNC void UNITEX_CALL SyncDeleteMutex(SYNC_Mutex_OBJECT pMut)
 }
 
 
+/*
+Worker threads implementation for Posix API
+*/
+
+typedef struct
+{
+    t_sync_worker_func worker_func;
+    void* privateDataPtr;
+    unsigned int iNumWorker;
+} SYNC_WORKER_INFO;
+
+
+static void* SyncWorkerFuncPosix(void* pv)
+{
+    SYNC_WORKER_INFO* pwi = (SYNC_WORKER_INFO*)pv;
+    (*(pwi->worker_func))(pwi->privateDataPtr,pwi->iNumWorker);
+    return NULL;
+}
+
+
+UNITEX_FUNC int UNITEX_CALL SyncIsWorkerThreadAvailable()
+{
+    return 1;
+}
+
+
+UNITEX_FUNC void UNITEX_CALL SyncRunWorkerThreads(unsigned int iNbThread,t_sync_worker_func worker_func,void** privateDataPtrArray)
+{
+    unsigned int i;
+    if (iNbThread == 0)
+        return;
+    pthread_t* pTid = (pthread_t*)malloc(sizeof(pthread_t)*iNbThread);
+    int* pStarted = (int*)malloc(sizeof(int)*iNbThread);
+    SYNC_WORKER_INFO* pWorkerInfoArray = (SYNC_WORKER_INFO*)malloc(sizeof(SYNC_WORKER_INFO)*iNbThread);
+    if ((pTid == NULL) || (pStarted == NULL) || (pWorkerInfoArray == NULL))
+    {
+        free(pTid);
+        free(pStarted);
+        free(pWorkerInfoArray);
+        /* we cannot create threads, so we do the job here */
+        for (i=0;i<iNbThread;i++)
+            (*worker_func)(*(privateDataPtrArray+i),i);
+        return;
+    }
+
+    for (i=0;i<iNbThread;i++)
+    {
+        (pWorkerInfoArray+i)->worker_func = worker_func;
+        (pWorkerInfoArray+i)->privateDataPtr = *(privateDataPtrArray+i);
+        (pWorkerInfoArray+i)->iNumWorker = i;
+        *(pStarted+i) = (pthread_create(pTid+i,NULL,SyncWorkerFuncPosix,(pWorkerInfoArray+i)) == 0);
+        if (!(*(pStarted+i)))
+        {
+            /* if the thread cannot be created, the worker runs in the current thread */
+            SyncWorkerFuncPosix(pWorkerInfoArray+i);
+        }
+    }
+
+    for (i=0;i<iNbThread;i++)
+        if (*(pStarted+i))
+            pthread_join(*(pTid+i),NULL);
+
+    free(pWorkerInfoArray);
+    free(pStarted);
+    free(pTid);
+}
+
+
 
 } // namespace unitex
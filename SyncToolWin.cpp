@@ -191,6 +191,91 @@ UNITEX_FUNC void UNITEX_CALL SyncDeleteMutex(SYNC_Mutex_OBJECT pMut)
 
 
 
+
+/* Worker threads implementation for Win32 API */
+
+#ifdef UNITEX_USING_WINRT_API
+
+UNITEX_FUNC int UNITEX_CALL SyncIsWorkerThreadAvailable()
+{
+    return 0;
+}
+
+UNITEX_FUNC void UNITEX_CALL SyncRunWorkerThreads(unsigned int iNbThread,t_sync_worker_func worker_func,void** privateDataPtrArray)
+{
+    unsigned int i;
+    for (i=0;i<iNbThread;i++)
+        (*worker_func)(*(privateDataPtrArray+i),i);
+}
+
+#else
+
+typedef struct
+{
+    t_sync_worker_func worker_func;
+    void* privateDataPtr;
+    unsigned int iNumWorker;
+} SYNC_WORKER_INFO;
+
+
+static DWORD WINAPI SyncWorkerFuncWin(LPVOID pv)
+{
+    SYNC_WORKER_INFO* pwi = (SYNC_WORKER_INFO*)pv;
+    (*(pwi->worker_func))(pwi->privateDataPtr,pwi->iNumWorker);
+    return 0;
+}
+
+
+UNITEX_FUNC int UNITEX_CALL SyncIsWorkerThreadAvailable()
+{
+    return 1;
+}
+
+
+UNITEX_FUNC void UNITEX_CALL SyncRunWorkerThreads(unsigned int iNbThread,t_sync_worker_func worker_func,void** privateDataPtrArray)
+{
+    unsigned int i;
+    if (iNbThread == 0)
+        return;
+    HANDLE* pHandle = (HANDLE*)malloc(sizeof(HANDLE)*iNbThread);
+    SYNC_WORKER_INFO* pWorkerInfoArray = (SYNC_WORKER_INFO*)malloc(sizeof(SYNC_WORKER_INFO)*iNbThread);
+    if ((pHandle == NULL) || (pWorkerInfoArray == NULL))
+    {
+        free(pHandle);
+        free(pWorkerInfoArray);
+        /* we cannot create threads, so we do the job here */
+        for (i=0;i<iNbThread;i++)
+            (*worker_func)(*(privateDataPtrArray+i),i);
+        return;
+    }
+
+    for (i=0;i<iNbThread;i++)
+    {
+        DWORD dwThreadId;
+        (pWorkerInfoArray+i)->worker_func = worker_func;
+        (pWorkerInfoArray+i)->privateDataPtr = *(privateDataPtrArray+i);
+        (pWorkerInfoArray+i)->iNumWorker = i;
+        *(pHandle+i) = CreateThread(NULL,0,SyncWorkerFuncWin,(pWorkerInfoArray+i),0,&dwThreadId);
+        if (*(pHandle+i) == NULL)
+        {
+            /* if the thread cannot be created, the worker runs in the current thread */
+            SyncWorkerFuncWin(pWorkerInfoArray+i);
+        }
+    }
+
+    for (i=0;i<iNbThread;i++)
+        if (*(pHandle+i) != NULL)
+        {
+            WaitForSingleObject(*(pHandle+i),INFINITE);
+            CloseHandle(*(pHandle+i));
+        }
+
+    free(pWorkerInfoArray);
+    free(pHandle);
+}
+
+#endif
+
 #endif
 
 } // namespace unitex
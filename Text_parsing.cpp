@@ -32,6 +32,7 @@
 #include "File.h"
 #include "MappedFileHelper.h"
 #include "DebugMode.h"
+#include "SyncTool.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -83,185 +84,226 @@ static long CalcPerfHalfHundred(long text_size, long matching_units) {
 }
 
 /**
- * Performs the Locate operation on the text, saving the occurrences
- * on the fly.
+ * When Locate works with several threads, each worker explores a chunk of
+ * the text. Instead of being added to the global match list, the matches
+ * found from each origin are recorded in the chunk, in the order they were
+ * produced. They are replayed later in text order by the main thread, so
+ * that match selection and concord.ind are exactly the same as with a
+ * single thread.
  */
-void launch_locate(U_FILE* out, long int text_size, U_FILE* info,
-        struct locate_parameters* p) {
-    p->token_error_ctx.n_errors = 0;
-    p->token_error_ctx.last_start = -1;
-    p->token_error_ctx.last_length = 0;
-    p->token_error_ctx.n_matches_at_token_pos__locate = 0;
-    p->token_error_ctx.n_matches_at_token_pos__morphological_locate = 0;
+struct locate_chunk {
+   /* The chunk covers the origins [start;end[ */
+   int start;
+   int end;
+   /* The matches produced by the worker */
+   struct match_list* first;
+   struct match_list* last;
+   /* Pairs (origin,number of matches found from this origin) */
+   vector_int* origins;
+   unsigned long count_step;
+};
 
 
-    p->is_in_trace_state = 0;
-    if ((p->fnc_locate_trace_step != NULL))
-        p->is_in_trace_state = 1;
+/**
+ * Stores a copy of the given match in the given chunk.
+ */
+static void record_chunk_match(struct locate_chunk* c, struct match_list* m, int origin) {
+    /* The copy is allocated with the standard allocator, because it
+     * will be freed by the main thread */
+    struct match_list* copy = new_match(m->m.start_pos_in_token, m->m.end_pos_in_token,
+            m->output, m->weight, NULL, STANDARD_ALLOCATOR);
+    if (c->first == NULL) {
+        c->first = c->last = copy;
+    } else {
+        c->last->next = copy;
+        c->last = copy;
+    }
+    int n = c->origins->nbelems;
+    if (n != 0 && c->origins->tab[n - 2] == origin) {
+        (c->origins->tab[n - 1])++;
+    } else {
+        vector_int_add(c->origins, origin);
+        vector_int_add(c->origins, 1);
+    }
+}
 
-    //fill_buffer(p->token_buffer, f);
-    OptimizedFst2State initial_state =
-            p->optimized_states[p->fst2->initial_states[1]];
-    p->current_origin = 0;
-    int n_read = 0;
-    int unite;
-    clock_t startTime = clock();
-    clock_t currentTime;
-    unsigned long total_count_step = 0;
 
-    unite = (int)(((text_size / 100) > 1000) ? (text_size / 100) : 1000);
-    variable_backup_memory_reserve* backup_reserve =
-            create_variable_backup_memory_reserve(p->input_variables,1);
-    p->backup_memory_reserve = backup_reserve;
-    int current_token;
-    while (p->current_origin < p->buffer_size &&
-            p->buffer[p->current_origin] < p->tokens->size &&
-            p->number_of_matches != p->search_limit) {
-        if (unite != 0) {
-            n_read = p->current_origin % unite;
-            if (n_read == 0 && ((currentTime = clock()) - startTime > DELAY)) {
-                startTime = currentTime;
-                u_printf("%2.2f%% done        \r", 100.0
-                        * (float) (p->current_origin)
-                        / (float) text_size);
-            }
-        }
-        current_token = p->buffer[p->current_origin];
-        if (!(current_token == p->SPACE && p->space_policy
-                == DONT_START_WITH_SPACE) && !get_value(p->failfast,
-                current_token)) {
-
-            int cache_found = 0;
-            if (p->useLocateCache)
-                cache_found =  consult_cache(p->buffer, p->current_origin,
-                    p->buffer_size, p->match_cache,
-                    p->cached_match_vector);
-            if (cache_found) {
-                /* If we have found matches in the cache, we use them */
-                for (int i=0;i<p->cached_match_vector->nbelems;i++) {
-                    struct match_list* tmp=(struct match_list*)(p->cached_match_vector->tab[i]);
-                    while (tmp!=NULL) {
-                        /* We have to adjust the match coordinates */
-                        int size=tmp->m.end_pos_in_token-tmp->m.start_pos_in_token;
-                        tmp->m.start_pos_in_token=p->current_origin;
-                        tmp->m.end_pos_in_token=tmp->m.start_pos_in_token+size;
-                        real_add_match(tmp,p,p->al.prv_alloc_generic);
-                        tmp=tmp->next;
-                    }
+/**
+ * Adds a match found from the current origin either to the match list or,
+ * if we are in a worker thread, to the current chunk.
+ */
+static inline void add_match_from_current_origin(struct match_list* m, struct locate_parameters* p) {
+    if (p->chunk == NULL) {
+        real_add_match(m, p, p->al.prv_alloc_generic);
+    } else {
+        record_chunk_match(p->chunk, m, p->current_origin);
+    }
+}
+
+
+/**
+ * Explores the grammar from p->current_origin, using the cache if possible.
+ */
+static void locate_from_current_origin(OptimizedFst2State initial_state,
+        struct locate_parameters* p, unsigned long* total_count_step) {
+    int current_token = p->buffer[p->current_origin];
+    if (!(current_token == p->SPACE && p->space_policy
+            == DONT_START_WITH_SPACE) && !get_value(p->failfast,
+            current_token)) {
+
+        int cache_found = 0;
+        if (p->useLocateCache)
+            cache_found =  consult_cache(p->buffer, p->current_origin,
+                p->buffer_size, p->match_cache,
+                p->cached_match_vector);
+        if (cache_found) {
+            /* If we have found matches in the cache, we use them */
+            for (int i=0;i<p->cached_match_vector->nbelems;i++) {
+                struct match_list* tmp=(struct match_list*)(p->cached_match_vector->tab[i]);
+                while (tmp!=NULL) {
+                    /* We have to adjust the match coordinates */
+                    int size=tmp->m.end_pos_in_token-tmp->m.start_pos_in_token;
+                    tmp->m.start_pos_in_token=p->current_origin;
+                    tmp->m.end_pos_in_token=tmp->m.start_pos_in_token+size;
+                    add_match_from_current_origin(tmp,p);
+                    tmp=tmp->next;
                 }
-            } else {
-                /* Standard locate procedure */
-                p->stack_base = -1;
-                p->stack->stack_pointer = -1;
-                struct parsing_info* matches = NULL;
-                p->left_ctx_shift = 0;
-                p->left_ctx_base = 0;
-
-                p->counting_step.count_call=0;
-                p->counting_step.count_cancel_trying=0;
-                p->last_tested_position = 0;
-                p->last_matched_position = -1;
-                p->graph_depth=0;
-                p->explore_depth=-1;
-                p->token_error_ctx.n_matches_at_token_pos__morphological_locate = 0;
-
-                if (p->is_in_cancel_state == 1)
-                  p->is_in_cancel_state = 0;
-                p->counting_step_count_cancel_trying_real_in_debug_or_trace = 0;
-                p->no_fail_fast=0;
-                p->weight=-1;
-                int n_matches=0;
-                locate(/*0,*/ initial_state, 0,/* 0,*/ &matches, &n_matches, NULL, p);
+            }
+        } else {
+            /* Standard locate procedure */
+            p->stack_base = -1;
+            p->stack->stack_pointer = -1;
+            struct parsing_info* matches = NULL;
+            p->left_ctx_shift = 0;
+            p->left_ctx_base = 0;
+
+            p->counting_step.count_call=0;
+            p->counting_step.count_cancel_trying=0;
+            p->last_tested_position = 0;
+            p->last_matched_position = -1;
+            p->graph_depth=0;
+            p->explore_depth=-1;
+            p->token_error_ctx.n_matches_at_token_pos__morphological_locate = 0;
+
+            if (p->is_in_cancel_state == 1)
+              p->is_in_cancel_state = 0;
+            p->counting_step_count_cancel_trying_real_in_debug_or_trace = 0;
+            p->no_fail_fast=0;
+            p->weight=-1;
+            int n_matches=0;
+            locate(/*0,*/ initial_state, 0,/* 0,*/ &matches, &n_matches, NULL, p);
 
-                clean_allocator(p->al.pa.prv_alloc_vector_int_inside_token);
+            clean_allocator(p->al.pa.prv_alloc_vector_int_inside_token);
 
 
-                int count_call_real = p->counting_step.count_call;
-                count_call_real -= (p->is_in_trace_state == 0) ? (p->counting_step.count_cancel_trying) : (p->counting_step_count_cancel_trying_real_in_debug_or_trace);
+            int count_call_real = p->counting_step.count_call;
+            count_call_real -= (p->is_in_trace_state == 0) ? (p->counting_step.count_cancel_trying) : (p->counting_step_count_cancel_trying_real_in_debug_or_trace);
 
 
 //u_printf("token number %d : %d step\n",p->current_origin,count_call_real,p->tokens);
 
-                total_count_step += (unsigned long)count_call_real;
-
-                if ((p->max_count_call > 0)
-                        && (p->counting_step.count_call >= p->max_count_call)) {
-                    error(
-                            "Stop computing token %u after %u step computing with grammar %s.\n",
-                            p->current_origin, p->counting_step.count_call, p->graph_filename);
-                } else if ((p->max_count_call_warning > 0) && (p->counting_step.count_call
-                        >= p->max_count_call_warning)) {
-                    error(
-                            "Warning : computing token %u take %u step computing with grammar %s.\n",
-                            p->current_origin, p->counting_step.count_call, p->graph_filename);
-                }
-                int can_cache_matches = 0;
-                p->last_tested_position=p->last_tested_position+p->current_origin;
-                if (p->last_matched_position == -1) {
-                    if (p->last_tested_position == p->current_origin
-                            && !u_is_digit(p->tokens->value[current_token][0])
-                            && !p->no_fail_fast) {
-                        /* We are in the fail fast case, nothing has been matched while
-                         * looking only at the first current token. That means that no match
-                         * could ever happen when this token is found in the text.
-                         *
-                         * NOTE: we add the digit test because if the fail came from
-                         * something like <NB><<....>>, then it may have failed on a token
-                         * because of the morphological filter, not because of the first
-                         * token itself */
-                        set_value(p->failfast, current_token, 1);
-                    }
-                } else {
-                    if (p->last_tested_position <= p->last_matched_position
-                            && !at_text_start(p,0)) {
-                        /* If there are matches that could never be longer, we
-                         * can cache them, BUT, we never cache a match that occurred
-                         * at the beginning of the text, since it may be a contextual
-                         * match depending on the {^} meta */
-                        can_cache_matches = 1;
-                    }
-                }
-                struct match_list* tmp;
+            (*total_count_step) += (unsigned long)count_call_real;
+
+            if (p->window != NULL && p->window->overflow) {
+                /* The results are not reliable, since the exploration was
+                 * stopped by the window end and not by the text end. The
+                 * caller will explore this origin again with a larger window */
                 while (p->match_cache_first != NULL) {
-                    real_add_match(p->match_cache_first, p, p->al.prv_alloc_generic);
-                    tmp = p->match_cache_first;
+                    struct match_list* tmp = p->match_cache_first;
                     p->match_cache_first = p->match_cache_first->next;
-                    if (can_cache_matches &&
-                          tmp->m.start_pos_in_token==p->current_origin) {
-                        /* We have to test the start position, because a match obtained using a left
-                         * context could cause problems. We have to set tmp->next to NULL because
-                         * we just want to consider this single match */
-                        tmp->next=NULL;
-                        /* We have to cache the match using the longest possible context and not
-                         * only the end of the match. Imagine that the text contains the
-                         * sequence "...volley-ball..." with the matches "volley" and
-                         * "volley-ball". If we cache these two matches with their own ends,
-                         * then, if the text contains "volley ball meeting", we will find
-                         * "volley" in cache and skip longer matches like "volley ball".
-                         */
-                        cache_match(tmp, p->buffer,
-                                tmp->m.start_pos_in_token,
-                                p->last_matched_position,
-                                &(p->match_cache[current_token]), p->al.prv_alloc_generic);
-                    } else {
-                        free_match_list_element(tmp, p->al.prv_alloc_generic);
-                    }
+                    free_match_list_element(tmp, p->al.prv_alloc_generic);
                 }
                 p->match_cache_last = NULL;
                 free_parsing_info(matches,&p->al.pa);
                 if (p->dic_variables != NULL) {
                     clear_dic_variable_list(&(p->dic_variables));
                 }
+                reset_Variables(p->input_variables);
+                return;
+            }
+
+            if ((p->max_count_call > 0)
+                    && (p->counting_step.count_call >= p->max_count_call)) {
+                error(
+                        "Stop computing token %u after %u step computing with grammar %s.\n",
+                        p->current_origin, p->counting_step.count_call, p->graph_filename);
+            } else if ((p->max_count_call_warning > 0) && (p->counting_step.count_call
+                    >= p->max_count_call_warning)) {
+                error(
+                        "Warning : computing token %u take %u step computing with grammar %s.\n",
+                        p->current_origin, p->counting_step.count_call, p->graph_filename);
+            }
+            int can_cache_matches = 0;
+            p->last_tested_position=p->last_tested_position+p->current_origin;
+            if (p->last_matched_position == -1) {
+                if (p->last_tested_position == p->current_origin
+                        && !u_is_digit(p->tokens->value[current_token][0])
+                        && !p->no_fail_fast) {
+                    /* We are in the fail fast case, nothing has been matched while
+                     * looking only at the first current token. That means that no match
+                     * could ever happen when this token is found in the text.
+                     *
+                     * NOTE: we add the digit test because if the fail came from
+                     * something like <NB><<....>>, then it may have failed on a token
+                     * because of the morphological filter, not because of the first
+                     * token itself */
+                    set_value(p->failfast, current_token, 1);
+                }
+            } else {
+                if (p->last_tested_position <= p->last_matched_position
+                        && !at_text_start(p,0)) {
+                    /* If there are matches that could never be longer, we
+                     * can cache them, BUT, we never cache a match that occurred
+                     * at the beginning of the text, since it may be a contextual
+                     * match depending on the {^} meta */
+                    can_cache_matches = 1;
+                }
+            }
+            struct match_list* tmp;
+            while (p->match_cache_first != NULL) {
+                add_match_from_current_origin(p->match_cache_first, p);
+                tmp = p->match_cache_first;
+                p->match_cache_first = p->match_cache_first->next;
+                if (can_cache_matches &&
+                      tmp->m.start_pos_in_token==p->current_origin) {
+                    /* We have to test the start position, because a match obtained using a left
+                     * context could cause problems. We have to set tmp->next to NULL because
+                     * we just want to consider this single match */
+                    tmp->next=NULL;
+                    /* We have to cache the match using the longest possible context and not
+                     * only the end of the match. Imagine that the text contains the
+                     * sequence "...volley-ball..." with the matches "volley" and
+                     * "volley-ball". If we cache these two matches with their own ends,
+                     * then, if the text contains "volley ball meeting", we will find
+                     * "volley" in cache and skip longer matches like "volley ball".
+                     */
+                    cache_match(tmp, p->buffer,
+                            tmp->m.start_pos_in_token,
+                            p->last_matched_position,
+                            p->match_cache);
+                } else {
+                    free_match_list_element(tmp, p->al.prv_alloc_generic);
+                }
+            }
+            p->match_cache_last = NULL;
+            if (can_cache_matches) {
+                evict_caches_if_needed(p->match_cache);
+            }
+            free_parsing_info(matches,&p->al.pa);
+            if (p->dic_variables != NULL) {
+                clear_dic_variable_list(&(p->dic_variables));
             }
         }
-        reset_Variables(p->input_variables);
-        p->match_list = save_matches(p->match_list,p->current_origin, out, p, p->al.prv_alloc_generic);
-        (p->current_origin)++;
-    } /* End of the big while */
-    free_reserve(backup_reserve);
-    p->backup_memory_reserve = NULL;
+    }
+    reset_Variables(p->input_variables);
+}
 
-    p->match_list = save_matches(p->match_list,p->current_origin+1, out, p, p->al.prv_alloc_generic);
+
+/**
+ * Prints the final statistics of a Locate operation.
+ */
+static void print_locate_statistics(long int text_size, U_FILE* info,
+        struct locate_parameters* p, unsigned long total_count_step) {
     u_printf("100%% done      \n\n");
     u_printf("%d match%s\n", p->number_of_matches,
             (p->number_of_matches == 1) ? "" : "es");
@@ -278,6 +320,10 @@ void launch_locate(U_FILE* out, long int text_size, U_FILE* info,
                 / (float) 1000.0));
     }
     u_printf("%u exploration step\n",(unsigned int)total_count_step);
+    if (p->useLocateCache) {
+        u_printf("Cache: %lu hits, %lu misses, %lu evictions\n",p->match_cache->hits,
+                p->match_cache->misses,p->match_cache->evictions);
+    }
 
     /*
     {
@@ -302,6 +348,262 @@ void launch_locate(U_FILE* out, long int text_size, U_FILE* info,
     }
 }
 
+
+/**
+ * Initializes the error and trace state of the given parameters before
+ * launching a Locate operation.
+ */
+static void init_locate_launch(struct locate_parameters* p) {
+    p->token_error_ctx.n_errors = 0;
+    p->token_error_ctx.last_start = -1;
+    p->token_error_ctx.last_length = 0;
+    p->token_error_ctx.n_matches_at_token_pos__locate = 0;
+    p->token_error_ctx.n_matches_at_token_pos__morphological_locate = 0;
+
+
+    p->is_in_trace_state = 0;
+    if ((p->fnc_locate_trace_step != NULL))
+        p->is_in_trace_state = 1;
+}
+
+
+/**
+ * In streaming mode, moves the text window to the current origin. We keep
+ * the tokens of the matches that have not been saved yet, since
+ * save_matches needs them.
+ */
+static void update_text_window(struct locate_parameters* p) {
+    int keep_from = p->current_origin;
+    if (keep_from > 0) {
+        /* at_text_start may look at the previous token */
+        keep_from--;
+    }
+    for (struct match_list* l = p->match_list; l != NULL; l = l->next) {
+        if (l->m.start_pos_in_token < keep_from) {
+            keep_from = l->m.start_pos_in_token;
+        }
+    }
+    fill_locate_text_window(p, keep_from);
+}
+
+
+/**
+ * Performs the Locate operation on the text, saving the occurrences
+ * on the fly.
+ */
+void launch_locate(U_FILE* out, long int text_size, U_FILE* info,
+        struct locate_parameters* p) {
+    init_locate_launch(p);
+
+    //fill_buffer(p->token_buffer, f);
+    OptimizedFst2State initial_state =
+            p->optimized_states[p->fst2->initial_states[1]];
+    p->current_origin = 0;
+    int n_read = 0;
+    int unite;
+    clock_t startTime = clock();
+    clock_t currentTime;
+    unsigned long total_count_step = 0;
+
+    unite = (int)(((text_size / 100) > 1000) ? (text_size / 100) : 1000);
+    variable_backup_memory_reserve* backup_reserve =
+            create_variable_backup_memory_reserve(p->input_variables,1);
+    p->backup_memory_reserve = backup_reserve;
+    if (p->window != NULL) {
+        update_text_window(p);
+    }
+    while (p->current_origin < p->buffer_size &&
+            p->buffer[p->current_origin] < p->tokens->size &&
+            p->number_of_matches != p->search_limit) {
+        if (unite != 0) {
+            n_read = p->current_origin % unite;
+            if (n_read == 0 && ((currentTime = clock()) - startTime > DELAY)) {
+                startTime = currentTime;
+                u_printf("%2.2f%% done        \r", 100.0
+                        * (float) (p->current_origin)
+                        / (float) text_size);
+            }
+        }
+        locate_from_current_origin(initial_state, p, &total_count_step);
+        if (p->window != NULL && p->window->overflow) {
+            /* The exploration was discarded because it went beyond the
+             * window, so we try again with a larger one */
+            p->window->lookahead *= 2;
+            update_text_window(p);
+            continue;
+        }
+        p->match_list = save_matches(p->match_list,p->current_origin, out, p, p->al.prv_alloc_generic);
+        (p->current_origin)++;
+        if (p->window != NULL) {
+            update_text_window(p);
+        }
+    } /* End of the big while */
+    free_reserve(backup_reserve);
+    p->backup_memory_reserve = NULL;
+
+    p->match_list = save_matches(p->match_list,p->current_origin+1, out, p, p->al.prv_alloc_generic);
+    p->exploration_steps = total_count_step;
+    print_locate_statistics(text_size, info, p, total_count_step);
+}
+
+
+/**
+ * Worker thread function: explores all the origins of the worker's chunk.
+ */
+static void ABSTRACT_CALLBACK_UNITEX locate_worker_thread(void* private_ptr, unsigned int /* num_worker */) {
+    struct locate_parameters* p = (struct locate_parameters*)private_ptr;
+    struct locate_chunk* c = p->chunk;
+    OptimizedFst2State initial_state =
+            p->optimized_states[p->fst2->initial_states[1]];
+    for (p->current_origin = c->start; p->current_origin < c->end; (p->current_origin)++) {
+        locate_from_current_origin(initial_state, p, &(c->count_step));
+    }
+}
+
+
+/**
+ * Adds the matches recorded in the given chunk to the match list of 'p'
+ * and saves them exactly as launch_locate would have done. Then, the
+ * chunk is emptied.
+ */
+static void replay_chunk(struct locate_chunk* c, U_FILE* out, long int text_size,
+        struct locate_parameters* p, clock_t* startTime) {
+    int unite = (int)(((text_size / 100) > 1000) ? (text_size / 100) : 1000);
+    clock_t currentTime;
+    struct match_list* m = c->first;
+    int k = 0;
+    for (p->current_origin = c->start; p->current_origin < c->end
+            && p->number_of_matches != p->search_limit; (p->current_origin)++) {
+        if ((p->current_origin % unite) == 0 && ((currentTime = clock()) - (*startTime) > DELAY)) {
+            (*startTime) = currentTime;
+            u_printf("%2.2f%% done        \r", 100.0
+                    * (float) (p->current_origin)
+                    / (float) text_size);
+        }
+        if (k < c->origins->nbelems && c->origins->tab[k] == p->current_origin) {
+            for (int i = 0; i < c->origins->tab[k + 1]; i++) {
+                real_add_match(m, p, p->al.prv_alloc_generic);
+                m = m->next;
+            }
+            k += 2;
+        }
+        p->match_list = save_matches(p->match_list,p->current_origin, out, p, p->al.prv_alloc_generic);
+    }
+    free_match_list(c->first, STANDARD_ALLOCATOR);
+    c->first = c->last = NULL;
+    c->origins->nbelems = 0;
+}
+
+
+/**
+ * Returns the end of the chunk that starts at 'start'. Chunks are cut just
+ * after a {S} sentence delimiter.
+ */
+static int get_chunk_end(struct locate_parameters* p, int start, int chunk_size, int text_end) {
+    int end = start + chunk_size;
+    if (end >= text_end) {
+        return text_end;
+    }
+    while (end < text_end && p->buffer[end - 1] != p->SENTENCE) {
+        end++;
+    }
+    return end;
+}
+
+
+/**
+ * Performs the Locate operation with 'n_threads' workers. The text is cut
+ * at {S} boundaries into chunks that are explored in parallel, and the
+ * matches are then merged in text order, so that the result is the same
+ * as the one of launch_locate.
+ *
+ * If the parallel mode cannot be used (Korean, trace, no {S} in the text,
+ * no thread support), we just call launch_locate.
+ */
+void launch_locate_in_threads(U_FILE* out, long int text_size, U_FILE* info,
+        struct locate_parameters* p, int n_threads, vector_ptr* injected_vars) {
+    if (n_threads <= 1 || p->SENTENCE == -1 || p->korean != NULL
+            || p->fnc_locate_trace_step != NULL || p->window != NULL
+            || !SyncIsWorkerThreadAvailable()) {
+        launch_locate(out, text_size, info, p);
+        return;
+    }
+    init_locate_launch(p);
+    int text_end = 0;
+    while (text_end < p->buffer_size && p->buffer[text_end] < p->tokens->size) {
+        text_end++;
+    }
+    int chunk_size = text_end / n_threads + 1;
+    if (chunk_size > LOCATE_THREAD_CHUNK_SIZE) {
+        chunk_size = LOCATE_THREAD_CHUNK_SIZE;
+    }
+    struct locate_parameters** workers = (struct locate_parameters**)malloc(n_threads * sizeof(struct locate_parameters*));
+    struct locate_chunk* chunks = (struct locate_chunk*)malloc(n_threads * sizeof(struct locate_chunk));
+    if (workers == NULL || chunks == NULL) {
+        fatal_alloc_error("launch_locate_in_threads");
+    }
+    for (int i = 0; i < n_threads; i++) {
+        workers[i] = new_locate_worker_parameters(p, injected_vars);
+        /* The cache memory budget is shared by all the workers */
+        workers[i]->match_cache->max_size = p->match_cache->max_size / n_threads;
+        if (p->match_cache->max_size != 0 && workers[i]->match_cache->max_size == 0) {
+            workers[i]->match_cache->max_size = 1;
+        }
+        if (p->match_cache_file != NULL) {
+            /* Each worker starts with the sequences loaded from the cache file */
+            merge_LocateCacheSet(workers[i]->match_cache, p->match_cache);
+        }
+        workers[i]->backup_memory_reserve = create_variable_backup_memory_reserve(workers[i]->input_variables,1);
+        chunks[i].first = chunks[i].last = NULL;
+        chunks[i].origins = new_vector_int(1024);
+        chunks[i].count_step = 0;
+        workers[i]->chunk = chunks + i;
+    }
+    clock_t startTime = clock();
+    unsigned long total_count_step = 0;
+    int start = 0;
+    p->current_origin = 0;
+    while (start < text_end && p->number_of_matches != p->search_limit) {
+        int n = 0;
+        while (n < n_threads && start < text_end) {
+            chunks[n].start = start;
+            chunks[n].end = get_chunk_end(p, start, chunk_size, text_end);
+            start = chunks[n].end;
+            n++;
+        }
+        SyncRunWorkerThreads((unsigned int)n, locate_worker_thread, (void**)workers);
+        for (int i = 0; i < n; i++) {
+            total_count_step += chunks[i].count_step;
+            chunks[i].count_step = 0;
+            if (p->number_of_matches != p->search_limit) {
+                replay_chunk(chunks + i, out, text_size, p, &startTime);
+            } else {
+                free_match_list(chunks[i].first, STANDARD_ALLOCATOR);
+                chunks[i].first = chunks[i].last = NULL;
+            }
+        }
+    }
+    for (int i = 0; i < n_threads; i++) {
+        p->match_cache->hits += workers[i]->match_cache->hits;
+        p->match_cache->misses += workers[i]->match_cache->misses;
+        p->match_cache->evictions += workers[i]->match_cache->evictions;
+        if (p->match_cache_file != NULL) {
+            /* The sequences cached by the workers will be saved */
+            merge_LocateCacheSet(p->match_cache, workers[i]->match_cache);
+        }
+        free_reserve(workers[i]->backup_memory_reserve);
+        workers[i]->backup_memory_reserve = NULL;
+        free_vector_int(chunks[i].origins);
+        free_locate_worker_parameters(workers[i]);
+    }
+    free(chunks);
+    free(workers);
+
+    p->match_list = save_matches(p->match_list,p->current_origin+1, out, p, p->al.prv_alloc_generic);
+    p->exploration_steps = total_count_step;
+    print_locate_statistics(text_size, info, p, total_count_step);
+}
+
 /**
  *  Prints the current context to stderr,
  *  except if it was already printed.
@@ -319,8 +621,10 @@ void error_at_token_pos(const char* message, int start, int length,
         return;
     }
     error("%s with grammar %s\n  ", message, p->graph_filename);
+    /* In streaming mode, the tokens before the window are not available */
+    int first_position = (p->window != NULL) ? p->window->start : 0;
     for (i = (start - 4); (i <= (start + 20)) && (i < p->buffer_size); i++) {
-        if (i < 0) {
+        if (i < first_position) {
             continue;
         }
         if (i == start) {
@@ -591,6 +895,9 @@ struct locate_parameters* p /* miscellaneous parameters needed by the function *
     /* If we have reached the end of the token buffer, we indicate it by setting
      * the current tokens to -1 */
     if ((((pos + p->current_origin) >= p->buffer_size)) || (pos==-1)) {
+        if (pos != -1) {
+            check_text_window_end(p, pos + p->current_origin);
+        }
         token = -1;
         token2 = -1;
     } else {
@@ -606,6 +913,7 @@ struct locate_parameters* p /* miscellaneous parameters needed by the function *
             pos2 = pos;
         }
         if ((pos2 + p->current_origin) >= p->buffer_size) {
+            check_text_window_end(p, pos2 + p->current_origin);
             token2 = -1;
         } else {
             token2 = p->buffer[pos2 + p->current_origin];
@@ -1142,6 +1450,9 @@ struct locate_parameters* p /* miscellaneous parameters needed by the function *
                                     + p->current_origin]])) == 0)) {
                         z++;
                     }
+                    if (z == pos_limit) {
+                        check_text_window_end(p, z + p->current_origin);
+                    }
 
                     // If we have stopped because of the end of the buffer, next_pos_add = 0
                     // If we have stopped because of a non matching token, next_pos_add = 1
@@ -1762,8 +2073,10 @@ static int find_longest_compound_word(int pos, struct DLC_tree_node* node,
         position_max = pos - 1;
     else
         position_max = -1;
-    if (pos + p->current_origin == p->buffer_size)
+    if (pos + p->current_origin == p->buffer_size) {
+        check_text_window_end(p, pos + p->current_origin);
         return position_max;
+    }
     /* As the 'node->destination_tokens' array may contain duplicates, we look for
      * one, and then we look before and after it, in order to examine all the
      * duplicates. */
@@ -2172,23 +2485,30 @@ struct match_list* ptr;
          *   1) offset in token
          *   2) offset in char inside the token
          *   3) offset in logical letter inside the current char (for Korean) */
-        u_fprintf(f, "%d.0.0 %d.%d.0", l->m.start_pos_in_token,
-                l->m.end_pos_in_token, u_strlen(
-                        p->tokens->value[p->buffer[l->m.end_pos_in_token]]) - 1);
-        if (l->output != NULL) {
-            /* If there is an output */
-            if (!p->debug) {
-                /* Normal mode */
-                u_fprintf(f, " %S", l->output);
-            } else {
-                /* In debug mode, we save the normal (non debug) mode output,
-                 * before the debug one */
-                u_fprintf(f, " ");
-                save_real_output_from_debug(f,p->real_output_policy,l->output);
-                u_fputs(l->output,f);
+        if (p->binary_concord != NULL) {
+            Match m = l->m;
+            m.start_pos_in_char = m.start_pos_in_letter = m.end_pos_in_letter = 0;
+            m.end_pos_in_char = u_strlen(p->tokens->value[p->buffer[l->m.end_pos_in_token]]) - 1;
+            add_binary_concord_match(p->binary_concord, &m, l->output);
+        } else {
+            u_fprintf(f, "%d.0.0 %d.%d.0", l->m.start_pos_in_token,
+                    l->m.end_pos_in_token, u_strlen(
+                            p->tokens->value[p->buffer[l->m.end_pos_in_token]]) - 1);
+            if (l->output != NULL) {
+                /* If there is an output */
+                if (!p->debug) {
+                    /* Normal mode */
+                    u_fprintf(f, " %S", l->output);
+                } else {
+                    /* In debug mode, we save the normal (non debug) mode output,
+                     * before the debug one */
+                    u_fprintf(f, " ");
+                    save_real_output_from_debug(f,p->real_output_policy,l->output);
+                    u_fputs(l->output,f);
+                }
             }
+            u_fprintf(f, "\n");
         }
-        u_fprintf(f, "\n");
         if (p->ambiguous_output_policy == ALLOW_AMBIGUOUS_OUTPUTS) {
             (p->number_of_outputs)++;
             /* If we allow different outputs for ambiguous transducers,
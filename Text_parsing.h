@@ -65,8 +65,13 @@ namespace unitex {
 /* we try to known if user request cancel each COUNT_CANCEL_TRYING_INIT_CONST locate */
 #define COUNT_CANCEL_TRYING_INIT_CONST (1024)
 
+/* maximal size in tokens of the text chunks explored by each thread
+ * when Locate works with several threads */
+#define LOCATE_THREAD_CHUNK_SIZE (1<<18)
+
 void error_at_token_pos(const char* message,int start,int length,struct locate_parameters* p,const struct optimizedFst2State*);
 void launch_locate(U_FILE*,long int,U_FILE*,struct locate_parameters*);
+void launch_locate_in_threads(U_FILE*,long int,U_FILE*,struct locate_parameters*,int,vector_ptr*);
 void locate(/*int,*/OptimizedFst2State,int,/*int,*/struct parsing_info**,int*,struct list_context*,struct locate_parameters*);
 
 
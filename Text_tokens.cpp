@@ -38,10 +38,57 @@ if (tmp==NULL) {
 tmp->N=0;
 tmp->SENTENCE_MARKER=-1;
 tmp->token=NULL;
+tmp->hash_index=NULL;
+tmp->hash_bits=0;
 return tmp;
 }
 
 
+/**
+ * Returns the slot of the hash index where to start looking for the
+ * given token.
+ */
+static inline unsigned int get_token_slot(const unichar* s,int hash_bits) {
+/* We use the upper bits of the product, because the lower bits of
+ * hash_unichar are poorly distributed */
+return (hash_unichar((unichar*)s)*2654435769u)>>(32-hash_bits);
+}
+
+
+/**
+ * Builds the hash index that is used by get_token_number to find a token
+ * without comparing it to all the tokens of the text.
+ */
+static void build_token_hash_index(struct text_tokens* tok,Abstract_allocator prv_alloc) {
+/* We want at least twice more slots than tokens */
+int bits=4;
+while (bits<30 && (1<<bits)<2*tok->N) bits++;
+int size=1<<bits;
+tok->hash_index=(int*)malloc_cb(size*sizeof(int),prv_alloc);
+if (tok->hash_index==NULL) {
+   fatal_alloc_error("build_token_hash_index");
+}
+tok->hash_bits=bits;
+for (int i=0;i<size;i++) {
+   tok->hash_index[i]=-1;
+}
+for (int i=0;i<tok->N;i++) {
+   unsigned int slot=get_token_slot(tok->token[i],bits);
+   while (tok->hash_index[slot]!=-1) {
+      if (!u_strcmp(tok->token[tok->hash_index[slot]],tok->token[i])) {
+         /* If a token appears twice, we keep its first number, as
+          * the linear search used to do */
+         break;
+      }
+      slot=(slot+1)&(size-1);
+   }
+   if (tok->hash_index[slot]==-1) {
+      tok->hash_index[slot]=i;
+   }
+}
+}
+
+
 struct text_tokens* load_text_tokens(const VersatileEncodingConfig* vec,const char* nom,Abstract_allocator prv_alloc) {
 U_FILE* f;
 f=u_fopen(vec,nom,U_READ);
@@ -83,7 +130,7 @@ if (i!=res->N) {
   free_cb(res, prv_alloc);
   return NULL;
 }
-
+build_token_hash_index(res,prv_alloc);
 return res;
 }
 
@@ -130,6 +177,7 @@ for (int i=0;i<tok->N;i++) {
    free(tok->token[i]);
 }
 free_cb(tok->token,prv_alloc);
+if (tok->hash_index!=NULL) free_cb(tok->hash_index,prv_alloc);
 free_cb(tok,prv_alloc);
 }
 
@@ -166,9 +214,23 @@ return l;
 
 
 
+/**
+ * Returns the number of the given token, or -1 if it is not a token
+ * of the text.
+ */
 int get_token_number(const unichar* s,struct text_tokens* tok) {
-for (int i=0;i<tok->N;i++) {
-    if (!u_strcmp(tok->token[i],s)) return i;
+if (tok->hash_index==NULL) {
+   for (int i=0;i<tok->N;i++) {
+       if (!u_strcmp(tok->token[i],s)) return i;
+   }
+   return -1;
+}
+unsigned int mask=(1u<<tok->hash_bits)-1;
+unsigned int slot=get_token_slot(s,tok->hash_bits);
+int n;
+while ((n=tok->hash_index[slot])!=-1) {
+   if (!u_strcmp(tok->token[n],s)) return n;
+   slot=(slot+1)&mask;
 }
 return -1;
 }
@@ -45,6 +45,8 @@ namespace unitex {
  *  - The token id of the sentence marker   (int SENTENCE_MARKER)
  *  - The token id of the stop marker       (int STOP_MARKER)
  *  - The token id of the space             (int SPACE)
+ *  - A hash index used by get_token_number (int* hash_index): it has
+ *    2^hash_bits slots, each one containing a token id or -1
  */
 
 struct text_tokens {
@@ -53,6 +55,8 @@ struct text_tokens {
    int SENTENCE_MARKER;
    int STOP_MARKER;
    int SPACE;
+   int* hash_index;
+   int hash_bits;
 };
 
 
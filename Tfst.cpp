@@ -55,6 +55,10 @@ t->offset_in_tokens=-1;
 t->offset_in_chars=-1;
 t->automaton=NULL;
 t->tags=NULL;
+t->binary_map=NULL;
+t->binary=NULL;
+t->binary_size=0;
+t->binary_pool=NULL;
 return t;
 }
 
@@ -66,11 +70,74 @@ void close_text_automaton(Tfst* t) {
 if (t==NULL) return;
 if (t->tfst!=NULL) u_fclose(t->tfst);
 if (t->tind!=NULL) u_fclose(t->tind);
+if (t->binary_map!=NULL) {
+   af_release_mapfile_pointer(t->binary_map,t->binary);
+   af_close_mapfile(t->binary_map);
+}
 free_current_sentence(t);
 free(t);
 }
 
 
+/**
+ * Returns 1 if the given file is a binary .tfst file; 0 otherwise.
+ */
+static int is_binary_tfst_file(const char* name) {
+U_FILE* f=u_fopen(BINARY,name,U_READ);
+if (f==NULL) return 0;
+char magic[BINARY_TFST_MAGIC_SIZE];
+int ret=(fread(magic,1,BINARY_TFST_MAGIC_SIZE,f)==BINARY_TFST_MAGIC_SIZE
+         && !memcmp(magic,BINARY_TFST_MAGIC,BINARY_TFST_MAGIC_SIZE));
+u_fclose(f);
+return ret;
+}
+
+
+/**
+ * Opens the given binary text automaton file by mapping it in memory.
+ * 'tind_size' is the size of the associated .tind file.
+ */
+static Tfst* open_binary_text_automaton(const char* tfst,const char* tind,int tind_size) {
+ABSTRACTMAPFILE* amf=af_open_mapfile(tfst,MAPFILE_OPTION_READ,0);
+if (amf==NULL) {
+   error("Cannot open file %s\n",tfst);
+   return NULL;
+}
+size_t size=af_get_mapfile_size(amf);
+const unsigned char* binary=(const unsigned char*)af_get_mapfile_pointer(amf);
+/* The file may have been truncated after its magic number, so we must
+ * check its size before reading the header */
+const int32_t* header=(const int32_t*)(binary+BINARY_TFST_MAGIC_SIZE);
+if (binary==NULL || size<(size_t)BINARY_TFST_HEADER_SIZE) {
+   error("Invalid binary text automaton %s\n",tfst);
+   if (binary!=NULL) af_release_mapfile_pointer(amf,binary);
+   af_close_mapfile(amf);
+   return NULL;
+}
+int N=header[0];
+if (N<=0 || (long long)N*4!=tind_size || header[1]<BINARY_TFST_HEADER_SIZE || header[2]<0
+    || (size_t)header[1]+(size_t)header[2]*sizeof(unichar)>size) {
+   error("Invalid binary text automaton %s\n",tfst);
+   af_release_mapfile_pointer(amf,binary);
+   af_close_mapfile(amf);
+   return NULL;
+}
+U_FILE* f=u_fopen(BINARY,tind,U_READ);
+if (f==NULL) {
+   error("Cannot open file %s\n",tind);
+   af_release_mapfile_pointer(amf,binary);
+   af_close_mapfile(amf);
+   return NULL;
+}
+Tfst* t=new_Tfst(NULL,f,N);
+t->binary_map=amf;
+t->binary=binary;
+t->binary_size=size;
+t->binary_pool=(const unichar*)(binary+header[1]);
+return t;
+}
+
+
 /**
  * Opens the given text automaton file, but loads no sentence.
  * Returns NULL if:
@@ -87,6 +154,9 @@ if (size==-1) {
    error("Cannot get size of file %s\n",tind);
    return NULL;
 }
+if (is_binary_tfst_file(tfst)) {
+   return open_binary_text_automaton(tfst,tind,size);
+}
 U_FILE* f=u_fopen(vec,tfst,U_READ);
 if (f==NULL) {
    error("Cannot open file %s\n",tfst);
@@ -138,6 +208,39 @@ tfst->tags=NULL;
 }
 
 
+/**
+ * Moves the current sentence of 'src' into 'dest', freeing the current sentence
+ * of 'dest', if any. After that, 'src' has no sentence loaded. This allows to
+ * keep several sentences of the same text automaton in memory.
+ */
+void move_current_sentence(Tfst* src,Tfst* dest) {
+if (src==NULL || dest==NULL) {
+   fatal_error("NULL error in move_current_sentence\n");
+}
+if (dest->current_sentence!=NO_SENTENCE_LOADED) {
+   free_current_sentence(dest);
+}
+dest->current_sentence=src->current_sentence;
+dest->text=src->text;
+dest->tokens=src->tokens;
+dest->token_sizes=src->token_sizes;
+dest->token_content=src->token_content;
+dest->offset_in_tokens=src->offset_in_tokens;
+dest->offset_in_chars=src->offset_in_chars;
+dest->automaton=src->automaton;
+dest->tags=src->tags;
+src->current_sentence=NO_SENTENCE_LOADED;
+src->text=NULL;
+src->tokens=NULL;
+src->token_sizes=NULL;
+src->token_content=NULL;
+src->offset_in_tokens=-1;
+src->offset_in_chars=-1;
+src->automaton=NULL;
+src->tags=NULL;
+}
+
+
 /**
  * Returns the offset of the given sentence in the .tfst of the
  * given text automaton. Remember that sentences are numbered from 1.
@@ -227,6 +330,79 @@ return tag;
 }
 
 
+/**
+ * Loads the given sentence of a binary text automaton. The arrays are
+ * used as they are in the mapped file, but the sentence is still turned into
+ * the structures used by all the programs that work on text automata, since
+ * some of them modify the automaton or its tags.
+ */
+static void load_binary_sentence(Tfst* tfst,int n,long offset) {
+if (offset<BINARY_TFST_HEADER_SIZE
+    || (size_t)offset+BINARY_TFST_SENTENCE_HEADER_SIZE*sizeof(int32_t)>tfst->binary_size) {
+   fatal_error("load_sentence: invalid offset for sentence %d\n",n);
+}
+const int32_t* header=(const int32_t*)(tfst->binary+offset);
+if (header[0]!=n) {
+   fatal_error("load_sentence: Invalid sentence header: should be sentence %d\n",n);
+}
+int text_length=header[1];
+int n_tokens=header[2];
+int n_states=header[5];
+int n_transitions=header[6];
+int n_tags=header[7];
+const int32_t* tokens=header+BINARY_TFST_SENTENCE_HEADER_SIZE;
+const int32_t* token_sizes=tokens+n_tokens;
+const int32_t* first_transition=token_sizes+n_tokens;
+const int32_t* is_final=first_transition+n_states+1;
+const int32_t* tag_numbers=is_final+n_states;
+const int32_t* destinations=tag_numbers+n_transitions;
+const int32_t* tags=destinations+n_transitions;
+const unichar* text=(const unichar*)(tags+7*n_tags);
+if ((size_t)((const unsigned char*)(text+text_length+1)-tfst->binary)>tfst->binary_size) {
+   fatal_error("load_sentence: truncated sentence %d\n",n);
+}
+tfst->text=u_strdup(text,text_length);
+tfst->tokens=new_vector_int(n_tokens>0?n_tokens:1);
+tfst->token_sizes=new_vector_int(n_tokens>0?n_tokens:1);
+memcpy(tfst->tokens->tab,tokens,n_tokens*sizeof(int));
+memcpy(tfst->token_sizes->tab,token_sizes,n_tokens*sizeof(int));
+tfst->tokens->nbelems=tfst->token_sizes->nbelems=n_tokens;
+tfst->offset_in_tokens=header[3];
+tfst->offset_in_chars=header[4];
+tfst->automaton=new_SingleGraph(n_states>0?n_states:1,INT_TAGS);
+for (int i=0;i<n_states;i++) {
+   SingleGraphState s=add_state(tfst->automaton);
+   if (i==0) {
+      /* By convention, the first state is initial */
+      set_initial_state(s);
+   }
+   if (is_final[i]) {
+      set_final_state(s);
+   }
+   for (int j=first_transition[i];j<first_transition[i+1];j++) {
+      add_outgoing_transition(s,tag_numbers[j],destinations[j]);
+   }
+}
+tfst->tags=new_vector_ptr(n_tags>0?n_tags:1);
+for (int i=0;i<n_tags;i++) {
+   const int32_t* t=tags+7*i;
+   if (t[0]==-1) {
+      vector_ptr_add(tfst->tags,new_TfstTag(T_EPSILON));
+      continue;
+   }
+   TfstTag* tag=new_TfstTag(T_STD);
+   tag->content=u_strdup(tfst->binary_pool+t[0]);
+   tag->m.start_pos_in_token=t[1];
+   tag->m.start_pos_in_char=t[2];
+   tag->m.start_pos_in_letter=t[3];
+   tag->m.end_pos_in_token=t[4];
+   tag->m.end_pos_in_char=t[5];
+   tag->m.end_pos_in_letter=t[6];
+   vector_ptr_add(tfst->tags,tag);
+}
+}
+
+
 /**
  * Loads the given sentence of the given text automaton.
  */
@@ -242,6 +418,10 @@ if (tfst->current_sentence!=NO_SENTENCE_LOADED) {
 }
 tfst->current_sentence=n;
 long offset=get_sentence_offset(tfst,n);
+if (tfst->binary!=NULL) {
+   load_binary_sentence(tfst,n,offset);
+   return;
+}
 fseek(tfst->tfst,offset,SEEK_SET);
 /* Now we can read the sentence */
 int N=0;
@@ -374,25 +554,14 @@ if (4!=fwrite(t,1,4,tind)) {
 
 
 /**
- * Saves the current sentence of the given tfst.
- * If 'tags' is not NULL, it is supposed to contain ready-to-dump tag labels that
- * will be used; otherwise, the function saves each TfstTag.
- *
- * The form_frequencies hash table is to be used when calling compute_form_frequencies.
- *
- * WARNING: if tags are provided, they are supposed to be \n terminated !
+ * Checks that the current sentence of the given tfst can be saved with the
+ * given tags, and updates the form frequencies, if any.
  */
-void save_current_sentence(Tfst* tfst,U_FILE* out_tfst,U_FILE* out_tind,unichar** tags,int n_tags,
-                            struct hash_table* form_frequencies) {
+static void prepare_sentence_to_save(Tfst* tfst,unichar** tags,int n_tags,
+                                     struct hash_table* form_frequencies) {
 if (tfst==NULL) {
    fatal_error("NULL tfst in save_current_sentence\n");
 }
-if (out_tfst==NULL) {
-   fatal_error("NULL output .tfst file in save_current_sentence\n");
-}
-if (out_tind==NULL) {
-   fatal_error("NULL output .tind file in save_current_sentence\n");
-}
 if (tfst->current_sentence==NO_SENTENCE_LOADED) {
    fatal_error("No sentence to save in save_current_sentence\n");
 }
@@ -414,6 +583,27 @@ if (form_frequencies!=NULL) {
        compute_form_frequencies(tfst->automaton,(TfstTag**)(tfst->tags->tab),form_frequencies);
     }
 }
+}
+
+
+/**
+ * Saves the current sentence of the given tfst.
+ * If 'tags' is not NULL, it is supposed to contain ready-to-dump tag labels that
+ * will be used; otherwise, the function saves each TfstTag.
+ *
+ * The form_frequencies hash table is to be used when calling compute_form_frequencies.
+ *
+ * WARNING: if tags are provided, they are supposed to be \n terminated !
+ */
+void save_current_sentence(Tfst* tfst,U_FILE* out_tfst,U_FILE* out_tind,unichar** tags,int n_tags,
+                            struct hash_table* form_frequencies) {
+if (out_tfst==NULL) {
+   fatal_error("NULL output .tfst file in save_current_sentence\n");
+}
+if (out_tind==NULL) {
+   fatal_error("NULL output .tind file in save_current_sentence\n");
+}
+prepare_sentence_to_save(tfst,tags,n_tags,form_frequencies);
 
 /* First, we update the offset index in the .tind file */
 long offset=ftell(out_tfst);
@@ -465,6 +655,195 @@ u_fprintf(out_tfst,"f\n");
 }
 
 
+/**
+ * Allocates, initializes and returns a writer for a binary .tfst, whose
+ * header is written in 'tfst'. The files must have been opened in
+ * BINARY mode and they are not closed by close_binary_tfst_writer.
+ */
+struct binary_tfst_writer* new_binary_tfst_writer(U_FILE* tfst,U_FILE* tind) {
+struct binary_tfst_writer* w=(struct binary_tfst_writer*)malloc(sizeof(struct binary_tfst_writer));
+if (w==NULL) {
+   fatal_alloc_error("new_binary_tfst_writer");
+}
+w->tfst=tfst;
+w->tind=tind;
+w->N=0;
+w->contents=new_string_hash(1024);
+w->content_offsets=new_vector_int(1024);
+w->pool_size=0;
+w->buffer=new_vector_int(1024);
+/* The header will be updated when closing the writer */
+int32_t header[3]={0,0,0};
+fwrite(BINARY_TFST_MAGIC,1,BINARY_TFST_MAGIC_SIZE,tfst);
+fwrite(header,sizeof(int32_t),3,tfst);
+return w;
+}
+
+
+/**
+ * Returns the offset in the pool of the given tag content, adding it to
+ * the pool if needed.
+ */
+static int get_binary_tfst_content_offset(struct binary_tfst_writer* w,const unichar* content) {
+int n=get_value_index(content,w->contents);
+if (n==w->content_offsets->nbelems) {
+   vector_int_add(w->content_offsets,w->pool_size);
+   w->pool_size+=u_strlen(content)+1;
+}
+return w->content_offsets->tab[n];
+}
+
+
+/**
+ * Adds to the buffer of the writer the description of the tag 't'.
+ */
+static void add_binary_tfst_tag(struct binary_tfst_writer* w,const TfstTag* t) {
+vector_int_add(w->buffer,(t->type==T_EPSILON)?-1:get_binary_tfst_content_offset(w,t->content));
+vector_int_add(w->buffer,t->m.start_pos_in_token);
+vector_int_add(w->buffer,t->m.start_pos_in_char);
+vector_int_add(w->buffer,t->m.start_pos_in_letter);
+vector_int_add(w->buffer,t->m.end_pos_in_token);
+vector_int_add(w->buffer,t->m.end_pos_in_char);
+vector_int_add(w->buffer,t->m.end_pos_in_letter);
+}
+
+
+/**
+ * Adds to the buffer of the writer the description of the tag given as
+ * it would be written in a text .tfst, i.e. "@<E>\n.\n" or
+ * "@STD\n@content\n@a.b.c-d.e.f\n.\n".
+ */
+static void add_binary_tfst_tag(struct binary_tfst_writer* w,unichar* s,Ustring* content) {
+TfstTag tag;
+if (!u_strcmp(s,"@<E>\n.\n")) {
+   tag.type=T_EPSILON;
+   tag.content=NULL;
+   tag.m.start_pos_in_token=tag.m.start_pos_in_char=tag.m.start_pos_in_letter=-1;
+   tag.m.end_pos_in_token=tag.m.end_pos_in_char=tag.m.end_pos_in_letter=-1;
+   add_binary_tfst_tag(w,&tag);
+   return;
+}
+if (!u_starts_with(s,"@STD\n@")) {
+   fatal_error("save_current_sentence: invalid tag %S\n",s);
+}
+int i=6;
+empty(content);
+while (s[i]!='\n' && s[i]!='\0') {
+   u_strcat(content,s[i++]);
+}
+if (s[i]!='\n' || s[i+1]!='@'
+    || 6>u_sscanf(s+i+2,"%d.%d.%d-%d.%d.%d",&tag.m.start_pos_in_token,&tag.m.start_pos_in_char,
+                  &tag.m.start_pos_in_letter,&tag.m.end_pos_in_token,&tag.m.end_pos_in_char,
+                  &tag.m.end_pos_in_letter)) {
+   fatal_error("save_current_sentence: invalid tag %S\n",s);
+}
+tag.type=T_STD;
+tag.content=content->str;
+add_binary_tfst_tag(w,&tag);
+}
+
+
+/**
+ * Saves the current sentence of the given tfst with the given binary
+ * writer. 'tags', 'n_tags' and 'form_frequencies' have the same meaning as
+ * for the text version of save_current_sentence.
+ */
+void save_current_sentence(Tfst* tfst,struct binary_tfst_writer* w,unichar** tags,int n_tags,
+                            struct hash_table* form_frequencies) {
+prepare_sentence_to_save(tfst,tags,n_tags,form_frequencies);
+dump_offset(ftell(w->tfst),w->tind);
+SingleGraph g=tfst->automaton;
+int n_transitions=0;
+for (int i=0;i<g->number_of_states;i++) {
+   for (Transition* t=g->states[i]->outgoing_transitions;t!=NULL;t=t->next) {
+      n_transitions++;
+   }
+}
+if (tags==NULL) {
+   n_tags=tfst->tags->nbelems;
+}
+int text_length=u_strlen(tfst->text);
+vector_int* b=w->buffer;
+b->nbelems=0;
+vector_int_add(b,tfst->current_sentence);
+vector_int_add(b,text_length);
+vector_int_add(b,tfst->tokens->nbelems);
+vector_int_add(b,tfst->offset_in_tokens);
+vector_int_add(b,tfst->offset_in_chars);
+vector_int_add(b,g->number_of_states);
+vector_int_add(b,n_transitions);
+vector_int_add(b,n_tags);
+for (int i=0;i<tfst->tokens->nbelems;i++) {
+   vector_int_add(b,tfst->tokens->tab[i]);
+}
+for (int i=0;i<tfst->token_sizes->nbelems;i++) {
+   vector_int_add(b,tfst->token_sizes->tab[i]);
+}
+n_transitions=0;
+for (int i=0;i<g->number_of_states;i++) {
+   vector_int_add(b,n_transitions);
+   for (Transition* t=g->states[i]->outgoing_transitions;t!=NULL;t=t->next) {
+      n_transitions++;
+   }
+}
+vector_int_add(b,n_transitions);
+for (int i=0;i<g->number_of_states;i++) {
+   vector_int_add(b,is_final_state(g->states[i]));
+}
+for (int i=0;i<g->number_of_states;i++) {
+   for (Transition* t=g->states[i]->outgoing_transitions;t!=NULL;t=t->next) {
+      vector_int_add(b,t->tag_number);
+   }
+}
+for (int i=0;i<g->number_of_states;i++) {
+   for (Transition* t=g->states[i]->outgoing_transitions;t!=NULL;t=t->next) {
+      vector_int_add(b,t->state_number);
+   }
+}
+if (tags!=NULL) {
+   Ustring* content=new_Ustring(64);
+   for (int i=0;i<n_tags;i++) {
+      add_binary_tfst_tag(w,tags[i],content);
+   }
+   free_Ustring(content);
+} else {
+   for (int i=0;i<n_tags;i++) {
+      add_binary_tfst_tag(w,(TfstTag*)(tfst->tags->tab[i]));
+   }
+}
+fwrite(b->tab,sizeof(int32_t),b->nbelems,w->tfst);
+/* The text is padded so that the next sentence is aligned */
+fwrite(tfst->text,sizeof(unichar),text_length+1,w->tfst);
+if ((text_length+1)%2) {
+   unichar zero='\0';
+   fwrite(&zero,sizeof(unichar),1,w->tfst);
+}
+(w->N)++;
+}
+
+
+/**
+ * Saves the pool of tag contents at the end of the binary .tfst, updates
+ * its header and frees the writer.
+ */
+void close_binary_tfst_writer(struct binary_tfst_writer* w) {
+if (w==NULL) return;
+int32_t header[3];
+header[0]=w->N;
+header[1]=(int32_t)ftell(w->tfst);
+header[2]=w->pool_size;
+for (int i=0;i<w->contents->size;i++) {
+   fwrite(w->contents->value[i],sizeof(unichar),u_strlen(w->contents->value[i])+1,w->tfst);
+}
+fseek(w->tfst,BINARY_TFST_MAGIC_SIZE,SEEK_SET);
+fwrite(header,sizeof(int32_t),3,w->tfst);
+free_string_hash(w->contents);
+free_vector_int(w->content_offsets);
+free_vector_int(w->buffer);
+free(w);
+}
+
+
 /**
  * Builds a \n terminated string representation of the given TfstTag.
  */
@@ -32,6 +32,8 @@
 #include "SingleGraph.h"
 #include "Match.h"
 #include "HashTable.h"
+#include "String_hash.h"
+#include "Af_stdio.h"
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -41,6 +43,36 @@ namespace unitex {
 
 #define NO_SENTENCE_LOADED -1
 
+/**
+ * A .tfst file can also be saved in a binary format, which starts with
+ * BINARY_TFST_MAGIC, i.e. a UTF16-LE byte order mark followed by the line
+ * "#T". Then come, as native 32-bit integers, the number of sentences, the
+ * offset of the tag content pool in bytes and its size in unichars.
+ *
+ * The .tind gives, as for text .tfst files, the offset of each sentence,
+ * which is made of BINARY_TFST_SENTENCE_HEADER_SIZE integers:
+ *
+ *    sentence number, text length L, number of tokens T, offset in tokens,
+ *    offset in chars, number of states S, number of transitions R,
+ *    number of tags G
+ *
+ * followed by these arrays of integers:
+ *
+ *    tokens[T], token_sizes[T], first_transition[S+1], is_final[S],
+ *    tag_numbers[R], destinations[R], tags[7*G]
+ *
+ * and then by the L+1 unichars of the sentence text, padded to a multiple of
+ * 4 bytes. The transitions of state #i are the ones from first_transition[i]
+ * to first_transition[i+1]. A tag is described by the offset of its content
+ * in the pool (-1 for the epsilon tag) and its 6 bounds. The contents of the
+ * tags are shared by all the sentences and they are stored in the pool as
+ * '\0'-terminated strings.
+ */
+#define BINARY_TFST_MAGIC "\xFF\xFE#\0T\0\n\0"
+#define BINARY_TFST_MAGIC_SIZE 8
+#define BINARY_TFST_HEADER_SIZE (BINARY_TFST_MAGIC_SIZE+3*(int)sizeof(int32_t))
+#define BINARY_TFST_SENTENCE_HEADER_SIZE 8
+
 /**
  * This structure represents a text automaton. This structure
  * is meant to manipulate one sentence automaton at a time.
@@ -77,6 +109,13 @@ typedef struct {
    /* The tags of the current sentence automaton */
    vector_ptr* tags;
 
+   /* If the .tfst is in the binary format, it is mapped in memory and
+    * the sentences are read directly from it */
+   ABSTRACTMAPFILE* binary_map;
+   const unsigned char* binary;
+   size_t binary_size;
+   const unichar* binary_pool;
+
 } Tfst;
 
 
@@ -129,9 +168,29 @@ Tfst* new_Tfst(U_FILE* tfst,U_FILE* tind,int N);
 Tfst* open_text_automaton(const VersatileEncodingConfig*,const char* tfst);
 void close_text_automaton(Tfst* tfst);
 void load_sentence(Tfst* tfst,int n);
+void move_current_sentence(Tfst* src,Tfst* dest);
 void save_current_sentence(Tfst* tfst,U_FILE* out_tfst,U_FILE* tind,unichar** tags,int n_tags,
                             struct hash_table* form_frequencies);
 
+/**
+ * This structure is used to save a binary .tfst file. The contents of the tags
+ * are interned, so that the pool can be saved at the end of the file.
+ */
+struct binary_tfst_writer {
+   U_FILE* tfst;
+   U_FILE* tind;
+   int N;
+   struct string_hash* contents;
+   vector_int* content_offsets;
+   int pool_size;
+   vector_int* buffer;
+};
+
+struct binary_tfst_writer* new_binary_tfst_writer(U_FILE* tfst,U_FILE* tind);
+void save_current_sentence(Tfst* tfst,struct binary_tfst_writer* writer,unichar** tags,int n_tags,
+                            struct hash_table* form_frequencies);
+void close_binary_tfst_writer(struct binary_tfst_writer* writer);
+
 TfstTag* new_TfstTag(TfstTagType);
 void free_TfstTag(TfstTag*);
 void TfstTag_to_string(TfstTag*,unichar*);
@@ -36,6 +36,18 @@
 #include "Token.h"
 #include "Offsets.h"
 #include "Overlap.h"
+#include "SyncTool.h"
+#include "base/cpu/extensions.h"
+
+#if defined(UNITEX_HAS_CPU_EXTENSION_SSE2) && UNITEX_HAS_CPU_EXTENSION_SSE2
+#include <emmintrin.h>
+#define TOKENIZE_USE_SSE2 1
+#endif
+
+#if defined(UNITEX_HAS_CPU_EXTENSION_AVX2) && UNITEX_HAS_CPU_EXTENSION_AVX2
+#include <immintrin.h>
+#define TOKENIZE_USE_AVX2 1
+#endif
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -52,6 +64,8 @@ static void compute_statistics(U_FILE*,vector_ptr*,Alphabet*,int,int,int,int);
 static int tokenization(U_FILE*,U_FILE*,U_FILE*,Alphabet*,vector_ptr*,struct hash_table*,vector_int*,
         vector_int*,vector_int*,
            int*,int*,int*,int*,U_FILE*,vector_offset*,int);
+static int threaded_tokenization(U_FILE*,U_FILE*,U_FILE*,Alphabet*,vector_ptr*,struct hash_table*,vector_int*,
+                                vector_int*,vector_int*,int*,int*,int*,int*,int,int);
 static void save_new_line_positions(U_FILE*,vector_int*);
 static int load_token_file(char* filename, const VersatileEncodingConfig*,vector_ptr* tokens,struct hash_table* hashtable,vector_int* n_occur);
 
@@ -89,6 +103,11 @@ const char* usage_Tokenize =
          "  --input_offsets=XXX: base offset file to be used\n"
          "  --output_offsets=XXX: offset file to be produced (at \"uima\" format)\n"
          "\n"
+         "  --threads=N: tokenizes the text with N threads (default: 1). The text is split\n"
+         "               at new lines into chunks that are tokenized in parallel; the results\n"
+         "               are the same as with a single thread. This option is ignored\n"
+         "               when --output_offsets is used\n"
+         "\n"
          "  -V/--only-verify-arguments: only verify arguments syntax and exit\n"
          "  -h/--help: this help\n"
          "\n"
@@ -107,7 +126,7 @@ static void usage() {
   u_printf(usage_Tokenize);
 }
 
-const char* optstring_Tokenize=":a:cwt:Vhk:q:$:@:";
+const char* optstring_Tokenize=":a:cwt:Vhk:q:$:@:#:";
 const struct option_TS lopts_Tokenize[]={
   {"alphabet", required_argument_TS, NULL, 'a'},
   {"char_by_char", no_argument_TS, NULL, 'c'},
@@ -117,6 +136,7 @@ const struct option_TS lopts_Tokenize[]={
   {"output_encoding",required_argument_TS,NULL,'q'},
   {"input_offsets",required_argument_TS,NULL,'$'},
   {"output_offsets",required_argument_TS,NULL,'@'},
+  {"threads",required_argument_TS,NULL,'#'},
   {"only_verify_arguments",no_argument_TS,NULL,'V'},
   {"help", no_argument_TS, NULL, 'h'},
   {NULL, no_argument_TS, NULL, 0}
@@ -149,6 +169,8 @@ char* out_offsets = (buffer_filename + (step_filename_buffer * 3));
 VersatileEncodingConfig vec=VEC_DEFAULT;
 int val,index=-1;
 int mode=NORMAL;
+int n_threads=1;
+char foo;
 bool only_verify_arguments = false;
 UnitexGetOpt options;
 while (EOF!=(val=options.parse_long(argc,argv,optstring_Tokenize,lopts_Tokenize,&index))) {
@@ -197,6 +219,13 @@ while (EOF!=(val=options.parse_long(argc,argv,optstring_Tokenize,lopts_Tokenize,
              }
              strcpy(out_offsets,options.vars()->optarg);
              break;
+   case '#': if (1!=sscanf(options.vars()->optarg,"%d%c",&n_threads,&foo) || n_threads<=0) {
+                /* foo is used to check that the param is not like "45gjh" */
+                error("Invalid number of threads: %s\n",options.vars()->optarg);
+                free(buffer_filename);
+                return USAGE_ERROR_CODE;
+             }
+             break;
    case 'V': only_verify_arguments = true;
              break;
    case 'h': usage();
@@ -375,10 +404,17 @@ int TOKENS_TOTAL=0;
 int WORDS_TOTAL=0;
 int DIGITS_TOTAL=0;
 u_printf("Tokenizing text...\n");
-int result_tokenization = tokenization(text,out,output,alph,tokens,hashtable,n_occur,n_enter_pos,
+int result_tokenization;
+if (n_threads>1 && f_out_offsets==NULL) {
+   result_tokenization = threaded_tokenization(text,out,output,alph,tokens,hashtable,n_occur,n_enter_pos,
+                          snt_offsets,
+                          &SENTENCES,&TOKENS_TOTAL,&WORDS_TOTAL,&DIGITS_TOTAL,(mode!=NORMAL),n_threads);
+} else {
+   result_tokenization = tokenization(text,out,output,alph,tokens,hashtable,n_occur,n_enter_pos,
                           snt_offsets,
                           &SENTENCES,&TOKENS_TOTAL,&WORDS_TOTAL,&DIGITS_TOTAL,f_out_offsets,
                           v_in_offsets,(mode!=NORMAL));
+}
 u_printf((result_tokenization == 0) ? "\nDone.\n" : "\nTokenization error.\n");
 save_new_line_positions(enter,n_enter_pos);
 if (!save_snt_offsets(snt_offsets,snt_offsets_pos)) {
@@ -658,8 +694,439 @@ static inline int enlarge_token_buffer_if_needed(unichar** token_buffer, size_t
     return enlarge_token_buffer_as_needed(token_buffer, buffer_size, size_needed);
 }
 
+/**
+ * Returns the number of trailing 1 bits of 'mask'.
+ */
+static inline int count_trailing_ones(unsigned int mask) {
+#if defined(__GNUC__)
+return __builtin_ctz(~mask);
+#else
+int k=0;
+while (mask & (1u<<k)) k++;
+return k;
+#endif
+}
+
+
+/**
+ * Returns the length of the sequence of separators (spaces, tabs and new
+ * lines) that starts at 's', looking at no more than 'n' characters. If this
+ * sequence contains a new line, '*enter' is set to 1. When AVX2 or SSE2 is
+ * available, 16 or 8 characters are tested at a time.
+ */
+static inline int scan_separators(const unichar* s,int n,char* enter) {
+int i=0;
+#ifdef TOKENIZE_USE_AVX2
+const __m256i space32=_mm256_set1_epi16(' ');
+const __m256i tab32=_mm256_set1_epi16('\t');
+const __m256i cr32=_mm256_set1_epi16(0x0d);
+const __m256i lf32=_mm256_set1_epi16(0x0a);
+while (i+16<=n) {
+   __m256i v=_mm256_loadu_si256((const __m256i*)(s+i));
+   __m256i new_line=_mm256_or_si256(_mm256_cmpeq_epi16(v,cr32),_mm256_cmpeq_epi16(v,lf32));
+   __m256i separator=_mm256_or_si256(new_line,_mm256_or_si256(_mm256_cmpeq_epi16(v,space32),_mm256_cmpeq_epi16(v,tab32)));
+   unsigned int separator_mask=(unsigned int)_mm256_movemask_epi8(separator);
+   unsigned int new_line_mask=(unsigned int)_mm256_movemask_epi8(new_line);
+   if (separator_mask==0xFFFFFFFFu) {
+      if (new_line_mask!=0) *enter=1;
+      i=i+16;
+      continue;
+   }
+   int k=count_trailing_ones(separator_mask);
+   if (new_line_mask & ((1u<<k)-1)) *enter=1;
+   return i+k/2;
+}
+#endif
+#ifdef TOKENIZE_USE_SSE2
+const __m128i space=_mm_set1_epi16(' ');
+const __m128i tab=_mm_set1_epi16('\t');
+const __m128i cr=_mm_set1_epi16(0x0d);
+const __m128i lf=_mm_set1_epi16(0x0a);
+while (i+8<=n) {
+   __m128i v=_mm_loadu_si128((const __m128i*)(s+i));
+   __m128i new_line=_mm_or_si128(_mm_cmpeq_epi16(v,cr),_mm_cmpeq_epi16(v,lf));
+   __m128i separator=_mm_or_si128(new_line,_mm_or_si128(_mm_cmpeq_epi16(v,space),_mm_cmpeq_epi16(v,tab)));
+   /* Each character gives 2 bits in the masks */
+   unsigned int separator_mask=(unsigned int)_mm_movemask_epi8(separator);
+   unsigned int new_line_mask=(unsigned int)_mm_movemask_epi8(new_line);
+   if (separator_mask==0xFFFFu) {
+      if (new_line_mask!=0) *enter=1;
+      i=i+8;
+      continue;
+   }
+   int k=count_trailing_ones(separator_mask);
+   if (new_line_mask & ((1u<<k)-1)) *enter=1;
+   return i+k/2;
+}
+#endif
+for (;i<n;i++) {
+   unichar c=s[i];
+   if (c==0x0d || c==0x0a) *enter=1;
+   else if (c!=' ' && c!='\t') break;
+}
+return i;
+}
+
+
+/**
+ * Same as is_letter, but inlined: the case flags of the alphabet are
+ * read directly, since they tell which characters are letters.
+ */
+static inline int is_token_letter(unichar c,const Alphabet* alph) {
+if (alph==NULL) {
+   return u_is_letter(c);
+}
+return CASE_FLAG_MACRO(c,alph)!=0;
+}
+
+
+#define TOKENIZE_MAX_LETTER_RANGES 2
+
+/**
+ * Ranges [start,start+length[ of ASCII letters of the alphabet. Letter
+ * sequences are scanned with vector comparisons against these ranges, and
+ * only the characters outside them, like accented letters, are looked up
+ * in the alphabet. Usual alphabets need 2 ranges, A-Z and a-z. If the ASCII
+ * letters do not fit in TOKENIZE_MAX_LETTER_RANGES ranges, the remaining ones
+ * are looked up too: every range tested costs 4 vector operations for each
+ * block of characters. Unused ranges are empty, so that all ranges can always
+ * be tested.
+ */
+struct letter_ranges {
+   unichar start[TOKENIZE_MAX_LETTER_RANGES];
+   unichar length[TOKENIZE_MAX_LETTER_RANGES];
+};
+
+
+static void compute_letter_ranges(const Alphabet* alph,struct letter_ranges* r) {
+int n=0;
+unichar c=0;
+while (c<0x80 && n<TOKENIZE_MAX_LETTER_RANGES) {
+   if (!is_token_letter(c,alph)) {
+      c++;
+      continue;
+   }
+   unichar start=c;
+   while (c<0x80 && is_token_letter(c,alph)) c++;
+   r->start[n]=start;
+   r->length[n]=(unichar)(c-start);
+   n++;
+}
+for (;n<TOKENIZE_MAX_LETTER_RANGES;n++) {
+   r->start[n]=0;
+   r->length[n]=0;
+}
+}
+
+
+#ifdef TOKENIZE_USE_SSE2
+/**
+ * Returns the position of the first character at or after 'i' that is not
+ * in the letter ranges, or the position where less than 8 characters are
+ * left before 'n'. SSE2 has no unsigned 16-bit comparison, so c-start<length
+ * is tested as a signed comparison after flipping the sign bit of both sides.
+ */
+static inline int skip_letter_ranges(const unichar* s,int i,int n,const struct letter_ranges* r) {
+#ifdef TOKENIZE_USE_AVX2
+const __m256i bias32=_mm256_set1_epi16((short)0x8000);
+while (i+16<=n) {
+   __m256i v=_mm256_loadu_si256((const __m256i*)(s+i));
+   __m256i letter=_mm256_setzero_si256();
+   for (int j=0;j<TOKENIZE_MAX_LETTER_RANGES;j++) {
+      __m256i x=_mm256_xor_si256(_mm256_sub_epi16(v,_mm256_set1_epi16((short)r->start[j])),bias32);
+      letter=_mm256_or_si256(letter,_mm256_cmpgt_epi16(_mm256_set1_epi16((short)(r->length[j]^0x8000)),x));
+   }
+   /* Each character gives 2 bits in the mask */
+   unsigned int mask=(unsigned int)_mm256_movemask_epi8(letter);
+   if (mask!=0xFFFFFFFFu) {
+      return i+count_trailing_ones(mask)/2;
+   }
+   i=i+16;
+}
+#endif
+const __m128i bias=_mm_set1_epi16((short)0x8000);
+while (i+8<=n) {
+   __m128i v=_mm_loadu_si128((const __m128i*)(s+i));
+   __m128i letter=_mm_setzero_si128();
+   for (int j=0;j<TOKENIZE_MAX_LETTER_RANGES;j++) {
+      __m128i x=_mm_xor_si128(_mm_sub_epi16(v,_mm_set1_epi16((short)r->start[j])),bias);
+      letter=_mm_or_si128(letter,_mm_cmplt_epi16(x,_mm_set1_epi16((short)(r->length[j]^0x8000))));
+   }
+   unsigned int mask=(unsigned int)_mm_movemask_epi8(letter);
+   if (mask!=0xFFFFu) {
+      return i+count_trailing_ones(mask)/2;
+   }
+   i=i+8;
+}
+return i;
+}
+#endif
+
+
+/**
+ * Returns the length of the sequence of letters that starts at 's', looking
+ * at no more than 'n' characters. When SSE2 is available, the ASCII letters
+ * described by 'r' are skipped 8 (or 16 with AVX2) characters at a time.
+ */
+static inline int scan_letters(const unichar* s,int n,const Alphabet* alph,const struct letter_ranges* r) {
+int i=0;
+for (;;) {
+#ifdef TOKENIZE_USE_SSE2
+   i=skip_letter_ranges(s,i,n,r);
+#endif
+   /* The character that stopped the vector scan may still be a letter
+    * that is not in the ranges, like an accented one */
+   if (i==n || !is_token_letter(s[i],alph)) return i;
+   i++;
+}
+}
+
 #define TOKENIZE_ORIGINAL_TOKEN_BUFFER_SIZE 0x400
 
+/**
+ * This structure contains everything needed to tokenize a text, token by
+ * token, with the tokenize_token function. The text is read from 'buffer',
+ * that is refilled from 'f' when 'f' is not NULL; when 'f' is NULL, 'buffer'
+ * contains the whole text to tokenize and it is never modified. Token numbers
+ * are either written to 'coded_text' or, if 'codes' is not NULL, appended to
+ * 'codes'. 'COUNT' is the position of the current character 'c' in the text.
+ */
+struct tokenize_state {
+   U_FILE* f;
+   unichar* buffer;
+   unsigned int pos_in_buffer;
+   unsigned int filled_in_buffer;
+   int c;
+   int COUNT;
+   Alphabet* alph;
+   int char_by_char;
+   unichar* token_buffer;
+   size_t token_buffer_size;
+   vector_ptr* tokens;
+   struct hash_table* hashtable;
+   vector_int* n_occur;
+   vector_int* n_enter_pos;
+   vector_int* snt_offsets;
+   /* The total shift induced by separator normalization */
+   int snt_offsets_shift;
+   int SENTENCES;
+   int TOKENS_TOTAL;
+   int WORDS_TOTAL;
+   int DIGITS_TOTAL;
+   U_FILE* coded_text;
+   unsigned char write_buffer[(TOKENIZE_WRITE_BUFFER_SIZE * 4) + 0x10];
+   unsigned int pos_out_buffer;
+   vector_int* codes;
+   U_FILE* f_out_offsets;
+   vector_offset* v_in_offsets;
+   int offset_index;
+   int shift;
+   /* Set to a non null value if an offset could not be saved */
+   int offset_error;
+   struct letter_ranges letters;
+};
+
+
+/**
+ * Initializes the given state to tokenize the 'filled' characters of 'buffer'
+ * and then, if 'f' is not NULL, the rest of 'f'. Codes are written into
+ * 'coded_text'. Returns ALLOC_ERROR_CODE if the token buffer cannot be
+ * allocated.
+ */
+static int init_tokenize_state(struct tokenize_state* s,U_FILE* f,unichar* buffer,int filled,
+                               Alphabet* alph,int char_by_char,
+                               vector_ptr* tokens,struct hash_table* hashtable,vector_int* n_occur,
+                               vector_int* n_enter_pos,vector_int* snt_offsets,U_FILE* coded_text) {
+s->f=f;
+s->buffer=buffer;
+s->pos_in_buffer=0;
+s->filled_in_buffer=filled;
+s->COUNT=0;
+s->alph=alph;
+s->char_by_char=char_by_char;
+s->token_buffer_size=TOKENIZE_ORIGINAL_TOKEN_BUFFER_SIZE;
+s->token_buffer=(unichar*)malloc(sizeof(unichar)*s->token_buffer_size);
+if (s->token_buffer==NULL) {
+   alloc_error("init_tokenize_state");
+   return ALLOC_ERROR_CODE;
+}
+s->tokens=tokens;
+s->hashtable=hashtable;
+s->n_occur=n_occur;
+s->n_enter_pos=n_enter_pos;
+s->snt_offsets=snt_offsets;
+s->snt_offsets_shift=0;
+s->SENTENCES=0;
+s->TOKENS_TOTAL=0;
+s->WORDS_TOTAL=0;
+s->DIGITS_TOTAL=0;
+s->coded_text=coded_text;
+s->pos_out_buffer=0;
+s->codes=NULL;
+s->f_out_offsets=NULL;
+s->v_in_offsets=NULL;
+s->offset_index=0;
+s->shift=0;
+s->offset_error=0;
+compute_letter_ranges(alph,&(s->letters));
+if (s->filled_in_buffer==0 && f!=NULL) {
+   s->c=fast_u_fgetc_raw(f,buffer,&(s->pos_in_buffer),&(s->filled_in_buffer));
+} else {
+   s->c=(s->filled_in_buffer==0) ? EOF : buffer[s->pos_in_buffer++];
+}
+return SUCCESS_RETURN_CODE;
+}
+
+
+/**
+ * Returns the next character of the text, or EOF.
+ */
+static inline int next_tokenize_char(struct tokenize_state* s) {
+if (s->pos_in_buffer<s->filled_in_buffer) {
+   return s->buffer[s->pos_in_buffer++];
+}
+if (s->f==NULL) {
+   return EOF;
+}
+return fast_u_fgetc_raw(s->f,s->buffer,&(s->pos_in_buffer),&(s->filled_in_buffer));
+}
+
+
+/**
+ * Gets the number of the token in the token buffer, and saves it with its offsets.
+ */
+static void add_tokenize_token(struct tokenize_state* s,int current_pos) {
+int n=get_token_number(s->token_buffer,s->tokens,s->hashtable,s->n_occur);
+if (save_token_offset(s->f_out_offsets,s->token_buffer,n,current_pos,s->COUNT,s->v_in_offsets,
+                      &(s->offset_index),&(s->shift))) {
+   s->offset_error=1;
+}
+if (s->codes!=NULL) {
+   vector_int_add(s->codes,n);
+} else {
+   fast_fwrite_raw(s->coded_text,n,s->write_buffer,&(s->pos_out_buffer),TOKENIZE_WRITE_BUFFER_SIZE);
+}
+(s->TOKENS_TOTAL)++;
+}
+
+
+/**
+ * Reads the token that starts with the current character, and saves it.
+ * Sequences of separators are turned into a single space, tags like
+ * {aujourd'hui,.ADV} are checked, and words are sequences of letters, or
+ * single letters in char by char mode. Returns DEFAULT_ERROR_CODE if the
+ * text contains an invalid tag.
+ */
+static int tokenize_token(struct tokenize_state* s) {
+int current_pos=s->COUNT;
+int c=s->c;
+(s->COUNT)++;
+if (c==' ' || c==0x0d || c==0x0a || c=='\t') {
+   char ENTER=0;
+   if (c==0x0d || c==0x0a) ENTER=1;
+   // if the char is a separator, we jump all the separators, scanning
+   // the read buffer directly as long as possible
+   for (;;) {
+      int k=scan_separators(s->buffer+s->pos_in_buffer,(int)(s->filled_in_buffer-s->pos_in_buffer),&ENTER);
+      s->pos_in_buffer+=k;
+      s->COUNT+=k;
+      if (s->pos_in_buffer<s->filled_in_buffer) {
+         /* The separator sequence ends in the buffer */
+         c=s->buffer[s->pos_in_buffer++];
+         break;
+      }
+      c=next_tokenize_char(s);
+      if (c!=' ' && c!=0x0d && c!=0x0a && c!='\t') break;
+      if (c==0x0d || c==0x0a) ENTER=1;
+      (s->COUNT)++;
+   }
+   s->token_buffer[0]=' ';
+   s->token_buffer[1]='\0';
+   if (s->COUNT-current_pos!=1) {
+      /* If there is a shift with the .snt file */
+      add_snt_offsets(s->snt_offsets,s->TOKENS_TOTAL,s->snt_offsets_shift,s->snt_offsets_shift+(s->COUNT-current_pos-1));
+      s->snt_offsets_shift+=(s->COUNT-current_pos-1);
+   }
+   /* If there is a \n, we note it */
+   if (ENTER==1) {
+      vector_int_add(s->n_enter_pos,s->TOKENS_TOTAL);
+   }
+   add_tokenize_token(s,current_pos);
+}
+else if (c=='{') {
+   s->token_buffer[0]='{';
+   int z=1;
+   bool protected_char=false; // Cassys add
+   while (((c=next_tokenize_char(s))!='}' && c!='{' && c!='\n' && c!=EOF) || (protected_char && c!=EOF)) {
+      protected_char=(c=='\\'); // Cassys add
+      enlarge_token_buffer_if_needed(&(s->token_buffer),&(s->token_buffer_size),z+2);
+      s->token_buffer[z++]=(unichar)c;
+      (s->COUNT)++;
+   }
+   if (c!='}') {
+      // if the tag has no ending }
+      enlarge_token_buffer_if_needed(&(s->token_buffer),&(s->token_buffer_size),z+1);
+      s->token_buffer[z]='\0';
+      error("Error: a tag without ending } has been found:\n%S\n",s->token_buffer);
+      return DEFAULT_ERROR_CODE;
+   }
+   enlarge_token_buffer_if_needed(&(s->token_buffer),&(s->token_buffer_size),z+2);
+   s->token_buffer[z]='}';
+   s->token_buffer[z+1]='\0';
+   if (!u_strcmp(s->token_buffer,"{S}")) {
+      // if we have found a sentence delimiter
+      (s->SENTENCES)++;
+   } else if (u_strcmp(s->token_buffer,"{STOP}") && !check_tag_token(s->token_buffer,1)) {
+      // if a tag is incorrect, we exit
+      error("The text contains an invalid tag. Unitex cannot process it.");
+      return DEFAULT_ERROR_CODE;
+   }
+   (s->COUNT)++;
+   add_tokenize_token(s,current_pos);
+   c=next_tokenize_char(s);
+}
+else {
+   s->token_buffer[0]=(unichar)c;
+   int n=1;
+   int letter=is_token_letter(s->token_buffer[0],s->alph);
+   if (!letter || s->char_by_char) {
+      s->token_buffer[1]='\0';
+      if (letter) (s->WORDS_TOTAL)++;
+      if (c>='0' && c<='9') (s->DIGITS_TOTAL)++;
+      add_tokenize_token(s,current_pos);
+      c=next_tokenize_char(s);
+   }
+   else {
+      // we copy the letters that are in the read buffer at once
+      for (;;) {
+         int k=scan_letters(s->buffer+s->pos_in_buffer,(int)(s->filled_in_buffer-s->pos_in_buffer),s->alph,&(s->letters));
+         enlarge_token_buffer_if_needed(&(s->token_buffer),&(s->token_buffer_size),n+k+2);
+         memcpy(s->token_buffer+n,s->buffer+s->pos_in_buffer,k*sizeof(unichar));
+         n+=k;
+         s->pos_in_buffer+=k;
+         s->COUNT+=k;
+         if (s->pos_in_buffer<s->filled_in_buffer) {
+            /* The letter sequence ends in the buffer */
+            c=s->buffer[s->pos_in_buffer++];
+            break;
+         }
+         c=next_tokenize_char(s);
+         if (EOF==c || !is_token_letter((unichar)c,s->alph)) break;
+         enlarge_token_buffer_if_needed(&(s->token_buffer),&(s->token_buffer_size),n+2);
+         s->token_buffer[n++]=(unichar)c;
+         (s->COUNT)++;
+      }
+      enlarge_token_buffer_if_needed(&(s->token_buffer),&(s->token_buffer_size),n+1);
+      s->token_buffer[n]='\0';
+      (s->WORDS_TOTAL)++;
+      add_tokenize_token(s,current_pos);
+   }
+}
+s->c=c;
+return SUCCESS_RETURN_CODE;
+}
+
+
 static int tokenization(U_FILE* f_read,U_FILE* coded_text,U_FILE* output,Alphabet* alph,
                          vector_ptr* tokens,struct hash_table* hashtable,
                          vector_int* n_occur,vector_int* n_enter_pos,
@@ -668,151 +1135,287 @@ static int tokenization(U_FILE* f_read,U_FILE* coded_text,U_FILE* output,Alphabe
                          int *SENTENCES,int *TOKENS_TOTAL,int *WORDS_TOTAL,
                          int *DIGITS_TOTAL,U_FILE* f_out_offsets,vector_offset* v_in_offsets,
                          int char_by_char) {
-int c;
-int n;
-char ENTER;
-int COUNT=0;
 int current_megabyte=0;
-int shift=0;
 unichar read_buffer[TOKENIZE_GET_BUFFER_SIZE];
-unsigned char write_buffer[(TOKENIZE_WRITE_BUFFER_SIZE * 4) + 0x10];
-unsigned int pos_in_buffer = 0;
-unsigned int filled_in_buffer = 0;
-unsigned int pos_out_buffer = 0;
-c = fast_u_fgetc_raw(f_read, read_buffer, &pos_in_buffer, &filled_in_buffer);
-int current_pos;
-int snt_offsets_shift=0;
-int offset_index=0;
-int result=0; // 0 = no error
-size_t token_buffer_size = TOKENIZE_ORIGINAL_TOKEN_BUFFER_SIZE;
-unichar * token_buffer = (unichar*)malloc(sizeof(unichar)*token_buffer_size);
-if (token_buffer == NULL) {
-  alloc_error("tokenization");
+struct tokenize_state s;
+if (init_tokenize_state(&s,f_read,read_buffer,0,alph,char_by_char,tokens,hashtable,n_occur,
+                        n_enter_pos,snt_offsets,coded_text)!=SUCCESS_RETURN_CODE) {
   return ALLOC_ERROR_CODE;
 }
-while ((c!=EOF) && (result == 0)) {
-   current_pos=COUNT;
-   COUNT++;
-   if ((COUNT/(1024*512))!=current_megabyte) {
+s.f_out_offsets=f_out_offsets;
+s.v_in_offsets=v_in_offsets;
+int result=SUCCESS_RETURN_CODE;
+while ((s.c!=EOF) && (s.offset_error==0) && (result==SUCCESS_RETURN_CODE)) {
+   if (((s.COUNT+1)/(1024*512))!=current_megabyte) {
       current_megabyte++;
-      int z=(COUNT/(1024*512));
+      int z=((s.COUNT+1)/(1024*512));
       u_printf("%d megabyte%s read...       \r",z,(z>1)?"s":"");
    }
-   if (c==' ' || c==0x0d || c==0x0a || c=='\t') {
-      ENTER=0;
-      if (c==0x0d || c==0x0a) ENTER=1;
-      // if the char is a separator, we jump all the separators
-      while ((c = fast_u_fgetc_raw(f_read, read_buffer, &pos_in_buffer, &filled_in_buffer)) == ' ' || c == 0x0d || c == 0x0a || c == '\t') {
-        if (c==0x0d || c==0x0a) ENTER=1;
-        COUNT++;
-      }
-      token_buffer[0]=' ';
-      token_buffer[1]='\0';
-      n=get_token_number(token_buffer,tokens,hashtable,n_occur);
-      if (COUNT-current_pos!=1) {
-          /* If there is a shift with the .snt file */
-          add_snt_offsets(snt_offsets,*TOKENS_TOTAL,snt_offsets_shift,snt_offsets_shift+(COUNT-current_pos-1));
-          snt_offsets_shift+=(COUNT-current_pos-1);
+   result=tokenize_token(&s);
+}
+free(s.token_buffer);
+(*SENTENCES)+=s.SENTENCES;
+(*TOKENS_TOTAL)+=s.TOKENS_TOTAL;
+(*WORDS_TOTAL)+=s.WORDS_TOTAL;
+(*DIGITS_TOTAL)+=s.DIGITS_TOTAL;
+if (result!=SUCCESS_RETURN_CODE) {
+   return result;
+}
+fast_fwrite_raw_flush(coded_text,s.write_buffer,&(s.pos_out_buffer));
+for (int n=0;n<tokens->nbelems;n++) {
+   u_fprintf(output,"%S\n",tokens->tab[n]);
+}
+if (s.offset_error!=0) {
+   u_printf("Unsucessfull.\n");
+   return DEFAULT_ERROR_CODE;
+}
+return SUCCESS_RETURN_CODE;
+}
+
+
+/* When tokenizing in threads, the text is read by blocks of n_threads chunks
+ * of about TOKENIZE_CHUNK_SIZE characters */
+#define TOKENIZE_CHUNK_SIZE 0x100000
+
+static inline int is_tokenize_separator(unichar c) {
+return c==' ' || c==0x0d || c==0x0a || c=='\t';
+}
+
+
+/**
+ * Returns 1 if a chunk of text can start at the given position, i.e. if the
+ * tokenization of the text before and after this position gives the same
+ * tokens as the tokenization of the whole text. This is the case after a
+ * separator sequence that contains a new line, provided that this new line
+ * cannot be a protected character in a tag like {a\<new line>b}.
+ */
+static int is_chunk_boundary(const unichar* text,int pos) {
+return pos>=2 && text[pos-1]==0x0a && text[pos-2]!='\\' && !is_tokenize_separator(text[pos]);
+}
+
+
+/**
+ * This structure contains the result of the tokenization of a chunk of text.
+ * Tokens are numbered locally to the chunk, in the order of their first
+ * occurrence, and positions are relative to the start of the chunk.
+ */
+struct tokenize_chunk {
+   const unichar* text;
+   int length;
+   Alphabet* alph;
+   int char_by_char;
+   vector_ptr* tokens;
+   struct hash_table* hashtable;
+   vector_int* n_occur;
+   vector_int* codes;
+   vector_int* n_enter_pos;
+   vector_int* snt_offsets;
+   /* The total shift induced by separator normalization in this chunk */
+   int snt_offsets_shift;
+   int SENTENCES;
+   int WORDS_TOTAL;
+   int DIGITS_TOTAL;
+   int result;
+};
+
+
+/**
+ * Tokenizes a chunk of text exactly as the tokenization function does,
+ * except that offsets are not handled.
+ */
+static void ABSTRACT_CALLBACK_UNITEX tokenize_chunk_thread(void* private_ptr,unsigned int /* num_worker */) {
+struct tokenize_chunk* t=(struct tokenize_chunk*)private_ptr;
+struct tokenize_state s;
+/* The chunk is never modified, since there is no file to refill it from */
+t->result=init_tokenize_state(&s,NULL,(unichar*)t->text,t->length,t->alph,t->char_by_char,
+                              t->tokens,t->hashtable,t->n_occur,t->n_enter_pos,t->snt_offsets,NULL);
+if (t->result!=SUCCESS_RETURN_CODE) {
+   return;
+}
+s.codes=t->codes;
+while (s.c!=EOF && t->result==SUCCESS_RETURN_CODE) {
+   t->result=tokenize_token(&s);
+}
+t->snt_offsets_shift=s.snt_offsets_shift;
+t->SENTENCES=s.SENTENCES;
+t->WORDS_TOTAL=s.WORDS_TOTAL;
+t->DIGITS_TOTAL=s.DIGITS_TOTAL;
+free(s.token_buffer);
+}
+
+
+/**
+ * Adds the tokens of the given chunk to the global token list, replaces the
+ * local token numbers of the chunk by the global ones, and saves them. Since
+ * chunks are merged in text order, and local numbers follow the order of the
+ * first occurrences in the chunk, tokens get the same numbers as with a
+ * sequential tokenization.
+ */
+static void merge_tokenize_chunk(struct tokenize_chunk* t,U_FILE* coded_text,
+                                 vector_ptr* tokens,struct hash_table* hashtable,
+                                 vector_int* n_occur,vector_int* n_enter_pos,vector_int* snt_offsets,
+                                 int *snt_offsets_shift,int *SENTENCES,int *TOKENS_TOTAL,
+                                 int *WORDS_TOTAL,int *DIGITS_TOTAL) {
+int* global_number=(int*)malloc(sizeof(int)*(t->tokens->nbelems+1));
+if (global_number==NULL) {
+   fatal_alloc_error("merge_tokenize_chunk");
+}
+for (int i=0;i<t->tokens->nbelems;i++) {
+   int n=get_token_number((unichar*)t->tokens->tab[i],tokens,hashtable,n_occur);
+   /* get_token_number has already counted one occurrence */
+   n_occur->tab[n]+=t->n_occur->tab[i]-1;
+   global_number[i]=n;
+}
+for (int i=0;i<t->codes->nbelems;i++) {
+   t->codes->tab[i]=global_number[t->codes->tab[i]];
+}
+fwrite(t->codes->tab,sizeof(int),t->codes->nbelems,coded_text);
+free(global_number);
+for (int i=0;i<t->n_enter_pos->nbelems;i++) {
+   vector_int_add(n_enter_pos,(*TOKENS_TOTAL)+t->n_enter_pos->tab[i]);
+}
+for (int i=0;i<t->snt_offsets->nbelems;i=i+3) {
+   add_snt_offsets(snt_offsets,(*TOKENS_TOTAL)+t->snt_offsets->tab[i],
+                   (*snt_offsets_shift)+t->snt_offsets->tab[i+1],
+                   (*snt_offsets_shift)+t->snt_offsets->tab[i+2]);
+}
+(*snt_offsets_shift)+=t->snt_offsets_shift;
+(*TOKENS_TOTAL)+=t->codes->nbelems;
+(*SENTENCES)+=t->SENTENCES;
+(*WORDS_TOTAL)+=t->WORDS_TOTAL;
+(*DIGITS_TOTAL)+=t->DIGITS_TOTAL;
+}
+
+
+static void init_tokenize_chunk(struct tokenize_chunk* t,const unichar* text,int length,
+                                Alphabet* alph,int char_by_char) {
+t->text=text;
+t->length=length;
+t->alph=alph;
+t->char_by_char=char_by_char;
+t->tokens=new_vector_ptr(4096);
+t->hashtable=new_hash_table((HASH_FUNCTION)hash_unichar,(EQUAL_FUNCTION)u_equal,
+                            (FREE_FUNCTION)free,NULL,(KEYCOPY_FUNCTION)keycopy);
+t->n_occur=new_vector_int(4096);
+t->codes=new_vector_int(length/2+1);
+t->n_enter_pos=new_vector_int(1024);
+t->snt_offsets=new_vector_int(1024);
+t->snt_offsets_shift=0;
+t->SENTENCES=0;
+t->WORDS_TOTAL=0;
+t->DIGITS_TOTAL=0;
+t->result=SUCCESS_RETURN_CODE;
+}
+
+
+static void free_tokenize_chunk(struct tokenize_chunk* t) {
+free_vector_ptr(t->tokens,free);
+free_hash_table(t->hashtable);
+free_vector_int(t->n_occur);
+free_vector_int(t->codes);
+free_vector_int(t->n_enter_pos);
+free_vector_int(t->snt_offsets);
+}
+
+
+/**
+ * Tokenizes the text with several threads. The text is read by blocks that
+ * are split at new lines into chunks tokenized in parallel, and the chunk
+ * results are then merged in text order. The produced files are the same as
+ * with the tokenization function, but offsets cannot be produced this way.
+ */
+static int threaded_tokenization(U_FILE* f_read,U_FILE* coded_text,U_FILE* output,Alphabet* alph,
+                         vector_ptr* tokens,struct hash_table* hashtable,
+                         vector_int* n_occur,vector_int* n_enter_pos,
+                         vector_int* snt_offsets,
+                         int *SENTENCES,int *TOKENS_TOTAL,int *WORDS_TOTAL,
+                         int *DIGITS_TOTAL,int char_by_char,int n_threads) {
+int capacity=n_threads*TOKENIZE_CHUNK_SIZE;
+unichar* text=(unichar*)malloc(sizeof(unichar)*capacity);
+struct tokenize_chunk* chunks=(struct tokenize_chunk*)malloc(sizeof(struct tokenize_chunk)*n_threads);
+void** chunk_ptrs=(void**)malloc(sizeof(void*)*n_threads);
+if (text==NULL || chunks==NULL || chunk_ptrs==NULL) {
+   alloc_error("threaded_tokenization");
+   free(text);
+   free(chunks);
+   free(chunk_ptrs);
+   return ALLOC_ERROR_CODE;
+}
+int filled=0;
+int eof=0;
+int snt_offsets_shift=0;
+long long total_read=0;
+int current_megabyte=0;
+int result=SUCCESS_RETURN_CODE;
+while (result==SUCCESS_RETURN_CODE && (!eof || filled>0)) {
+   while (!eof && filled<capacity) {
+      int n=u_fget_unichars_raw(text+filled,capacity-filled,f_read);
+      if (n<=0) {
+         eof=1;
+      } else {
+         filled+=n;
       }
-      result=save_token_offset(f_out_offsets,token_buffer,n,current_pos,COUNT,v_in_offsets,&offset_index,&shift);
-      /* If there is a \n, we note it */
-      if (ENTER==1) {
-         vector_int_add(n_enter_pos,*TOKENS_TOTAL);
+   }
+   /* The text is processed up to the last chunk boundary, unless we
+    * have reached the end of the file */
+   int end=filled;
+   if (!eof) {
+      for (end=filled-1;end>0 && !is_chunk_boundary(text,end);end--) {}
+      if (end==0) {
+         /* If there is no new line in the whole block, we enlarge it */
+         unichar* new_text=(unichar*)realloc(text,sizeof(unichar)*capacity*2);
+         if (new_text==NULL) {
+            alloc_error("threaded_tokenization");
+            result=ALLOC_ERROR_CODE;
+            break;
+         }
+         text=new_text;
+         capacity=capacity*2;
+         continue;
       }
-      (*TOKENS_TOTAL)++;
-      fast_fwrite_raw(coded_text, n, write_buffer, &pos_out_buffer, TOKENIZE_WRITE_BUFFER_SIZE);
    }
-   else if (c=='{') {
-     token_buffer[0]='{';
-     int z=1;
-     bool protected_char = false; // Cassys add
-     while ((((c = fast_u_fgetc_raw(f_read, read_buffer, &pos_in_buffer, &filled_in_buffer)) != '}' && c
-                    != '{' && c != '\n') || protected_char)) {
-            protected_char = false; // Cassys add
-            if (c == '\\') { // Cassys add
-                protected_char = true; // Cassys add
-            } // Cassys add
-            enlarge_token_buffer_if_needed(&token_buffer, &token_buffer_size, z+2);
-            token_buffer[z++] = (unichar) c;
-            COUNT++;
-    }
-
-     if (c!='}') {
-        // if the tag has no ending }
-        enlarge_token_buffer_if_needed(&token_buffer, &token_buffer_size, z + 1);
-        token_buffer[z]='\0';
-        error("Error: a tag without ending } has been found:\n%S\n",token_buffer);
-        free(token_buffer);
-        return DEFAULT_ERROR_CODE;
-     }
-     if (c=='\n') {
-        // if the tag contains a return
-        error("Error: a tag containing a new-line sequence has been found\n");
-        free(token_buffer);
-        return DEFAULT_ERROR_CODE;
-     }
-     enlarge_token_buffer_if_needed(&token_buffer, &token_buffer_size, z + 2);
-     token_buffer[z]='}';
-     token_buffer[z+1]='\0';
-     if (!u_strcmp(token_buffer,"{S}")) {
-        // if we have found a sentence delimiter
-        (*SENTENCES)++;
-     } else {
-        if (u_strcmp(token_buffer,"{STOP}") && !check_tag_token(token_buffer,1)) {
-           // if a tag is incorrect, we exit
-           error("The text contains an invalid tag. Unitex cannot process it.");
-           free(token_buffer);
-           return DEFAULT_ERROR_CODE;
-        }
-     }
-     n=get_token_number(token_buffer,tokens,hashtable,n_occur);
-     COUNT++;
-     result=save_token_offset(f_out_offsets,token_buffer,n,current_pos,COUNT,v_in_offsets,&offset_index,&shift);
-     (*TOKENS_TOTAL)++;
-     fast_fwrite_raw(coded_text, n, write_buffer, &pos_out_buffer, TOKENIZE_WRITE_BUFFER_SIZE);
-     c = fast_u_fgetc_raw(f_read, read_buffer, &pos_in_buffer, &filled_in_buffer);
+   /* Then, we split the block into chunks */
+   int n_chunks=0;
+   int start=0;
+   while (start<end) {
+      int chunk_end=end;
+      if (n_chunks<n_threads-1) {
+         for (chunk_end=start+1+(end-start)/(n_threads-n_chunks);
+              chunk_end<end && !is_chunk_boundary(text,chunk_end);chunk_end++) {}
+      }
+      init_tokenize_chunk(chunks+n_chunks,text+start,chunk_end-start,alph,char_by_char);
+      chunk_ptrs[n_chunks]=chunks+n_chunks;
+      n_chunks++;
+      start=chunk_end;
    }
-   else {
-      token_buffer[0]=(unichar)c;
-      n=1;
-      if (!is_letter(token_buffer[0],alph) || char_by_char) {
-         token_buffer[1]='\0';
-         if (is_letter(token_buffer[0],alph)) (*WORDS_TOTAL)++;
-         n=get_token_number(token_buffer,tokens,hashtable,n_occur);
-         result=save_token_offset(f_out_offsets,token_buffer,n,current_pos,COUNT,v_in_offsets,&offset_index,
-                 &shift);
-         (*TOKENS_TOTAL)++;
-         if (c>='0' && c<='9') (*DIGITS_TOTAL)++;
-         fast_fwrite_raw(coded_text, n, write_buffer, &pos_out_buffer, TOKENIZE_WRITE_BUFFER_SIZE);
-         c = fast_u_fgetc_raw(f_read, read_buffer, &pos_in_buffer, &filled_in_buffer);
+   SyncRunWorkerThreads((unsigned int)n_chunks,tokenize_chunk_thread,chunk_ptrs);
+   for (int i=0;i<n_chunks;i++) {
+      if (result==SUCCESS_RETURN_CODE) {
+         result=chunks[i].result;
       }
-      else {
-          while (EOF != (c = fast_u_fgetc_raw(f_read, read_buffer, &pos_in_buffer, &filled_in_buffer)) && is_letter((unichar)c, alph)) {
-           enlarge_token_buffer_if_needed(&token_buffer, &token_buffer_size, n + 2);
-           token_buffer[n++]=(unichar)c;
-           COUNT++;
-         }
-         enlarge_token_buffer_if_needed(&token_buffer, &token_buffer_size, n + 1);
-         token_buffer[n]='\0';
-         n=get_token_number(token_buffer,tokens,hashtable,n_occur);
-         result=save_token_offset(f_out_offsets,token_buffer,n,current_pos,COUNT,v_in_offsets,&offset_index,
-                 &shift);
-         (*TOKENS_TOTAL)++;
-         (*WORDS_TOTAL)++;
-         fast_fwrite_raw(coded_text, n, write_buffer, &pos_out_buffer, TOKENIZE_WRITE_BUFFER_SIZE);
+      if (result==SUCCESS_RETURN_CODE) {
+         merge_tokenize_chunk(chunks+i,coded_text,tokens,hashtable,n_occur,n_enter_pos,snt_offsets,
+                              &snt_offsets_shift,SENTENCES,TOKENS_TOTAL,WORDS_TOTAL,DIGITS_TOTAL);
       }
+      free_tokenize_chunk(chunks+i);
+   }
+   memmove(text,text+end,sizeof(unichar)*(filled-end));
+   filled=filled-end;
+   total_read=total_read+end;
+   if ((int)(total_read/(1024*512))!=current_megabyte) {
+      current_megabyte=(int)(total_read/(1024*512));
+      u_printf("%d megabyte%s read...       \r",current_megabyte,(current_megabyte>1)?"s":"");
    }
 }
-fast_fwrite_raw_flush(coded_text, write_buffer, &pos_out_buffer);
-for (n=0;n<tokens->nbelems;n++) {
-   u_fprintf(output,"%S\n",tokens->tab[n]);
+free(text);
+free(chunks);
+free(chunk_ptrs);
+if (result!=SUCCESS_RETURN_CODE) {
+   return result;
 }
-if (result!=0) {
-   u_printf("Unsucessfull.\n");
-   free(token_buffer);
-   return DEFAULT_ERROR_CODE;
+for (int n=0;n<tokens->nbelems;n++) {
+   u_fprintf(output,"%S\n",tokens->tab[n]);
 }
-free(token_buffer);
 return SUCCESS_RETURN_CODE;
 }
 
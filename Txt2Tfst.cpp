@@ -116,6 +116,8 @@ const char* usage_Txt2Tfst =
          "  -t XXX/--tagset=XXX: use the XXX ELAG tagset file to normalize the dictionary entries\n"
          "  -K/--korean: tells Txt2Tfst that it works on Korean\n"
          "  -S/--no_statistics: do not produce statistics file\n"
+         "  -b/--binary: save the text automaton in the binary .tfst format that can be\n"
+         "               mapped in memory by the programs that read it\n"
          "  -V/--only-verify-arguments: only verify arguments syntax and exit\n"
          "  -h/--help: this help\n"
          "\n"
@@ -132,7 +134,7 @@ static void usage() {
 }
 
 
-const char* optstring_Txt2Tfst=":a:cn:t:KVhk:q:S";
+const char* optstring_Txt2Tfst=":a:cn:t:KVhk:q:Sb";
 const struct option_TS lopts_Txt2Tfst[]={
   {"alphabet", required_argument_TS, NULL, 'a'},
   {"clean", no_argument_TS, NULL, 'c'},
@@ -144,6 +146,7 @@ const struct option_TS lopts_Txt2Tfst[]={
   {"input_encoding",required_argument_TS,NULL,'k'},
   {"output_encoding",required_argument_TS,NULL,'q'},
   {"no_statistics",no_argument_TS,NULL,'S'},
+  {"binary",no_argument_TS,NULL,'b'},
   {NULL, no_argument_TS, NULL, 0}
 };
 
@@ -155,6 +158,7 @@ if (argc==1) {
 }
 
 int save_statistics=1;
+int binary=0;
 char alphabet[FILENAME_MAX]="";
 char norm[FILENAME_MAX]="";
 char tagset[FILENAME_MAX]="";
@@ -189,6 +193,8 @@ while (EOF!=(val=options.parse_long(argc,argv,optstring_Txt2Tfst,lopts_Txt2Tfst,
              break;
    case 'S': save_statistics = 0;
              break;
+   case 'b': binary=1;
+             break;
    case 'V': only_verify_arguments = true;
              break;
    case 'h': usage();
@@ -305,7 +311,7 @@ if (f==NULL) {
 char text_tfst[FILENAME_MAX];
 get_snt_path(argv[options.vars()->optind],text_tfst);
 strcat(text_tfst,"text.tfst");
-U_FILE* tfst=u_fopen(&vec,text_tfst,U_WRITE);
+U_FILE* tfst=binary?u_fopen(BINARY,text_tfst,U_WRITE):u_fopen(&vec,text_tfst,U_WRITE);
 if (tfst==NULL) {
   error("Cannot create %s\n",text_tfst);
   u_fclose(f);
@@ -395,8 +401,13 @@ int N=0;
 int total=0;
 int current_global_position_in_tokens=0;
 int current_global_position_in_chars=0;
-/* We reserve the space for printing the number of sentence automata */
-u_fprintf(tfst,"0000000000\n");
+struct binary_tfst_writer* binary_writer=NULL;
+if (binary) {
+   binary_writer=new_binary_tfst_writer(tfst,tind);
+} else {
+   /* We reserve the space for printing the number of sentence automata */
+   u_fprintf(tfst,"0000000000\n");
+}
 u_printf("Constructing text automaton...\n");
 Ustring* text=new_Ustring(2048);
 struct hash_table* form_frequencies=new_hash_table((HASH_FUNCTION)hash_unichar,(EQUAL_FUNCTION)u_equal,
@@ -404,7 +415,7 @@ struct hash_table* form_frequencies=new_hash_table((HASH_FUNCTION)hash_unichar,(
 
 while (read_sentence(buffer,&N,&total,f,tokens->SENTENCE_MARKER,tokens->SPACE)) {
    /* We compute and save the current sentence description */
-   build_sentence_automaton(buffer,N,tokens,tree,alph,tfst,tind,sentence_number,CLEAN,
+   build_sentence_automaton(buffer,N,tokens,tree,alph,tfst,tind,binary_writer,sentence_number,CLEAN,
             normalization_tree,&tag_list,
             current_global_position_in_tokens,
             current_global_position_in_chars+get_shift(n_enter_char,enter_pos,current_global_position_in_tokens,snt_offsets),
@@ -446,10 +457,13 @@ free_hash_table(form_frequencies);
 free_Ustring(text);
 free_language_t(language);
 free_normalization_tree(normalization_tree);
+close_binary_tfst_writer(binary_writer);
 u_fclose(tind);
 // close tfst before call write_number_of_graphs()
 u_fclose(tfst);
-write_number_of_graphs(&vec,text_tfst,sentence_number-1,0);
+if (!binary) {
+   write_number_of_graphs(&vec,text_tfst,sentence_number-1,0);
+}
 free_text_tokens(tokens);
 delete korean;
 free_alphabet(alph);
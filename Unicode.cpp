@@ -20,12 +20,19 @@
  */
 
 #include <stdio.h>
+#include <limits.h>
 #include "Af_stdio.h"
 static ABSTRACTFILE* (*real_fopen)(const char*,const char*)=af_fopen;
 
 #include "Unicode.h"
 #include "Error.h"
 #include "AbstractAllocator.h"
+#include "base/cpu/extensions.h"
+
+#if defined(UNITEX_HAS_CPU_EXTENSION_SSE2) && UNITEX_HAS_CPU_EXTENSION_SSE2
+#include <emmintrin.h>
+#define UNICODE_USE_SSE2 1
+#endif
 
 #ifndef HAS_UNITEX_NAMESPACE
 #define HAS_UNITEX_NAMESPACE 1
@@ -92,6 +99,37 @@ const unichar* U_EMPTY=&U_NULL;
 const unichar EPSILON[]={'<','E','>','\0'};
 
 
+/**
+ * Size in bytes of the blocks read by the buffer of a U_FILE.
+ */
+#define U_READ_BUFFER_SIZE 0x8000
+
+/**
+ * Read buffer of a U_FILE opened in U_READ mode. 'bytes' contains 'n_bytes'
+ * bytes of the file, starting at offset 'start'. The first 'n_decoded' ones have
+ * been decoded into the 'len' characters of 'chars', and 'pos' is the index of
+ * the next character to be read. The remaining bytes are either an incomplete
+ * sequence that will be completed by the next block, or a sequence that must be
+ * read by the unbuffered functions. In UTF8, 'mark_pos' and 'mark_offset' keep
+ * the byte offset of a character, so that the offset of the current character
+ * can be computed incrementally.
+ *
+ * The arrays are only allocated at the first read, so that files that are read
+ * with fread or directly through their ABSTRACTFILE don't pay for them.
+ */
+struct u_read_buffer {
+   unsigned char* bytes;
+   int n_bytes;
+   int n_decoded;
+   long start;
+   unichar* chars;
+   int len;
+   int pos;
+   int mark_pos;
+   int mark_offset;
+};
+
+
 /**
  * Allocates, initializes and returns a new U_FILE*
  * f is supposed to have been opened.
@@ -100,6 +138,7 @@ U_FILE* new_U_FILE(ABSTRACTFILE* f,Encoding e) {
 U_FILE* u=(U_FILE*)malloc(sizeof(U_FILE));
 u->f=f;
 u->enc=e;
+u->buffer=NULL;
 return u;
 }
 
@@ -109,23 +148,331 @@ return u;
  */
 void free_U_FILE(U_FILE* u) {
 if (u==NULL) return;
+if (u->buffer!=NULL) {
+   free(u->buffer->bytes);
+   free(u->buffer->chars);
+   free(u->buffer);
+}
 free(u);
 }
 
 
-const U_FILE CTE_U_STDIN  = { (ABSTRACTFILE*)pVF_StdIn,  UTF8 };
-const U_FILE CTE_U_STDOUT = { (ABSTRACTFILE*)pVF_StdOut, UTF8 };
-const U_FILE CTE_U_STDERR = { (ABSTRACTFILE*)pVF_StdErr, UTF8 };
+static void reset_u_read_buffer(struct u_read_buffer* b) {
+b->n_bytes=0;
+b->n_decoded=0;
+b->len=0;
+b->pos=0;
+b->mark_pos=0;
+b->mark_offset=0;
+}
+
+
+/**
+ * Attaches a read buffer to the given U_FILE. PLATFORM_DEPENDENT_UTF16 files
+ * are left unbuffered.
+ */
+static void add_u_read_buffer(U_FILE* u) {
+if (u->enc!=UTF16_LE && u->enc!=BIG_ENDIAN_UTF16 && u->enc!=UTF8 && u->enc!=ASCII) {
+   return;
+}
+u->buffer=(struct u_read_buffer*)malloc(sizeof(struct u_read_buffer));
+if (u->buffer==NULL) {
+   fatal_alloc_error("add_u_read_buffer");
+}
+u->buffer->bytes=NULL;
+u->buffer->chars=NULL;
+u->buffer->start=0;
+reset_u_read_buffer(u->buffer);
+}
+
+
+/**
+ * Same as new_U_FILE, for a file opened in U_READ mode.
+ */
+static U_FILE* new_read_U_FILE(ABSTRACTFILE* f,Encoding e) {
+U_FILE* u=new_U_FILE(f,e);
+add_u_read_buffer(u);
+return u;
+}
+
+
+/**
+ * Returns the length in bytes of the UTF8 representation of a character
+ * decoded by decode_UTF8_block.
+ */
+static inline int u_read_buffer_UTF8_length(unichar c) {
+return (c<0x80) ? 1 : ((c<0x800) ? 2 : 3);
+}
+
+
+#ifdef UNICODE_USE_SSE2
+/**
+ * Widens the 16 bytes at 's' into 16 characters at 't', and returns the
+ * number of leading bytes that are lower than 0x80.
+ */
+static inline int widen_16_bytes(const unsigned char* s,unichar* t) {
+const __m128i zero=_mm_setzero_si128();
+__m128i v=_mm_loadu_si128((const __m128i*)s);
+_mm_storeu_si128((__m128i*)t,_mm_unpacklo_epi8(v,zero));
+_mm_storeu_si128((__m128i*)(t+8),_mm_unpackhi_epi8(v,zero));
+/* The mask has a bit set for each byte that is not ASCII */
+unsigned int mask=(unsigned int)_mm_movemask_epi8(v)|0x10000;
+#if defined(__GNUC__)
+return __builtin_ctz(mask);
+#else
+int k=0;
+while (!(mask & (1u<<k))) k++;
+return k;
+#endif
+}
+#endif
+
+
+/**
+ * Decodes as many UTF8 characters as possible from the bytes of 'b'. Runs of
+ * ASCII characters are detected 16 bytes at a time with SSE2, 8 otherwise. Only
+ * 1, 2 and 3 byte sequences in their shortest form are decoded, so that the
+ * length of a character can be deduced from its value. Decoding stops on
+ * anything else.
+ */
+static void decode_UTF8_block(struct u_read_buffer* b) {
+const unsigned char* s=b->bytes;
+unichar* t=b->chars;
+int end=b->n_bytes;
+int i=0,n=0;
+while (i<end) {
+   unsigned char c=s[i];
+   if (c<0x80) {
+#ifdef UNICODE_USE_SSE2
+      if (i+16<=end) {
+         /* The 16 bytes are widened anyway, since 'chars' has room for
+          * them: we only keep the ASCII ones */
+         int k=widen_16_bytes(s+i,t+n);
+         i+=k;
+         n+=k;
+         continue;
+      }
+#endif
+      if (i+8<=end) {
+         uint64_t w;
+         memcpy(&w,s+i,8);
+         if (!(w & 0x8080808080808080ULL)) {
+            for (int k=0;k<8;k++) {
+               t[n+k]=s[i+k];
+            }
+            i+=8;
+            n+=8;
+            continue;
+         }
+      }
+      t[n++]=c;
+      i++;
+   } else if ((c&0xE0)==0xC0) {
+      if (c<0xC2 || i+1>=end || (s[i+1]&0xC0)!=0x80) break;
+      t[n++]=(unichar)(((c&0x1F)<<6) | (s[i+1]&0x3F));
+      i+=2;
+   } else if ((c&0xF0)==0xE0) {
+      if (i+2>=end || (s[i+1]&0xC0)!=0x80 || (s[i+2]&0xC0)!=0x80) break;
+      unichar v=(unichar)(((c&0x0F)<<12) | ((s[i+1]&0x3F)<<6) | (s[i+2]&0x3F));
+      if (v<0x800) break;
+      t[n++]=v;
+      i+=3;
+   } else {
+      break;
+   }
+}
+b->n_decoded=i;
+b->len=n;
+}
+
+
+static bool is_platform_little_endian();
+
+/**
+ * Decodes the complete UTF16 characters of 'b'. When the file has the byte
+ * order of the platform, this is just a copy.
+ */
+static void decode_UTF16_block(struct u_read_buffer* b,int little_endian) {
+int n=b->n_bytes/2;
+const unsigned char* s=b->bytes;
+if ((little_endian!=0)==is_platform_little_endian()) {
+   memcpy(b->chars,s,n*sizeof(unichar));
+} else {
+   int hi=little_endian ? 1 : 0;
+   int i=0;
+#ifdef UNICODE_USE_SSE2
+   for (;i+8<=n;i+=8) {
+      __m128i v=_mm_loadu_si128((const __m128i*)(s+2*i));
+      v=_mm_or_si128(_mm_slli_epi16(v,8),_mm_srli_epi16(v,8));
+      _mm_storeu_si128((__m128i*)(b->chars+i),v);
+   }
+#endif
+   for (;i<n;i++) {
+      b->chars[i]=(unichar)((s[2*i+hi]<<8) | s[2*i+1-hi]);
+   }
+}
+b->n_decoded=2*n;
+b->len=n;
+}
+
+
+/**
+ * Reads the next block of the file into the buffer of 'u' and decodes it.
+ * Returns 1 if at least one character is available. Otherwise, the file is
+ * put back at the current reading position and 0 is returned, so that the
+ * caller can fall back on the unbuffered functions, which deal with the end of
+ * file and with the sequences that the block decoders leave alone.
+ */
+static int fill_u_read_buffer(U_FILE* u) {
+struct u_read_buffer* b=u->buffer;
+if (b->bytes==NULL) {
+   b->bytes=(unsigned char*)malloc(U_READ_BUFFER_SIZE);
+   b->chars=(unichar*)malloc(U_READ_BUFFER_SIZE*sizeof(unichar));
+   if (b->bytes==NULL || b->chars==NULL) {
+      fatal_alloc_error("fill_u_read_buffer");
+   }
+}
+int tail=b->n_bytes-b->n_decoded;
+if (b->n_bytes==0) {
+   b->start=af_ftell(u->f);
+} else {
+   memmove(b->bytes,b->bytes+b->n_decoded,tail);
+   b->start=b->start+b->n_decoded;
+}
+size_t n=af_fread(b->bytes+tail,1,U_READ_BUFFER_SIZE-tail,u->f);
+if (n==(size_t)EOF) n=0;
+b->n_bytes=tail+(int)n;
+b->pos=0;
+b->mark_pos=0;
+b->mark_offset=0;
+switch (u->enc) {
+   case UTF16_LE: decode_UTF16_block(b,1); break;
+   case BIG_ENDIAN_UTF16: decode_UTF16_block(b,0); break;
+   case UTF8: decode_UTF8_block(b); break;
+   default: {
+      int i=0;
+#ifdef UNICODE_USE_SSE2
+      for (;i+16<=b->n_bytes;i+=16) {
+         widen_16_bytes(b->bytes+i,b->chars+i);
+      }
+#endif
+      for (;i<b->n_bytes;i++) {
+         b->chars[i]=b->bytes[i];
+      }
+      b->n_decoded=b->n_bytes;
+      b->len=b->n_bytes;
+   }
+}
+if (b->len!=0) return 1;
+if (b->n_bytes!=0) {
+   af_fseek(u->f,b->start,SEEK_SET);
+}
+reset_u_read_buffer(b);
+return 0;
+}
+
+
+/**
+ * Returns 1 if the next character of 'u' is in its buffer, refilling it if needed.
+ */
+static inline int u_read_buffer_ready(U_FILE* u) {
+return u->buffer->pos<u->buffer->len || fill_u_read_buffer(u);
+}
+
+
+/**
+ * Returns the offset in bytes, relative to the beginning of the block, of the
+ * character #pos of the buffer of 'u'.
+ */
+static int u_read_buffer_offset(U_FILE* u,int pos) {
+struct u_read_buffer* b=u->buffer;
+if (u->enc==UTF16_LE || u->enc==BIG_ENDIAN_UTF16) return 2*pos;
+if (u->enc!=UTF8) return pos;
+int i=0,offset=0;
+if (pos>=b->mark_pos) {
+   i=b->mark_pos;
+   offset=b->mark_offset;
+}
+for (;i<pos;i++) {
+   offset=offset+u_read_buffer_UTF8_length(b->chars[i]);
+}
+b->mark_pos=pos;
+b->mark_offset=offset;
+return offset;
+}
+
+
+/**
+ * Discards the content of the buffer of 'u' and puts the file at the position
+ * of the next character to be read. This must be done before any access to the
+ * ABSTRACTFILE that does not go through the buffer.
+ */
+static void sync_u_read_buffer(U_FILE* u) {
+struct u_read_buffer* b=u->buffer;
+if (b==NULL || b->n_bytes==0) return;
+af_fseek(u->f,b->start+u_read_buffer_offset(u,b->pos),SEEK_SET);
+reset_u_read_buffer(b);
+}
+
+
+/**
+ * Tries to move the reading position of 'u' to the given absolute offset
+ * without leaving the current block. Returns 1 in case of success; 0 if the
+ * offset is not the position of a character of the block.
+ */
+static int seek_in_u_read_buffer(U_FILE* u,long offset) {
+struct u_read_buffer* b=u->buffer;
+if (b->n_bytes==0 || offset<b->start || offset>b->start+b->n_decoded) return 0;
+int relative=(int)(offset-b->start);
+int pos;
+if (u->enc==UTF16_LE || u->enc==BIG_ENDIAN_UTF16) {
+   if (relative%2!=0) return 0;
+   pos=relative/2;
+} else if (u->enc==UTF8) {
+   int current=0;
+   pos=0;
+   if (relative>=b->mark_offset) {
+      pos=b->mark_pos;
+      current=b->mark_offset;
+   }
+   while (current<relative) {
+      current=current+u_read_buffer_UTF8_length(b->chars[pos++]);
+   }
+   if (current!=relative) return 0;
+   b->mark_pos=pos;
+   b->mark_offset=current;
+} else {
+   pos=relative;
+}
+b->pos=pos;
+return 1;
+}
+
+
+const U_FILE CTE_U_STDIN  = { (ABSTRACTFILE*)pVF_StdIn,  UTF8, NULL };
+const U_FILE CTE_U_STDOUT = { (ABSTRACTFILE*)pVF_StdOut, UTF8, NULL };
+const U_FILE CTE_U_STDERR = { (ABSTRACTFILE*)pVF_StdErr, UTF8, NULL };
 
 U_FILE* U_STDIN  = (U_FILE*)&CTE_U_STDIN;
 U_FILE* U_STDOUT = (U_FILE*)&CTE_U_STDOUT;
 U_FILE* U_STDERR = (U_FILE*)&CTE_U_STDERR;
 
 int fseek(U_FILE* stream, long offset, int whence) {
+if (stream->buffer!=NULL && stream->buffer->n_bytes!=0) {
+   if (whence==SEEK_CUR) {
+      offset=offset+ftell(stream);
+      whence=SEEK_SET;
+   }
+   if (whence==SEEK_SET && seek_in_u_read_buffer(stream,offset)) return 0;
+   reset_u_read_buffer(stream->buffer);
+}
 return af_fseek(stream->f,offset,whence);
 }
 
 long ftell(U_FILE* stream) {
+if (stream->buffer!=NULL && stream->buffer->n_bytes!=0) {
+   return stream->buffer->start+u_read_buffer_offset(stream,stream->buffer->pos);
+}
 return af_ftell(stream->f);
 }
 
@@ -134,14 +481,18 @@ fseek( stream, 0L, SEEK_SET );
 }
 
 int u_feof(U_FILE* stream) {
+struct u_read_buffer* b=stream->buffer;
+if (b!=NULL && (b->pos<b->len || b->n_decoded<b->n_bytes)) return 0;
 return af_feof(stream->f);
 }
 
 size_t fread(void *ptr,size_t size,size_t nmemb,U_FILE *stream) {
+sync_u_read_buffer(stream);
 return af_fread(ptr,size,nmemb,stream->f);
 }
 
 size_t fwrite(const void *ptr,size_t size,size_t nmemb,U_FILE *stream) {
+sync_u_read_buffer(stream);
 return af_fwrite(ptr,size,nmemb,stream->f);
 }
 
@@ -149,6 +500,9 @@ return af_fwrite(ptr,size,nmemb,stream->f);
 
 int u_fgetc_raw(Encoding,ABSTRACTFILE*);
 int u_fgetc_raw(U_FILE* f) {
+if (f->buffer!=NULL && u_read_buffer_ready(f)) {
+   return f->buffer->chars[f->buffer->pos++];
+}
 return u_fgetc_raw(f->enc,f->f);
 }
 
@@ -166,27 +520,33 @@ return u_fgetc(UTF8,f);
 }
 
 int u_fgetc(U_FILE* f) {
-return u_fgetc(f->enc,f->f);
+if (f->buffer==NULL) {
+   return u_fgetc(f->enc,f->f);
+}
+int c=u_fgetc_raw(f);
+if (c==0x0D) {
+   /* If we read a '\r', we try to skip the '\n' */
+   if (EOF==u_fgetc_raw(f)) return EOF;
+   return '\n';
+}
+return c;
 }
 
 int u_fgetc_CR(Encoding,ABSTRACTFILE*);
 int u_fgetc_CR(U_FILE* f) {
-return u_fgetc_CR(f->enc,f->f);
+if (f->buffer==NULL) {
+   return u_fgetc_CR(f->enc,f->f);
 }
-
-int u_fread_raw(Encoding,unichar*,int,ABSTRACTFILE*);
-int u_fread_raw(unichar* t,int N,U_FILE* f) {
-return u_fread_raw(f->enc,t,N,f->f);
+int c=u_fgetc_raw(f);
+if (c!=0x0D) {
+   return c;
 }
-
-int u_fread(Encoding,unichar*,int,ABSTRACTFILE*,int*);
-int u_fread(unichar* t,int N,U_FILE* f,int *OK) {
-return u_fread(f->enc,t,N,f->f,OK);
+/* We only skip a '\n' that is in the buffer: if the buffer cannot be refilled,
+ * we are either at the end of the file or before a sequence that cannot be a '\n' */
+if (u_read_buffer_ready(f) && f->buffer->chars[f->buffer->pos]==0x0A) {
+   f->buffer->pos++;
 }
-
-int u_fread_raw(Encoding,unichar*,int,ABSTRACTFILE*,int*);
-int u_fread_raw(unichar* t,int N,U_FILE* f,int *OK) {
-return u_fread_raw(f->enc,t,N,f->f,OK);
+return '\n';
 }
 
 int u_fputc_raw(Encoding,unichar,ABSTRACTFILE*);
@@ -216,11 +576,6 @@ int u_fputc(unichar c,U_FILE* f) {
 return u_fputc(f->enc,c,f->f);
 }
 
-int u_ungetc(Encoding,unichar,ABSTRACTFILE*);
-int u_ungetc(unichar c,U_FILE* f) {
-return u_ungetc(f->enc,c,f->f);
-}
-
 int u_fwrite_raw(Encoding,const unichar*,int,ABSTRACTFILE*);
 int u_fwrite_raw(const unichar* t,int N,U_FILE* f) {
 return u_fwrite_raw(f->enc,t,N,f->f);
@@ -252,38 +607,6 @@ void u_fputs_conv_lf_to_crlf_option(const unichar*t, U_FILE* f, int conv_lf_to_c
     //return u_fputs_conv_lf_to_crlf_option(f->enc, t, f->f, conv_lf_to_crlf_option);
 }
 
-int u_fgets(Encoding,unichar*,ABSTRACTFILE*);
-int u_fgets(unichar* s,U_FILE* f) {
-return u_fgets(f->enc,s,f->f);
-}
-
-int u_fgets(Encoding,unichar*,int,ABSTRACTFILE*);
-int u_fgets(unichar* s,int size,U_FILE* f) {
-return u_fgets(f->enc,s,size,f->f);
-}
-
-int u_fgets_treat_cr_as_lf(Encoding,unichar* s,int size,ABSTRACTFILE* f);
-int u_fgets_treat_cr_as_lf(unichar* s,int size,U_FILE* f) {
-return u_fgets_treat_cr_as_lf(f->enc,s,size,f->f);
-}
-
-int u_fgets2(Encoding,unichar*,ABSTRACTFILE*);
-int u_fgets2(unichar* s,U_FILE* f) {
-return u_fgets2(f->enc,s,f->f);
-}
-
-int u_fgets_limit2(Encoding,unichar*,int,ABSTRACTFILE*);
-int u_fgets_limit2(unichar* s,int size,U_FILE* f) {
-return u_fgets_limit2(f->enc,s,size,f->f);
-}
-
-
-int u_fgets_dynamic_buffer(Encoding encoding, unichar** line, size_t* buffer_size, ABSTRACTFILE* f, int treat_CR_as_LF);
-int u_fgets_dynamic_buffer(unichar** line, size_t* buffer_size, U_FILE* f, int treat_CR_as_LF) {
-return u_fgets_dynamic_buffer(f->enc, line, buffer_size, f->f, treat_CR_as_LF);
-}
-
-
 /**
  * Skips a line. Returns 0 if end of file has been reached; 1 otherwise.
  */
@@ -773,7 +1096,7 @@ if (MODE==U_READ) {
          af_fclose(f);
          return NULL;
       }
-      return new_U_FILE(f,encoding);
+      return new_read_U_FILE(f,encoding);
    }
 
    if ((encoding==BIG_ENDIAN_UTF16) && (is_BOM!=0)) {
@@ -783,7 +1106,7 @@ if (MODE==U_READ) {
          af_fclose(f);
          return NULL;
       }
-      return new_U_FILE(f,encoding);
+      return new_read_U_FILE(f,encoding);
    }
 
    if ((encoding==UTF8) && (is_BOM==1)) {
@@ -793,10 +1116,10 @@ if (MODE==U_READ) {
          af_fclose(f);
          return NULL;
       }
-      return new_U_FILE(f,encoding);
+      return new_read_U_FILE(f,encoding);
    }
 
-   return new_U_FILE(f,encoding);
+   return new_read_U_FILE(f,encoding);
 }
 /* If the file is opened in WRITE mode, we may insert the 0xFEFF unicode char */
 if (MODE==U_WRITE) {
@@ -1136,10 +1459,10 @@ return c;
  *
  * WARNING: this function will be deprecated
  */
-int u_fread_raw(Encoding encoding,unichar* t,int N,ABSTRACTFILE* f) {
+int u_fread_raw(unichar* t,int N,U_FILE* f) {
 int i,c;
 for (i=0;i<N;i++) {
-   c=u_fgetc_raw(encoding,f);
+   c=u_fgetc_raw(f);
    if (c==EOF) return i;
    t[i]=(unichar)c;
 }
@@ -1153,12 +1476,12 @@ return i;
  *
  * The '*OK' parameter is set to 0 if at least one '\0' was found and ignored; 1 otherwise.
  */
-int u_fread(Encoding encoding,unichar* t,int N,ABSTRACTFILE* f,int *OK) {
+int u_fread(unichar* t,int N,U_FILE* f,int *OK) {
 int i,c;
 *OK=1;
 i=0;
 while (i<N) {
-   c=u_fgetc_CR(encoding,f);
+   c=u_fgetc_CR(f);
    if (c==EOF) return i;
    if (c=='\0') {
       *OK=0;
@@ -1176,12 +1499,12 @@ return i;
  *
  * The '*OK' parameter is set to 0 if at least one '\0' was found and ignored; 1 otherwise.
  */
-int u_fread_raw(Encoding encoding,unichar* t,int N,ABSTRACTFILE* f,int *OK) {
+int u_fread_raw(unichar* t,int N,U_FILE* f,int *OK) {
 int i,c;
 *OK=1;
 i=0;
 while (i<N) {
-   c= u_fgetc_raw(encoding,f);
+   c=u_fgetc_raw(f);
    if (c==EOF) return i;
    if (c=='\0') {
       *OK=0;
@@ -1397,6 +1720,34 @@ return u_ungetc_raw(encoding,c,f);
 }
 
 
+/**
+ * U_FILE version of u_ungetc_raw. If 'c' is the last character read from
+ * the buffer, we just step back in the buffer.
+ */
+int u_ungetc_raw(unichar c,U_FILE* f) {
+struct u_read_buffer* b=f->buffer;
+if (b!=NULL && b->pos>0 && b->chars[b->pos-1]==c) {
+   b->pos--;
+   return 1;
+}
+sync_u_read_buffer(f);
+return u_ungetc_raw(f->enc,c,f->f);
+}
+
+
+/**
+ * U_FILE version of u_ungetc.
+ */
+int u_ungetc(unichar c,U_FILE* f) {
+if (c=='\n') {
+   if (!u_ungetc_raw(c,f)) return 0;
+   if (!u_ungetc_raw(c,f)) return 0;
+   return 1;
+}
+return u_ungetc_raw(c,f);
+}
+
+
 /**
  * Writes N characters from t. Returns the number of characters written.
  * It does not write '\r\n' for '\n'.
@@ -1747,6 +2098,81 @@ int u_fgets_buffered(Encoding encoding,unichar* line,int i_is_size,int size,ABST
 }
 
 
+/**
+ * U_FILE version of u_fgets_buffered, that reads the characters from the buffer
+ * of the file. If the buffer cannot be refilled, the end of the line is read by
+ * the ABSTRACTFILE version, so that the end of file and the sequences that are
+ * not decoded by blocks are handled as before.
+ */
+static int u_fgets_buffered(U_FILE* f,unichar* line,int i_is_size,int size,int treat_CR_as_LF) {
+struct u_read_buffer* b=f->buffer;
+if (b==NULL || ((i_is_size!=0) && (size<=1))) {
+   /* A line of at most 1 char has no room for any character, and the
+    * ABSTRACTFILE version deals with that case in its own way */
+   sync_u_read_buffer(f);
+   return u_fgets_buffered(f->enc,line,i_is_size,size,f->f,treat_CR_as_LF);
+}
+/* 'max' is the number of characters that can be stored in 'line' */
+int max=(i_is_size!=0) ? size-1 : INT_MAX;
+int n=0;
+for (;;) {
+   if (b->pos==b->len && !fill_u_read_buffer(f)) {
+      if (n!=0 && n==max) {
+         line[n]='\0';
+         return n;
+      }
+      int ret=u_fgets_buffered(f->enc,line+n,i_is_size,(i_is_size!=0) ? size-n : 0,f->f,treat_CR_as_LF);
+      if (ret!=EOF) {
+         return n+ret;
+      }
+      if (n==0) {
+         return EOF;
+      }
+      line[n]='\0';
+      return n;
+   }
+   const unichar* chars=b->chars;
+   int pos=b->pos;
+   int len=b->len;
+   while (pos<len) {
+      unichar c=chars[pos];
+      if (c<=0x0D) {
+         if (c==0) {
+            fatal_error("Corrupted %s text file containing null characters\n",
+                        (f->enc==UTF8) ? "UTF8" : ((f->enc==ASCII) ? "ASCII" : "UTF16"));
+         }
+         if (c==0x0D && treat_CR_as_LF==0) {
+            pos++;
+            continue;
+         }
+         if (c=='\n' || c==0x0D) {
+            if (i_is_size==1) {
+               if (n==max) {
+                  /* In that case, the end of line is left in the file */
+                  b->pos=pos;
+                  line[n]='\0';
+                  return n;
+               }
+               line[n++]=c;
+            }
+            b->pos=pos+1;
+            line[n]='\0';
+            return n;
+         }
+      }
+      if (n==max) {
+         b->pos=pos;
+         line[n]='\0';
+         return n;
+      }
+      line[n++]=c;
+      pos++;
+   }
+   b->pos=pos;
+}
+}
+
+
 /**
  * u_fgets_dynamic_buffer read a line and store it on a growing buffer
  *
@@ -1760,7 +2186,7 @@ int u_fgets_buffered(Encoding encoding,unichar* line,int i_is_size,int size,ABST
  *   if (line != NULL) free(line);
  */
 #define START_SIZE_DYNAMIC_BUFFER 512
-int u_fgets_dynamic_buffer(Encoding encoding, unichar** line, size_t* buffer_size, ABSTRACTFILE* f, int treat_CR_as_LF)
+int u_fgets_dynamic_buffer(unichar** line, size_t* buffer_size, U_FILE* f, int treat_CR_as_LF)
 {
     if (((*line) == NULL) || ((*buffer_size) == 0))
     {
@@ -1774,18 +2200,18 @@ int u_fgets_dynamic_buffer(Encoding encoding, unichar** line, size_t* buffer_siz
 
     **line = 0;
     int pos = 0;
-    long start_current_line = af_ftell(f);
+    long start_current_line = ftell(f);
     for (;;)
     {
         int read_possible = (int)(*buffer_size);
-        int nb_read = u_fgets_buffered(encoding, (*line), 2, (int)read_possible, f, treat_CR_as_LF);
+        int nb_read = u_fgets_buffered(f, (*line), 2, (int)read_possible, treat_CR_as_LF);
         if (nb_read == EOF)
             return (pos == 0) ? EOF : pos;
         pos = nb_read;
         *((*line) + pos) = 0;
         if (nb_read != (read_possible - 1))
             return pos;
-        if (af_fseek(f, start_current_line, SEEK_SET) != 0)
+        if (fseek(f, start_current_line, SEEK_SET) != 0)
         {
           fatal_error("u_fgets_dynamic_buffer seek error\n");
           return EOF;
@@ -1808,8 +2234,8 @@ int u_fgets_dynamic_buffer(Encoding encoding, unichar** line, size_t* buffer_siz
  *
  * NOTE: there is no overflow control!
  */
-int u_fgets(Encoding encoding,unichar* line,ABSTRACTFILE* f) {
-    return u_fgets_buffered(encoding,line,0,0,f,0);
+int u_fgets(unichar* line,U_FILE* f) {
+    return u_fgets_buffered(f,line,0,0,0);
 }
 
 
@@ -1826,15 +2252,15 @@ int u_fgets(Encoding encoding,unichar* line,ABSTRACTFILE* f) {
  * Author: Olivier Blanc
  * Modified by Sébastien Paumier
  */
-int u_fgets(Encoding encoding,unichar* line,int size,ABSTRACTFILE* f) {
-return u_fgets_buffered(encoding,line,1,size,f,0);
+int u_fgets(unichar* line,int size,U_FILE* f) {
+return u_fgets_buffered(f,line,1,size,0);
 }
 
 /*
  * same thing, but all CR are converted as LF
  */
-int u_fgets_treat_cr_as_lf(Encoding encoding,unichar* line,int size,ABSTRACTFILE* f) {
-return u_fgets_buffered(encoding,line,1,size,f,1);
+int u_fgets_treat_cr_as_lf(unichar* line,int size,U_FILE* f) {
+return u_fgets_buffered(f,line,1,size,1);
 }
 
 
@@ -1854,8 +2280,8 @@ return u_fgets_buffered(encoding,line,1,size,f,1);
  * Modified by Sébastien Paumier
  * option limit2 by Gilles Vollant
  */
-int u_fgets_limit2(Encoding encoding,unichar* line,int size,ABSTRACTFILE* f) {
-    return u_fgets_buffered(encoding,line,2,size,f,0);
+int u_fgets_limit2(unichar* line,int size,U_FILE* f) {
+    return u_fgets_buffered(f,line,2,size,0);
 }
 
 
@@ -1877,9 +2303,9 @@ int u_fgets_limit2(Encoding encoding,unichar* line,int size,ABSTRACTFILE* f) {
  *
  * will lead to a string like: a b c \ d e \n e f
  */
-int u_fgets2(Encoding encoding,unichar* line,ABSTRACTFILE* f) {
+int u_fgets2(unichar* line,U_FILE* f) {
 int pos,length;
-if (EOF==(pos=u_fgets(encoding,line,f))) {
+if (EOF==(pos=u_fgets(line,f))) {
    /* If we are at the end of file, then we return EOF */
    return EOF;
 }
@@ -1894,7 +2320,7 @@ while (line[length-1]=='\\') {
    /* We try to read another line. We try to store it at &(line[length]),
     * because, if we can read such a line, we will have to replace the
     * backslash by a \n */
-   pos=u_fgets(encoding,&(line[length]),f);
+   pos=u_fgets(&(line[length]),f);
    if (pos==EOF) {
       /* If we cannot read another line, we return the current length */
       return length;
@@ -2137,7 +2563,30 @@ size_t convert_utf8_to_unichar(unichar*dest, size_t nb_unichar_alloc_walk, size_
  */
 int u_fget_unichars_raw(unichar* buffer, int size, U_FILE* f)
 {
-    return u_fget_unichars_raw(f->enc, buffer, size, f->f);
+    struct u_read_buffer* b = f->buffer;
+    if (b == NULL)
+        return u_fget_unichars_raw(f->enc, buffer, size, f->f);
+    int size_done = 0;
+    while (size_done < size)
+    {
+        if (u_read_buffer_ready(f))
+        {
+            int nb_unichar = b->len - b->pos;
+            if (nb_unichar > size - size_done)
+                nb_unichar = size - size_done;
+            memcpy(buffer + size_done, b->chars + b->pos, nb_unichar * sizeof(unichar));
+            b->pos += nb_unichar;
+            size_done += nb_unichar;
+            continue;
+        }
+        /* end of file, or a sequence that is not decoded by blocks:
+         * we take one char with the unbuffered function and try the buffer again */
+        int nb_read = u_fget_unichars_raw(f->enc, buffer + size_done, 1, f->f);
+        if (nb_read <= 0)
+            return (size_done > 0) ? size_done : nb_read;
+        size_done += nb_read;
+    }
+    return size_done;
 }
 
 
@@ -2837,7 +3286,6 @@ return (c==' ') || (c=='\t') || (c=='\r') || (c=='\n');
  * Author: Sébastien Paumier
  */
 int u_vfscanf(U_FILE* ufile,const char* format,va_list list) {
-Encoding encoding=ufile->enc;
 ABSTRACTFILE* f=ufile->f;
 int c;
 int *i;
@@ -2854,11 +3302,11 @@ while (*format) {
          stdin_ch=-1;
       } else {
          /* If we have no character in the 1-char buffer, we take one from the ABSTRACTFILE */
-         c=u_fgetc_raw(encoding,f);
+         c=u_fgetc_raw(ufile);
       }
    } else {
       /* If we have to take one from the ABSTRACTFILE */
-      c=u_fgetc_raw(encoding,f);
+      c=u_fgetc_raw(ufile);
    }
    if (c==EOF) {
       if (n_variables==0) {
@@ -2878,7 +3326,7 @@ while (*format) {
       } else {
          /* 2) the format is for instance a '\t' and we have a current input
           *    separator that is not a '\t' => we skip all separators that are not '\t' */
-         while ((c=u_fgetc_raw(encoding,f))!=EOF && is_separator((unichar)c) && c!=*format) {}
+         while ((c=u_fgetc_raw(ufile))!=EOF && is_separator((unichar)c) && c!=*format) {}
          /* Subcase 1: EOF */
          if (c==EOF) return (n_variables==0)?EOF:n_variables;
          /* Subcase 2: we found the correct separator */
@@ -2893,7 +3341,7 @@ while (*format) {
    /* Now we must deal with an input separator when the current format character
     * is not a separator */
    while (c!=EOF && is_separator((unichar)c)) {
-      c=u_fgetc_raw(encoding,f);
+      c=u_fgetc_raw(ufile);
    }
    /* Again, we may have reached the EOF */
    if (c==EOF) {
@@ -2936,7 +3384,7 @@ while (*format) {
             int pos=0;
             do {
                ch[pos++]=(char)c;
-            } while ((c=u_fgetc_raw(encoding,f))!=EOF && !is_separator((unichar)c));
+            } while ((c=u_fgetc_raw(ufile))!=EOF && !is_separator((unichar)c));
             ch[pos]='\0';
             if (c!=EOF) {
                /* If we have read a separator, we put it back in the file, for
@@ -2945,7 +3393,7 @@ while (*format) {
                   stdin_ch=c;
                }
                else {
-                  u_ungetc_raw(encoding,(unichar)c,f);
+                  u_ungetc_raw((unichar)c,ufile);
                }
             }
             n_variables++;
@@ -2958,7 +3406,7 @@ while (*format) {
             int pos=0;
             do {
                uc[pos++]=(unichar)c;
-            } while ((c=u_fgetc_raw(encoding,f))!=EOF && !is_separator((unichar)c));
+            } while ((c=u_fgetc_raw(ufile))!=EOF && !is_separator((unichar)c));
             uc[pos]='\0';
             if (c!=EOF) {
                /* If we have read a separator, we put it back in the file, for
@@ -2967,7 +3415,7 @@ while (*format) {
                   stdin_ch=c;
                }
                else {
-                  u_ungetc_raw(encoding,(unichar)c,f);
+                  u_ungetc_raw((unichar)c,ufile);
                }
             }
             n_variables++;
@@ -2981,7 +3429,7 @@ while (*format) {
             if (c=='+' || c=='-') {
                /* If we have a sign, we must read the next character */
                if (c=='-') multiplier=-1;
-               c=u_fgetc_raw(encoding,f);
+               c=u_fgetc_raw(ufile);
                if (c==EOF || c<'0' || c>'9') {
                   /* If we have reached the EOF or if we have a non digit character */
                   return n_variables;
@@ -2993,7 +3441,7 @@ while (*format) {
             *i=0;
             do {
                *i=(*i)*10+(unichar)c-'0';
-            } while ((c=u_fgetc_raw(encoding,f))!=EOF && c>='0' && c<='9');
+            } while ((c=u_fgetc_raw(ufile))!=EOF && c>='0' && c<='9');
             *i=(*i)*multiplier;
             if (c!=EOF) {
                /* If we have read a non digit, we put it back in the file, for
@@ -3002,7 +3450,7 @@ while (*format) {
                   stdin_ch=c;
                }
                else {
-                  u_ungetc_raw(encoding,(unichar)c,f);
+                  u_ungetc_raw((unichar)c,ufile);
                }
             }
             n_variables++;
@@ -3016,7 +3464,7 @@ while (*format) {
             if (c=='+' || c=='-') {
                /* If we have a sign, we must read the next character */
                if (c=='-') multiplier=-1;
-               c=u_fgetc_raw(encoding,f);
+               c=u_fgetc_raw(ufile);
                if (c==EOF || !u_is_hexa_digit((unichar)c)) {
                   /* If we have reached the EOF or if we have a non hexa digit character */
                   return n_variables;
@@ -3031,7 +3479,7 @@ while (*format) {
                else if (c>='a' && c<='f') c=c-'a'+10;
                else c=c-'A'+10;
                *i=(*i)*16+c;
-            } while ((c=u_fgetc_raw(encoding,f))!=EOF && u_is_hexa_digit((unichar)c));
+            } while ((c=u_fgetc_raw(ufile))!=EOF && u_is_hexa_digit((unichar)c));
             *i=(*i)*multiplier;
             if (c!=EOF) {
                /* If we have read a non digit, we put it back in the file, for
@@ -3040,7 +3488,7 @@ while (*format) {
                   stdin_ch=c;
                }
                else {
-                  u_ungetc_raw(encoding,(unichar)c,f);
+                  u_ungetc_raw((unichar)c,ufile);
                }
             }
             n_variables++;
@@ -86,12 +86,18 @@ typedef enum {
 typedef uint16_t unichar;
 
 
+struct u_read_buffer;
+
 /**
  * This structure is used to represent a file with its encoding.
+ * 'buffer' is only used by files opened in U_READ mode: it holds a
+ * block of decoded characters so that reading functions don't have to
+ * go through the ABSTRACTFILE for each character. It is NULL otherwise.
  */
 typedef struct {
     ABSTRACTFILE* f;
     Encoding enc;
+    struct u_read_buffer* buffer;
 } U_FILE;
 
 
@@ -59,6 +59,7 @@
  *         UNITEX_HAS_CPU_EXTENSION(SSE41)  \\ Streaming SIMD Extensions 4.1
  *         UNITEX_HAS_CPU_EXTENSION(SSE42)  \\ Streaming SIMD Extensions 4.2
  *         UNITEX_HAS_CPU_EXTENSION(SSE5)   \\ Streaming SIMD Extensions 5
+ *         UNITEX_HAS_CPU_EXTENSION(AVX2)   \\ Advanced Vector Extensions 2
  *         UNITEX_HAS_CPU_EXTENSION(AES)    \\ AES Instruction Set
  * @endcode
  *
@@ -72,6 +73,7 @@
  * @see    UNITEX_HAS_CPU_EXTENSION_SSE41
  * @see    UNITEX_HAS_CPU_EXTENSION_SSE42
  * @see    UNITEX_HAS_CPU_EXTENSION_SSE5
+ * @see    UNITEX_HAS_CPU_EXTENSION_AVX2
  * @see    UNITEX_HAS_CPU_EXTENSION_AES
  */
 #define UNITEX_HAS_CPU_EXTENSION(ExtensionName)\
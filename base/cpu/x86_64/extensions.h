@@ -55,6 +55,7 @@
 // SSE41:  Streaming SIMD Extensions 4.1 instructions
 // SSE42:  Streaming SIMD Extensions 4.2 instructions
 // SSE5:   Streaming SIMD Extensions 5 instructions
+// AVX2:   Advanced Vector Extensions 2 instructions
 // AES:    Advanced Encryption Standard Instruction Set
 // PCLMUL: Carryless multiply instruction
 // gcc -dM -E -x c /dev/null -march=native
@@ -68,6 +69,7 @@
     UNITEX_HAVE(SSE41)   || __SSE4_1__  ||\
     UNITEX_HAVE(SSE42)   || __SSE4_2__  ||\
     UNITEX_HAVE(SSE5)    || __SSSE5__   ||\
+    UNITEX_HAVE(AVX2)    || __AVX2__    ||\
     UNITEX_HAVE(AES)     || __AES__     ||\
     UNITEX_HAVE(PCLMUL)  || __PCLMUL__
 /* ************************************************************************** */
@@ -111,6 +113,10 @@
 #  define UNITEX_HAS_CPU_EXTENSION_SSE5    1   // Streaming SIMD Extensions 5
 #  endif  // UNITEX_HAVE(SSE42)
 
+#  if UNITEX_HAVE(AVX2)  || __AVX2__
+#  define UNITEX_HAS_CPU_EXTENSION_AVX2    1   // Advanced Vector Extensions 2
+#  endif  // UNITEX_HAVE(AVX2)
+
 #  if UNITEX_HAVE(AES)     ||  __AES__     ||\
       UNITEX_HAVE(PCLMUL)  ||  __PCLMUL__
 #  define UNITEX_HAS_CPU_EXTENSION_AES     1   // AES Instruction Set
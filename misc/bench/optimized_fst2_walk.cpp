@@ -0,0 +1,260 @@
+/*
+ * Unitex
+ *
+ * Copyright (C) 2001-2020 Universit Paris-Est Marne-la-Valle <unitex@univ-mlv.fr>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ *
+ */
+
+/**
+ * Micro-benchmark of the exploration of the optimized fst2 states used by Locate.
+ *
+ * A large flattened grammar (a single graph) is generated, its tags are typed
+ * as process_tags would do (token lists, pattern numbers and metas), and the
+ * optimized states are built. Then, a random exploration that visits the
+ * lists of each state as locate() does is run on the states. We print the
+ * number of exploration steps per second and, when the kernel lets us read
+ * the hardware counters, the number of cache misses per step. This is the
+ * reference to use before changing the layout of the optimized states.
+ *
+ * Usage: optimized_fst2_walk [number of states [number of steps]]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Unicode.h"
+#include "Fst2.h"
+#include "List_int.h"
+#include "OptimizedFst2.h"
+#include "MetaSymbols.h"
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+using namespace unitex;
+
+#define N_TOKENS 5000
+#define N_PATTERNS 50
+#define MAX_CANDIDATES 64
+
+static unsigned int seed=12345;
+
+static unsigned int next_random() {
+seed^=seed<<13;
+seed^=seed>>17;
+seed^=seed<<5;
+return seed;
+}
+
+
+/**
+ * Writes a flattened grammar with 'n_states' states, each one having 1 to 5
+ * transitions to one of the 64 next states, and 'n_tags' tags.
+ */
+static void write_grammar(const char* name,int n_states,int n_tags) {
+U_FILE* f=u_fopen(UTF16_LE,name,U_WRITE);
+if (f==NULL) {
+   fatal_error("Cannot create %s\n",name);
+}
+u_fprintf(f,"0000000001\n-1 flattened\n");
+for (int i=0;i<n_states;i++) {
+   int final=(i==n_states-1) || (next_random()%16==0);
+   u_fprintf(f,"%c ",final?'t':':');
+   if (i!=n_states-1) {
+      int n=1+next_random()%5;
+      for (int j=0;j<n;j++) {
+         int dest=i+1+next_random()%64;
+         if (dest>=n_states) dest=n_states-1;
+         u_fprintf(f,"%d %d ",1+next_random()%(n_tags-1),dest);
+      }
+   }
+   u_fprintf(f,"\n");
+}
+u_fprintf(f,"f \n%%<E>\n");
+for (int i=1;i<n_tags;i++) {
+   u_fprintf(f,"%%t%d\n",i);
+}
+u_fprintf(f,"f\n");
+u_fclose(f);
+}
+
+
+/**
+ * Gives the tags the types that process_tags and the tag optimizations give
+ * to a real grammar: mostly token lists, then patterns and a few metas.
+ */
+static void type_tags(Fst2* fst2) {
+fst2->tags[0]->type=META_TAG;
+fst2->tags[0]->meta=META_EPSILON;
+for (int i=1;i<fst2->number_of_tags;i++) {
+   Fst2Tag tag=fst2->tags[i];
+   int kind=i%8;
+   if (kind<5) {
+      tag->type=TOKEN_LIST_TAG;
+      int n=1+next_random()%3;
+      for (int j=0;j<n;j++) {
+         tag->matching_tokens=sorted_insert(next_random()%N_TOKENS,tag->matching_tokens);
+      }
+   } else if (kind<7) {
+      tag->type=PATTERN_NUMBER_TAG;
+      tag->pattern_number=next_random()%N_PATTERNS;
+   } else {
+      tag->type=META_TAG;
+      tag->meta=META_MOT;
+   }
+}
+}
+
+
+static Transition* find_token(OptimizedFst2State s,int token) {
+int low=0;
+int high=s->number_of_tokens-1;
+while (low<=high) {
+   int middle=(low+high)/2;
+   if (s->tokens[middle]==token) return s->token_transitions[middle];
+   if (s->tokens[middle]<token) low=middle+1;
+   else high=middle-1;
+}
+return NULL;
+}
+
+
+/**
+ * Explores the states for 'n_steps' steps. At each step, the lists of the
+ * current state are read as locate() reads them for a random text token,
+ * and we go on with one of the transitions that match. Returns a checksum
+ * of the visited states.
+ */
+static long long walk(OptimizedFst2State* states,int n_states,long long n_steps) {
+Transition* candidates[MAX_CANDIDATES];
+long long checksum=0;
+int current=0;
+for (long long step=0;step<n_steps;step++) {
+   OptimizedFst2State s=states[current];
+   int token=next_random()%N_TOKENS;
+   int n=0;
+   for (struct opt_graph_call* g=s->graph_calls;g!=NULL;g=g->next) {
+      if (n<MAX_CANDIDATES) candidates[n++]=g->transition;
+   }
+   for (struct opt_meta* m=s->metas;m!=NULL;m=m->next) {
+      if (n<MAX_CANDIDATES && (m->meta!=META_MOT || token%2==0)) candidates[n++]=m->transition;
+   }
+   for (struct opt_pattern* p=s->patterns;p!=NULL;p=p->next) {
+      if (n<MAX_CANDIDATES && (p->pattern_number+token)%3==0) candidates[n++]=p->transition;
+   }
+   for (Transition* t=find_token(s,token);t!=NULL;t=t->next) {
+      if (n<MAX_CANDIDATES) candidates[n++]=t;
+   }
+   for (struct opt_variable* v=s->input_variable_starts;v!=NULL;v=v->next) {
+      if (n<MAX_CANDIDATES) candidates[n++]=v->transition;
+   }
+   for (struct opt_variable* v=s->input_variable_ends;v!=NULL;v=v->next) {
+      if (n<MAX_CANDIDATES) candidates[n++]=v->transition;
+   }
+   if (n==0) {
+      /* Dead end: we restart from a random state, as the exploration
+       * of the next text position would do */
+      current=next_random()%n_states;
+   } else {
+      current=candidates[next_random()%n]->state_number;
+   }
+   checksum+=current;
+}
+return checksum;
+}
+
+
+#if defined(__linux__)
+static int open_cache_miss_counter() {
+struct perf_event_attr attr;
+memset(&attr,0,sizeof(attr));
+attr.type=PERF_TYPE_HARDWARE;
+attr.size=sizeof(attr);
+attr.config=PERF_COUNT_HW_CACHE_MISSES;
+attr.disabled=1;
+attr.exclude_kernel=1;
+attr.exclude_hv=1;
+return (int)syscall(__NR_perf_event_open,&attr,0,-1,-1,0);
+}
+#endif
+
+
+/**
+ * Runs the walk 3 times and prints the best speed.
+ */
+static void measure(const char* name,OptimizedFst2State* states,int n_states,long long n_steps) {
+double best=1e30;
+long long misses=-1;
+long long checksum=0;
+for (int run=0;run<3;run++) {
+   seed=777;
+   int fd=-1;
+#if defined(__linux__)
+   fd=open_cache_miss_counter();
+   if (fd>=0) {
+      ioctl(fd,PERF_EVENT_IOC_RESET,0);
+      ioctl(fd,PERF_EVENT_IOC_ENABLE,0);
+   }
+#endif
+   clock_t start=clock();
+   checksum=walk(states,n_states,n_steps);
+   double t=(double)(clock()-start)/CLOCKS_PER_SEC;
+#if defined(__linux__)
+   if (fd>=0) {
+      long long count;
+      ioctl(fd,PERF_EVENT_IOC_DISABLE,0);
+      if (read(fd,&count,sizeof(count))==sizeof(count) && (misses<0 || count<misses)) {
+         misses=count;
+      }
+      close(fd);
+   }
+#endif
+   if (t<best) best=t;
+}
+u_printf("%-10s %8.2f M steps/s  ",name,n_steps/best/1e6);
+if (misses<0) {
+   u_printf("cache misses/step: n/a");
+} else {
+   u_printf("cache misses/step: %.3f",(double)misses/n_steps);
+}
+u_printf("  (checksum %lld)\n",checksum);
+}
+
+
+int main(int argc,char* argv[]) {
+int n_states=(argc>1) ? atoi(argv[1]) : 400000;
+long long n_steps=(argc>2) ? atoll(argv[2]) : 20000000;
+const char* name="optimized_fst2_walk.fst2";
+write_grammar(name,n_states,n_states/4+2);
+VersatileEncodingConfig vec=VEC_DEFAULT;
+Fst2* fst2=load_fst2(&vec,name,0);
+af_remove(name);
+if (fst2==NULL) {
+   fatal_error("Cannot load the generated grammar\n");
+}
+type_tags(fst2);
+OptimizedFst2State* states=build_optimized_fst2_states(NULL,NULL,fst2,STANDARD_ALLOCATOR);
+u_printf("%d states, %d tags, %lld steps\n",fst2->number_of_states,fst2->number_of_tags,n_steps);
+measure("states",states,fst2->number_of_states,n_steps);
+free_optimized_states(states,fst2->number_of_states,STANDARD_ALLOCATOR);
+free_Fst2(fst2);
+return 0;
+}
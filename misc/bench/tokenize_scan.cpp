@@ -0,0 +1,253 @@
+/*
+ * Unitex
+ *
+ * Copyright (C) 2001-2020 Universit Paris-Est Marne-la-Valle <unitex@univ-mlv.fr>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ *
+ */
+
+/**
+ * Micro-benchmark of the separator and letter scanners of Tokenize.
+ *
+ * A text is generated from random words of 1 to 12 letters (by default), some
+ * of them with accented letters, separated by spaces, new lines and punctuation. The text is cut
+ * into separator runs, letter runs and single characters in 3 ways:
+ * - "per char": the loop Tokenize used before the scanners, one character
+ *   and one is_letter call at a time;
+ * - "scalar": the scanners without vector instructions, that read the case
+ *   flags of the alphabet inline;
+ * - "scanners": scan_separators and scan_letters as compiled in Tokenize.
+ * For each one, we print the throughput in MB of UTF-16 text per second.
+ * The 3 ways must find the same number of tokens.
+ *
+ * The scanners are static functions, so Tokenize.cpp is included here
+ * rather than linked, in order to measure the exact same code. Build with
+ * ADDITIONAL_CFLAG=-march=native to measure the AVX2 path.
+ *
+ * Usage: tokenize_scan [millions of characters [% of accented words [max word length]]]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "Tokenize.cpp"
+
+using namespace unitex;
+
+static unsigned int seed=12345;
+
+static unsigned int next_random() {
+seed^=seed<<13;
+seed^=seed>>17;
+seed^=seed<<5;
+return seed;
+}
+
+
+/**
+ * Writes an alphabet with the ASCII letters and a few accented ones.
+ */
+static Alphabet* create_alphabet() {
+const char* name="tokenize_scan_alphabet.txt";
+U_FILE* f=u_fopen(UTF16_LE,name,U_WRITE);
+if (f==NULL) {
+   fatal_error("Cannot create %s\n",name);
+}
+for (unichar c='a';c<='z';c++) {
+   u_fprintf(f,"%C%C\n",c-'a'+'A',c);
+}
+static const unichar accents[]={0xE0,0xE2,0xE7,0xE8,0xE9,0xEA,0xEE,0xF4,0xF9,0xFB,0};
+for (int i=0;accents[i]!=0;i++) {
+   u_fprintf(f,"%C%C\n",accents[i]-0x20,accents[i]);
+}
+u_fclose(f);
+VersatileEncodingConfig vec=VEC_DEFAULT;
+Alphabet* alph=load_alphabet(&vec,name);
+af_remove(name);
+if (alph==NULL) {
+   fatal_error("Cannot load the generated alphabet\n");
+}
+return alph;
+}
+
+
+/**
+ * Fills 'text' with 'n' characters of generated text.
+ */
+static void create_text(unichar* text,int n,int accent_percent,int max_length) {
+static const unichar accents[]={0xE0,0xE7,0xE8,0xE9,0xEA,0xF4};
+static const char* punctuation=",.;:'-";
+int i=0;
+while (i<n) {
+   /* A word of 1 to max_length letters, with an accented letter in some of them */
+   int length=1+next_random()%max_length;
+   int accent=(int)(next_random()%100)<accent_percent ? (int)(next_random()%length) : -1;
+   for (int j=0;j<length && i<n;j++) {
+      if (j==accent) text[i++]=accents[next_random()%6];
+      else text[i++]=(unichar)('a'+next_random()%26);
+   }
+   if (i==n) break;
+   unsigned int r=next_random()%100;
+   if (r<8) {
+      text[i++]=punctuation[next_random()%6];
+   } else if (r<11) {
+      /* A new line, possibly followed by an indentation */
+      text[i++]=0x0d;
+      if (i<n) text[i++]=0x0a;
+      for (int k=next_random()%6;k>0 && i<n;k--) text[i++]=' ';
+      continue;
+   }
+   if (i<n) text[i++]=' ';
+}
+}
+
+
+/**
+ * The loop of Tokenize before the scanners.
+ */
+static int count_tokens_per_char(const unichar* s,int n,const Alphabet* alph) {
+int tokens=0;
+int enters=0;
+int i=0;
+while (i<n) {
+   unichar c=s[i++];
+   if (c==' ' || c==0x0d || c==0x0a || c=='\t') {
+      char enter=(c==0x0d || c==0x0a);
+      while (i<n && (s[i]==' ' || s[i]==0x0d || s[i]==0x0a || s[i]=='\t')) {
+         if (s[i]==0x0d || s[i]==0x0a) enter=1;
+         i++;
+      }
+      enters+=enter;
+   } else if (is_letter(c,alph)) {
+      while (i<n && is_letter(s[i],alph)) i++;
+   }
+   tokens++;
+}
+return tokens+enters;
+}
+
+
+/**
+ * Same as scan_letters, with the scalar lookup of the case flags only.
+ */
+static inline int scan_letters_scalar(const unichar* s,int n,const Alphabet* alph) {
+int i=0;
+while (i+4<=n && CASE_FLAG_MACRO(s[i],alph) && CASE_FLAG_MACRO(s[i+1],alph)
+       && CASE_FLAG_MACRO(s[i+2],alph) && CASE_FLAG_MACRO(s[i+3],alph)) {
+   i=i+4;
+}
+while (i<n && CASE_FLAG_MACRO(s[i],alph)) i++;
+return i;
+}
+
+
+static inline int scan_separators_scalar(const unichar* s,int n,char* enter) {
+int i=0;
+for (;i<n;i++) {
+   unichar c=s[i];
+   if (c==0x0d || c==0x0a) *enter=1;
+   else if (c!=' ' && c!='\t') break;
+}
+return i;
+}
+
+
+static int count_tokens_scalar(const unichar* s,int n,const Alphabet* alph) {
+int tokens=0;
+int enters=0;
+int i=0;
+while (i<n) {
+   unichar c=s[i++];
+   if (c==' ' || c==0x0d || c==0x0a || c=='\t') {
+      char enter=(c==0x0d || c==0x0a);
+      i+=scan_separators_scalar(s+i,n-i,&enter);
+      enters+=enter;
+   } else if (is_token_letter(c,alph)) {
+      i+=scan_letters_scalar(s+i,n-i,alph);
+   }
+   tokens++;
+}
+return tokens+enters;
+}
+
+
+static int count_tokens_scanners(const unichar* s,int n,const Alphabet* alph) {
+struct letter_ranges letters;
+compute_letter_ranges(alph,&letters);
+int tokens=0;
+int enters=0;
+int i=0;
+while (i<n) {
+   unichar c=s[i++];
+   if (c==' ' || c==0x0d || c==0x0a || c=='\t') {
+      char enter=(c==0x0d || c==0x0a);
+      i+=scan_separators(s+i,n-i,&enter);
+      enters+=enter;
+   } else if (is_token_letter(c,alph)) {
+      i+=scan_letters(s+i,n-i,alph,&letters);
+   }
+   tokens++;
+}
+return tokens+enters;
+}
+
+
+/**
+ * Runs 'count' 3 times and prints the best throughput.
+ */
+static int measure(const char* name,int (*count)(const unichar*,int,const Alphabet*),
+                   const unichar* text,int n,const Alphabet* alph) {
+double best=1e30;
+int tokens=0;
+for (int run=0;run<3;run++) {
+   clock_t start=clock();
+   tokens=count(text,n,alph);
+   double t=(double)(clock()-start)/CLOCKS_PER_SEC;
+   if (t<best) best=t;
+}
+u_printf("%-10s %8.1f MB/s  (%d tokens)\n",name,n*sizeof(unichar)/best/1e6,tokens);
+return tokens;
+}
+
+
+int main(int argc,char* argv[]) {
+int n=((argc>1) ? atoi(argv[1]) : 50)*1000000;
+int accent_percent=(argc>2) ? atoi(argv[2]) : 20;
+int max_length=(argc>3) ? atoi(argv[3]) : 12;
+Alphabet* alph=create_alphabet();
+unichar* text=(unichar*)malloc(n*sizeof(unichar));
+if (text==NULL) {
+   fatal_alloc_error("main");
+}
+create_text(text,n,accent_percent,max_length);
+#if defined(TOKENIZE_USE_AVX2)
+const char* vectors="AVX2";
+#elif defined(TOKENIZE_USE_SSE2)
+const char* vectors="SSE2";
+#else
+const char* vectors="none";
+#endif
+u_printf("%d characters, %d%% of accented words, words of 1 to %d letters, vector instructions: %s\n",
+         n,accent_percent,max_length,vectors);
+int a=measure("per char",count_tokens_per_char,text,n,alph);
+int b=measure("scalar",count_tokens_scalar,text,n,alph);
+int c=measure("scanners",count_tokens_scanners,text,n,alph);
+free(text);
+free_alphabet(alph);
+if (a!=b || a!=c) {
+   fatal_error("The token counts differ\n");
+}
+return 0;
+}
@@ -0,0 +1,161 @@
+/*
+ * Unitex
+ *
+ * Copyright (C) 2001-2020 Universit Paris-Est Marne-la-Valle <unitex@univ-mlv.fr>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ *
+ */
+
+/**
+ * Micro-benchmark of the reading functions of U_FILE.
+ *
+ * For each encoding read through the read buffer of u_fopen, a text of lines
+ * of random words is generated: Latin words with a few accented letters, or
+ * Cyrillic words for the second UTF8 text. The file is then read with
+ * u_fgetc, u_fgets and u_fgets_dynamic_buffer, and we print the best
+ * throughput of 3 runs, in MB of file per second.
+ *
+ * Usage: u_fopen_read [file size in MB]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "Unicode.h"
+#include "Af_stdio.h"
+
+using namespace unitex;
+
+#define LINE_SIZE 8192
+
+static long long total_checksum=0;
+
+static unsigned int seed=12345;
+
+static unsigned int next_random() {
+seed^=seed<<13;
+seed^=seed>>17;
+seed^=seed<<5;
+return seed;
+}
+
+
+/**
+ * Writes lines of random words in 'name' until 'size' bytes are written.
+ * If 'cyrillic' is set, the letters are taken from the Cyrillic block.
+ * If 'ascii' is set, there is no accented letter. Returns the size of the file.
+ */
+static long write_text(const char* name,Encoding encoding,long size,int cyrillic,int ascii) {
+static const unichar accents[]={0xE0,0xE7,0xE8,0xE9,0xEA,0xF4};
+U_FILE* f=u_fopen(encoding,name,U_WRITE);
+if (f==NULL) {
+   fatal_error("Cannot create %s\n",name);
+}
+while (ftell(f)<size) {
+   int words=1+next_random()%20;
+   for (int i=0;i<words;i++) {
+      int length=1+next_random()%10;
+      for (int j=0;j<length;j++) {
+         unichar c;
+         if (cyrillic) c=(unichar)(0x430+next_random()%32);
+         else if (!ascii && next_random()%20==0) c=accents[next_random()%6];
+         else c=(unichar)('a'+next_random()%26);
+         u_fputc(c,f);
+      }
+      u_fputc(i==words-1 ? '.' : ' ',f);
+   }
+   u_fputc('\n',f);
+}
+size=ftell(f);
+u_fclose(f);
+return size;
+}
+
+
+/**
+ * Reads the whole file with the given function.
+ * Returns a checksum of what has been read.
+ */
+static long long read_text(const char* name,Encoding encoding,int function) {
+static unichar line[LINE_SIZE];
+U_FILE* f=u_fopen(encoding,name,U_READ);
+if (f==NULL) {
+   fatal_error("Cannot open %s\n",name);
+}
+long long checksum=0;
+int c;
+switch (function) {
+   case 0: {
+      while ((c=u_fgetc(f))!=EOF) checksum+=c;
+      break;
+   }
+   case 1: {
+      while ((c=u_fgets(line,LINE_SIZE,f))!=EOF) checksum+=c+line[0];
+      break;
+   }
+   default: {
+      unichar* buffer=NULL;
+      size_t size=0;
+      while ((c=u_fgets_dynamic_buffer(&buffer,&size,f))!=EOF) checksum+=c+buffer[0];
+      free(buffer);
+   }
+}
+u_fclose(f);
+return checksum;
+}
+
+
+static void measure(const char* label,const char* name,Encoding encoding,long size) {
+static const char* functions[]={"u_fgetc","u_fgets","u_fgets_dynamic_buffer"};
+u_printf("%-15s",label);
+for (int function=0;function<3;function++) {
+   double best=1e30;
+   long long checksum=0;
+   for (int run=0;run<3;run++) {
+      clock_t start=clock();
+      checksum=read_text(name,encoding,function);
+      double t=(double)(clock()-start)/CLOCKS_PER_SEC;
+      if (t<best) best=t;
+   }
+   u_printf("  %s %7.0f MB/s",functions[function],size/best/1e6);
+   total_checksum+=checksum;
+}
+u_printf("\n");
+}
+
+
+int main(int argc,char* argv[]) {
+long size=((argc>1) ? atol(argv[1]) : 20)*1000000L;
+const char* name="u_fopen_read.txt";
+struct {
+   const char* label;
+   Encoding encoding;
+   int cyrillic;
+   int ascii;
+} texts[]={
+   {"UTF16-LE",UTF16_LE,0,0},
+   {"UTF16-BE",BIG_ENDIAN_UTF16,0,0},
+   {"UTF8 (Latin)",UTF8,0,0},
+   {"UTF8 (Cyrillic)",UTF8,1,0},
+   {"ASCII",ASCII,0,1},
+};
+for (size_t i=0;i<sizeof(texts)/sizeof(texts[0]);i++) {
+   long real_size=write_text(name,texts[i].encoding,size,texts[i].cyrillic,texts[i].ascii);
+   measure(texts[i].label,name,texts[i].encoding,real_size);
+}
+af_remove(name);
+u_printf("(checksum %lld)\n",total_checksum);
+return 0;
+}
@@ -0,0 +1,139 @@
+#!/bin/sh
+# =============================================================================
+# Unitex/GramLab Cassys in-memory cascade check
+# =============================================================================
+# Copyright (C) 2020 Université Paris-Est Marne-la-Vallée <unitex@univ-mlv.fr>
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this program; if not, write to the Free Software
+# Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+#
+# =============================================================================
+# Runs the same cascade with Cassys in the default mode and with
+# -M/--in_memory, and checks that both modes give:
+#  - the same final text_csc.txt and text_csc.raw files;
+#  - for each transducer, the same text.cod, tokens.txt and concord.ind.
+# The in-memory mode does not write the other files of the intermediate snt
+# directories (enter.pos, stats.n, tok_by_*.txt, snt_offsets.pos) nor the
+# labeled .snt texts, so they are not compared. No transducer of the cascade
+# glues its outputs to the surrounding text, which is the case where the
+# tokens of both modes differ. See the -M entry in the usage of Cassys.
+#
+# The text, alphabet and grammars are generated, so the check only needs a
+# UnitexToolLogger binary:
+#
+#   misc/tools/check_cassys_in_memory.sh bin/UnitexToolLogger [WORK_DIR]
+#
+# The exit status is 0 if the two modes agree, 1 otherwise.
+# =============================================================================
+# This shell script must work in any POSIX-like system, including systems without
+# bash. See this helpful document on writing portable shell scripts:
+# @see http://www.gnu.org/s/hello/manual/autoconf/Portable-Shell.html
+# =============================================================================
+THIS_SCRIPT_NAME=$(basename -- "$0")             # This script name
+
+if [ $# -lt 1 ] || [ ! -x "$1" ]; then
+  echo "Usage: $THIS_SCRIPT_NAME UNITEX_TOOL_LOGGER [WORK_DIR]" >&2
+  exit 2
+fi
+UNITEX_TOOL_LOGGER=$(cd -P -- "$(dirname -- "$1")" && pwd -P)/$(basename -- "$1")
+WORK_DIR=${2:-$(mktemp -d "${TMPDIR:-/tmp}/cassys_check.XXXXXX")}
+mkdir -p "$WORK_DIR/input" || exit 2
+cd "$WORK_DIR/input" || exit 2
+
+# =============================================================================
+# Input: alphabet, text and a cascade of 4 transducers (3 in merge mode, with
+# lexical tags that are matched by the following ones, and 1 in replace mode)
+# =============================================================================
+for l in a b c d e f g h i j k l m n o p q r s t u v w x y z; do
+  printf '%s%s\n' "$(echo "$l" | tr 'a-z' 'A-Z')" "$l"
+done > Alphabet.txt
+
+i=0
+while [ $i -lt 40 ]; do
+  cat << EOF
+The cat sat on the mat, and a dog ran in 3 houses.
+Mary saw the big dog near a house ; the cat runs fast 12 times.
+A dog , a cat and the house : John saw 7 of them.
+The the cat , dog house a a dog 5.
+EOF
+  i=$((i+1))
+done > text.txt
+
+# In a .fst2, each state line ends with a space, hence the printf formats
+printf -- '0000000001\n-1 g1\n: 1 1 \n: 2 2 3 2 \n: 4 3 \nt \nf \n' > g1.fst2
+printf -- '%%<E>\n%%<E>/{\n%%the\n%%a\n%%<E>/,.DET}\nf\n' >> g1.fst2
+
+printf -- '0000000001\n-1 g2\n: 1 1 \n: 2 2 3 2 5 2 \n: 4 3 \nt \nf \n' > g2.fst2
+printf -- '%%<E>\n%%<E>/{\n%%cat\n%%dog\n%%<E>/,.N}\n%%house\nf\n' >> g2.fst2
+
+printf -- '0000000001\n-1 g3\n: 1 1 \n: 2 2 \n: 3 3 \n: 4 4 \nt \nf \n' > g3.fst2
+printf -- '%%<E>\n%%<E>/{\n%%<DET>\n%%<N>\n%%<E>/,.NP}\nf\n' >> g3.fst2
+
+printf -- '0000000001\n-1 g4\n: 1 1 \n: 2 2 \n: 2 2 3 3 \nt \nf \n' > g4.fst2
+printf -- '%%<E>\n%%<MOT>\n%%<NB>\n%%<E>/ NUM\nf\n' >> g4.fst2
+
+"$UNITEX_TOOL_LOGGER" Normalize text.txt > normalize.log 2>&1 || {
+  echo "Normalize failed, see $WORK_DIR/input/normalize.log" >&2
+  exit 2
+}
+
+# =============================================================================
+# Runs the cascade in the given directory, with the given extra arguments
+# =============================================================================
+run_cascade() {
+  mkdir -p "$WORK_DIR/$1" && cp Alphabet.txt text.snt g1.fst2 g2.fst2 g3.fst2 g4.fst2 "$WORK_DIR/$1/" || exit 2
+  dir=$1
+  shift
+  (cd "$WORK_DIR/$dir" && mkdir -p text_snt &&
+   "$UNITEX_TOOL_LOGGER" Tokenize -a Alphabet.txt text.snt > tokenize.log 2>&1 &&
+   "$UNITEX_TOOL_LOGGER" Cassys -a Alphabet.txt -t text.snt\
+     -s g1.fst2 -m M -s g2.fst2 -m M -s g3.fst2 -m M -s g4.fst2 -m R "$@" > cassys.log 2>&1) || {
+    echo "Cassys failed, see $WORK_DIR/$dir/cassys.log" >&2
+    exit 2
+  }
+}
+
+run_cascade files
+run_cascade memory -M
+
+# =============================================================================
+# Comparison
+# =============================================================================
+cd "$WORK_DIR" || exit 2
+status=0
+compare() {
+  if [ ! -f "files/$1" ] || [ ! -f "memory/$1" ]; then
+    echo "MISSING $1"
+    status=1
+  elif ! cmp -s "files/$1" "memory/$1"; then
+    echo "DIFFERS $1"
+    status=1
+  fi
+}
+compare text_csc.txt
+compare text_csc.raw
+stages=0
+for d in files/text_csc/text_*_snt; do
+  stage=${d#files/}
+  for f in text.cod tokens.txt concord.ind; do
+    if [ -f "files/$stage/$f" ]; then
+      compare "$stage/$f"
+    fi
+  done
+  stages=$((stages+1))
+done
+if [ $status -eq 0 ]; then
+  echo "OK: the in-memory cascade gives the same results ($stages snt directories compared in $WORK_DIR)"
+fi
+exit $status